@@ -0,0 +1,114 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_CLOCK_SYNC_HPP
+#define URX_CLOCK_SYNC_HPP
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace urx {
+
+    /**
+     * \brief Online estimate of the mapping between controller and host time
+     *
+     * Every frame from the controller carries 'timestamp' (seconds
+     * since controller boot) and is received at some local time. The
+     * observed difference (host - controller) is the true offset plus a
+     * transport delay that is always positive, so the lower envelope of
+     * the observations is the best estimate of the offset.
+     *
+     * The samples are grouped into buckets, the minimum of each bucket
+     * is kept and a line is fitted through the last N minimas. The slope
+     * of the line is the drift between the two clocks, and the largest
+     * residual is reported as the error bound of the mapping.
+     *
+     * Note that the minimum transport delay can not be observed, so all
+     * mappings are relative to "controller time + fastest delivery".
+     *
+     * add() is expected to be called from a single thread, the
+     * conversion functions can be called from anywhere.
+     */
+    class Clock_Sync
+    {
+    public:
+        /**
+         * \param bucket_size number of samples to reduce to a single minima
+         * \param buckets number of minimas to fit the line to
+         */
+        Clock_Sync(std::size_t bucket_size = 50, std::size_t buckets = 20);
+
+        /**
+         * \brief add new observation
+         *
+         * \param ur_ts controller timestamp [s]
+         * \param host_ns local CLOCK_MONOTONIC [ns] when frame was received
+         */
+        void add(double ur_ts, int64_t host_ns);
+
+        /**
+         * \return true once enough samples have been seen to produce an estimate
+         */
+        bool valid() const;
+
+        /**
+         * \brief map controller time to host CLOCK_MONOTONIC
+         *
+         * \return host time [ns], 0 if no estimate is available
+         */
+        int64_t to_host_ns(double ur_ts) const;
+
+        /**
+         * \brief map host CLOCK_MONOTONIC to controller time
+         *
+         * \return controller time [s], negative if no estimate is available
+         */
+        double to_controller(int64_t host_ns) const;
+
+        /**
+         * \return estimated drift of controller clock relative to host [ppm]
+         */
+        double drift_ppm() const;
+
+        /**
+         * \return largest deviation of the minimas from the fitted line [ns]
+         */
+        int64_t error_bound_ns() const;
+
+        void reset();
+
+    private:
+        struct Point {
+            double x;           // controller time [s]
+            double y;           // host - controller [ns]
+        };
+
+        const std::size_t bucket_size_;
+        const std::size_t buckets_;
+
+        // current (incomplete) bucket, only touched by add()
+        std::size_t in_bucket_;
+        Point bucket_min_;
+
+        // ring of completed bucket minimas, only touched by add()
+        std::vector<Point> minimas_;
+        std::size_t head_;
+        std::size_t num_minimas_;
+
+        // fitted model, y = a + b * (x - x0)
+        mutable std::mutex model_lock_;
+        bool valid_;
+        double x0_;
+        double a_;
+        double b_;
+        double err_;
+
+        void fit();
+    };
+}
+#endif  // URX_CLOCK_SYNC_HPP
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_CODEC_HPP
+#define URX_CODEC_HPP
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Lossless codecs for blocks of telemetry, one column at a time.
+ *
+ * xor_*: doubles, after Gorilla (Pelkonen et al., VLDB 2015). Each
+ * value is XORed with the previous one, and only the meaningful bits
+ * of the XOR are stored, reusing the previous leading/trailing-zero
+ * window when it fits:
+ *
+ *   '0'                           same value
+ *   '10' <bits>                   inside the previous window
+ *   '11' <lead:5> <len:6> <bits>  new window (len 0 means 64)
+ *
+ * dod_*: integers (timestamps in ns, seqnrs, registers, modes). The
+ * delta-of-delta is zigzag-encoded into the smallest bucket:
+ *
+ *   '0'                 0
+ *   '10'    7 bits      '110'   14 bits    '1110'  20 bits
+ *   '11110' 32 bits     '11111' 64 bits
+ *
+ * The buckets are wider than Gorilla's (which has second resolution),
+ * 14 bits covers the few us of receive jitter on a ns timestamp.
+ *
+ * The first value is stored raw (64 bits). Both decoders work on a
+ * whole block: the bit stream is parsed into plain XORs/deltas first,
+ * and the values are then rebuilt by a separate prefix pass over the
+ * contiguous output.
+ */
+namespace urx {
+    /**
+     * \brief append n doubles, encoded, to out
+     */
+    void xor_encode(const double *v, std::size_t n, std::vector<uint8_t>& out);
+
+    /**
+     * \brief decode n doubles from sz bytes
+     *
+     * \return false if the input is too short
+     */
+    bool xor_decode(const uint8_t *in, std::size_t sz, std::size_t n, double *out);
+
+    void dod_encode(const int64_t *v, std::size_t n, std::vector<uint8_t>& out);
+    bool dod_decode(const uint8_t *in, std::size_t sz, std::size_t n, int64_t *out);
+}
+#endif  // URX_CODEC_HPP
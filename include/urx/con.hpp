@@ -11,10 +11,61 @@
 #include <string>
 #include <stdbool.h>
 #include <exception>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 namespace urx {
     constexpr int RTDE_PORT = 30004;
     constexpr int URX_PORT = 30002;
+    constexpr int DASHBOARD_PORT = 29999;
+
+    // do_recv()/recv_for() return codes besides -1 (error)
+    constexpr int CON_TIMEOUT = -3;     // nothing arrived before the deadline
+    constexpr int CON_CANCELLED = -4;   // woken up by cancel()
+    constexpr int CON_WAIT_FOREVER = -1;
+
+    constexpr int CON_CONNECT_TIMEOUT_MS = 2000;
+    constexpr int CON_ATTEMPT_DELAY_MS = 250;   // head start per address (RFC 8305)
+
+    /**
+     * \brief socket options for latency-critical connections
+     *
+     * The default is what Con has always done (TCP_NODELAY only if
+     * asked for in do_connect()). Options the kernel refuses (busy
+     * polling and high priorities typically need CAP_NET_ADMIN) are
+     * reported and otherwise ignored.
+     */
+    struct Con_Profile {
+        bool nodelay{false};
+        int busy_poll_us{0};            // SO_BUSY_POLL, 0: off
+        bool prefer_busy_poll{false};   // SO_PREFER_BUSY_POLL
+        bool quickack{false};           // TCP_QUICKACK, re-armed after every read
+        // SO_RCVLOWAT = data frame size while streaming. Text messages
+        // and control replies received while streaming are shorter and
+        // are delayed until the next frame, i.e. by up to one cycle.
+        bool rcvlowat_frame{false};
+        int priority{-1};               // SO_PRIORITY, -1: leave
+        int tos{-1};                    // IP_TOS, -1: leave
+        int spin_us{0};                 // spin on MSG_DONTWAIT before blocking
+
+        /**
+         * \brief everything on, EF (46) DSCP marking and 50us spin/busy-poll
+         */
+        static Con_Profile low_latency()
+        {
+            Con_Profile p;
+            p.nodelay = true;
+            p.busy_poll_us = 50;
+            p.prefer_busy_poll = true;
+            p.quickack = true;
+            p.rcvlowat_frame = true;
+            p.priority = 6;
+            p.tos = 46 << 2;
+            p.spin_us = 50;
+            return p;
+        }
+    };
     class Con
     {
     public:
@@ -22,29 +73,109 @@ namespace urx {
             remote_(remote),
             port_(port),
             sock_(-1),
-            connected_(false)
+            connected_(false),
+            nodelay_(false),
+            recv_timeout_ms_(CON_WAIT_FOREVER),
+            connect_timeout_ms_(CON_CONNECT_TIMEOUT_MS),
+            cancel_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
         {};
 
-        virtual ~Con() { disconnect(); }
+        virtual ~Con()
+        {
+            disconnect();
+            if (cancel_fd_ >= 0)
+                close(cancel_fd_);
+        }
 
         // Avoid libc-names like 'connect', 'send' etc
         virtual void disconnect();
+
+        /**
+         * \brief connect to remote (hostname, IPv4 or IPv6 literal)
+         *
+         * All addresses the name resolves to are tried, IPv6 and IPv4
+         * interleaved. Each gets CON_ATTEMPT_DELAY_MS before the next
+         * is started in parallel and the first to complete wins
+         * ("happy eyeballs"). Gives up after the connect timeout,
+         * which covers the name lookup as well.
+         */
         virtual bool do_connect(bool nodelay = false);
 
+        /**
+         * \brief upper bound for do_connect(), default CON_CONNECT_TIMEOUT_MS
+         */
+        void set_connect_timeout(int timeout_ms) { connect_timeout_ms_ = timeout_ms; }
+        int connect_timeout() const { return connect_timeout_ms_; }
+
+        /**
+         * \brief close socket and connect again (with the same options)
+         */
+        virtual bool reconnect();
+
         virtual int  do_send(void *sbuf, int ssz);
 
         /**
          * do_recv() receive update from the robot
          *
+         * Waits at most for the timeout set by set_recv_timeout()
+         * (default forever).
+         *
          * @param rbuf : buffer to store incoming URx data into
          * @param rsz : size of buffer
          * @param ts : local timestamp (ns) for when frame was received.
          *
-         * @returns: bytes stored in buffer
+         * @returns: bytes stored in buffer, -1 on error, CON_TIMEOUT or
+         * CON_CANCELLED. If the remote closed the connection (or it
+         * failed hard), the connection is marked as disconnected.
          */
         int  do_recv(void *rbuf, int rsz) { return do_recv(rbuf, rsz, NULL); };
         virtual int  do_recv(void *rbuf, int rsz, unsigned long *ts);
 
+        /**
+         * \brief receive with an explicit deadline
+         *
+         * \param timeout_ms max time to wait, 0 to only take what is
+         * already queued, CON_WAIT_FOREVER to block.
+         *
+         * \return as do_recv()
+         */
+        virtual int recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *ts);
+
+        /**
+         * \brief non-blocking receive, CON_TIMEOUT if nothing is queued
+         */
+        int try_recv(void *rbuf, int rsz, unsigned long *ts = NULL) { return recv_for(rbuf, rsz, 0, ts); }
+
+        /**
+         * \brief default deadline for do_recv() and do_send_recv()
+         */
+        void set_recv_timeout(int timeout_ms) { recv_timeout_ms_ = timeout_ms; }
+        int recv_timeout() const { return recv_timeout_ms_; }
+
+        /**
+         * \brief wake up a thread blocked in receive
+         *
+         * The (next) receive returns CON_CANCELLED. Safe to call from
+         * any thread. If nobody was waiting the cancellation stays
+         * pending, use clear_cancel() once the receiver is gone.
+         */
+        virtual void cancel();
+        virtual void clear_cancel();
+
+        /**
+         * \brief set socket tuning, applied now and on every (re)connect
+         */
+        void set_profile(const Con_Profile& profile);
+        const Con_Profile& profile() const { return profile_; }
+
+        /**
+         * \brief do not wake up a receiver for less than bytes
+         *
+         * Only meaningful when all messages are at least this large, so
+         * it should be reset to 1 before any short request/response.
+         */
+        bool set_rcvlowat(int bytes);
+
         virtual int  do_send_recv(void *sbuf, int ssz, void *rbuf, int rsz);
 
         bool is_connected() { return connected_; }
@@ -53,6 +184,25 @@ namespace urx {
         int port_;
         int sock_;
         bool connected_;
+        bool nodelay_;
+        int recv_timeout_ms_;
+        int connect_timeout_ms_;
+        int cancel_fd_;
+        Con_Profile profile_;
+
+    private:
+        void apply_profile();
+        int finish_recv(ssize_t read_sz, void *rbuf, int rsz, unsigned long *rx_ts);
     };
+
+    /**
+     * \brief connect several connections at once
+     *
+     * Each connection is bounded by its own connect timeout, so with N
+     * arms this takes as long as the slowest one instead of the sum.
+     *
+     * \return number of connections that are connected
+     */
+    int connect_all(const std::vector<Con *>& cons, bool nodelay = false);
 }
 #endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_CON_SHM_HPP
+#define URX_CON_SHM_HPP
+#include <urx/con.hpp>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+namespace urx {
+    constexpr std::size_t SHM_RING_SZ = 64 * 1024;     // per direction
+    constexpr uint32_t SHM_MAGIC = 0x55525853;          // "URXS"
+
+    /**
+     * \brief single-producer/single-consumer message ring
+     *
+     * Lives in shared memory. head and tail are running byte offsets,
+     * only written by the producer and consumer respectively. Each
+     * message is a 32 bit length followed by the payload, padded to 8
+     * bytes. seq is bumped for every message so that an idle consumer
+     * can sleep on it with a (process-shared) futex.
+     */
+    struct Shm_Ring {
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) std::atomic<uint32_t> seq;
+        std::atomic<uint32_t> waiters;
+        alignas(64) unsigned char data[SHM_RING_SZ];
+    };
+
+    struct Shm_Channel {
+        uint32_t magic;
+        uint32_t ring_sz;
+        std::atomic<uint32_t> server_up;
+        std::atomic<uint32_t> client_up;      // 0: not yet, 1: up, 2: gone
+        Shm_Ring down;          // server -> client
+        Shm_Ring up;            // client -> server
+    };
+
+    enum Shm_Role {
+        SHM_CLIENT,
+        SHM_SERVER
+    };
+
+    /**
+     * \brief Con over a pair of shared-memory rings
+     *
+     * For a simulator or proxy on the same host. The server side
+     * (simulator, proxy, or a test) creates the POSIX shared memory
+     * object, the client attaches to it by name:
+     *
+     *    new RTDE_Handler(new Con_Shm("/urx-rtde"))
+     *
+     * Every do_send() becomes one message and every receive returns one
+     * message, so the handlers see exactly the frames they would get
+     * over TCP. A message larger than the receive buffer is truncated.
+     *
+     * A receiver with data waiting never enters the kernel, an idle one
+     * sleeps in futex(). Timeouts, cancel() and the profile spin work
+     * as for the socket.
+     */
+    class Con_Shm : public Con
+    {
+    public:
+        Con_Shm(const std::string name, Shm_Role role = SHM_CLIENT) :
+            Con(name, 0),
+            role_(role),
+            ch_(nullptr),
+            cancelled_(false)
+        {};
+
+        virtual ~Con_Shm();
+
+        void disconnect();
+        bool do_connect(bool nodelay = false);
+        int do_send(void *sbuf, int ssz);
+        int recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *ts);
+        void cancel();
+        void clear_cancel();
+
+    private:
+        Shm_Ring *rx() { return role_ == SHM_SERVER ? &ch_->up : &ch_->down; }
+        Shm_Ring *tx() { return role_ == SHM_SERVER ? &ch_->down : &ch_->up; }
+        bool peer_up();
+        int take(Shm_Ring *r, void *rbuf, int rsz, unsigned long *ts);
+
+        const Shm_Role role_;
+        Shm_Channel *ch_;
+        std::atomic<bool> cancelled_;
+    };
+}
+#endif  // URX_CON_SHM_HPP
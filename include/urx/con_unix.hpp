@@ -0,0 +1,35 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_CON_UNIX_HPP
+#define URX_CON_UNIX_HPP
+#include <urx/con.hpp>
+
+namespace urx {
+    /**
+     * \brief Con over an AF_UNIX stream socket
+     *
+     * For a proxy or simulator on the same host, skipping the TCP/IP
+     * loopback stack. Carries the same byte stream as the TCP
+     * connection, so handlers work unmodified:
+     *
+     *    new RTDE_Handler(new Con_Unix("/run/urx/rtde.sock"))
+     *
+     * A path starting with '@' is in the abstract namespace. TCP
+     * options in the profile do not apply and are ignored.
+     */
+    class Con_Unix : public Con
+    {
+    public:
+        Con_Unix(const std::string path) :
+            Con(path, 0)
+        {};
+
+        bool do_connect(bool nodelay = false);
+    };
+}
+#endif  // URX_CON_UNIX_HPP
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_CON_URING_HPP
+#define URX_CON_URING_HPP
+#include <urx/con.hpp>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <atomic>
+
+namespace urx {
+    constexpr unsigned URING_ENTRIES = 32;
+    constexpr unsigned URING_BUFS = 16;         // receive buffers handed to the kernel
+    constexpr unsigned URING_BUF_SZ = 2048;     // RTDE frames are at most 2000 bytes
+    constexpr unsigned URING_SEND_SLOTS = 4;    // largest linked send is 4 slots
+
+    struct Uring;
+
+    struct Uring_Stats {
+        uint64_t enters;        // io_uring_enter() calls, both rings
+        uint64_t frames;        // receive completions consumed
+        uint64_t sends;
+        uint64_t rearms;        // multishot receive (re)armed
+    };
+
+    /**
+     * \brief Con using io_uring instead of poll()/recvfrom()/send()
+     *
+     * A multishot receive stays armed on the socket and fills buffers
+     * provided to the kernel up front, so a frame that has already
+     * arrived is picked up from the completion queue without any
+     * syscall, and waiting for one costs a single io_uring_enter()
+     * (which also hands consumed buffers back).
+     *
+     * Sends are copied into registered (fixed) buffers and written
+     * with WRITE_FIXED, larger sends as a linked chain so the pieces
+     * stay in order. Submitting and waiting for the result is a single
+     * enter. Send and receive use separate rings so that a sender and
+     * the receiver thread never share a queue.
+     *
+     * If the kernel refuses io_uring (too old, disabled by sysctl or
+     * seccomp) the connection falls back to the plain Con socket path.
+     */
+    class Con_Uring : public Con
+    {
+    public:
+        Con_Uring(const std::string remote, int port) :
+            Con(remote, port),
+            rx_(nullptr),
+            tx_(nullptr),
+            bufs_(nullptr),
+            bufs_sz_(0),
+            ready_head_(0),
+            ready_cnt_(0),
+            provided_(0),
+            recv_armed_(false),
+            cancel_armed_(false),
+            eof_(false),
+            cancelled_(false),
+            rx_err_(0),
+            enters_(0),
+            frames_(0),
+            sends_(0),
+            rearms_(0)
+        {};
+
+        virtual ~Con_Uring();
+
+        void disconnect();
+        bool do_connect(bool nodelay = false);
+        int do_send(void *sbuf, int ssz);
+        int recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *ts);
+        void clear_cancel();
+
+        /**
+         * \return true if io_uring is in use (false: socket fallback)
+         */
+        bool uring() const { return rx_ != nullptr; }
+
+        Uring_Stats stats() const;
+
+    private:
+        bool setup_ring();
+        void teardown_ring();
+        void reap_rx();
+        void arm_recv();
+        void arm_cancel();
+        void provide(uint16_t bid);
+        int take(void *rbuf, int rsz, unsigned long *ts);
+        int rx_enter(unsigned min_complete, int timeout_ms);
+
+        Uring *rx_;
+        Uring *tx_;
+        std::mutex tx_lock_;
+
+        // URING_BUFS receive buffers followed by URING_SEND_SLOTS send slots
+        unsigned char *bufs_;
+        std::size_t bufs_sz_;
+
+        struct Rx_Frame {
+            uint16_t bid;
+            int len;
+            int off;            // already handed out by take()
+            unsigned long ts;
+        };
+        // completed receives not yet consumed, at most one per buffer
+        Rx_Frame ready_[URING_BUFS];
+        unsigned ready_head_;
+        unsigned ready_cnt_;
+        unsigned provided_;     // buffers currently owned by the kernel
+
+        bool recv_armed_;
+        bool cancel_armed_;
+        bool eof_;
+        bool cancelled_;
+        int rx_err_;
+
+        std::atomic<uint64_t> enters_;
+        std::atomic<uint64_t> frames_;
+        std::atomic<uint64_t> sends_;
+        std::atomic<uint64_t> rearms_;
+    };
+}
+#endif  // URX_CON_URING_HPP
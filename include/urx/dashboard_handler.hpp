@@ -0,0 +1,123 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_DASHBOARD_HANDLER_HPP
+#define URX_DASHBOARD_HANDLER_HPP
+
+#include <urx/handler.hpp>
+#include <urx/con.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+namespace urx {
+    /**
+     * \brief Client for the Dashboard server (port 29999)
+     *
+     * Commands are newline-terminated text, and the server answers each
+     * with a single line, in order. Instead of waiting for each answer
+     * before sending the next command, commands are written to the
+     * socket as they come (pipelined) and a promise is queued for each.
+     * A reader thread matches incoming lines to the queue in FIFO order.
+     *
+     * A batch of commands is written with a single send(), so a startup
+     * sequence costs a single round-trip, and batches to several robots
+     * can be issued before waiting for any of them.
+     *
+     * If the connection is lost, all pending futures resolve to an
+     * empty string (the server never sends empty lines).
+     */
+    class Dashboard_Handler : public Handler
+    {
+    public:
+        /**
+         * \brief connect, but do *not* start the reader
+         *
+         * Mostly for testing, see handle_incoming().
+         */
+        Dashboard_Handler(Con *c) : Handler(c), reading_(false), welcomed_(false)
+        {
+            con_->do_connect(true);
+        };
+
+        Dashboard_Handler(const std::string remote) :
+            Dashboard_Handler(new Con(remote, DASHBOARD_PORT))
+        {
+            start();
+        };
+
+        ~Dashboard_Handler();
+
+        /**
+         * \brief start the reader thread
+         */
+        bool start();
+
+        /**
+         * \brief say goodbye to the server and stop the reader
+         */
+        void stop();
+
+        /**
+         * \brief send single command
+         *
+         * \return future with the response (without trailing newline)
+         */
+        std::future<std::string> command(const std::string& cmd);
+
+        /**
+         * \brief send several commands in one go
+         *
+         * \return futures, in the same order as cmds
+         */
+        std::vector<std::future<std::string>> batch(const std::vector<std::string>& cmds);
+
+        // Common commands
+        std::future<std::string> power_on() { return command("power on"); }
+        std::future<std::string> power_off() { return command("power off"); }
+        std::future<std::string> brake_release() { return command("brake release"); }
+        std::future<std::string> load(const std::string& program) { return command("load " + program); }
+        std::future<std::string> play() { return command("play"); }
+        std::future<std::string> pause() { return command("pause"); }
+        std::future<std::string> stop_program() { return command("stop"); }
+        std::future<std::string> robotmode() { return command("robotmode"); }
+        std::future<std::string> safetystatus() { return command("safetystatus"); }
+        std::future<std::string> close_popup() { return command("close popup"); }
+        std::future<std::string> unlock_protective_stop() { return command("unlock protective stop"); }
+
+        /**
+         * \brief handle bytes received from the server
+         *
+         * Called by the reader, exposed to allow testing without a
+         * live connection.
+         */
+        void handle_incoming(const char *buf, std::size_t len);
+
+        /**
+         * \return number of commands awaiting a response
+         */
+        std::size_t pending();
+
+    private:
+        void reader();
+        void fail_pending();
+
+        std::mutex lock_;
+        std::deque<std::promise<std::string>> pending_;
+        std::string partial_;
+
+        std::thread reader_;
+        std::atomic<bool> reading_;
+        bool welcomed_;
+    };
+}
+#endif  // URX_DASHBOARD_HANDLER_HPP
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_DECODE_PLAN_HPP
+#define URX_DECODE_PLAN_HPP
+#include <urx/magic.h>
+#include <urx/rtde_recipe.hpp>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace urx {
+    /**
+     * \brief where one recipe field is in the payload
+     */
+    struct Decode_Step {
+        std::string field;
+        std::size_t offset;             // into the payload handed to the sinks
+        enum RTDE_DATA_TYPE type;       // as registered (VECTOR6D etc)
+        enum RTDE_DATA_TYPE scalar;     // element type
+        int count;                      // elements, 1, 3 or 6
+        int col;                        // first column
+    };
+
+    /**
+     * \brief flat, per-scalar, view of an output recipe
+     *
+     * Each scalar in the recipe is one column, so VECTOR6D actual_q
+     * becomes actual_q[0] .. actual_q[5]. Used by consumers of the raw
+     * frames (RTDE_Frame_Sink) to decode the payload without going
+     * through the recipe storage. STRING fields are skipped.
+     *
+     * Signals of an attached Derived_Signals stage are appended as
+     * DOUBLE columns after the recipe fields.
+     */
+    class Decode_Plan
+    {
+    public:
+        Decode_Plan() : key_offset_(-1) {};
+        explicit Decode_Plan(RTDE_Recipe *recipe);
+
+        const std::vector<Decode_Step>& steps() const { return steps_; }
+
+        std::size_t num_columns() const { return names_.size(); }
+        const std::string& column_name(int col) const { return names_[col]; }
+        const std::string& column_field(int col) const { return fields_[col]; }
+        enum RTDE_DATA_TYPE column_type(int col) const { return types_[col]; }
+
+        /**
+         * \param component element of a vector field (0 for scalars)
+         * \return column index, -1 if not in the recipe
+         */
+        int column(const std::string& field, int component = 0) const;
+        std::vector<int> columns(const std::string& field) const;
+
+        /**
+         * \brief offset of "timestamp" in the payload, -1 if not in the recipe
+         */
+        int key_offset() const { return key_offset_; }
+
+        /**
+         * \brief controller timestamp [s] if present, else local receive time
+         */
+        double key(const unsigned char *payload, unsigned long ts) const;
+
+        static void split_type(enum RTDE_DATA_TYPE type, enum RTDE_DATA_TYPE& scalar, int& count);
+
+        /**
+         * \brief one big-endian scalar from the wire as double
+         */
+        static double decode(const unsigned char *p, enum RTDE_DATA_TYPE scalar);
+
+        /**
+         * \brief one big-endian scalar to host order, type_to_size(scalar) bytes
+         */
+        static void to_host(const unsigned char *p, enum RTDE_DATA_TYPE scalar, void *dst);
+
+    private:
+        std::vector<Decode_Step> steps_;
+        std::vector<std::string> names_;
+        std::vector<std::string> fields_;
+        std::vector<enum RTDE_DATA_TYPE> types_;
+        int key_offset_;
+    };
+}
+#endif  // URX_DECODE_PLAN_HPP
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_DERIVED_HPP
+#define URX_DERIVED_HPP
+#include <urx/magic.h>
+#include <urx/rtde_recipe.hpp>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace urx {
+    enum Derived_Op {
+        DERIVED_PRODUCT,        // a * b, element-wise
+        DERIVED_DIFFERENCE,     // a - b
+        DERIVED_SUM,            // a + b
+        DERIVED_SCALE,          // k * a
+        DERIVED_NORM,           // euclidean norm of some elements of a
+        DERIVED_LOWPASS,        // y += k * (a - y), first order
+    };
+
+    /**
+     * \brief one derived signal, values are doubles
+     */
+    struct Derived_Signal {
+        std::string name;
+        Derived_Op op;
+        int a;                  // first value slot of the operands
+        int b;
+        int a_width;            // 1: broadcast over the other operand
+        int b_width;
+        double k;
+        int width;              // 1, 3 or 6 values
+        int slot;               // first value slot of the result
+        std::size_t offset;     // into the frame handed to the sinks
+    };
+
+    /**
+     * \brief per-frame compute stage of an output recipe
+     *
+     * Signals are declared once, by name, over the fields of the
+     * recipe or over signals declared before them:
+     *
+     *    urx::Derived_Signals d(recipe);
+     *    d.product("joint_power", "actual_current", "actual_joint_voltage");
+     *    d.difference("tracking_error", "target_q", "actual_q");
+     *    d.norm("tcp_speed", "actual_TCP_speed", 0, 3);
+     *    d.lowpass("current_lp", "actual_current", 0.1);
+     *    d.attach();
+     *
+     * Once attached, the recipe runs the stage for every parsed frame
+     * on the receiver, before the sinks. The operands are decoded once,
+     * the expressions are evaluated over whole vectors and the results
+     * are appended to a copy of the payload, big-endian like the wire
+     * data. A Decode_Plan built after attach() lists them as extra
+     * columns, so History, Log_Writer and other sinks see them as if
+     * the controller had sent them.
+     *
+     * Declare everything and attach() after the recipe fields are
+     * final and before the consumers are created. Not thread-safe,
+     * like add_sink(). value() and values() point into storage the
+     * receiver overwrites with every frame, so they are for the
+     * receiver thread and the sinks only. Robot publishes a copy in
+     * Robot_State::derived, index it with slot().
+     */
+    class Derived_Signals
+    {
+    public:
+        explicit Derived_Signals(RTDE_Recipe *recipe);
+        ~Derived_Signals();
+
+        /**
+         * \brief element-wise, a scalar operand is applied to every element
+         *
+         * \return false on unknown operands, mismatched widths or if
+         * name is taken
+         */
+        bool product(const std::string& name, const std::string& a, const std::string& b);
+        bool difference(const std::string& name, const std::string& a, const std::string& b);
+        bool sum(const std::string& name, const std::string& a, const std::string& b);
+        bool scale(const std::string& name, const std::string& a, double k);
+
+        /**
+         * \brief sqrt of the sum of squares of count elements from first
+         *
+         * \param count all remaining elements if negative
+         */
+        bool norm(const std::string& name, const std::string& a, int first = 0, int count = -1);
+
+        /**
+         * \brief first order low-pass, starts at the first value
+         *
+         * \param alpha 0 < alpha <= 1, smaller is smoother
+         */
+        bool lowpass(const std::string& name, const std::string& a, double alpha);
+
+        bool attach();
+        void detach();
+        bool attached() const { return attached_; }
+
+        const std::vector<Derived_Signal>& signals() const { return signals_; }
+        std::size_t extra_bytes() const { return extra_bytes_; }
+
+        /**
+         * \brief results of the last frame, width() values, nullptr if unknown
+         *
+         * Receiver thread only, see the class description.
+         */
+        const double *value(const std::string& name) const;
+
+        /**
+         * \brief index of the first value of name in values(), -1 if unknown
+         */
+        int slot(const std::string& name) const;
+
+        /**
+         * \brief all values of the last frame (operands included)
+         */
+        const std::vector<double>& values() const { return vals_; }
+
+        uint64_t frames() const { return frames_; }
+
+        /**
+         * \brief evaluate one frame (called from RTDE_Recipe::parse())
+         *
+         * \return the payload with the derived values appended
+         */
+        const unsigned char *process(const unsigned char *payload, unsigned long ts);
+
+    private:
+        struct Load {
+            std::string field;
+            std::size_t offset;
+            enum RTDE_DATA_TYPE scalar;
+            int count;
+            int slot;
+        };
+
+        // value slots of a field or an earlier signal, -1 if unknown
+        int operand(const std::string& name, int& width);
+        bool taken(const std::string& name) const;
+        bool add(const std::string& name, Derived_Op op, const std::string& a, const std::string& b, double k);
+
+        RTDE_Recipe *recipe_;
+        std::vector<Load> loads_;
+        std::vector<Derived_Signal> signals_;
+        std::vector<double> vals_;
+        std::vector<unsigned char> frame_;
+        std::size_t wire_bytes_;
+        std::size_t extra_bytes_;
+        bool attached_;
+        bool primed_;
+        uint64_t frames_;
+    };
+}
+#endif  // URX_DERIVED_HPP
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_FRAME_MONITOR_HPP
+#define URX_FRAME_MONITOR_HPP
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+namespace urx {
+    // Known RTDE cycle times (e-series at 500Hz, CB3 at 125Hz)
+    constexpr double PERIOD_500HZ = 0.002;
+    constexpr double PERIOD_125HZ = 0.008;
+
+    /**
+     * \brief description of a single discontinuity in the output stream
+     */
+    struct Frame_Gap {
+        double prev_ts;         // controller timestamp of last good frame
+        double ts;              // controller timestamp of the frame that revealed the gap
+        int missed;             // number of cycles that never arrived
+        int32_t prev_seqnr;
+        int32_t seqnr;
+    };
+
+    /**
+     * \brief snapshot of the counters kept by Frame_Monitor
+     */
+    struct Frame_Stats {
+        uint64_t frames;            // frames seen in total
+        uint64_t gaps;              // number of discontinuities
+        uint64_t missed;            // sum of all missed cycles
+        uint64_t max_missed;        // largest single gap (in cycles)
+        uint64_t duplicates;        // frames with a timestamp we have already seen
+        uint64_t seqnr_regressions; // output seqnr moved backwards
+        uint64_t extrapolated;      // frames synthesized by a gap-policy
+    };
+
+    /**
+     * \brief Detect dropped controller frames
+     *
+     * The UR controller stamps every RTDE output frame with the time
+     * since boot, and this advances with exactly one cycle (2ms at
+     * 500Hz, 8ms at 125Hz) per frame. Any larger increment means one or
+     * more frames were lost somewhere between the controller and us.
+     *
+     * If no period is given, it will be learned from the first few
+     * frames and snapped to the closest known cycle time.
+     *
+     * update() is expected to be called from a single thread (the
+     * receiver), stats() can be called from anywhere.
+     */
+    class Frame_Monitor
+    {
+    public:
+        Frame_Monitor(double period = 0.0) :
+            period_(period),
+            fixed_period_(period > 0.0),
+            learn_left_(LEARN_FRAMES),
+            learn_min_(0.0),
+            prev_ts_(-1.0),
+            prev_seqnr_(0)
+        {
+            reset();
+        };
+
+        /**
+         * \brief register a new frame
+         *
+         * \param ur_ts controller timestamp [s]
+         * \param seqnr sequence number echoed back in the output registers
+         *
+         * \return number of frames missed since previous update, -1 for
+         * a duplicate or out-of-order frame
+         */
+        int update(double ur_ts, int32_t seqnr);
+
+        /**
+         * \brief set callback to fire whenever a gap is detected
+         *
+         * The callback is called from the thread calling update() and
+         * should return quickly.
+         */
+        void on_gap(std::function<void(const Frame_Gap&)> cb) { gap_cb_ = cb; };
+
+        /**
+         * \brief tag that a frame was synthesized to cover for a gap
+         */
+        void extrapolated() { extrapolated_.fetch_add(1, std::memory_order_relaxed); };
+
+        /**
+         * \return expected cycle time [s], 0.0 if not yet known
+         */
+        double period() const { return period_.load(std::memory_order_relaxed); }
+
+        Frame_Stats stats() const;
+
+        void reset();
+
+    private:
+        static constexpr int LEARN_FRAMES = 8;
+
+        std::atomic<double> period_;
+        bool fixed_period_;
+        int learn_left_;
+        double learn_min_;
+
+        double prev_ts_;
+        int32_t prev_seqnr_;
+
+        std::function<void(const Frame_Gap&)> gap_cb_;
+
+        std::atomic<uint64_t> frames_;
+        std::atomic<uint64_t> gaps_;
+        std::atomic<uint64_t> missed_;
+        std::atomic<uint64_t> max_missed_;
+        std::atomic<uint64_t> duplicates_;
+        std::atomic<uint64_t> seqnr_regressions_;
+        std::atomic<uint64_t> extrapolated_;
+
+        void learn(double delta);
+    };
+}
+#endif  // URX_FRAME_MONITOR_HPP
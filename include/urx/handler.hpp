@@ -25,6 +25,23 @@ namespace urx {
      */
     bool is_connected() { return con_->is_connected(); }
 
+    /**
+     * \brief bound how long recv() may block, see Con::set_recv_timeout()
+     */
+    void set_recv_timeout(int timeout_ms) { con_->set_recv_timeout(timeout_ms); }
+
+    /**
+     * \brief wake up a blocked receiver (Con::cancel()) and, once it
+     * has been joined, drop the cancellation again.
+     */
+    void cancel_recv() { con_->cancel(); }
+    void resume_recv() { con_->clear_cancel(); }
+
+    /**
+     * \brief socket tuning, see Con_Profile
+     */
+    void set_profile(const Con_Profile& profile) { con_->set_profile(profile); }
+
     protected:
         Con* con_;
     };
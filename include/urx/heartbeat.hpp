@@ -0,0 +1,138 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_HEARTBEAT_HPP
+#define URX_HEARTBEAT_HPP
+#include <urx/rtde_recipe.hpp>
+#include <urx/register_map.hpp>
+#include <urx/script_cache.hpp>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+namespace urx {
+    constexpr int HB_DEFAULT_MAX_MISSED = 5;
+
+    struct Heartbeat_Stats {
+        uint64_t frames;            // frames checked
+        uint64_t beats;             // host beats sent
+        uint64_t stalls;            // script heartbeat lost (max_missed reached)
+        uint64_t recoveries;        // script heartbeat back after a stall
+        double last_detect_ms;      // last script beat to detection of the stall
+        double max_detect_ms;
+        int32_t script_missed;      // host beats the script is currently missing
+        int32_t max_script_missed;  // worst seen, >= max_missed: script stopped the arm
+    };
+
+    /**
+     * \brief two-way liveness check between host and URScript
+     *
+     * The host bumps a seqnr in an input register with every input
+     * frame it sends (beat()) and tells the script how many cycles it
+     * may miss. The script bumps its own seqnr in an output register
+     * every cycle, and reports how many cycles it has gone without a
+     * new host seqnr. The integer registers are allocated from a
+     * Register_Map (so they stay clear of Trajectory_Stream), and the
+     * scripts find them through params():
+     *
+     *   ${hb_seqnr}            input, host seqnr
+     *   ${hb_limit}            input, max missed cycles, 0: disabled
+     *   ${hb_script_seqnr}     output, script seqnr
+     *   ${hb_script_missed}    output, cycles since the last new host seqnr
+     *
+     * ur_speedj.script, tcp_pose.script and ur_servoj_stream.script
+     * keep the script side and stop the arm once the host has been
+     * silent for max_missed cycles. On the host, check() runs in
+     * the receiver for every frame; it is a couple of integer compares
+     * unless the script seqnr has stood still for max_missed frames,
+     * in which case the stall callback fires once, with the time since
+     * the last script beat as detection latency.
+     *
+     * check() is expected to be called from a single thread (the
+     * receiver), beat() with the lock that protects the input recipe
+     * held and stats() from anywhere.
+     */
+    class Heartbeat
+    {
+    public:
+        Heartbeat(int max_missed = HB_DEFAULT_MAX_MISSED);
+
+        bool add_input_fields(RTDE_Recipe *in);
+        bool add_output_fields(RTDE_Recipe *out);
+
+        /**
+         * \brief register index of each heartbeat channel, keyed by name
+         */
+        Script_Params params() const;
+
+        /**
+         * \brief params() of a default Heartbeat, for scripts uploaded
+         * without one
+         */
+        static Script_Params default_params();
+
+        /**
+         * \brief keep another map from allocating the heartbeat registers
+         */
+        bool reserve(Register_Map *map) const;
+
+        /**
+         * \brief next host seqnr, call before sending the input recipe
+         */
+        void beat();
+
+        /**
+         * \brief check the script seqnr of the frame just parsed
+         *
+         * \param rx_ns local receive time of the frame [ns]
+         * \return false while the script heartbeat is lost
+         */
+        bool check(int64_t rx_ns);
+
+        /**
+         * \brief called (from check()) when the script heartbeat is lost
+         *
+         * The argument is the detection latency [ns].
+         */
+        void on_stall(std::function<void(int64_t)> cb) { stall_cb_ = cb; }
+
+        int max_missed() const { return max_missed_; }
+        bool alive() const { return !stalled_; }
+
+        Heartbeat_Stats stats() const;
+        void reset();
+
+    private:
+        const int32_t max_missed_;
+
+        // mirrors of the registers, registered with the recipes
+        int32_t host_seqnr_;
+        int32_t limit_;
+        int32_t script_seqnr_;
+        int32_t script_missed_;
+        Register_Map map_;
+
+        // receiver side
+        int32_t prev_script_;
+        bool seen_;
+        int missed_;
+        int64_t last_beat_ns_;
+        std::atomic<bool> stalled_;
+
+        std::function<void(int64_t)> stall_cb_;
+
+        std::atomic<uint64_t> frames_;
+        std::atomic<uint64_t> beats_;
+        std::atomic<uint64_t> stalls_;
+        std::atomic<uint64_t> recoveries_;
+        std::atomic<int64_t> last_detect_ns_;
+        std::atomic<int64_t> max_detect_ns_;
+        std::atomic<int32_t> cur_script_missed_;
+        std::atomic<int32_t> max_script_missed_;
+    };
+}
+#endif  // URX_HEARTBEAT_HPP
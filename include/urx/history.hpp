@@ -0,0 +1,149 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_HISTORY_HPP
+#define URX_HISTORY_HPP
+#include <urx/rtde_recipe.hpp>
+#include <urx/decode_plan.hpp>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace urx {
+    constexpr int HISTORY_READ_RETRIES = 4;
+
+    /**
+     * \brief a copy of a time window, one vector per requested column
+     */
+    struct History_Snapshot {
+        std::vector<double> ts;                 // key [s]
+        std::vector<std::vector<double>> cols;
+
+        std::size_t size() const { return ts.size(); }
+    };
+
+    struct History_Stats {
+        std::size_t n;
+        double min;
+        double max;
+        double mean;
+        double rms;
+    };
+
+    /**
+     * \brief fixed-capacity columnar ring of decoded output frames
+     *
+     * One column of doubles per scalar in the recipe (a VECTOR6D field
+     * is 6 columns), laid out as structure-of-arrays so that a window
+     * of one joint is contiguous. Frames are keyed by the controller
+     * timestamp if the recipe has a "timestamp" field, otherwise by the
+     * local receive time. Integers are stored as doubles, exact up to
+     * 2^53.
+     *
+     * The receiver appends through the RTDE_Frame_Sink hook without
+     * locking or allocating. Readers never block the receiver: they
+     * read the ring directly and then check that the writer has not
+     * lapped the part they looked at, retrying (HISTORY_READ_RETRIES)
+     * or dropping the oldest frames when it did.
+     *
+     * If the key goes backwards (controller restarted), the history
+     * starts over.
+     *
+     *    urx::History h(recipe, 4096);
+     *    recipe->add_sink(&h);
+     *    ...
+     *    h.last(2.0, {h.column("actual_current", 0)}, snap);
+     */
+    class History : public RTDE_Frame_Sink
+    {
+    public:
+        /**
+         * \param recipe output recipe, all fields added
+         * \param capacity frames kept, rounded up to a power of 2
+         */
+        History(RTDE_Recipe *recipe, std::size_t capacity);
+
+        void on_frame(const unsigned char *payload, unsigned long ts) override;
+
+        /**
+         * \brief index of a column
+         *
+         * \param component element of a vector field (0 for scalars)
+         * \return column index, -1 if not recorded
+         */
+        int column(const std::string& name, int component = 0) const { return plan_.column(name, component); }
+
+        /**
+         * \brief all columns belonging to name (1 for scalars, 3 or 6 for vectors)
+         */
+        std::vector<int> columns(const std::string& name) const { return plan_.columns(name); }
+
+        std::size_t num_columns() const { return plan_.num_columns(); }
+        const std::string& column_name(int col) const { return plan_.column_name(col); }
+        std::size_t capacity() const { return cap_; }
+
+        /**
+         * \brief number of frames currently readable
+         */
+        std::size_t size() const;
+
+        /**
+         * \brief key of the newest frame, negative if empty
+         */
+        double latest() const;
+
+        /**
+         * \brief copy frames with t0 <= key <= t1
+         *
+         * The vectors in out are reused, so a reader that keeps its
+         * snapshot around does not allocate once warmed up.
+         *
+         * \return false on bad columns or if the window could not be
+         * read consistently
+         */
+        bool snapshot(double t0, double t1, const std::vector<int>& cols, History_Snapshot& out) const;
+
+        /**
+         * \brief snapshot of the last seconds up to the newest frame
+         */
+        bool last(double seconds, const std::vector<int>& cols, History_Snapshot& out) const;
+
+        /**
+         * \brief min/max/mean/RMS of one column over t0 <= key <= t1
+         */
+        bool stats(double t0, double t1, int col, History_Stats& out) const;
+
+        /**
+         * \brief stats() for each column of a (vector) field, e.g. per joint
+         */
+        std::vector<History_Stats> stats(double t0, double t1, const std::string& name) const;
+
+    private:
+        double *col_(int c) { return &data_[(std::size_t)c * cap_]; }
+        const double *col_(int c) const { return &data_[(std::size_t)c * cap_]; }
+        double key_(uint64_t frame) const { return keys_[frame & mask_]; }
+        uint64_t lower_(uint64_t lo, uint64_t hi, double t, bool upper) const;
+        uint64_t oldest_safe_() const;
+        template<typename F>
+        bool read_(double t0, double t1, F&& f) const;
+
+        std::size_t cap_;
+        uint64_t mask_;
+        Decode_Plan plan_;
+
+        std::vector<double> keys_;
+        std::vector<double> data_;
+
+        // frames [first_, head_) are valid (unless overwritten)
+        std::atomic<uint64_t> head_;
+        std::atomic<uint64_t> first_;
+        double last_key_;
+    };
+}
+#endif  // URX_HISTORY_HPP
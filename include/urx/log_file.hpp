@@ -0,0 +1,275 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_LOG_FILE_HPP
+#define URX_LOG_FILE_HPP
+#include <urx/rtde_recipe.hpp>
+#include <urx/decode_plan.hpp>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/*
+ * Columnar RTDE recording
+ *
+ * +----------------------+ 0
+ * | log_file_header      |
+ * | log_column_desc[]    |
+ * +----------------------+ header_bytes (page aligned)
+ * | chunk 0              |
+ * +----------------------+ header_bytes + chunk_bytes
+ * | chunk 1              |
+ * ...
+ *
+ * Every chunk has room for chunk_frames frames and starts with a
+ * log_chunk_header (frames used, min/max key), followed by one array
+ * per column at the offset given in the column descriptor. Values are
+ * stored in host byte order (see byte_order) with their RTDE width.
+ * Column 0 is the key (controller timestamp if recorded, else local
+ * receive time) [s], column 1 the local receive time [ns], then one
+ * column per scalar in the recipe.
+ *
+ * Only the last chunk can be partially filled.
+ *
+ * With LOG_FLAG_COMPRESSED, a chunk is the log_chunk_header followed
+ * by each column encoded (see urx/codec.hpp) as a 32 bit length and
+ * the data, padded to 8 bytes. Chunks then vary in size, bytes in the
+ * chunk header leads to the next one.
+ */
+#define URX_LOG_MAGIC "URXLOG1"
+#define URX_LOG_CHUNK_MAGIC 0x4b4e4843  // "CHNK"
+
+struct log_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // 0x01020304 in writer's order
+    uint32_t num_columns;
+    uint32_t chunk_frames;
+    uint64_t chunk_bytes;       // uncompressed chunk
+    uint64_t header_bytes;
+    uint32_t flags;
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct log_column_desc {
+    char name[64];              // field name, as in magic.h
+    uint8_t field_type;         // enum RTDE_DATA_TYPE as registered
+    uint8_t scalar;             // enum RTDE_DATA_TYPE of each value
+    uint8_t component;          // element of a vector field
+    uint8_t elem_size;
+    uint32_t offset;            // of the column within a chunk
+} __attribute__((packed));
+
+struct log_chunk_header {
+    uint32_t magic;
+    uint32_t frames;
+    double t_min;
+    double t_max;
+    uint64_t seq;
+    uint64_t bytes;             // whole chunk, including this header
+} __attribute__((packed));
+
+namespace urx {
+    // 2: flags in the file header, bytes in the chunk header
+    constexpr uint32_t LOG_VERSION = 2;
+    constexpr std::size_t LOG_CHUNK_FRAMES = 2048;     // ~4s at 500Hz
+    constexpr std::size_t LOG_PAGE = 4096;
+    constexpr uint32_t LOG_FLAG_COMPRESSED = 1;
+
+    /**
+     * \brief record every frame of an output recipe to a columnar file
+     *
+     * Attach to the recipe with add_sink(). Frames are decoded straight
+     * into a memory-mapped chunk of the file, so the receiver does no
+     * formatting and no write() calls, only a new mapping every
+     * chunk_frames frames.
+     *
+     * Compressed, frames are collected in one of two in-memory chunks
+     * and a full chunk is encoded and written by a background thread
+     * while the receiver fills the other. If the encoder falls a whole
+     * chunk behind, frames are dropped (and counted) rather than
+     * stalling the receiver. Only complete chunks are visible in the
+     * file until close().
+     */
+    class Log_Writer : public RTDE_Frame_Sink
+    {
+    public:
+        Log_Writer(RTDE_Recipe *recipe, std::size_t chunk_frames = LOG_CHUNK_FRAMES, bool compress = false);
+        ~Log_Writer();
+
+        bool open(const std::string& path);
+        void close();
+        bool is_open() const { return fd_ >= 0; }
+
+        void on_frame(const unsigned char *payload, unsigned long ts) override;
+
+        uint64_t frames() const { return frames_; }
+        uint64_t dropped() const { return dropped_; }
+
+        /**
+         * \brief bytes written to the file so far
+         */
+        uint64_t bytes() const;
+
+    private:
+        bool map_chunk_(uint64_t k);
+        void unmap_chunk_();
+        void init_chunk_(unsigned char *chunk, uint64_t k);
+        bool queue_chunk_();
+        void encoder_();
+        bool write_encoded_(const unsigned char *chunk);
+
+        Decode_Plan plan_;
+        std::vector<struct log_column_desc> cols_;
+        std::size_t chunk_frames_;
+        std::size_t chunk_bytes_;
+        std::size_t header_bytes_;
+
+        int fd_;
+        unsigned char *chunk_;
+        uint64_t chunk_idx_;
+        uint32_t in_chunk_;
+        uint64_t frames_;
+        uint64_t dropped_;
+
+        std::atomic<uint64_t> append_off_;     // file size, bytes() reads it
+
+        // compressed: two staging chunks and the encoder thread
+        bool compress_;
+        std::vector<unsigned char> staging_[2];
+        int cur_;
+        std::thread encoder_thread_;
+        std::mutex lock_;
+        std::condition_variable cv_;
+        unsigned char *pending_;        // full chunk waiting for the encoder
+        bool stop_;
+        bool failed_;
+        std::vector<uint8_t> enc_;
+        std::vector<int64_t> ints_;
+    };
+
+    /**
+     * \brief read a recording made by Log_Writer
+     *
+     * The file is mapped read-only, views point straight into it and
+     * stay valid until close(). Seeking by time assumes the key is
+     * increasing, which holds unless the controller was restarted
+     * during the recording.
+     *
+     * Compressed recordings have no views, use read() to decode a
+     * column of a chunk. times(), value() and seek() decode (and cache)
+     * the column they need, so they are not thread-safe on a
+     * compressed recording.
+     */
+    class Log_Reader
+    {
+    public:
+        Log_Reader();
+        ~Log_Reader();
+
+        bool open(const std::string& path);
+        void close();
+
+        std::size_t num_chunks() const { return num_chunks_; }
+        uint64_t num_frames() const { return num_frames_; }
+        std::size_t num_columns() const { return cols_ ? hdr_->num_columns : 0; }
+        bool compressed() const { return hdr_ && (hdr_->flags & LOG_FLAG_COMPRESSED); }
+
+        /**
+         * \brief "t", "rx_ns", "timestamp", "actual_q[2]" etc
+         */
+        std::string column_name(int col) const;
+        enum RTDE_DATA_TYPE column_type(int col) const;
+
+        /**
+         * \param component element of a vector field (0 for scalars)
+         * \return column index, -1 if not recorded
+         */
+        int column(const std::string& field, int component = 0) const;
+
+        std::size_t chunk_frames(std::size_t chunk) const { return chunk_hdr_(chunk)->frames; }
+        double chunk_t_min(std::size_t chunk) const { return chunk_hdr_(chunk)->t_min; }
+        double chunk_t_max(std::size_t chunk) const { return chunk_hdr_(chunk)->t_max; }
+
+        /**
+         * \brief zero-copy view of one column of a chunk
+         *
+         * \return chunk_frames(chunk) values, nullptr if T does not
+         * match the stored type (double for DOUBLE, uint32_t or int32_t
+         * for UINT32/INT32 etc)
+         */
+        template<typename T>
+        const T *view(std::size_t chunk, int col) const
+        {
+            if (compressed() || !type_ok_<T>(chunk, col))
+                return nullptr;
+            return (const T *)(chunk_base_(chunk) + cols_[col].offset);
+        }
+
+        /**
+         * \brief copy (decode) one column of a chunk
+         *
+         * \param out room for chunk_frames(chunk) values, T as for view()
+         */
+        template<typename T>
+        bool read(std::size_t chunk, int col, T *out) const
+        {
+            return type_ok_<T>(chunk, col) && out && read_(chunk, col, out);
+        }
+
+        const double *times(std::size_t chunk) const;
+
+        /**
+         * \brief any value as double
+         */
+        double value(std::size_t chunk, int col, std::size_t idx) const;
+
+        /**
+         * \brief first frame with key >= t
+         *
+         * \return false if all frames are older than t
+         */
+        bool seek(double t, std::size_t& chunk, std::size_t& idx) const;
+
+    private:
+        template<typename T>
+        bool type_ok_(std::size_t chunk, int col) const
+        {
+            return chunk < num_chunks_ && col >= 0 && col < (int)num_columns() &&
+                sizeof(T) == cols_[col].elem_size &&
+                std::is_floating_point<T>::value == (cols_[col].scalar == DOUBLE);
+        }
+
+        const unsigned char *chunk_base_(std::size_t chunk) const { return base_ + chunk_off_[chunk]; }
+        const struct log_chunk_header *chunk_hdr_(std::size_t chunk) const
+        {
+            return (const struct log_chunk_header *)chunk_base_(chunk);
+        }
+        bool read_(std::size_t chunk, int col, void *out) const;
+        const unsigned char *cached_(std::size_t chunk, int col) const;
+
+        const unsigned char *base_;
+        std::size_t size_;
+        const struct log_file_header *hdr_;
+        const struct log_column_desc *cols_;
+        std::size_t num_chunks_;
+        uint64_t num_frames_;
+        std::vector<std::size_t> chunk_off_;
+
+        // last decoded key column and other column of a compressed recording
+        mutable std::size_t cache_chunk_[2];
+        mutable int cache_col_[2];
+        mutable std::vector<unsigned char> cache_[2];
+    };
+}
+#endif  // URX_LOG_FILE_HPP
@@ -144,20 +144,76 @@ static struct rtde_data_names rtde_input_names[] = {
 	{ "input_bit_registers32_to_63", 	UINT32 },
 
 
-	/* ==============================================================
-	 * FIXME
-	 *
-	 * Must add the remaining regs here! (these are not currently
-	 * not valid.
-	 *==============================================================*/
-
 	/*
 	 * 64 general purpose bits
 	 *
 	 * X: [64..127] - The upper range of the boolean input registers
 	 *		  can be used by external RTDE clients (i.e URCAPS).
 	 */
-	{ "input_bit_register_X",		BOOL },
+	{ "input_bit_register_64",		BOOL },
+	{ "input_bit_register_65",		BOOL },
+	{ "input_bit_register_66",		BOOL },
+	{ "input_bit_register_67",		BOOL },
+	{ "input_bit_register_68",		BOOL },
+	{ "input_bit_register_69",		BOOL },
+	{ "input_bit_register_70",		BOOL },
+	{ "input_bit_register_71",		BOOL },
+	{ "input_bit_register_72",		BOOL },
+	{ "input_bit_register_73",		BOOL },
+	{ "input_bit_register_74",		BOOL },
+	{ "input_bit_register_75",		BOOL },
+	{ "input_bit_register_76",		BOOL },
+	{ "input_bit_register_77",		BOOL },
+	{ "input_bit_register_78",		BOOL },
+	{ "input_bit_register_79",		BOOL },
+	{ "input_bit_register_80",		BOOL },
+	{ "input_bit_register_81",		BOOL },
+	{ "input_bit_register_82",		BOOL },
+	{ "input_bit_register_83",		BOOL },
+	{ "input_bit_register_84",		BOOL },
+	{ "input_bit_register_85",		BOOL },
+	{ "input_bit_register_86",		BOOL },
+	{ "input_bit_register_87",		BOOL },
+	{ "input_bit_register_88",		BOOL },
+	{ "input_bit_register_89",		BOOL },
+	{ "input_bit_register_90",		BOOL },
+	{ "input_bit_register_91",		BOOL },
+	{ "input_bit_register_92",		BOOL },
+	{ "input_bit_register_93",		BOOL },
+	{ "input_bit_register_94",		BOOL },
+	{ "input_bit_register_95",		BOOL },
+	{ "input_bit_register_96",		BOOL },
+	{ "input_bit_register_97",		BOOL },
+	{ "input_bit_register_98",		BOOL },
+	{ "input_bit_register_99",		BOOL },
+	{ "input_bit_register_100",		BOOL },
+	{ "input_bit_register_101",		BOOL },
+	{ "input_bit_register_102",		BOOL },
+	{ "input_bit_register_103",		BOOL },
+	{ "input_bit_register_104",		BOOL },
+	{ "input_bit_register_105",		BOOL },
+	{ "input_bit_register_106",		BOOL },
+	{ "input_bit_register_107",		BOOL },
+	{ "input_bit_register_108",		BOOL },
+	{ "input_bit_register_109",		BOOL },
+	{ "input_bit_register_110",		BOOL },
+	{ "input_bit_register_111",		BOOL },
+	{ "input_bit_register_112",		BOOL },
+	{ "input_bit_register_113",		BOOL },
+	{ "input_bit_register_114",		BOOL },
+	{ "input_bit_register_115",		BOOL },
+	{ "input_bit_register_116",		BOOL },
+	{ "input_bit_register_117",		BOOL },
+	{ "input_bit_register_118",		BOOL },
+	{ "input_bit_register_119",		BOOL },
+	{ "input_bit_register_120",		BOOL },
+	{ "input_bit_register_121",		BOOL },
+	{ "input_bit_register_122",		BOOL },
+	{ "input_bit_register_123",		BOOL },
+	{ "input_bit_register_124",		BOOL },
+	{ "input_bit_register_125",		BOOL },
+	{ "input_bit_register_126",		BOOL },
+	{ "input_bit_register_127",		BOOL },
 
 	/*
 	 * 48 general purpose integer registers
@@ -354,7 +410,70 @@ static struct rtde_data_names rtde_output_names[] = {
 	 * X: [64..127] - The upper range of the boolean output
 	 * registers can be used by external RTDE clients (i.e URCAPS).
 	 */
-	{ "output_bit_register_X", 	BOOL},
+	{ "output_bit_register_64", 	BOOL},
+	{ "output_bit_register_65", 	BOOL},
+	{ "output_bit_register_66", 	BOOL},
+	{ "output_bit_register_67", 	BOOL},
+	{ "output_bit_register_68", 	BOOL},
+	{ "output_bit_register_69", 	BOOL},
+	{ "output_bit_register_70", 	BOOL},
+	{ "output_bit_register_71", 	BOOL},
+	{ "output_bit_register_72", 	BOOL},
+	{ "output_bit_register_73", 	BOOL},
+	{ "output_bit_register_74", 	BOOL},
+	{ "output_bit_register_75", 	BOOL},
+	{ "output_bit_register_76", 	BOOL},
+	{ "output_bit_register_77", 	BOOL},
+	{ "output_bit_register_78", 	BOOL},
+	{ "output_bit_register_79", 	BOOL},
+	{ "output_bit_register_80", 	BOOL},
+	{ "output_bit_register_81", 	BOOL},
+	{ "output_bit_register_82", 	BOOL},
+	{ "output_bit_register_83", 	BOOL},
+	{ "output_bit_register_84", 	BOOL},
+	{ "output_bit_register_85", 	BOOL},
+	{ "output_bit_register_86", 	BOOL},
+	{ "output_bit_register_87", 	BOOL},
+	{ "output_bit_register_88", 	BOOL},
+	{ "output_bit_register_89", 	BOOL},
+	{ "output_bit_register_90", 	BOOL},
+	{ "output_bit_register_91", 	BOOL},
+	{ "output_bit_register_92", 	BOOL},
+	{ "output_bit_register_93", 	BOOL},
+	{ "output_bit_register_94", 	BOOL},
+	{ "output_bit_register_95", 	BOOL},
+	{ "output_bit_register_96", 	BOOL},
+	{ "output_bit_register_97", 	BOOL},
+	{ "output_bit_register_98", 	BOOL},
+	{ "output_bit_register_99", 	BOOL},
+	{ "output_bit_register_100", 	BOOL},
+	{ "output_bit_register_101", 	BOOL},
+	{ "output_bit_register_102", 	BOOL},
+	{ "output_bit_register_103", 	BOOL},
+	{ "output_bit_register_104", 	BOOL},
+	{ "output_bit_register_105", 	BOOL},
+	{ "output_bit_register_106", 	BOOL},
+	{ "output_bit_register_107", 	BOOL},
+	{ "output_bit_register_108", 	BOOL},
+	{ "output_bit_register_109", 	BOOL},
+	{ "output_bit_register_110", 	BOOL},
+	{ "output_bit_register_111", 	BOOL},
+	{ "output_bit_register_112", 	BOOL},
+	{ "output_bit_register_113", 	BOOL},
+	{ "output_bit_register_114", 	BOOL},
+	{ "output_bit_register_115", 	BOOL},
+	{ "output_bit_register_116", 	BOOL},
+	{ "output_bit_register_117", 	BOOL},
+	{ "output_bit_register_118", 	BOOL},
+	{ "output_bit_register_119", 	BOOL},
+	{ "output_bit_register_120", 	BOOL},
+	{ "output_bit_register_121", 	BOOL},
+	{ "output_bit_register_122", 	BOOL},
+	{ "output_bit_register_123", 	BOOL},
+	{ "output_bit_register_124", 	BOOL},
+	{ "output_bit_register_125", 	BOOL},
+	{ "output_bit_register_126", 	BOOL},
+	{ "output_bit_register_127", 	BOOL},
 
 	/* 48 general purpose integer registers
 	 * X: [0..23] - The lower range of the integer output registers is reserved for FieldBus/PLC interface usage.
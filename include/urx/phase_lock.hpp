@@ -0,0 +1,102 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_PHASE_LOCK_HPP
+#define URX_PHASE_LOCK_HPP
+#include <atomic>
+#include <cstdint>
+
+namespace urx {
+
+    struct Phase_Lock_Stats {
+        uint64_t sent;          // updates released by the scheduler
+        uint64_t hits;          // echoed in the very next frame
+        uint64_t misses;        // not echoed in the next frame
+        int64_t offset_ns;      // current release offset after frame arrival
+        double hit_rate;        // hits / (hits + misses)
+    };
+
+    /**
+     * \brief Learn the phase of the controller cycle and find the best send time
+     *
+     * The controller reads the input registers at a fixed point in its
+     * cycle, and an update that arrives after this point will have to
+     * wait a full cycle. The round-trip therefore depends heavily on
+     * *when* we send relative to the cycle.
+     *
+     * Phase_Lock tracks the arrival of output frames (a PLL biased
+     * towards the earliest arrivals as delays are strictly positive) and
+     * proposes a release time at a given offset after the expected
+     * arrival. Feedback on whether an update was echoed by the
+     * controller in the following frame (a hit) moves the offset:
+     *
+     * - a miss moves the release point earlier by a large step
+     * - a streak of hits moves it later by a small step
+     *
+     * so the offset settles just before the latest point that still
+     * makes the next controller tick, which leaves the control-loop as
+     * much time as possible to compute the update.
+     */
+    class Phase_Lock
+    {
+    public:
+        Phase_Lock() { reset(); };
+
+        /**
+         * \brief register arrival of a new output frame
+         *
+         * \param host_ns local CLOCK_MONOTONIC at reception [ns]
+         * \param period expected cycle time [s]
+         */
+        void on_arrival(int64_t host_ns, double period);
+
+        /**
+         * \return true when enough frames have been seen to trust the phase
+         */
+        bool locked() const { return arrivals_ >= LOCK_FRAMES; }
+
+        /**
+         * \return absolute CLOCK_MONOTONIC time [ns] for releasing the
+         * update for the current cycle.
+         */
+        int64_t release_ns() const { return pred_ns_ + offset_ns_.load(std::memory_order_relaxed); }
+
+        /**
+         * \return expected CLOCK_MONOTONIC arrival [ns] of the next frame
+         */
+        int64_t next_arrival_ns() const { return pred_ns_ + period_ns_; }
+
+        /**
+         * \brief an update was released
+         */
+        void sent() { sent_.fetch_add(1, std::memory_order_relaxed); }
+
+        /**
+         * \brief feedback, was the last update echoed in the next frame?
+         */
+        void report(bool hit);
+
+        Phase_Lock_Stats stats() const;
+
+        void reset();
+
+    private:
+        static constexpr int LOCK_FRAMES = 16;
+        static constexpr int HIT_STREAK = 32;
+
+        int64_t period_ns_;
+        int64_t pred_ns_;
+        int arrivals_;
+        int streak_;
+
+        std::atomic<int64_t> offset_ns_;
+        std::atomic<uint64_t> sent_;
+        std::atomic<uint64_t> hits_;
+        std::atomic<uint64_t> misses_;
+    };
+}
+#endif  // URX_PHASE_LOCK_HPP
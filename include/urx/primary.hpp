@@ -0,0 +1,253 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_PRIMARY_HPP
+#define URX_PRIMARY_HPP
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <endian.h>
+
+/*
+ * Wire-format of the primary/secondary client interface (port
+ * 30001/30002), all fields big-endian. Only the parts we decode are
+ * described, the rest is skipped using the length-fields.
+ */
+enum PRIMARY_MESSAGE_TYPE {
+    PRIMARY_ROBOT_STATE = 16,
+    PRIMARY_ROBOT_MESSAGE = 20,
+    PRIMARY_PROGRAM_STATE_MESSAGE = 25,
+};
+
+enum PRIMARY_PACKAGE_TYPE {
+    PRIMARY_ROBOT_MODE_DATA = 0,
+    PRIMARY_JOINT_DATA = 1,
+    PRIMARY_MASTERBOARD_DATA = 3,
+};
+
+enum PRIMARY_ROBOT_MESSAGE_TYPE {
+    PRIMARY_MESSAGE_TEXT = 0,
+    PRIMARY_MESSAGE_ERROR_CODE = 6,
+};
+
+struct primary_header {
+    uint32_t size;              // incl. header
+    uint8_t type;
+} __attribute__((packed));
+
+// sub-package of PRIMARY_ROBOT_STATE
+struct primary_package_header {
+    uint32_t size;              // incl. header
+    uint8_t type;
+} __attribute__((packed));
+
+struct primary_robot_mode_data {
+    struct primary_package_header hdr;
+    uint64_t timestamp;
+    bool real_robot_connected;
+    bool real_robot_enabled;
+    bool robot_power_on;
+    bool emergency_stopped;
+    bool protective_stopped;
+    bool program_running;
+    bool program_paused;
+    uint8_t robot_mode;
+    uint8_t control_mode;
+    uint64_t target_speed_fraction;
+    uint64_t speed_scaling;
+    uint64_t target_speed_fraction_limit;
+} __attribute__((packed));
+
+struct primary_joint {
+    uint64_t q_actual;
+    uint64_t q_target;
+    uint64_t qd_actual;
+    uint32_t i_actual;
+    uint32_t v_actual;
+    uint32_t t_motor;
+    uint32_t t_micro;           // obsolete
+    uint8_t joint_mode;
+} __attribute__((packed));
+
+struct primary_joint_data {
+    struct primary_package_header hdr;
+    struct primary_joint joint[6];
+} __attribute__((packed));
+
+// only the leading part up to the safety mode
+struct primary_masterboard_data {
+    struct primary_package_header hdr;
+    uint32_t digital_input_bits;
+    uint32_t digital_output_bits;
+    uint8_t analog_input_range0;
+    uint8_t analog_input_range1;
+    uint64_t analog_input0;
+    uint64_t analog_input1;
+    uint8_t analog_output_domain0;
+    uint8_t analog_output_domain1;
+    uint64_t analog_output0;
+    uint64_t analog_output1;
+    uint32_t masterboard_temperature;
+    uint32_t robot_voltage_48v;
+    uint32_t robot_current;
+    uint32_t master_io_current;
+    uint8_t safety_mode;
+    uint8_t in_reduced_mode;
+} __attribute__((packed));
+
+struct primary_robot_message {
+    struct primary_header hdr;
+    uint64_t timestamp;
+    int8_t source;
+    uint8_t message_type;
+} __attribute__((packed));
+
+struct primary_error_code {
+    struct primary_robot_message msg;
+    int32_t code;
+    int32_t argument;
+    int32_t report_level;
+    uint8_t data_type;
+    uint32_t data;
+    // followed by text, up to end of message
+} __attribute__((packed));
+
+static inline double primary_double(uint64_t be)
+{
+    uint64_t v = be64toh(be);
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+static inline float primary_float(uint32_t be)
+{
+    uint32_t v = be32toh(be);
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+namespace urx {
+    enum Program_State {
+        PROGRAM_STOPPED = 0,
+        PROGRAM_RUNNING,
+        PROGRAM_PAUSED,
+    };
+
+    struct Primary_State {
+        uint64_t ts;                    // controller time [ms]
+        int robot_mode;
+        int control_mode;
+        int safety_mode;
+        int program_state;              // Program_State
+        bool power_on;
+        bool emergency_stopped;
+        bool protective_stopped;
+        double speed_scaling;
+        double q[6];
+        double qd[6];
+        float current[6];
+        float t_motor[6];
+        int joint_mode[6];
+    };
+
+    struct Primary_Error {
+        uint64_t ts;
+        int source;
+        int code;
+        int argument;
+        int report_level;
+        std::string text;
+    };
+
+    struct Primary_Stats {
+        uint64_t bytes;
+        uint64_t messages;
+        uint64_t state_updates;
+        uint64_t errors;                // error-code messages
+        uint64_t malformed;             // dropped due to bad length
+    };
+
+    /**
+     * \brief Streaming parser for the primary/secondary client interface
+     *
+     * Bytes from the socket are fed in as they arrive and split into
+     * messages using the length-header. Complete messages are decoded in
+     * place (packed structs over the receive buffer, as for RTDE), only
+     * a partial message at the end of a read is copied and kept for the
+     * next feed().
+     *
+     * The callbacks are called from the thread calling feed() when the
+     * corresponding value *changes*, without internal locks held. The
+     * first state seen is reported as a change from -1.
+     */
+    class Primary_Parser
+    {
+    public:
+        Primary_Parser() { reset(); }
+
+        /**
+         * \brief feed raw bytes from the socket
+         *
+         * A length outside the valid range means the stream is out of
+         * step; there is no marker to resynchronize on, so everything
+         * buffered is dropped and -1 returned. The stream must be
+         * restarted (reconnected) before feeding more.
+         *
+         * \return number of complete messages parsed, -1 if malformed
+         */
+        int feed(const unsigned char *buf, std::size_t len);
+
+        /**
+         * \brief decode a single, complete message
+         *
+         * \return false if message is malformed
+         */
+        bool parse_message(const unsigned char *msg, std::size_t len);
+
+        /**
+         * \return copy of the latest decoded state
+         */
+        Primary_State state();
+
+        Primary_Stats stats() const;
+
+        void on_robot_mode(std::function<void(int prev, int mode)> cb) { robot_mode_cb_ = cb; }
+        void on_safety_mode(std::function<void(int prev, int mode)> cb) { safety_mode_cb_ = cb; }
+        void on_program_state(std::function<void(int prev, int state)> cb) { program_state_cb_ = cb; }
+        void on_error(std::function<void(const Primary_Error&)> cb) { error_cb_ = cb; }
+
+        void reset();
+
+    private:
+        bool parse_robot_state(const unsigned char *msg, std::size_t len);
+        bool parse_robot_message(const unsigned char *msg, std::size_t len);
+
+        std::vector<unsigned char> partial_;
+
+        std::mutex state_lock_;
+        Primary_State state_;
+
+        std::function<void(int, int)> robot_mode_cb_;
+        std::function<void(int, int)> safety_mode_cb_;
+        std::function<void(int, int)> program_state_cb_;
+        std::function<void(const Primary_Error&)> error_cb_;
+
+        std::atomic<uint64_t> bytes_;
+        std::atomic<uint64_t> messages_;
+        std::atomic<uint64_t> state_updates_;
+        std::atomic<uint64_t> errors_;
+        std::atomic<uint64_t> malformed_;
+    };
+}
+#endif  // URX_PRIMARY_HPP
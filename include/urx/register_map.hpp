@@ -0,0 +1,150 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_REGISTER_MAP_HPP
+#define URX_REGISTER_MAP_HPP
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <urx/rtde_recipe.hpp>
+#include <urx/script_cache.hpp>
+#include <urx/trajectory.hpp>
+
+namespace urx {
+    // general purpose registers on the controller
+    constexpr int NUM_INT_REGISTERS = 48;
+    constexpr int NUM_DOUBLE_REGISTERS = 48;
+    constexpr int NUM_BIT_REGISTERS = 128;
+
+    // lower halves are reserved for PLCs and fieldbus
+    constexpr int REG_USER_BASE = 24;
+    constexpr int REG_USER_BIT_BASE = 64;
+
+    enum Reg_Type {
+        REG_INT,        // int32_t
+        REG_DOUBLE,     // double
+        REG_BIT,        // bool
+    };
+
+    enum Reg_Dir {
+        REG_IN,         // host -> controller (input registers)
+        REG_OUT,        // controller -> host (output registers)
+    };
+
+    struct Reg_Channel {
+        std::string name;
+        Reg_Dir dir;
+        Reg_Type type;
+        int first;              // first register (or bit) allocated
+        std::size_t count;
+        void *storage;
+    };
+
+    /**
+     * \brief allocate registers for named channels, drive both recipe and script
+     *
+     * Each channel is given a name, a direction, a type and the host
+     * variable(s) backing it. Registers are handed out consecutively per
+     * type and direction starting at the given base, so nothing is wasted
+     * and the same definition produces
+     *
+     * - the fields of the input and output RTDE_Recipe (build())
+     * - a URScript header with get_<name>() for inputs and
+     *   set_<name>(v) for outputs (script_header())
+     * - Script_Params with the register index of each channel, for
+     *   ${name} placeholders in hand-written scripts (params())
+     *
+     * Bits 64..127 are single input/output_bit_register_N fields. Bits
+     * below 64 (only when asked for with bit_base) are packed into
+     * input/output_bit_registers0_to_31 and 32_to_63 as bit fields on
+     * the recipe (RTDE_Recipe::add_bit_field()).
+     *
+     * By default the registers used by Trajectory_Stream are reserved,
+     * so a map and a streamed trajectory can share the recipes.
+     */
+    class Register_Map
+    {
+    public:
+        /**
+         * \param base first int/double register to use, 24 leaves the
+         * lower half to PLCs and fieldbus.
+         * \param bit_base first bit to use, 64 for the same reason
+         * \param trajectory reserve the Trajectory_Stream registers
+         */
+        Register_Map(int base = REG_USER_BASE, int bit_base = REG_USER_BIT_BASE, bool trajectory = true);
+
+        /**
+         * \brief keep registers used elsewhere out of the allocation
+         *
+         * \return false if a channel already uses one of them
+         */
+        bool reserve(Reg_Dir dir, Reg_Type type, int first, std::size_t count);
+
+        /**
+         * \brief allocate count consecutive registers of type for a channel
+         *
+         * \return first register (or bit) allocated, -1 if name is taken
+         * or registers are exhausted.
+         */
+        int add(const std::string& name, Reg_Dir dir, Reg_Type type, void *storage, std::size_t count = 1);
+
+        int add_int(const std::string& name, Reg_Dir dir, int32_t *storage, std::size_t count = 1)
+        {
+            return add(name, dir, REG_INT, storage, count);
+        }
+        int add_double(const std::string& name, Reg_Dir dir, double *storage, std::size_t count = 1)
+        {
+            return add(name, dir, REG_DOUBLE, storage, count);
+        }
+        int add_bit(const std::string& name, Reg_Dir dir, bool *storage, std::size_t count = 1)
+        {
+            return add(name, dir, REG_BIT, storage, count);
+        }
+
+        /**
+         * \brief add fields for all channels to the recipes
+         *
+         * Either recipe can be nullptr if no channels use that direction.
+         */
+        bool build(RTDE_Recipe *in, RTDE_Recipe *out);
+
+        /**
+         * \brief generate URScript accessors for all channels
+         */
+        std::string script_header() const;
+
+        /**
+         * \brief register index of each channel, keyed by name
+         */
+        Script_Params params() const;
+
+        const std::vector<Reg_Channel>& channels() const { return channels_; }
+        const Reg_Channel *find(const std::string& name) const;
+
+        /**
+         * \return bytes added to the input (or output) data package
+         */
+        std::size_t frame_bytes(Reg_Dir dir) const;
+
+    private:
+        int limit(Reg_Type type) const;
+
+        struct Reserved {
+            Reg_Dir dir;
+            Reg_Type type;
+            int first;
+            std::size_t count;
+        };
+
+        std::vector<Reg_Channel> channels_;
+        std::vector<Reserved> reserved_;
+
+        // next free register, [dir][type]
+        int next_[2][3];
+    };
+}
+#endif  // URX_REGISTER_MAP_HPP
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_REPLAYER_HPP
+#define URX_REPLAYER_HPP
+#include <urx/con.hpp>
+#include <urx/log_file.hpp>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace urx {
+    class RTDE_Handler;
+
+    constexpr int REPLAY_OUT_RECIPE_ID = 1;
+
+    struct Replay_Stats {
+        uint64_t frames;        // data packages delivered
+        uint64_t inputs;        // input packages from the client, dropped
+        std::size_t missing;    // requested output scalars not in the recording (sent as 0)
+        double wall_s;          // first to last delivered frame
+        double fps;             // frames / wall_s
+        double decode_ns;       // mean time in parse_incoming_data(), run() only
+        double max_lag_ms;      // worst delivery behind schedule, paced replay only
+    };
+
+    /**
+     * \brief plays a recording (Log_Writer) back as an RTDE controller
+     *
+     * The Replayer is a Con that answers the RTDE control requests
+     * (protocol version, output/input setup, start and pause) and, once
+     * started, returns the recorded frames as data packages laid out
+     * for the output recipe the client registered. A recorded session
+     * thus goes through the exact same RTDE_Handler/RTDE_Recipe decode
+     * path, Robot::state() and on-state callbacks as live data:
+     *
+     *    auto rp = new urx::Replayer("session.urxlog", 10.0);
+     *    urx::Robot robot(urxh, new urx::RTDE_Handler(rp));
+     *    robot.set_reconnect(false);
+     *    robot.init_output();
+     *    robot.start();
+     *    rp->wait_finished();
+     *
+     * Frames are paced by the recorded keys divided by speed (1: as
+     * recorded, 10: ten times faster) or delivered as fast as the
+     * client reads them (speed 0). The receive timestamp handed to the
+     * handler is the recorded one, so anything keyed on it (History,
+     * Log_Writer) is reproduced exactly.
+     *
+     * Output fields missing from the recording are sent as 0 and
+     * counted in Replay_Stats::missing; "timestamp" falls back to the
+     * recorded key. Input packages are accepted and dropped.
+     *
+     * When the recording is exhausted the Replayer behaves like a
+     * silent controller: receives time out (or wait for cancel()) and
+     * finished() becomes true. Reconnecting does not rewind, so
+     * disable reconnect in Robot.
+     */
+    class Replayer : public Con
+    {
+    public:
+        Replayer(const std::string path, double speed = 1.0) :
+            Con(path, 0),
+            speed_(speed),
+            pending_sz_(0),
+            next_in_id_(REPLAY_OUT_RECIPE_ID + 1),
+            streaming_(false),
+            payload_sz_(0),
+            missing_(0),
+            rx_col_(-1),
+            chunk_(0),
+            idx_(0),
+            loaded_chunk_(-1),
+            t0_(0.0),
+            start_ns_(0),
+            first_ns_(0),
+            last_ns_(0),
+            frames_(0),
+            inputs_(0),
+            decode_ns_(0),
+            max_lag_ns_(0),
+            finished_(false)
+        {};
+
+        virtual ~Replayer() = default;
+
+        /**
+         * \brief 1: recorded rate, 10: ten times faster, 0: flat out
+         *
+         * Takes effect from the next start.
+         */
+        void set_speed(double speed) { speed_ = speed > 0.0 ? speed : 0.0; }
+        double speed() const { return speed_; }
+
+        /**
+         * \brief opens the recording
+         */
+        bool do_connect(bool nodelay = false);
+        void disconnect();
+
+        /**
+         * \brief consumes one RTDE request, the answer is returned by
+         * the next receive
+         */
+        int do_send(void *sbuf, int ssz);
+        int recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *ts);
+
+        /**
+         * \brief drive handler directly, without a receiver thread
+         *
+         * Feeds the recording through RTDE_Handler::parse_incoming_data()
+         * frame by frame (paced as for the receiver) and times the
+         * decode. The handler must use this Replayer as its connection
+         * and have its output recipe registered.
+         *
+         * \param max_frames stop after this many frames, 0: all of them
+         * \return frames the handler accepted
+         */
+        uint64_t run(RTDE_Handler *rtdeh, uint64_t max_frames = 0);
+
+        /**
+         * \return true once every recorded frame has been delivered
+         */
+        bool finished() const { return finished_; }
+
+        /**
+         * \brief block until finished()
+         *
+         * \param timeout_ms CON_WAIT_FOREVER or upper bound
+         * \return finished()
+         */
+        bool wait_finished(int timeout_ms = CON_WAIT_FOREVER);
+
+        Replay_Stats stats() const;
+
+        const Log_Reader& reader() const { return reader_; }
+
+    private:
+        struct Replay_Field {
+            int offset;                 // in payload
+            int elem_size;
+            int col;                    // -1: not recorded
+        };
+
+        bool setup_outputs(const char *names);
+        void setup_inputs(const char *names);
+        void reply(const void *msg, int sz);
+        bool load_chunk(std::size_t chunk);
+
+        /**
+         * \brief next frame as a data package, waiting for its turn
+         *
+         * \return size, 0 if the recording is exhausted or a negative
+         * CON_ code from waiting.
+         */
+        int next_frame(void *rbuf, int rsz, int timeout_ms, unsigned long *ts);
+        int wait_until(int64_t due_ns, int timeout_ms);
+
+        double speed_;
+        Log_Reader reader_;
+
+        // answer to the last control request
+        std::mutex lock_;
+        unsigned char pending_[2048];
+        int pending_sz_;
+        int next_in_id_;
+        std::atomic<bool> streaming_;
+
+        std::vector<Replay_Field> fields_;
+        int payload_sz_;
+        std::size_t missing_;
+        int rx_col_;
+
+        // current chunk, decoded once into host-order columns
+        std::size_t chunk_;
+        std::size_t idx_;
+        long loaded_chunk_;
+        std::vector<std::vector<unsigned char>> chunk_cols_;
+        std::vector<uint64_t> chunk_rx_;
+        std::vector<double> chunk_t_;
+
+        double t0_;                     // key of the first frame after start
+        int64_t start_ns_;              // CLOCK_MONOTONIC of that frame, 0: not yet
+
+        std::atomic<int64_t> first_ns_;
+        std::atomic<int64_t> last_ns_;
+        std::atomic<uint64_t> frames_;
+        std::atomic<uint64_t> inputs_;
+        std::atomic<uint64_t> decode_ns_;
+        std::atomic<int64_t> max_lag_ns_;
+
+        std::atomic<bool> finished_;
+        mutable std::mutex done_lock_;
+        std::condition_variable done_cv_;
+    };
+}
+#endif  // URX_REPLAYER_HPP
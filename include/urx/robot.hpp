@@ -12,12 +12,24 @@
 #include <condition_variable>
 #include <urx/urx_handler.hpp>
 #include <urx/rtde_handler.hpp>
+#include <urx/frame_monitor.hpp>
+#include <urx/clock_sync.hpp>
+#include <urx/phase_lock.hpp>
+#include <urx/trajectory.hpp>
+#include <urx/history.hpp>
+#include <urx/derived.hpp>
+#include <urx/heartbeat.hpp>
 #include <chrono>
 #include <thread>
 #include <atomic>
+#include <functional>
 
 namespace urx {
     constexpr std::size_t DOF = 6;
+
+    // The controller sends every 2ms (8ms on CB3), a silence this long
+    // means the link is gone.
+    constexpr int RTDE_RECV_TIMEOUT_MS = 250;
     enum {
         NO_COMMAND = 0,
         STOP_COMMAND,
@@ -33,6 +45,7 @@ namespace urx {
             dof(DOF),
             ur_ts(0),
             seqnr(0),
+            extrapolated(false),
             jq_ref(DOF),
             jq(DOF),
             jqd(DOF),
@@ -47,7 +60,8 @@ namespace urx {
         Robot_State(const Robot_State& a) :
             dof(DOF),
             ur_ts(a.ur_ts),
-            seqnr(a.seqnr)
+            seqnr(a.seqnr),
+            extrapolated(a.extrapolated)
         {
             jq_ref = a.jq_ref;
             jq     = a.jq;
@@ -56,6 +70,7 @@ namespace urx {
             jt     = a.jt;
 
             tcp_pose = a.tcp_pose;
+            derived  = a.derived;
         };
 
         // Copy constructor
@@ -65,6 +80,7 @@ namespace urx {
             local_ts_us = a.local_ts_us;
             ur_ts = a.ur_ts;
             seqnr = a.seqnr;
+            extrapolated = a.extrapolated;
             for (std::size_t i = 0; i < DOF; i++) {
                 jq_ref[i] = a.jq_ref[i];
                 jq[i]     = a.jq[i];
@@ -74,6 +90,7 @@ namespace urx {
 
                 tcp_pose[i] = a.tcp_pose[i];
             }
+            derived = a.derived;
             return *this;
         }
 
@@ -84,6 +101,7 @@ namespace urx {
             local_ts_us = a.local_ts_us;
             ur_ts = a.ur_ts;
             seqnr = a.seqnr;
+            extrapolated = a.extrapolated;
             for (std::size_t i = 0; i < DOF; i++) {
                 jq_ref[i] = a.jq_ref[i];
                 jq[i]     = a.jq[i];
@@ -93,6 +111,7 @@ namespace urx {
 
                 tcp_pose[i] = a.tcp_pose[i];
             }
+            derived = a.derived;
         }
 
         // Degrees of freedom for this arm
@@ -106,6 +125,10 @@ namespace urx {
         double ur_ts;
         int32_t seqnr;
 
+        // State was not received from the controller, but synthesized
+        // by the gap-policy to cover for a missing frame.
+        bool extrapolated;
+
         // angle for each joint
         std::vector<double> jq_ref;
         std::vector<double> jq;
@@ -115,8 +138,25 @@ namespace urx {
 
         // Tool Center Point pose
         std::vector<double> tcp_pose;
+
+        // copy of Derived_Signals::values() for the frame, empty
+        // without an attached stage. Index with Derived_Signals::slot().
+        std::vector<double> derived;
     };
 
+    /**
+     * \brief policy for synthesizing state over a missing frame
+     *
+     * Called with the last known state (received or extrapolated) and
+     * expected to advance next by dt seconds.
+     */
+    typedef std::function<void(const Robot_State& last, Robot_State& next, double dt)> Gap_Policy;
+
+    /**
+     * \brief Gap_Policy integrating joint speed and acceleration
+     */
+    void extrapolate_linear(const Robot_State& last, Robot_State& next, double dt);
+
 
     class Robot {
     public:
@@ -134,12 +174,26 @@ namespace urx {
             in_seqnr(1),
             cmd(NO_COMMAND),
             ur_state(Robot_State()),
-            ts_log_debug(false)
-
+            ts_log_debug(false),
+            max_extrapolated_(0),
+            num_extrapolated_(0),
+            phase_lock_(false),
+            phase_reset_(false),
+            tx_pending_(false),
+            tx_staged_(false),
+            tx_outstanding_(false),
+            tx_seqnr_(0),
+            traj_(nullptr),
+            traj_in_(nullptr),
+            history_(nullptr),
+            derived_(nullptr),
+            hb_(nullptr),
+            reconnect_(true)
         {
             out = new urx::RTDE_Recipe();
             in = new urx::RTDE_Recipe();
             in->dir_input();
+            rtdeh_->set_recv_timeout(RTDE_RECV_TIMEOUT_MS);
             rtdeh_->set_version();
             ts_log_fd = fopen("ts_receive.csv", "w");
             if (ts_log_fd) {
@@ -163,8 +217,13 @@ namespace urx {
 
             delete urxh_;
             delete rtdeh_;
+            delete derived_;
             delete out;
             delete in;
+            delete traj_in_;
+            delete traj_;
+            delete history_;
+            delete hb_;
             out_initialized_ = false;
             in_initialized_ = false;
         }
@@ -218,10 +277,27 @@ namespace urx {
         /**
          * \brief set new target joint speed (angular)
          *
-         * \return true if valid and successfully sent to remote.
+         * If phase-lock is enabled, the update is queued and released by
+         * the receiver thread at the learned offset in the controller
+         * cycle (see enable_phase_lock()).
+         *
+         * \return true if valid and successfully sent to (or queued for) remote.
          */
         bool update_w(std::vector<double>& new_w);
 
+        /**
+         * \brief update_w() in two steps, for sending to several arms at once
+         *
+         * stage_w() sets the new target and builds the input frame,
+         * release_w() sends it, so the expensive part is done up front
+         * and the release is a single send. Bypasses phase-lock. Used
+         * by Robot_Group.
+         *
+         * \return true if the update was staged (and sent)
+         */
+        bool stage_w(const std::vector<double>& new_w);
+        bool release_w();
+
         /**
          * \brief initalize robot, create recipes and prepare for start
          * 
@@ -256,9 +332,10 @@ namespace urx {
          * 
          * \pre init_input() must be called before this function to initialize the input registers on the URController
          * 
+         * \param params values for ${name} placeholders in the script
          * \return true on success.
          */
-        bool upload_script(const std::string& script);
+        bool upload_script(const std::string& script, const Script_Params& params = Script_Params());
 
         /**
          * \brief Wait for a new RTDE dataframe
@@ -299,6 +376,222 @@ namespace urx {
         // Returns the value of q_ref_initialized_
         bool q_ref_initialized() const {return q_ref_initialized_; };
 
+        /**
+         * \brief robot-mode, safety-mode etc from the primary interface
+         *
+         * Populated by the URX_Handler reader started by start().
+         */
+        Primary_Parser& primary() { return urxh_->primary(); }
+
+        /**
+         * \brief statistics for lost frames from the controller
+         */
+        Frame_Stats frame_stats() const { return frame_mon_.stats(); }
+
+        /**
+         * \brief register callback for when a frame-gap is detected
+         *
+         * Must be set before start(), the callback is called from the
+         * receiver thread without any locks held.
+         */
+        void on_frame_gap(std::function<void(const Frame_Gap&)> cb) { frame_mon_.on_gap(cb); }
+
+        /**
+         * \brief register callback for every new state from the controller
+         *
+         * Must be set before start(), the callback is called from the
+         * receiver thread after each received frame, with a copy of the
+         * state and without any locks held.
+         */
+        void on_state(std::function<void(const Robot_State&)> cb) { on_state_ = cb; }
+
+        /**
+         * \brief set policy for covering missing frames in state()
+         *
+         * When a policy is set, state() will only wait 1.5 cycles for a
+         * new frame. If nothing has arrived by then, the policy is used to
+         * extrapolate the last state one cycle ahead so that the
+         * control-loop can keep a steady cadence. This is done for at
+         * most max_frames consecutive cycles before state() falls back to
+         * the normal (long) wait.
+         *
+         * Must be set before start().
+         *
+         * \param policy to apply, nullptr to disable
+         * \param max_frames upper limit for consecutive synthesized frames
+         */
+        void set_gap_policy(Gap_Policy policy, int max_frames = 5);
+
+        /**
+         * \brief map controller timestamp to local CLOCK_MONOTONIC
+         *
+         * Uses the running estimate of offset and drift between the
+         * controller and this host (see Clock_Sync). Useful for
+         * timestamping external events (camera frames etc) against
+         * Robot_State::ur_ts.
+         *
+         * \return local time, or epoch if no estimate is ready yet
+         */
+        std::chrono::steady_clock::time_point controller_to_host(double ur_ts) const;
+
+        /**
+         * \brief map local CLOCK_MONOTONIC to controller time
+         *
+         * \return controller timestamp [s], negative if no estimate is ready yet.
+         */
+        double host_to_controller(std::chrono::steady_clock::time_point t) const;
+
+        /**
+         * \brief access the clock estimator (drift, error bound etc)
+         */
+        const Clock_Sync& clock_sync() const { return clock_; }
+
+        /**
+         * \brief phase-lock transmission of update_w() to the controller cycle
+         *
+         * When enabled, update_w() only queues the new values. The
+         * receiver thread learns the phase of the controller cycle from
+         * the arrival of output frames and releases the queued update at
+         * the offset that (still) makes the next controller tick. Hits
+         * are detected by the controller echoing the seqnr in
+         * output_int_register_0 in the following frame.
+         *
+         * Requires the receiver thread to run (start()).
+         */
+        void enable_phase_lock(bool enable);
+
+        /**
+         * \brief statistics for phase-locked transmission, incl. one-cycle hit rate
+         */
+        Phase_Lock_Stats phase_lock_stats() const { return phase_.stats(); }
+
+        /**
+         * \brief stream waypoints to a servoj consumer on the controller
+         *
+         * Adds the flow-control register to the output recipe, so this
+         * must be called *before* init_output(). Use init_trajectory()
+         * after init_output() to register the input recipe carrying the
+         * waypoint ring, then upload scripts/ur_servoj_stream.script.
+         *
+         * The receiver thread moves buffered waypoints into the ring as
+         * the controller consumes them, see Trajectory_Stream.
+         *
+         * \param mode joint positions or TCP poses
+         * \param capacity number of waypoints buffered on the host
+         */
+        bool enable_trajectory(Traj_Mode mode = TRAJ_JOINT, std::size_t capacity = 64);
+        bool init_trajectory();
+
+        /**
+         * \brief queue a new waypoint
+         *
+         * \param t time along the trajectory [s], must be increasing
+         * \param q joint positions or TCP pose, depending on mode
+         *
+         * \return false if the buffer is full (see trajectory_space())
+         */
+        bool push_waypoint(double t, const std::vector<double>& q);
+
+        /**
+         * \return number of waypoints that can be queued right now
+         */
+        std::size_t trajectory_space();
+
+        /**
+         * \brief let the controller finish the queued waypoints and stop
+         */
+        void finish_trajectory();
+
+        /**
+         * \brief recover automatically when the RTDE session is lost
+         *
+         * Enabled by default. When the socket closes, or too many
+         * consecutive frames fail, the receiver thread reconnects,
+         * registers the recipes again and resumes the stream, see
+         * RTDE_Handler::reconnect(). Meanwhile state() returns the last
+         * state received and update_w() fails.
+         *
+         * The policy should be set before start().
+         */
+        void set_reconnect(bool enable, const Reconnect_Policy& policy = Reconnect_Policy());
+
+        /**
+         * \brief number of losses, recoveries and time-to-recover
+         */
+        Recovery_Stats recovery_stats() const { return rtdeh_->recovery_stats(); }
+
+        /**
+         * \brief next text message (warnings, errors) from the controller
+         *
+         * Queued by the receiver, see RTDE_Handler::pop_message().
+         */
+        bool pop_message(RTDE_Text_Message& msg) { return rtdeh_->pop_message(msg); }
+
+        /**
+         * \brief how long the receiver waits for a frame before the
+         * session is considered lost (default RTDE_RECV_TIMEOUT_MS).
+         *
+         * Also bounds the control requests (register, start, stop).
+         */
+        void set_recv_timeout(int timeout_ms) { rtdeh_->set_recv_timeout(timeout_ms); }
+
+        /**
+         * \brief keep the last frames of the output recipe, see History
+         *
+         * Must be called after init_output() and before start().
+         *
+         * \param capacity frames kept (4096 is ~8s at 500Hz)
+         * \return the history (owned by Robot), nullptr on error
+         */
+        const History *enable_history(std::size_t capacity = 4096);
+        const History *history() const { return history_; }
+
+        /**
+         * \brief derived signals computed per frame, see Derived_Signals
+         *
+         * Must be called after init_output() and before start(). Declare
+         * the signals and attach() the stage before enable_history() or
+         * any other sink, so that they pick up the extra columns:
+         *
+         *    auto d = robot.enable_derived();
+         *    d->product("joint_power", "actual_current", "actual_joint_voltage");
+         *    d->attach();
+         *    robot.enable_history();
+         *
+         * The values of every frame are copied into the state, so
+         * state() (from any thread) carries them:
+         *
+         *    double p0 = robot.state().derived[d->slot("joint_power")];
+         *
+         * \return the stage (owned by Robot), nullptr on error
+         */
+        Derived_Signals *enable_derived();
+        const Derived_Signals *derived() const { return derived_; }
+
+        /**
+         * \brief host/script liveness check, see Heartbeat
+         *
+         * Adds the heartbeat registers to the recipes, so it must be
+         * called before init_output() and init_input(). Every input
+         * frame sent carries a new host seqnr, and the receiver checks
+         * the script seqnr of every frame. The shipped scripts
+         * (ur_speedj.script, tcp_pose.script, ur_servoj_stream.script)
+         * stop the arm after max_missed cycles without a new host seqnr;
+         * upload_script() hands them the registers (Heartbeat::params()).
+         */
+        bool enable_heartbeat(int max_missed = HB_DEFAULT_MAX_MISSED);
+
+        /**
+         * \brief register callback for when the script heartbeat is lost
+         *
+         * Must be set after enable_heartbeat() and before start(). The
+         * callback is called from the receiver thread without any locks
+         * held, with the detection latency [ns].
+         */
+        void on_heartbeat_lost(std::function<void(int64_t)> cb) { if (hb_) hb_->on_stall(cb); }
+
+        Heartbeat_Stats heartbeat_stats() const;
+
     private:
         /**
          * \brief mainloop for reciever thread
@@ -320,6 +613,32 @@ namespace urx {
          */
         Robot_State loc_state();
 
+        /**
+         * \brief cover for a late frame using the gap-policy
+         *
+         * Expects to be called with bottleneck held (via lk). Waits
+         * until the next frame is overdue and then synthesizes a new
+         * state.
+         *
+         * \returns true if out was populated with an extrapolated state
+         */
+        bool extrapolate(std::unique_lock<std::mutex>& lk, Robot_State& out);
+
+        /**
+         * \brief release queued input at the right phase
+         *
+         * Called by the receiver after each frame when phase-lock is
+         * enabled, expects to be called *without* locks held. Sleeps
+         * until the release point, then sends what update_w() queued,
+         * waiting at most until the next frame is due for it.
+         */
+        void release_queued(int64_t rx_ns);
+
+        /**
+         * \brief send the input recipe, expects locks to be held.
+         */
+        bool send_input();
+
         /**
          * \brief Monitors whether the results from inverse cinematic calculations in URScript are received in time.
          * 
@@ -373,6 +692,40 @@ namespace urx {
         std::vector<std::tuple<std::chrono::microseconds, double>> ts_log;
         FILE *ts_log_fd;
         bool ts_log_debug;
+
+        // Frame-gap detection and extrapolation over lost frames
+        Frame_Monitor frame_mon_;
+        Gap_Policy gap_policy_;
+        std::function<void(const Robot_State&)> on_state_;
+        int max_extrapolated_;
+        int num_extrapolated_;
+        Robot_State extrap_state_;
+        std::chrono::steady_clock::time_point last_rx_;
+
+        // mapping between controller time and local time
+        Clock_Sync clock_;
+
+        // phase-locked transmission
+        Phase_Lock phase_;
+        std::atomic<bool> phase_lock_;
+        std::atomic<bool> phase_reset_;     // enable_phase_lock(), done by the receiver
+        bool tx_pending_;       // update_w() queued an update
+        std::condition_variable tx_cv_;     // tx_pending_ set
+        bool tx_staged_;        // stage_w() prepared an update
+        bool tx_outstanding_;   // update released, awaiting echo
+        uint32_t tx_seqnr_;
+
+        // streamed trajectory, separate input recipe
+        Trajectory_Stream *traj_;
+        urx::RTDE_Recipe *traj_in_;
+
+        History *history_;
+        Derived_Signals *derived_;
+        Heartbeat *hb_;
+
+        // session recovery
+        std::atomic<bool> reconnect_;
+        Reconnect_Policy reconnect_policy_;
     };
 }
 #endif  // URX_ROBOT_HPP
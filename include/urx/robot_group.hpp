@@ -0,0 +1,115 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_ROBOT_GROUP_HPP
+#define URX_ROBOT_GROUP_HPP
+#include <urx/robot.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace urx {
+    constexpr int GROUP_ALIGN_ATTEMPTS = 3;
+
+    /**
+     * \brief one control cycle of all arms in a Robot_Group
+     */
+    struct Group_Cycle {
+        std::vector<Robot_State> states;
+        std::vector<int64_t> host_ns;   // state mapped to CLOCK_MONOTONIC, 0: no clock estimate yet
+        int64_t skew_ns;                // spread of host_ns, -1 until all arms have an estimate
+        int64_t release_spread_ns;      // first to last send of the last commit()
+    };
+
+    struct Group_Stats {
+        uint64_t cycles;
+        uint64_t misaligned;            // cycles where skew stayed above half a period
+        int64_t max_skew_ns;
+        double mean_skew_ns;
+        uint64_t commits;
+        uint64_t failed_releases;
+        int64_t max_spread_ns;
+        double mean_spread_ns;
+    };
+
+    /**
+     * \brief drive several arms (a dual-arm cell etc) in lock-step
+     *
+     * Each arm is a Robot with its own controller and connection.
+     * wait() collects a new state from every arm and lines them up on
+     * the controller clock: each controller timestamp is mapped to
+     * local time through that arm's Clock_Sync, and an arm running a
+     * cycle behind is given its next frame. The remaining spread is
+     * reported as the inter-arm skew of the cycle.
+     *
+     * Updates are gathered with stage() and sent by commit(). Staging
+     * builds the input frames, so commit() only issues one send per
+     * arm back-to-back from the calling thread; the spread between the
+     * first and the last send is reported with the next cycle.
+     *
+     *    urx::Robot_Group group;
+     *    group.add(&left);
+     *    group.add(&right);
+     *    urx::Group_Cycle c;
+     *    while (group.wait(c)) {
+     *        group.stage(0, w_left);
+     *        group.stage(1, w_right);
+     *        group.commit();
+     *    }
+     *
+     * Robots are not owned by the group and must be started (without
+     * phase-lock) before wait(). All calls are expected from a single
+     * control thread.
+     */
+    class Robot_Group
+    {
+    public:
+        /**
+         * \param period controller cycle [s]
+         */
+        Robot_Group(double period = 0.002);
+
+        /**
+         * \return index of the arm
+         */
+        std::size_t add(Robot *robot);
+        std::size_t size() const { return arms_.size(); }
+        Robot *arm(std::size_t idx) const { return arms_[idx]; }
+
+        /**
+         * \brief new, aligned state from every arm
+         *
+         * \return false if an arm did not deliver a state in time
+         */
+        bool wait(Group_Cycle& cycle);
+
+        /**
+         * \brief prepare new target joint speed for one arm
+         */
+        bool stage(std::size_t idx, const std::vector<double>& new_w);
+
+        /**
+         * \brief send all staged updates together
+         *
+         * \return true if every staged update was sent
+         */
+        bool commit();
+
+        Group_Stats stats() const { return stats_; }
+
+    private:
+        int64_t host_ns(std::size_t idx, const Robot_State& s) const;
+        int64_t skew(const std::vector<int64_t>& host, std::size_t& lagging) const;
+
+        const double period_;
+        std::vector<Robot *> arms_;
+        std::vector<bool> staged_;
+        int64_t last_spread_ns_;
+        Group_Stats stats_;
+    };
+}
+#endif  // URX_ROBOT_GROUP_HPP
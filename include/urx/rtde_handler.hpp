@@ -14,14 +14,65 @@
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <future>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <chrono>
 
 #include <urx/handler.hpp>
 #include <urx/header.hpp>
 #include <urx/con.hpp>
 #include <urx/rtde_recipe.hpp>
+#include <urx/text_queue.hpp>
 
 namespace urx
 {
+    // how long a control request (version, recipe, start/pause) may
+    // wait for its reply
+    constexpr int RTDE_REPLY_TIMEOUT_MS = 500;
+
+    // reads recv() does before giving up on a cycle without a data package
+    constexpr int RTDE_RECV_MAX_READS = 8;
+    struct Reconnect_Policy {
+        std::chrono::milliseconds initial_backoff{10};
+        std::chrono::milliseconds max_backoff{500};
+        int max_attempts{0};            // 0: keep trying
+    };
+
+    struct Recovery_Stats {
+        uint64_t losses;                // times reconnect() was needed
+        uint64_t recoveries;            // successful reconnects
+        uint64_t attempts;              // connection attempts in total
+        double last_ms;                 // time to recover, last
+        double max_ms;                  // time to recover, worst
+    };
+
+    struct RTDE_Rx_Stats {
+        uint64_t data;                  // data packages
+        uint64_t text;                  // text messages queued
+        uint64_t replies;               // control replies matched to a request
+        uint64_t unexpected;            // control replies nobody waited for, unknown types
+        uint64_t malformed;             // bad package size, read discarded
+        uint64_t dropped_text;          // text queue full
+    };
+
+    struct Swap_Stats {
+        uint64_t input_swaps;
+        uint64_t output_swaps;
+        double last_input_ms;           // swap_input(): call to switch-over
+        double last_gap_ms;             // swap_output(): last frame of the old recipe to the first of the new
+        double max_gap_ms;
+    };
+
+    /**
+     * \brief a control request in flight, see RTDE_Handler::wait()
+     */
+    struct RTDE_Request {
+        uint64_t id;
+        std::future<bool> result;       // true once CON accepted it
+    };
+
     class RTDE_Handler : public Handler
     {
 public:
@@ -29,6 +80,15 @@ public:
     RTDE_Handler(Con* c) :
         Handler(c),
         out(nullptr),
+        streaming_(false),
+        timed_out_(false),
+        recovery_({0, 0, 0, 0.0, 0.0}),
+        reregistering_(false),
+        receiver_(std::thread::id()),
+        next_request_(0),
+        swap_({0, 0, 0.0, 0.0, 0.0}),
+        gap_next_(nullptr),
+        gap_watch_(false),
         proxy_running(false)
     {
         con_->do_connect();
@@ -44,6 +104,7 @@ public:
      * \return true if UR controller supports v2
      */
     bool set_version();
+    RTDE_Request set_version_async();
 
     /**
      * \brief Kick connection and open socket to remote
@@ -105,6 +166,7 @@ public:
      * \return true if valid recipe and it was accepted by the UR controller
      */
     bool register_recipe(urx::RTDE_Recipe *r);
+    RTDE_Request register_recipe_async(urx::RTDE_Recipe *r);
 
     /**
      * \brief: start the stream of data relevant to the registered
@@ -121,6 +183,42 @@ public:
      * \return true if CON accepted the request.
      */
     bool start();
+    RTDE_Request start_async();
+
+    /**
+     * \brief replace an input recipe while the stream is running
+     *
+     * next is registered alongside the recipe currently at recipe_id,
+     * then the two are switched under the lock that serializes send():
+     * a send() is either the old layout or the new one, and from then
+     * on send(recipe_id) goes out with next (as does send() with the
+     * id of next). The old recipe is not re-registered on reconnect()
+     * and can be cleared or deleted by the caller.
+     *
+     * The controller lets a variable be in only one input recipe, so
+     * next should only carry new variables or those of recipes not in
+     * use; otherwise CON refuses it and the old recipe stays active.
+     *
+     * \return true once the new recipe is in use
+     */
+    bool swap_input(int recipe_id, urx::RTDE_Recipe *next);
+
+    /**
+     * \brief replace the output recipe with as short a gap as possible
+     *
+     * CON only changes the output recipe while paused, so pause, the
+     * new recipe and start are sent back to back and cost a single
+     * round trip. Frames in flight are parsed with the old recipe,
+     * everything after the reply with next. The gap between the last
+     * frame of the old and the first frame of the new recipe is
+     * reported in swap_stats() once that frame has arrived.
+     *
+     * \return true if CON accepted the new recipe and the stream is
+     * running again (if it was running)
+     */
+    bool swap_output(urx::RTDE_Recipe *next);
+
+    Swap_Stats swap_stats() const;
 
     /**
      * \brief: send an update of a specified input-recipe
@@ -134,6 +232,19 @@ public:
      */
     bool send(int recipe_id);
 
+    /**
+     * \brief split send() in two
+     *
+     * prepare() gathers the data into the DATA_PACKAGE of the recipe,
+     * send_prepared() only hands that package to the connection, so
+     * several frames can be built first and then sent back-to-back.
+     * A send() in between replaces the prepared package.
+     *
+     * \return true if the recipe is registered (and the frame was sent OK)
+     */
+    bool prepare(int recipe_id);
+    bool send_prepared(int recipe_id);
+
     /**
      * \brief receive new data (blocking)
      *
@@ -141,18 +252,119 @@ public:
      * parse_incoming_data() for decoding. The decoded data will be
      * stored in the locations specified for the recipe-fields.
      *
-     * Currently it assumes all incoming data is of type
-     * RTDE_DATA_PACKAGE belonging to the output_recipe.
+     * Every package in the stream is dispatched on its type:
+     *
+     *   DATA_PACKAGE     parsed with the output recipe
+     *   TEXT_MESSAGE     queued, see pop_message()
+     *   control replies  handed to the request waiting for it
+     *                    (start(), stop(), register_recipe() ..)
+     *
+     * Anything else is counted in rx_stats() and skipped. If a read
+     * held no data package, recv() keeps reading within the same
+     * timeout, so a message from the controller does not cost the
+     * data of that cycle.
+     *
+     * Blocks at most for the receive timeout (set_recv_timeout()),
+     * see timed_out(), or until cancel_recv().
 
      * \return true if valid, parseable data was received.
      */
     virtual bool recv();
 
+    /**
+     * \brief tell the handler a thread is calling recv() in a loop
+     *
+     * Call with true from the receiver thread before its first recv()
+     * and with false before it leaves. While set, requests from other
+     * threads only wait for the receiver to dispatch their reply and
+     * never read the stream themselves, which would steal its data
+     * frames. The receiver itself (e.g. in reconnect()) still reads.
+     */
+    void set_receiver(bool running);
+
+    /**
+     * \brief next text message from the controller
+     *
+     * Messages are queued by the receiver without locking or
+     * allocating, so log them from a thread that is not on the control
+     * path. Expects a single consumer.
+     *
+     * \return false if no message is waiting
+     */
+    bool pop_message(RTDE_Text_Message& msg) { return text_.pop(msg); }
+
+    /**
+     * \brief counters for the packages seen by the receiver
+     */
+    RTDE_Rx_Stats rx_stats() const;
+
+    /**
+     * \return true if the last recv() gave up because nothing arrived
+     */
+    bool timed_out() const { return timed_out_; }
+
     /**
      * \brief kindly ask CON to stop sending output updates
      * \return true if request was accepted
      */
     bool stop();
+    RTDE_Request stop_async();
+
+    /**
+     * \brief wait for the reply to an asynchronous request
+     *
+     * The *_async() calls send the request and return at once, so
+     * several can be in flight, e.g. the version, all recipes and
+     * start, costing a single round trip together:
+     *
+     *     std::vector<urx::RTDE_Request> reqs;
+     *     reqs.push_back(h.set_version_async());
+     *     reqs.push_back(h.register_recipe_async(&out));
+     *     reqs.push_back(h.register_recipe_async(&in));
+     *     reqs.push_back(h.start_async());
+     *     bool ok = h.wait_all(reqs);
+     *
+     * CON answers in order; replies are matched to the oldest pending
+     * request of the same type. If a receiver is running (see
+     * set_receiver()), the reply is picked up by recv() and the stream
+     * is not interrupted, otherwise wait() reads (and dispatches) the
+     * stream itself.
+     *
+     * A request without a reply within the timeout is dropped and
+     * counts as rejected. Its place in the queue is kept until the
+     * reply shows up (or the session is re-established), so a late
+     * reply is discarded and not taken for the next request of the
+     * same type. Requests still waiting when reconnect() establishes a
+     * new session are rejected.
+     *
+     * \return true if CON accepted the request
+     */
+    bool wait(RTDE_Request& req, int timeout_ms = RTDE_REPLY_TIMEOUT_MS);
+    bool wait_all(std::vector<RTDE_Request>& reqs, int timeout_ms = RTDE_REPLY_TIMEOUT_MS);
+
+    /**
+     * \brief re-establish a lost session
+     *
+     * Closes the socket and connects again with exponential backoff,
+     * then negotiates the protocol version, registers the same
+     * recipes (which may get new ids), re-sends the current values of
+     * all input recipes and restarts the stream if it was running.
+     *
+     * send() and send_prepared() fail fast while an attempt is in
+     * progress and, as the socket is closed, between attempts. Neither
+     * waits for the connect or the replies.
+     *
+     * \param policy backoff and retry limits
+     * \param keep_going polled between attempts, return false to give up
+     * \return true when the session is restored
+     */
+    bool reconnect(const Reconnect_Policy& policy = Reconnect_Policy(),
+                   std::function<bool()> keep_going = nullptr);
+
+    /**
+     * \brief number of losses, recoveries and time-to-recover
+     */
+    Recovery_Stats recovery_stats() const { return recovery_; }
 
     /**
      * \brief Apply the registered recipe(s) to the incoming data.
@@ -168,14 +380,71 @@ public:
 
 private:
     RTDE_Recipe *out;
+    // by id, a swapped-out id maps to its successor. Lookups are
+    // short, so they do not contend with send() holding bottleneck
     std::unordered_map<int, RTDE_Recipe *> recipes_in;
+    std::mutex recipes_lock_;
     // URControl will return a frame of *maximum* 2000 bytes, so set
     // recv-buffer to handle that.
     unsigned char buffer_[2048];
 
     void rtde_worker();
+    RTDE_Request submit_(void *req, int sz, std::function<bool(const unsigned char *, int)> done);
+    bool wait_until_(RTDE_Request& req, std::chrono::steady_clock::time_point deadline);
+    void drop_(uint64_t id, bool sent = true);
+    int read_(int timeout_ms, bool& parsed);
+    int dispatch_(struct rtde_header *hdr, unsigned long rx_ts);
+    bool registered_(urx::RTDE_Recipe *r, const unsigned char *reply, int len);
+    void note_frame_();
+    bool send_(int recipe_id);
+    RTDE_Recipe *in_recipe_(int recipe_id);
+    bool reregister(bool restart);
 
+    // input recipes in the order they were registered
+    std::vector<RTDE_Recipe *> registered_in_;
+    bool streaming_;
+    bool timed_out_;
+    Recovery_Stats recovery_;
+
+    // serializes send() with the recipe bookkeeping of a register
+    // reply and with swapping the recipe maps
     std::mutex bottleneck;
+    // reconnect() in progress, send() fails fast (set under bottleneck)
+    std::atomic<bool> reregistering_;
+
+    // buffer_ belongs to whoever holds rx_lock_, recv() or a request
+    // waiting for its reply when no receiver is running.
+    std::mutex rx_lock_;
+    std::atomic<std::thread::id> receiver_;
+
+    // control requests in the order they were sent, the dispatcher
+    // completes the oldest one of the type of the reply. A dropped
+    // request stays as a tombstone to swallow its late reply.
+    struct Pending_Request {
+        uint64_t id;
+        uint8_t type;
+        bool dropped;
+        std::function<bool(const unsigned char *, int)> done;
+        std::promise<bool> result;
+    };
+    std::mutex send_lock_;
+    std::mutex pending_lock_;
+    std::deque<std::unique_ptr<Pending_Request>> pending_;
+    uint64_t next_request_;
+
+    // output swap, the receiver timestamps frames around the switch
+    mutable std::mutex swap_lock_;
+    Swap_Stats swap_;
+    RTDE_Recipe *gap_next_;
+    std::atomic<bool> gap_watch_;
+    std::chrono::steady_clock::time_point gap_last_;
+
+    Text_Queue text_;
+    std::atomic<uint64_t> rx_data_{0};
+    std::atomic<uint64_t> rx_text_{0};
+    std::atomic<uint64_t> rx_replies_{0};
+    std::atomic<uint64_t> rx_unexpected_{0};
+    std::atomic<uint64_t> rx_malformed_{0};
 
     bool proxy_running;
 };
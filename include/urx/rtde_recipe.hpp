@@ -13,10 +13,44 @@
 #include <urx/rtde_recipe_token.hpp>
 #include <string>
 #include <vector>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
 #include <exception>
 
 namespace urx
 {
+    class Derived_Signals;
+
+    /**
+     * \brief a boolean or small integer packed into the bit registers
+     */
+    struct RTDE_Bit_Field {
+        std::string name;
+        int bit;                // first bit, 0..63
+        int width;              // number of bits, 1..32
+
+        int word() const { return bit / 32; }
+        int shift() const { return bit % 32; }
+        uint32_t mask() const { return (width == 32 ? ~0U : (1U << width) - 1) << shift(); }
+
+        std::function<uint32_t()> get;
+        std::function<void(uint32_t)> set;
+    };
+
+    /**
+     * \brief consumer of every (raw) frame parsed by an output recipe
+     *
+     * Called from the receiver thread right after the fields have been
+     * parsed, with the payload still in network byte order and the
+     * local receive timestamp. With a Derived_Signals stage attached,
+     * the payload is extended with the derived values (see
+     * Decode_Plan). Must not block.
+     */
+    struct RTDE_Frame_Sink {
+        virtual ~RTDE_Frame_Sink() =default;
+        virtual void on_frame(const unsigned char *payload, unsigned long ts) = 0;
+    };
 
     class RTDE_Recipe
     {
@@ -24,8 +58,13 @@ namespace urx
         RTDE_Recipe() :
             active_(false),
             recipe_id_(-1),
+            derived_(nullptr),
             bytes(0),
-            dir_out_(true)
+            dir_out_(true),
+            bit_words_{0, 0},
+            bit_word_added_{false, false},
+            used_bits_(0),
+            next_bit_(0)
         {
             ts_ns_ = nullptr;
             cpo = rtde_control_msg_get(125.0);
@@ -47,10 +86,98 @@ namespace urx
         bool add_field(std::string name, void *storage);
         std::string get_fields();
 
+        /**
+         * \brief pack a bool, enum or small integer into the bit registers
+         *
+         * Bits are packed into input_bit_registers0_to_31 and
+         * 32_to_63 (output_bit_registers* for output recipes), and the
+         * word is added as a field when its first bit is taken. Values
+         * are packed in store() and unpacked in parse(), so the
+         * storage is used just like with add_field().
+         *
+         * A field never straddles the two words.
+         *
+         * \param width number of bits
+         * \param bit first bit to use (0..63), next free if negative
+         * \return first bit used, -1 on error (or overlap)
+         */
+        template<typename T>
+        int add_bit_field(const std::string& name, T *storage, int width = 1, int bit = -1)
+        {
+            static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                          "bit fields must be bool, integer or enum");
+            if (!storage || width < 1 || width > 32)
+                return -1;
+
+            if (bit < 0) {
+                bit = next_bit_;
+                if (bit / 32 != (bit + width - 1) / 32)
+                    bit = (bit / 32 + 1) * 32;
+            } else if (bit / 32 != (bit + width - 1) / 32) {
+                return -1;
+            }
+            if (bit + width > 64)
+                return -1;
+
+            uint64_t m = ((1ULL << width) - 1) << bit;
+            if (used_bits_ & m)
+                return -1;
+            if (!add_bit_word(bit / 32))
+                return -1;
+
+            RTDE_Bit_Field f;
+            f.name = name;
+            f.bit = bit;
+            f.width = width;
+            f.get = [storage]() { return (uint32_t)*storage; };
+            f.set = [storage](uint32_t v) { *storage = (T)v; };
+            bit_fields.push_back(f);
+
+            used_bits_ |= m;
+            if (bit + width > next_bit_)
+                next_bit_ = bit + width;
+            return bit;
+        }
+
+        const std::vector<RTDE_Bit_Field>& get_bit_fields() { return bit_fields; }
+
+        /**
+         * \brief the tokens, in wire order (name, type and offset)
+         */
+        const std::vector<RTDE_Recipe_Token *>& get_tokens() { return fields; }
+
+        /**
+         * \brief feed every parsed frame to sink as well
+         *
+         * Not thread-safe, add sinks before the receiver is started.
+         */
+        void add_sink(RTDE_Frame_Sink *sink);
+        void remove_sink(RTDE_Frame_Sink *sink);
+
+        /**
+         * \brief per-frame compute stage run before the sinks
+         *
+         * Set by Derived_Signals::attach(), nullptr to remove.
+         */
+        void set_derived(Derived_Signals *derived) { derived_ = derived; }
+        Derived_Signals * derived() { return derived_; }
+
+        /**
+         * \brief URScript accessors for the bit fields
+         *
+         * get_<name>() for input recipes and set_<name>(v) for output
+         * recipes, multi-bit fields are (de)composed with
+         * binary_list_to_integer() and integer_to_binary_list().
+         */
+        std::string bit_field_script();
+
         bool track_ts_ns(unsigned long *ts_ns);
 
         /**
          * \brief Clear all fields stored in the recipe
+         *
+         * The recipe can be filled again and registered anew, the
+         * storage of the old fields is no longer touched.
          */
         void clear_fields();
 
@@ -93,13 +220,23 @@ namespace urx
         unsigned long *ts_ns_;
 
         std::vector<RTDE_Recipe_Token *> fields;
+        std::vector<RTDE_Frame_Sink *> sinks_;
+        Derived_Signals *derived_;
         struct rtde_control_package_out *cpo;
         struct rtde_control_package_in *cpi;
         int bytes;
         bool dir_out_;
         struct rtde_data_package *dp_;
 
+        // bit fields packed into (at most) 2 registered words
+        std::vector<RTDE_Bit_Field> bit_fields;
+        uint32_t bit_words_[2];
+        bool bit_word_added_[2];
+        uint64_t used_bits_;
+        int next_bit_;
+
         bool set_dir(bool dir_out);
+        bool add_bit_word(int word);
         struct rtde_control_package_out * msg_out_();
         struct rtde_control_package_in * msg_in_();
     };
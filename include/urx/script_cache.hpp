@@ -0,0 +1,121 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_SCRIPT_CACHE_HPP
+#define URX_SCRIPT_CACHE_HPP
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+namespace urx {
+    typedef std::map<std::string, std::string> Script_Params;
+
+    /**
+     * \brief normalized script, split at ${name} placeholders
+     *
+     * The script is normalized (CRLF -> LF, tabs -> 8 spaces) once when
+     * compiled, rendering is then a single pass over precomputed
+     * segments.
+     */
+    class Script_Template
+    {
+    public:
+        explicit Script_Template(const std::string& raw);
+
+        /**
+         * \brief substitute placeholders
+         *
+         * \return false if a placeholder has no value in params
+         */
+        bool render(const Script_Params& params, std::string& out) const;
+
+        const std::string& text() const { return text_; }
+        bool has_placeholders() const { return !segments_.empty(); }
+        const std::vector<std::string>& placeholders() const { return names_; }
+
+    private:
+        struct Segment {
+            std::size_t lit_end;    // end of literal text preceding placeholder
+            std::size_t next;       // where to continue after the placeholder
+            std::size_t name;       // index into names_
+        };
+
+        std::string text_;
+        std::vector<Segment> segments_;
+        std::vector<std::string> names_;
+    };
+
+    struct Script_Cache_Stats {
+        uint64_t hits;          // served without touching the file
+        uint64_t reads;         // file (re)read from disk
+        uint64_t compiles;      // new content normalized and compiled
+        uint64_t renders;       // placeholders substituted
+    };
+
+    /**
+     * \brief cache of compiled and rendered scripts
+     *
+     * A file is only read when its mtime or size changes, and only
+     * compiled when its content hash (FNV-1a) is new. Rendered output
+     * for a given set of parameters is kept, so re-uploading the same
+     * script with the same registers sends the cached buffer directly.
+     */
+    class Script_Cache
+    {
+    public:
+        Script_Cache() : stats_({0, 0, 0, 0}) {};
+
+        /**
+         * \brief get ready-to-send script
+         *
+         * \return rendered script, nullptr if file cannot be read or a
+         * placeholder is missing in params.
+         */
+        std::shared_ptr<const std::string> script(const std::string& fname,
+                                                  const Script_Params& params = Script_Params());
+
+        /**
+         * \brief get compiled template, nullptr if file cannot be read
+         */
+        std::shared_ptr<const Script_Template> get(const std::string& fname);
+
+        void clear();
+        Script_Cache_Stats stats();
+
+        /**
+         * \brief process-wide cache, used by URX_Handler
+         */
+        static Script_Cache& global();
+
+        static uint64_t hash(const std::string& s);
+
+    private:
+        static constexpr std::size_t MAX_RENDERED = 16;
+
+        struct Entry {
+            std::shared_ptr<const Script_Template> tmpl;
+            std::map<Script_Params, std::shared_ptr<const std::string>> rendered;
+        };
+
+        struct File {
+            int64_t mtime_ns;
+            int64_t size;
+            uint64_t hash;
+        };
+
+        std::shared_ptr<Entry> lookup(const std::string& fname);
+
+        std::mutex lock_;
+        std::map<std::string, File> files_;
+        std::map<uint64_t, std::shared_ptr<Entry>> entries_;
+        Script_Cache_Stats stats_;
+    };
+}
+#endif  // URX_SCRIPT_CACHE_HPP
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_TEXT_QUEUE_HPP
+#define URX_TEXT_QUEUE_HPP
+#include <urx/header.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace urx {
+    constexpr std::size_t TEXT_QUEUE_SIZE = 64;     // power of two
+
+    /**
+     * \brief RTDE_TEXT_MESSAGE sent by the controller
+     *
+     * Fixed size so that queueing it does not allocate in the
+     * receiver. Longer sources are truncated, the message itself is
+     * at most 255 bytes on the wire.
+     */
+    struct RTDE_Text_Message {
+        uint8_t level;              // RTDE_MESSAGE_TYPES
+        unsigned long rx_ts;        // local receive time [ns]
+        char source[64];
+        char text[256];
+    };
+
+    /**
+     * \brief parse a RTDE_TEXT_MESSAGE package
+     *
+     * \return false if the lengths do not add up to hdr.size
+     */
+    bool rtde_parse_text_message(const struct rtde_header *hdr, unsigned long rx_ts, RTDE_Text_Message& msg);
+
+    /**
+     * \brief single producer, single consumer ring of text messages
+     *
+     * The RTDE receiver pushes, whoever logs the messages pops. Neither
+     * side blocks or allocates; when the consumer falls behind, new
+     * messages are dropped and counted.
+     */
+    class Text_Queue
+    {
+    public:
+        Text_Queue() : head_(0), tail_(0), dropped_(0) {}
+
+        /**
+         * \return false if the queue was full (message dropped)
+         */
+        bool push(const RTDE_Text_Message& msg);
+
+        /**
+         * \return false if the queue is empty
+         */
+        bool pop(RTDE_Text_Message& msg);
+
+        std::size_t size() const;
+        uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        RTDE_Text_Message slots_[TEXT_QUEUE_SIZE];
+        std::atomic<uint64_t> head_;    // next to pop
+        std::atomic<uint64_t> tail_;    // next to push
+        std::atomic<uint64_t> dropped_;
+    };
+}
+#endif  // URX_TEXT_QUEUE_HPP
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#ifndef URX_TRAJECTORY_HPP
+#define URX_TRAJECTORY_HPP
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <urx/rtde_recipe.hpp>
+
+namespace urx {
+    constexpr std::size_t TRAJ_DOF = 6;
+
+    // Number of waypoints mirrored in input registers at any time. Each
+    // slot uses TRAJ_SLOT_REGS double registers (duration + 6 values),
+    // so 3 slots take input double registers 24..44 of the 24..47 range
+    // reserved for RTDE clients. 45..47 are left for Register_Map.
+    constexpr std::size_t TRAJ_RING = 3;
+    constexpr std::size_t TRAJ_SLOT_REGS = 1 + TRAJ_DOF;
+
+    // First register of the trajectory block (both int and double)
+    constexpr int TRAJ_REG_BASE = 24;
+
+    enum Traj_Mode {
+        TRAJ_STOP = 0,          // drain what is written, then stop
+        TRAJ_JOINT = 1,         // waypoints are joint positions [rad]
+        TRAJ_TCP = 2,           // waypoints are TCP poses (x,y,z,rx,ry,rz)
+    };
+
+    struct Waypoint {
+        double t;                       // time along trajectory [s]
+        std::array<double, TRAJ_DOF> q;
+    };
+
+    /**
+     * \brief Stream timestamped waypoints to a servoj consumer on the controller
+     *
+     * Waypoints are pushed into a bounded host-side buffer, and as the
+     * script on the controller consumes them, they are moved into a
+     * ring of TRAJ_RING slots of input registers. This allows the host
+     * to run several cycles ahead and the controller always has some
+     * lookahead to cover for a late host.
+     *
+     * Register layout (N = TRAJ_REG_BASE)
+     *
+     *   input_int_register_N           number of waypoints written to the ring
+     *   input_int_register_N+1         mode (Traj_Mode)
+     *   input_double_register_N+7*s    duration of slot s [s]
+     *   input_double_register_N+7*s+j  value j of slot s
+     *   output_int_register_N          number of waypoints consumed by the script
+     *
+     * Waypoint w lives in slot (w % TRAJ_RING), the counters are 32 bit
+     * so at 500Hz they wrap after ~49 days.
+     *
+     * See scripts/ur_servoj_stream.script for the consumer.
+     *
+     * Not thread-safe, caller is responsible for locking.
+     */
+    class Trajectory_Stream
+    {
+    public:
+        Trajectory_Stream(std::size_t capacity = 64, Traj_Mode mode = TRAJ_JOINT);
+
+        /**
+         * \brief add output field(s) for flow control to the output recipe
+         */
+        bool add_output_fields(RTDE_Recipe *out);
+
+        /**
+         * \brief add the register ring to an (otherwise empty) input recipe
+         */
+        bool add_input_fields(RTDE_Recipe *in);
+
+        /**
+         * \brief append waypoint to the buffer
+         *
+         * \return false if buffer is full or time is not increasing
+         */
+        bool push(const Waypoint& wp);
+
+        /**
+         * \brief move buffered waypoints into free ring slots
+         *
+         * To be called for every output frame received (after the
+         * consumed counter has been updated).
+         *
+         * \return true if the input registers changed and must be sent
+         */
+        bool sync();
+
+        /**
+         * \brief tell the consumer to stop once the written waypoints are done
+         */
+        void finish() { mode_ = TRAJ_STOP; };
+
+        /**
+         * \return number of waypoints that can be pushed right now
+         */
+        std::size_t space() const { return buf_.size() - count_; }
+
+        /**
+         * \return waypoints written, but not yet consumed by the controller
+         */
+        std::size_t in_flight() const { return (uint32_t)written_ - (uint32_t)consumed_; }
+
+        /**
+         * \return waypoints buffered on host, not yet written to the ring
+         */
+        std::size_t buffered() const { return count_; }
+
+        int32_t written() const { return written_; }
+        int32_t consumed() const { return consumed_; }
+
+    private:
+        std::vector<Waypoint> buf_;
+        std::size_t head_;
+        std::size_t count_;
+        double last_t_;         // time of last waypoint written to ring
+        bool have_last_;
+        double last_pushed_t_;
+
+        // mirror of the registers, addresses are registered with recipes
+        int32_t written_;
+        int32_t mode_;
+        double regs_[TRAJ_RING][TRAJ_SLOT_REGS];
+        int32_t consumed_;
+
+        int32_t sent_mode_;
+    };
+}
+#endif  // URX_TRAJECTORY_HPP
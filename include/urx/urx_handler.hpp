@@ -11,7 +11,11 @@
 #include <urx/handler.hpp>
 #include <urx/con.hpp>
 
-#include <urx/urx_script.hpp>
+#include <urx/script_cache.hpp>
+#include <urx/primary.hpp>
+
+#include <thread>
+#include <atomic>
 
 namespace urx {
     /**
@@ -20,19 +24,61 @@ namespace urx {
 class URX_Handler : public Handler
 {
 public:
-    URX_Handler(Con *c) : Handler(c)
+    URX_Handler(Con *c) : Handler(c), reading_(false)
     {
         con_->do_connect();
     };
 
     URX_Handler(const std::string remote) : URX_Handler(new Con(remote, URX_PORT)) {};
 
+    ~URX_Handler() { stop_reader(); }
+
     void disconnect() { con_->disconnect(); };
 
-    bool upload_script(const std::string script_name);
+    /**
+     * \brief upload script to the controller
+     *
+     * The script is served from Script_Cache::global(), so it is only
+     * read and normalized when the file changes, and ${name}
+     * placeholders are substituted from params.
+     *
+     * \return true if the complete script was sent
+     */
+    bool upload_script(const std::string script_name, const Script_Params& params = Script_Params());
+
+    /**
+     * \brief start background reader for the primary/secondary stream
+     *
+     * The controller pushes robot-state on this socket at 10Hz, and if
+     * it is not drained, the kernel buffer fills and the controller
+     * considers the connection stale. The reader feeds everything into
+     * primary(), register callbacks there *before* starting the reader.
+     *
+     * \return true if the reader was started (or is already running)
+     */
+    bool start_reader();
+
+    /**
+     * \brief stop the background reader
+     *
+     * Blocks until the reader returns from its current read, which is
+     * at most one state-message (~100ms) away.
+     */
+    void stop_reader();
+
+    bool reading() { return reading_; }
+
+    /**
+     * \brief access the parser (state, stats, change-callbacks)
+     */
+    Primary_Parser& primary() { return primary_; }
 
 private:
-    URX_Script script_;
+    void reader();
+
+    Primary_Parser primary_;
+    std::thread reader_;
+    std::atomic<bool> reading_;
 };
 }
 #endif  // URX_HANDLER_HPP
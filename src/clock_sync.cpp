@@ -0,0 +1,123 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/clock_sync.hpp>
+#include <cmath>
+
+urx::Clock_Sync::Clock_Sync(std::size_t bucket_size, std::size_t buckets) :
+    bucket_size_(bucket_size > 0 ? bucket_size : 1),
+    buckets_(buckets > 1 ? buckets : 2),
+    minimas_(buckets_)
+{
+    reset();
+}
+
+void urx::Clock_Sync::reset()
+{
+    in_bucket_ = 0;
+    head_ = 0;
+    num_minimas_ = 0;
+
+    std::lock_guard<std::mutex> lg(model_lock_);
+    valid_ = false;
+    x0_ = 0.0;
+    a_ = 0.0;
+    b_ = 0.0;
+    err_ = 0.0;
+}
+
+void urx::Clock_Sync::add(double ur_ts, int64_t host_ns)
+{
+    Point p = { ur_ts, (double)host_ns - ur_ts * 1e9 };
+    if (in_bucket_ == 0 || p.y < bucket_min_.y)
+        bucket_min_ = p;
+
+    if (++in_bucket_ < bucket_size_)
+        return;
+
+    minimas_[head_] = bucket_min_;
+    head_ = (head_ + 1) % buckets_;
+    if (num_minimas_ < buckets_)
+        num_minimas_++;
+    in_bucket_ = 0;
+
+    fit();
+}
+
+// Least-squares fit centered on mean x to keep the precision when the
+// controller has been running for days.
+void urx::Clock_Sync::fit()
+{
+    if (num_minimas_ < 2)
+        return;
+
+    double mx = 0.0, my = 0.0;
+    for (std::size_t i = 0; i < num_minimas_; i++) {
+        mx += minimas_[i].x;
+        my += minimas_[i].y;
+    }
+    mx /= num_minimas_;
+    my /= num_minimas_;
+
+    double sxx = 0.0, sxy = 0.0;
+    for (std::size_t i = 0; i < num_minimas_; i++) {
+        double dx = minimas_[i].x - mx;
+        sxx += dx * dx;
+        sxy += dx * (minimas_[i].y - my);
+    }
+    double b = sxx > 0.0 ? sxy / sxx : 0.0;
+
+    double err = 0.0;
+    for (std::size_t i = 0; i < num_minimas_; i++) {
+        double r = std::fabs(minimas_[i].y - (my + b * (minimas_[i].x - mx)));
+        if (r > err)
+            err = r;
+    }
+
+    std::lock_guard<std::mutex> lg(model_lock_);
+    x0_ = mx;
+    a_ = my;
+    b_ = b;
+    err_ = err;
+    valid_ = true;
+}
+
+bool urx::Clock_Sync::valid() const
+{
+    std::lock_guard<std::mutex> lg(model_lock_);
+    return valid_;
+}
+
+int64_t urx::Clock_Sync::to_host_ns(double ur_ts) const
+{
+    std::lock_guard<std::mutex> lg(model_lock_);
+    if (!valid_)
+        return 0;
+    return std::llround(ur_ts * 1e9 + a_ + b_ * (ur_ts - x0_));
+}
+
+// host = x*1e9 + a + b*(x - x0)  =>  x = (host - a + b*x0) / (1e9 + b)
+double urx::Clock_Sync::to_controller(int64_t host_ns) const
+{
+    std::lock_guard<std::mutex> lg(model_lock_);
+    if (!valid_)
+        return -1.0;
+    return ((double)host_ns - a_ + b_ * x0_) / (1e9 + b_);
+}
+
+double urx::Clock_Sync::drift_ppm() const
+{
+    // b is ns of offset per second of controller time
+    std::lock_guard<std::mutex> lg(model_lock_);
+    return b_ * 1e-3;
+}
+
+int64_t urx::Clock_Sync::error_bound_ns() const
+{
+    std::lock_guard<std::mutex> lg(model_lock_);
+    return (int64_t)std::ceil(err_);
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/codec.hpp>
+#include <string.h>
+
+namespace {
+    // MSB-first bit stream
+    class Bit_Writer
+    {
+    public:
+        Bit_Writer(std::vector<uint8_t>& out) : out_(out), acc_(0), bits_(0) {};
+
+        void put(uint64_t v, int n)
+        {
+            if (n > 32) {
+                put(v >> 32, n - 32);
+                n = 32;
+                v &= 0xffffffffULL;
+            }
+            acc_ = (acc_ << n) | (v & ((1ULL << n) - 1));
+            bits_ += n;
+            while (bits_ >= 8) {
+                bits_ -= 8;
+                out_.push_back((uint8_t)(acc_ >> bits_));
+            }
+        }
+
+        void flush()
+        {
+            if (bits_)
+                out_.push_back((uint8_t)(acc_ << (8 - bits_)));
+            bits_ = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& out_;
+        uint64_t acc_;
+        int bits_;
+    };
+
+    class Bit_Reader
+    {
+    public:
+        Bit_Reader(const uint8_t *in, std::size_t sz) : in_(in), sz_(sz), pos_(0) {};
+
+        // reads past the end return 0, check overrun() afterwards
+        uint64_t get(int n)
+        {
+            if (n > 32) {
+                uint64_t hi = get(n - 32);
+                return (hi << 32) | get(32);
+            }
+            uint64_t v = 0;
+            std::size_t byte = pos_ >> 3;
+            int skip = pos_ & 7;
+            // 5 bytes always cover skip + 32 bits
+            for (int i = 0; i < 5; i++)
+                v = (v << 8) | (byte + i < sz_ ? in_[byte + i] : 0);
+            pos_ += n;
+            return (v >> (40 - skip - n)) & ((1ULL << n) - 1);
+        }
+
+        bool bit() { return get(1); }
+        bool overrun() const { return pos_ > sz_ * 8; }
+
+    private:
+        const uint8_t *in_;
+        std::size_t sz_;
+        std::size_t pos_;
+    };
+
+    uint64_t bits_of(double d)
+    {
+        uint64_t u;
+        memcpy(&u, &d, sizeof(u));
+        return u;
+    }
+
+    uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+    int64_t unzigzag(uint64_t z) { return (int64_t)(z >> 1) ^ -(int64_t)(z & 1); }
+}
+
+void urx::xor_encode(const double *v, std::size_t n, std::vector<uint8_t>& out)
+{
+    if (!n)
+        return;
+    Bit_Writer bw(out);
+    uint64_t prev = bits_of(v[0]);
+    bw.put(prev, 64);
+
+    int lead = -1, trail = 0;
+    for (std::size_t i = 1; i < n; i++) {
+        uint64_t cur = bits_of(v[i]);
+        uint64_t x = cur ^ prev;
+        prev = cur;
+        if (!x) {
+            bw.put(0, 1);
+            continue;
+        }
+        int l = __builtin_clzll(x);
+        int t = __builtin_ctzll(x);
+        if (l > 31)
+            l = 31;
+        if (lead >= 0 && l >= lead && t >= trail) {
+            bw.put(0b10, 2);
+            bw.put(x >> trail, 64 - lead - trail);
+        } else {
+            int len = 64 - l - t;
+            bw.put(0b11, 2);
+            bw.put(l, 5);
+            bw.put(len == 64 ? 0 : len, 6);
+            bw.put(x >> t, len);
+            lead = l;
+            trail = t;
+        }
+    }
+    bw.flush();
+}
+
+bool urx::xor_decode(const uint8_t *in, std::size_t sz, std::size_t n, double *out)
+{
+    if (!n)
+        return true;
+    if (!in || !out)
+        return false;
+
+    // pass 1: bit stream -> XORs, stored in place
+    uint64_t *x = (uint64_t *)out;
+    Bit_Reader br(in, sz);
+    x[0] = br.get(64);
+    int lead = 0, trail = 0;
+    for (std::size_t i = 1; i < n; i++) {
+        if (!br.bit()) {
+            x[i] = 0;
+            continue;
+        }
+        if (br.bit()) {
+            lead = br.get(5);
+            int len = br.get(6);
+            if (!len)
+                len = 64;
+            trail = 64 - lead - len;
+            if (trail < 0)
+                return false;
+        }
+        x[i] = br.get(64 - lead - trail) << trail;
+    }
+    if (br.overrun())
+        return false;
+
+    // pass 2: prefix XOR
+    for (std::size_t i = 1; i < n; i++)
+        x[i] ^= x[i - 1];
+    return true;
+}
+
+void urx::dod_encode(const int64_t *v, std::size_t n, std::vector<uint8_t>& out)
+{
+    if (!n)
+        return;
+    Bit_Writer bw(out);
+    bw.put((uint64_t)v[0], 64);
+
+    // wrapping arithmetic, so any int64 sequence round-trips
+    uint64_t prev_delta = 0;
+    for (std::size_t i = 1; i < n; i++) {
+        uint64_t delta = (uint64_t)v[i] - (uint64_t)v[i - 1];
+        uint64_t z = zigzag((int64_t)(delta - prev_delta));
+        prev_delta = delta;
+        if (z == 0) {
+            bw.put(0, 1);
+        } else if (z < (1ULL << 7)) {
+            bw.put(0b10, 2);
+            bw.put(z, 7);
+        } else if (z < (1ULL << 14)) {
+            bw.put(0b110, 3);
+            bw.put(z, 14);
+        } else if (z < (1ULL << 20)) {
+            bw.put(0b1110, 4);
+            bw.put(z, 20);
+        } else if (z < (1ULL << 32)) {
+            bw.put(0b11110, 5);
+            bw.put(z, 32);
+        } else {
+            bw.put(0b11111, 5);
+            bw.put(z, 64);
+        }
+    }
+    bw.flush();
+}
+
+bool urx::dod_decode(const uint8_t *in, std::size_t sz, std::size_t n, int64_t *out)
+{
+    if (!n)
+        return true;
+    if (!in || !out)
+        return false;
+
+    static const int width[] = {7, 14, 20, 32, 64};
+
+    // pass 1: bit stream -> delta-of-deltas
+    uint64_t *d = (uint64_t *)out;
+    Bit_Reader br(in, sz);
+    d[0] = br.get(64);
+    for (std::size_t i = 1; i < n; i++) {
+        int ones = 0;
+        while (ones < 5 && br.bit())
+            ones++;
+        d[i] = ones ? (uint64_t)unzigzag(br.get(width[ones - 1])) : 0;
+    }
+    if (br.overrun())
+        return false;
+
+    // pass 2 and 3: dod -> delta -> value
+    for (std::size_t i = 2; i < n; i++)
+        d[i] += d[i - 1];
+    for (std::size_t i = 1; i < n; i++)
+        d[i] += d[i - 1];
+    return true;
+}
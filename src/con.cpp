@@ -11,43 +11,241 @@
 #include <linux/tcp.h>
 #include <urx/header.hpp>
 #include <chrono>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <string.h>
+#include <thread>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
 
 void urx::Con::disconnect()
 {
-    if (!connected_)
-        return;
+    if (sock_ >= 0)
+        close(sock_);
     connected_ = false;
     sock_ = -1;
 }
 
+bool urx::Con::reconnect()
+{
+    disconnect();
+    return do_connect(nodelay_);
+}
+
+namespace {
+    long ms_since(std::chrono::steady_clock::time_point t0)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    // Alternate address families, starting with whatever the resolver
+    // put first (normally IPv6).
+    std::vector<struct addrinfo *> interleave(struct addrinfo *res)
+    {
+        std::vector<struct addrinfo *> first, other, out;
+        for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+            if (ai->ai_family == res->ai_family)
+                first.push_back(ai);
+            else
+                other.push_back(ai);
+        }
+        for (std::size_t i = 0; i < first.size() || i < other.size(); i++) {
+            if (i < first.size())
+                out.push_back(first[i]);
+            if (i < other.size())
+                out.push_back(other[i]);
+        }
+        return out;
+    }
+
+    /*
+     * getaddrinfo() with an upper bound. Literal addresses are done at
+     * once. Names are looked up in a helper thread, which is left
+     * behind (and cleans up after itself) if the resolver does not
+     * answer in time.
+     */
+    int resolve(const std::string& host, int port, int timeout_ms, struct addrinfo **res)
+    {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        hints.ai_flags = AI_NUMERICHOST;
+        std::string service = std::to_string(port);
+        int err = getaddrinfo(host.c_str(), service.c_str(), &hints, res);
+        if (err != EAI_NONAME)
+            return err;
+
+        hints.ai_flags = 0;
+        if (timeout_ms < 0)
+            return getaddrinfo(host.c_str(), service.c_str(), &hints, res);
+
+        struct Lookup {
+            std::mutex m;
+            std::condition_variable cv;
+            bool done = false;
+            bool abandoned = false;
+            int err = 0;
+            struct addrinfo *res = nullptr;
+        };
+        auto l = std::make_shared<Lookup>();
+        std::thread([l, host, service, hints]() {
+            struct addrinfo *r = NULL;
+            int e = getaddrinfo(host.c_str(), service.c_str(), &hints, &r);
+            std::lock_guard<std::mutex> lg(l->m);
+            if (l->abandoned) {
+                if (!e)
+                    freeaddrinfo(r);
+                return;
+            }
+            l->err = e;
+            l->res = r;
+            l->done = true;
+            l->cv.notify_one();
+        }).detach();
+
+        std::unique_lock<std::mutex> ul(l->m);
+        if (!l->cv.wait_for(ul, std::chrono::milliseconds(timeout_ms), [&l] { return l->done; })) {
+            l->abandoned = true;
+            return EAI_AGAIN;
+        }
+        *res = l->res;
+        return l->err;
+    }
+
+    /*
+     * Non-blocking connect to each address in turn, without waiting
+     * for the previous one to fail (RFC 8305). Returns a connected,
+     * blocking, socket or -1.
+     */
+    int connect_any(const std::vector<struct addrinfo *>& addrs, int timeout_ms)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<struct pollfd> pending;
+        std::size_t next = 0;
+        long next_start = 0;
+        int winner = -1;
+
+        while (winner < 0) {
+            long now = ms_since(t0);
+            if (timeout_ms >= 0 && now >= timeout_ms)
+                break;
+
+            if (next < addrs.size() && (now >= next_start || pending.empty())) {
+                struct addrinfo *ai = addrs[next++];
+                int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+                if (fd < 0)
+                    continue;
+                if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                    winner = fd;
+                    break;
+                }
+                if (errno != EINPROGRESS) {
+                    close(fd);
+                    continue;
+                }
+                pending.push_back({fd, POLLOUT, 0});
+                next_start = now + urx::CON_ATTEMPT_DELAY_MS;
+            }
+            if (pending.empty()) {
+                if (next < addrs.size())
+                    continue;
+                break;
+            }
+
+            long wait = timeout_ms >= 0 ? timeout_ms - now : -1;
+            if (next < addrs.size() && (wait < 0 || next_start - now < wait))
+                wait = next_start - now;
+            if (poll(pending.data(), pending.size(), wait < 0 ? -1 : (int)wait) < 0 && errno != EINTR)
+                break;
+
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (!it->revents) {
+                    ++it;
+                    continue;
+                }
+                int err = 0;
+                socklen_t len = sizeof(err);
+                if (winner < 0 && getsockopt(it->fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+                    winner = it->fd;
+                } else {
+                    close(it->fd);
+                    // this one is out, no reason to hold back the next
+                    next_start = 0;
+                }
+                it = pending.erase(it);
+            }
+        }
+
+        for (auto& p : pending)
+            close(p.fd);
+        if (winner >= 0)
+            fcntl(winner, F_SETFL, fcntl(winner, F_GETFL) & ~O_NONBLOCK);
+        return winner;
+    }
+}
+
 bool urx::Con::do_connect(bool nodelay)
 {
     if (connected_)
         return true;
 
-    if ((sock_ = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    // stale socket from an earlier, failed, connection
+    disconnect();
+    nodelay_ = nodelay;
+
+    // name lookup and connect share the timeout
+    auto t0 = std::chrono::steady_clock::now();
+    struct addrinfo *res = NULL;
+    int err = resolve(remote_, port_, connect_timeout_ms_, &res);
+    if (err) {
+        std::cout << "do_connecting to " << remote_ << " Failed! (" << gai_strerror(err) << ")" << std::endl;
+        return false;
+    }
+    int left = connect_timeout_ms_;
+    if (left >= 0)
+        left = std::max(0L, left - ms_since(t0));
+    sock_ = connect_any(interleave(res), left);
+    freeaddrinfo(res);
+    if (sock_ < 0) {
+        std::cout << "do_connecting to " << remote_ << " Failed!" << std::endl;
         return false;
+    }
 
     if (nodelay) {
         int flag = 1;
         if (setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)))
             std::cerr << "Failed setting TCP_NODELAY on socket!" << std::endl;
     }
-
-    struct sockaddr_in serv_addr;
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port_);
-    if (inet_pton(AF_INET, remote_.c_str(), &serv_addr.sin_addr) <= 0)
-        return false;
-
-    if (connect(sock_, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-        std::cout << "do_connecting to " << remote_ << " Failed!" << std::endl;
-        return false;
-    }
+    apply_profile();
 
     connected_ = true;
     return connected_;
+}
+
+int urx::connect_all(const std::vector<Con *>& cons, bool nodelay)
+{
+    std::vector<std::thread> threads;
+    for (auto c : cons)
+        if (c)
+            threads.emplace_back([c, nodelay]() { c->do_connect(nodelay); });
+    for (auto& t : threads)
+        t.join();
 
+    int connected = 0;
+    for (auto c : cons)
+        if (c && c->is_connected())
+            connected++;
+    return connected;
 }
 
 int urx::Con::do_send(void *sbuf, int ssz)
@@ -64,23 +262,97 @@ int urx::Con::do_send(void *sbuf, int ssz)
 }
 
 int urx::Con::do_recv(void *rbuf, int rsz, unsigned long *rx_ts)
+{
+    return recv_for(rbuf, rsz, recv_timeout_ms_, rx_ts);
+}
+
+int urx::Con::recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *rx_ts)
 {
     struct sockaddr src_addr;
     socklen_t addrlen = sizeof(struct sockaddr);
 
     if (!rbuf)
         return -2;
+    if (!connected_)
+        return -1;
+
+    // Spin for a while first, trading a core for the wakeup latency of
+    // poll().
+    if (profile_.spin_us > 0 && timeout_ms != 0) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(profile_.spin_us);
+        do {
+            ssize_t read_sz = recvfrom(sock_, rbuf, rsz, MSG_DONTWAIT, &src_addr, &addrlen);
+            if (read_sz >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                return finish_recv(read_sz, rbuf, rsz, rx_ts);
+        } while (std::chrono::steady_clock::now() < end);
+    }
+
+    // Wait for data or cancel(), whatever comes first. The eventfd is
+    // only read when it fired, so a pending cancel is never lost.
+    //
+    // A signal (EINTR) or a wakeup without data (EAGAIN) is not a
+    // timeout, wait again for whatever is left until the deadline.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int wait_ms = timeout_ms;
+    for (;;) {
+        struct pollfd pfd[2] = {
+            {sock_, POLLIN, 0},
+            {cancel_fd_, POLLIN, 0},
+        };
+        int ready = poll(pfd, cancel_fd_ >= 0 ? 2 : 1, wait_ms);
+        if (ready == 0)
+            return CON_TIMEOUT;
+        if (ready < 0 && errno != EINTR)
+            return -1;
+        if (ready > 0) {
+            if (pfd[1].revents & POLLIN) {
+                clear_cancel();
+                return CON_CANCELLED;
+            }
+
+            ssize_t read_sz = recvfrom(sock_, rbuf, rsz, MSG_DONTWAIT, &src_addr, &addrlen);
+            if (read_sz >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                return finish_recv(read_sz, rbuf, rsz, rx_ts);
+        }
 
-    ssize_t read_sz = recvfrom(sock_, rbuf, rsz, 0, &src_addr, &addrlen);
+        if (timeout_ms < 0)
+            continue;
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0)
+            return CON_TIMEOUT;
+        wait_ms = (left + 999) / 1000;
+    }
+}
+
+int urx::Con::finish_recv(ssize_t read_sz, void *rbuf, int rsz, unsigned long *rx_ts)
+{
     if (rx_ts)
         *rx_ts = duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 
+    // orderly shutdown from remote, nothing more will arrive
+    if (read_sz == 0 && rsz > 0) {
+        printf("recvfrom() remote %s:%d closed the connection\n", remote_.c_str(), port_);
+        connected_ = false;
+        return -1;
+    }
+
     if (read_sz < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return CON_TIMEOUT;
         printf("recvfrom() failed! sock_=%d, rbuf=%p, rsz=%d, res=%zd (errno=%d %s)\n",
                sock_, rbuf, rsz, read_sz, errno, strerror(errno));
+        if (errno != EINTR)
+            connected_ = false;
         return read_sz;
     }
 
+    // The kernel drops out of quickack mode on its own, so this has to
+    // be done after every read.
+    if (profile_.quickack) {
+        int flag = 1;
+        setsockopt(sock_, IPPROTO_TCP, TCP_QUICKACK, &flag, sizeof(flag));
+    }
+
     // make sure we 0-terminate string (much faster than zeroing entire
     // buffer before recvfrom()
     if (read_sz < rsz)
@@ -89,6 +361,78 @@ int urx::Con::do_recv(void *rbuf, int rsz, unsigned long *rx_ts)
     return read_sz;
 }
 
+void urx::Con::set_profile(const Con_Profile& profile)
+{
+    profile_ = profile;
+    if (sock_ >= 0)
+        apply_profile();
+}
+
+void urx::Con::apply_profile()
+{
+    int val;
+    if (profile_.nodelay) {
+        val = 1;
+        if (setsockopt(sock_, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val)))
+            std::cerr << "Failed setting TCP_NODELAY on socket!" << std::endl;
+    }
+    if (profile_.busy_poll_us > 0) {
+        val = profile_.busy_poll_us;
+        if (setsockopt(sock_, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)))
+            perror("Failed setting SO_BUSY_POLL");
+    }
+    if (profile_.prefer_busy_poll) {
+        val = 1;
+        if (setsockopt(sock_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &val, sizeof(val)))
+            perror("Failed setting SO_PREFER_BUSY_POLL");
+    }
+    if (profile_.quickack) {
+        val = 1;
+        if (setsockopt(sock_, IPPROTO_TCP, TCP_QUICKACK, &val, sizeof(val)))
+            perror("Failed setting TCP_QUICKACK");
+    }
+    if (profile_.priority >= 0) {
+        val = profile_.priority;
+        if (setsockopt(sock_, SOL_SOCKET, SO_PRIORITY, &val, sizeof(val)))
+            perror("Failed setting SO_PRIORITY");
+    }
+    if (profile_.tos >= 0) {
+        struct sockaddr_storage ss;
+        socklen_t len = sizeof(ss);
+        bool v6 = getsockname(sock_, (struct sockaddr *)&ss, &len) == 0 && ss.ss_family == AF_INET6;
+        val = profile_.tos;
+        if (v6 ? setsockopt(sock_, IPPROTO_IPV6, IPV6_TCLASS, &val, sizeof(val)) :
+                 setsockopt(sock_, IPPROTO_IP, IP_TOS, &val, sizeof(val)))
+            perror("Failed setting IP_TOS");
+    }
+}
+
+bool urx::Con::set_rcvlowat(int bytes)
+{
+    if (sock_ < 0)
+        return false;
+    if (setsockopt(sock_, SOL_SOCKET, SO_RCVLOWAT, &bytes, sizeof(bytes))) {
+        perror("Failed setting SO_RCVLOWAT");
+        return false;
+    }
+    return true;
+}
+
+void urx::Con::cancel()
+{
+    uint64_t one = 1;
+    if (cancel_fd_ >= 0 && write(cancel_fd_, &one, sizeof(one)) != sizeof(one))
+        perror("cancel()");
+}
+
+void urx::Con::clear_cancel()
+{
+    uint64_t cnt;
+    if (cancel_fd_ >= 0)
+        while (read(cancel_fd_, &cnt, sizeof(cnt)) > 0)
+            ;
+}
+
 int urx::Con::do_send_recv(void *sbuf, int ssz, void *rbuf, int rsz)
 {
     auto sendsz = do_send(sbuf, ssz);
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/con_shm.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <climits>
+#include <chrono>
+#include <thread>
+#include <new>
+
+namespace {
+    constexpr uint32_t PAD = 0xffffffff;        // rest of the ring is unused, wrap
+    constexpr std::size_t HDR = sizeof(uint32_t);
+
+    std::size_t record_sz(std::size_t len)
+    {
+        return (HDR + len + 7) & ~std::size_t(7);
+    }
+
+    // Not FUTEX_PRIVATE_FLAG, the peer is usually another process
+    int futex_wait(std::atomic<uint32_t> *addr, uint32_t val, long timeout_ns)
+    {
+        struct timespec ts;
+        struct timespec *tp = NULL;
+        if (timeout_ns >= 0) {
+            ts.tv_sec = timeout_ns / 1000000000L;
+            ts.tv_nsec = timeout_ns % 1000000000L;
+            tp = &ts;
+        }
+        return syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, val, tp, NULL, 0);
+    }
+
+    void futex_wake(std::atomic<uint32_t> *addr)
+    {
+        syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+
+    void notify(urx::Shm_Ring *r)
+    {
+        r->seq.fetch_add(1, std::memory_order_release);
+        if (r->waiters.load(std::memory_order_acquire))
+            futex_wake(&r->seq);
+    }
+
+    long ns_left(std::chrono::steady_clock::time_point end)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(end - std::chrono::steady_clock::now()).count();
+        return left > 0 ? (long)left : 0;
+    }
+}
+
+urx::Con_Shm::~Con_Shm()
+{
+    disconnect();
+}
+
+void urx::Con_Shm::disconnect()
+{
+    connected_ = false;
+    if (!ch_)
+        return;
+
+    // Tell the peer, it may be asleep on the ring we read from as well
+    // as on the one we write to.
+    if (role_ == SHM_SERVER) {
+        ch_->server_up.store(0, std::memory_order_release);
+        shm_unlink(remote_.c_str());
+    } else {
+        ch_->client_up.store(2, std::memory_order_release);
+    }
+    notify(&ch_->down);
+    notify(&ch_->up);
+
+    munmap(ch_, sizeof(Shm_Channel));
+    ch_ = nullptr;
+}
+
+bool urx::Con_Shm::do_connect(bool nodelay)
+{
+    (void)nodelay;
+    if (connected_)
+        return true;
+    disconnect();
+
+    int fd;
+    if (role_ == SHM_SERVER) {
+        shm_unlink(remote_.c_str());
+        fd = shm_open(remote_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd >= 0 && ftruncate(fd, sizeof(Shm_Channel))) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        fd = shm_open(remote_.c_str(), O_RDWR | O_CLOEXEC, 0);
+    }
+    if (fd < 0) {
+        std::cout << "do_connecting to " << remote_ << " Failed!" << std::endl;
+        return false;
+    }
+
+    void *m = mmap(NULL, sizeof(Shm_Channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        perror("Con_Shm mmap()");
+        return false;
+    }
+
+    if (role_ == SHM_SERVER) {
+        // fresh object is zero-filled, publish magic last
+        ch_ = new (m) Shm_Channel();
+        ch_->ring_sz = SHM_RING_SZ;
+        ch_->server_up.store(1, std::memory_order_release);
+        __atomic_store_n(&ch_->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    } else {
+        ch_ = (Shm_Channel *)m;
+        if (__atomic_load_n(&ch_->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+            ch_->ring_sz != SHM_RING_SZ ||
+            !ch_->server_up.load(std::memory_order_acquire)) {
+            std::cout << "do_connecting to " << remote_ << " Failed! (no server)" << std::endl;
+            munmap(m, sizeof(Shm_Channel));
+            ch_ = nullptr;
+            return false;
+        }
+        // whatever a previous client left behind is stale
+        ch_->down.tail.store(ch_->down.head.load(std::memory_order_acquire), std::memory_order_release);
+        ch_->client_up.store(1, std::memory_order_release);
+    }
+
+    connected_ = true;
+    return connected_;
+}
+
+bool urx::Con_Shm::peer_up()
+{
+    // a server waits for its first client, it is only gone once it left
+    if (role_ == SHM_SERVER)
+        return ch_->client_up.load(std::memory_order_acquire) != 2;
+    return ch_->server_up.load(std::memory_order_acquire);
+}
+
+int urx::Con_Shm::do_send(void *sbuf, int ssz)
+{
+    if (!sbuf || ssz < 0)
+        return -2;
+    if (!connected_)
+        return -1;
+
+    std::size_t need = record_sz(ssz);
+    if (need > SHM_RING_SZ / 2) {
+        std::cout << "do_sending request FAILED! " << ssz << " bytes does not fit the ring" << std::endl;
+        return -1;
+    }
+
+    Shm_Ring *r = tx();
+    uint64_t head = r->head.load(std::memory_order_relaxed);
+    std::size_t off = head % SHM_RING_SZ;
+    std::size_t pad = off + need > SHM_RING_SZ ? SHM_RING_SZ - off : 0;
+
+    // Full ring: the reader is behind, wait for it like a blocking
+    // send() would, but not forever.
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(recv_timeout_ms_ >= 0 ? recv_timeout_ms_ : 1000);
+    while (head + pad + need - r->tail.load(std::memory_order_acquire) > SHM_RING_SZ) {
+        if (!peer_up() || std::chrono::steady_clock::now() >= end) {
+            std::cout << "do_sending request FAILED! ring full" << std::endl;
+            return -1;
+        }
+        std::this_thread::yield();
+    }
+
+    if (pad) {
+        memcpy(r->data + off, &PAD, HDR);
+        head += pad;
+        off = 0;
+    }
+    uint32_t len = ssz;
+    memcpy(r->data + off, &len, HDR);
+    memcpy(r->data + off + HDR, sbuf, ssz);
+    r->head.store(head + need, std::memory_order_release);
+    notify(r);
+    return ssz;
+}
+
+int urx::Con_Shm::take(Shm_Ring *r, void *rbuf, int rsz, unsigned long *rx_ts)
+{
+    for (;;) {
+        uint64_t tail = r->tail.load(std::memory_order_relaxed);
+        if (tail == r->head.load(std::memory_order_acquire))
+            return 0;
+
+        std::size_t off = tail % SHM_RING_SZ;
+        uint32_t len;
+        memcpy(&len, r->data + off, HDR);
+        if (len == PAD) {
+            r->tail.store(tail + SHM_RING_SZ - off, std::memory_order_release);
+            continue;
+        }
+        int n = (int)len < rsz ? (int)len : rsz;
+        memcpy(rbuf, r->data + off + HDR, n);
+        r->tail.store(tail + record_sz(len), std::memory_order_release);
+        if (rx_ts)
+            *rx_ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        return n > 0 ? n : 0;
+    }
+}
+
+int urx::Con_Shm::recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *rx_ts)
+{
+    if (!rbuf)
+        return -2;
+    if (!connected_)
+        return -1;
+
+    Shm_Ring *r = rx();
+    auto now = std::chrono::steady_clock::now();
+    auto end = now + std::chrono::milliseconds(timeout_ms > 0 ? timeout_ms : 0);
+    auto spin_end = now + std::chrono::microseconds(timeout_ms != 0 ? profile_.spin_us : 0);
+
+    for (;;) {
+        // Sample seq before looking at the ring, a message published
+        // after the check changes it and the futex will not sleep.
+        uint32_t seq = r->seq.load(std::memory_order_acquire);
+        int n = take(r, rbuf, rsz, rx_ts);
+        if (n > 0)
+            return n;
+        if (cancelled_.load(std::memory_order_acquire)) {
+            clear_cancel();
+            return CON_CANCELLED;
+        }
+        if (!peer_up()) {
+            connected_ = false;
+            return -1;
+        }
+        if (timeout_ms == 0)
+            return CON_TIMEOUT;
+        if (std::chrono::steady_clock::now() < spin_end)
+            continue;
+
+        long wait_ns = -1;
+        if (timeout_ms > 0) {
+            wait_ns = ns_left(end);
+            if (wait_ns == 0)
+                return CON_TIMEOUT;
+        }
+        r->waiters.fetch_add(1, std::memory_order_acq_rel);
+        futex_wait(&r->seq, seq, wait_ns);
+        r->waiters.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void urx::Con_Shm::cancel()
+{
+    Con::cancel();
+    cancelled_.store(true, std::memory_order_release);
+    // Bumping seq is harmless for the producer (it only ever adds) and
+    // makes sure a receiver about to sleep does not miss the wakeup.
+    if (ch_) {
+        Shm_Ring *r = rx();
+        r->seq.fetch_add(1, std::memory_order_release);
+        futex_wake(&r->seq);
+    }
+}
+
+void urx::Con_Shm::clear_cancel()
+{
+    Con::clear_cancel();
+    cancelled_.store(false, std::memory_order_release);
+}
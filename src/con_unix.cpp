@@ -0,0 +1,44 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/con_unix.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string.h>
+#include <stddef.h>
+
+bool urx::Con_Unix::do_connect(bool nodelay)
+{
+    (void)nodelay;
+    if (connected_)
+        return true;
+
+    disconnect();
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (remote_.empty() || remote_.size() >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, remote_.c_str(), remote_.size());
+    socklen_t len = offsetof(struct sockaddr_un, sun_path) + remote_.size();
+    if (addr.sun_path[0] == '@')
+        addr.sun_path[0] = 0;
+    else
+        len++;
+
+    if ((sock_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+        return false;
+
+    if (connect(sock_, (struct sockaddr *)&addr, len) < 0) {
+        std::cout << "do_connecting to " << remote_ << " Failed!" << std::endl;
+        disconnect();
+        return false;
+    }
+
+    connected_ = true;
+    return connected_;
+}
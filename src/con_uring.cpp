@@ -0,0 +1,565 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/con_uring.hpp>
+#include <linux/io_uring.h>
+#include <linux/tcp.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    enum : uint64_t {
+        TAG_RECV = 1,
+        TAG_CANCEL,
+        TAG_PROVIDE,
+        TAG_SEND,
+    };
+
+    // index in the registered file table
+    constexpr int FILE_SOCK = 0;
+    constexpr int FILE_CANCEL = 1;
+
+    constexpr uint16_t URING_BGID = 0;
+
+    unsigned long now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+/*
+ * A single submission/completion ring, mapped directly (no liburing).
+ * Owned by one thread at a time.
+ */
+struct urx::Uring {
+    int fd = -1;
+    unsigned entries = 0;
+    void *ring = MAP_FAILED;
+    std::size_t ring_sz = 0;
+    struct io_uring_sqe *sqes = (struct io_uring_sqe *)MAP_FAILED;
+    std::size_t sqes_sz = 0;
+
+    unsigned *sq_head = nullptr;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    struct io_uring_cqe *cqes = nullptr;
+
+    // local tail, published to the kernel in enter()
+    unsigned tail = 0;
+    unsigned features = 0;
+
+    ~Uring()
+    {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqes_sz);
+        if (ring != MAP_FAILED)
+            munmap(ring, ring_sz);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool init(unsigned n)
+    {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = syscall(__NR_io_uring_setup, n, &p);
+        if (fd < 0)
+            return false;
+
+        // 5.11+, keeps the mapping and the timed wait simple
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+            errno = ENOSYS;
+            return false;
+        }
+
+        entries = p.sq_entries;
+        features = p.features;
+        ring_sz = std::max(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                           p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe));
+        ring = mmap(NULL, ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ring == MAP_FAILED)
+            return false;
+        sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = (struct io_uring_sqe *)mmap(NULL, sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+
+        char *r = (char *)ring;
+        sq_head = (unsigned *)(r + p.sq_off.head);
+        sq_tail = (unsigned *)(r + p.sq_off.tail);
+        sq_mask = (unsigned *)(r + p.sq_off.ring_mask);
+        sq_array = (unsigned *)(r + p.sq_off.array);
+        cq_head = (unsigned *)(r + p.cq_off.head);
+        cq_tail = (unsigned *)(r + p.cq_off.tail);
+        cq_mask = (unsigned *)(r + p.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe *)(r + p.cq_off.cqes);
+        tail = *sq_tail;
+        return true;
+    }
+
+    int reg(unsigned op, void *arg, unsigned nr)
+    {
+        return syscall(__NR_io_uring_register, fd, op, arg, nr);
+    }
+
+    // next free sqe (zeroed), nullptr if the kernel has not caught up
+    struct io_uring_sqe *sqe()
+    {
+        if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= entries)
+            return nullptr;
+        unsigned idx = tail & *sq_mask;
+        sq_array[idx] = idx;
+        struct io_uring_sqe *s = &sqes[idx];
+        memset(s, 0, sizeof(*s));
+        tail++;
+        return s;
+    }
+
+    // submit what is queued and optionally wait for completions
+    int enter(unsigned min_complete, int timeout_ms)
+    {
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+        unsigned pending = tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (!pending && !min_complete)
+            return 0;
+
+        unsigned flags = 0;
+        struct io_uring_getevents_arg arg;
+        struct __kernel_timespec ts;
+        void *argp = NULL;
+        std::size_t argsz = 0;
+        if (min_complete) {
+            flags |= IORING_ENTER_GETEVENTS;
+            if (timeout_ms >= 0) {
+                ts.tv_sec = timeout_ms / 1000;
+                ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+                memset(&arg, 0, sizeof(arg));
+                arg.ts = (uint64_t)(uintptr_t)&ts;
+                flags |= IORING_ENTER_EXT_ARG;
+                argp = &arg;
+                argsz = sizeof(arg);
+            }
+        }
+        return syscall(__NR_io_uring_enter, fd, pending, min_complete, flags, argp, argsz);
+    }
+
+    bool cq_empty() const
+    {
+        return *cq_head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    template<typename F>
+    unsigned reap(F f)
+    {
+        unsigned head = *cq_head;
+        unsigned t = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        unsigned n = 0;
+        for (; head != t; head++, n++)
+            f(cqes[head & *cq_mask]);
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        return n;
+    }
+};
+
+urx::Con_Uring::~Con_Uring()
+{
+    // ~Con() only sees its own disconnect(), and the rings hold a
+    // reference to the socket.
+    teardown_ring();
+}
+
+void urx::Con_Uring::disconnect()
+{
+    teardown_ring();
+    Con::disconnect();
+}
+
+bool urx::Con_Uring::do_connect(bool nodelay)
+{
+    if (connected_)
+        return true;
+    if (!Con::do_connect(nodelay))
+        return false;
+
+    if (!setup_ring())
+        printf("%s: io_uring unavailable (%s), using plain socket calls\n", __func__, strerror(errno));
+    return true;
+}
+
+bool urx::Con_Uring::setup_ring()
+{
+    auto fail = [this]() {
+        int err = errno;
+        teardown_ring();
+        errno = err;
+        return false;
+    };
+
+    rx_ = new Uring();
+    tx_ = new Uring();
+    if (!rx_->init(URING_ENTRIES) || !tx_->init(URING_ENTRIES))
+        return fail();
+
+    bufs_sz_ = (URING_BUFS + URING_SEND_SLOTS) * URING_BUF_SZ;
+    bufs_ = (unsigned char *)mmap(NULL, bufs_sz_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs_ == MAP_FAILED) {
+        bufs_ = nullptr;
+        return fail();
+    }
+
+    // send slots are fixed buffers, pinned once instead of per write
+    struct iovec iov;
+    iov.iov_base = bufs_ + URING_BUFS * URING_BUF_SZ;
+    iov.iov_len = URING_SEND_SLOTS * URING_BUF_SZ;
+    if (tx_->reg(IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+        return fail();
+
+    int tx_files[1] = {sock_};
+    int rx_files[2] = {sock_, cancel_fd_};
+    if (tx_->reg(IORING_REGISTER_FILES, tx_files, 1) < 0 ||
+        rx_->reg(IORING_REGISTER_FILES, rx_files, cancel_fd_ >= 0 ? 2 : 1) < 0)
+        return fail();
+
+    // hand all receive buffers to the kernel
+    struct io_uring_sqe *s = rx_->sqe();
+    s->opcode = IORING_OP_PROVIDE_BUFFERS;
+    s->fd = URING_BUFS;
+    s->addr = (uint64_t)(uintptr_t)bufs_;
+    s->len = URING_BUF_SZ;
+    s->off = 0;
+    s->buf_group = URING_BGID;
+    s->user_data = TAG_PROVIDE;
+    if (rx_->enter(1, -1) < 0)
+        return fail();
+    int res = -EINVAL;
+    rx_->reap([&](const struct io_uring_cqe& cqe) { res = cqe.res; });
+    if (res < 0) {
+        errno = -res;
+        return fail();
+    }
+
+    ready_head_ = 0;
+    ready_cnt_ = 0;
+    provided_ = URING_BUFS;
+    eof_ = false;
+    cancelled_ = false;
+    rx_err_ = 0;
+    arm_recv();
+    arm_cancel();
+    if (rx_enter(0, -1) < 0)
+        return fail();
+    return true;
+}
+
+void urx::Con_Uring::teardown_ring()
+{
+    std::lock_guard<std::mutex> lg(tx_lock_);
+    delete rx_;
+    delete tx_;
+    rx_ = nullptr;
+    tx_ = nullptr;
+    if (bufs_)
+        munmap(bufs_, bufs_sz_);
+    bufs_ = nullptr;
+    recv_armed_ = false;
+    cancel_armed_ = false;
+}
+
+int urx::Con_Uring::rx_enter(unsigned min_complete, int timeout_ms)
+{
+    enters_.fetch_add(1, std::memory_order_relaxed);
+    return rx_->enter(min_complete, timeout_ms);
+}
+
+void urx::Con_Uring::arm_recv()
+{
+    struct io_uring_sqe *s = rx_->sqe();
+    if (!s) {
+        rx_enter(0, -1);
+        s = rx_->sqe();
+    }
+    s->opcode = IORING_OP_RECV;
+    s->fd = FILE_SOCK;
+    s->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    s->ioprio = IORING_RECV_MULTISHOT;
+    s->buf_group = URING_BGID;
+    s->user_data = TAG_RECV;
+    recv_armed_ = true;
+    rearms_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void urx::Con_Uring::arm_cancel()
+{
+    if (cancel_fd_ < 0)
+        return;
+    struct io_uring_sqe *s = rx_->sqe();
+    if (!s) {
+        rx_enter(0, -1);
+        s = rx_->sqe();
+    }
+    s->opcode = IORING_OP_POLL_ADD;
+    s->fd = FILE_CANCEL;
+    s->flags = IOSQE_FIXED_FILE;
+    s->poll32_events = POLLIN;
+    s->len = IORING_POLL_ADD_MULTI;
+    s->user_data = TAG_CANCEL;
+    cancel_armed_ = true;
+}
+
+void urx::Con_Uring::provide(uint16_t bid)
+{
+    struct io_uring_sqe *s = rx_->sqe();
+    if (!s) {
+        rx_enter(0, -1);
+        s = rx_->sqe();
+    }
+    s->opcode = IORING_OP_PROVIDE_BUFFERS;
+    s->fd = 1;
+    s->addr = (uint64_t)(uintptr_t)(bufs_ + bid * URING_BUF_SZ);
+    s->len = URING_BUF_SZ;
+    s->off = bid;
+    s->buf_group = URING_BGID;
+    s->user_data = TAG_PROVIDE;
+
+    // A completion per buffer would wake up the receiver for nothing
+    // (failures are still posted).
+    if (rx_->features & IORING_FEAT_CQE_SKIP)
+        s->flags = IOSQE_CQE_SKIP_SUCCESS;
+    provided_++;
+}
+
+void urx::Con_Uring::reap_rx()
+{
+    rx_->reap([this](const struct io_uring_cqe& cqe) {
+        switch (cqe.user_data) {
+        case TAG_RECV:
+            if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+                Rx_Frame& f = ready_[(ready_head_ + ready_cnt_) % URING_BUFS];
+                f.bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                f.len = cqe.res;
+                f.off = 0;
+                f.ts = now_ns();
+                ready_cnt_++;
+                provided_--;
+            } else if (cqe.res == 0) {
+                eof_ = true;
+            } else if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+                // ENOBUFS: all buffers are waiting to be consumed,
+                // re-armed once they are handed back.
+                rx_err_ = -cqe.res;
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE))
+                recv_armed_ = false;
+            break;
+        case TAG_CANCEL:
+            cancelled_ = true;
+            if (!(cqe.flags & IORING_CQE_F_MORE))
+                cancel_armed_ = false;
+            break;
+        case TAG_PROVIDE:
+            if (cqe.res < 0)
+                printf("%s: providing buffer failed (%s)\n", __func__, strerror(-cqe.res));
+            break;
+        default:
+            break;
+        }
+    });
+}
+
+int urx::Con_Uring::take(void *rbuf, int rsz, unsigned long *ts)
+{
+    Rx_Frame& f = ready_[ready_head_];
+    int n = std::min(f.len - f.off, rsz);
+    memcpy(rbuf, bufs_ + f.bid * URING_BUF_SZ + f.off, n);
+    if (n < rsz)
+        ((unsigned char *)rbuf)[n] = 0x00;
+    if (ts)
+        *ts = f.ts;
+
+    // Caller's buffer was too small, keep the rest for the next call
+    f.off += n;
+    if (f.off < f.len)
+        return n;
+
+    ready_head_ = (ready_head_ + 1) % URING_BUFS;
+    ready_cnt_--;
+    frames_.fetch_add(1, std::memory_order_relaxed);
+
+    // Buffers go back with the next enter, only force one when the
+    // kernel is about to run dry.
+    provide(f.bid);
+    if (provided_ <= URING_BUFS / 2)
+        rx_enter(0, -1);
+
+    if (profile_.quickack) {
+        int flag = 1;
+        setsockopt(sock_, IPPROTO_TCP, TCP_QUICKACK, &flag, sizeof(flag));
+    }
+    return n;
+}
+
+int urx::Con_Uring::recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *ts)
+{
+    if (!rx_)
+        return Con::recv_for(rbuf, rsz, timeout_ms, ts);
+    if (!rbuf)
+        return -2;
+    if (!connected_)
+        return -1;
+
+    auto start = std::chrono::steady_clock::now();
+    bool spun = false;
+    for (;;) {
+        reap_rx();
+        if (cancelled_) {
+            clear_cancel();
+            return CON_CANCELLED;
+        }
+        if (ready_cnt_ > 0)
+            return take(rbuf, rsz, ts);
+        if (eof_ || rx_err_) {
+            if (eof_)
+                printf("recv_for() remote %s:%d closed the connection\n", remote_.c_str(), port_);
+            else
+                printf("recv_for() failed, (errno=%d %s)\n", rx_err_, strerror(rx_err_));
+            connected_ = false;
+            return -1;
+        }
+        if (!recv_armed_)
+            arm_recv();
+        if (!cancel_armed_)
+            arm_cancel();
+
+        if (timeout_ms == 0) {
+            if (rx_enter(0, -1) < 0)
+                return -1;
+            reap_rx();
+            return ready_cnt_ > 0 ? take(rbuf, rsz, ts) : CON_TIMEOUT;
+        }
+
+        // completions are posted without us entering the kernel, so
+        // spinning on the queue costs no syscalls.
+        if (profile_.spin_us > 0 && !spun) {
+            spun = true;
+            auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(profile_.spin_us);
+            while (rx_->cq_empty() && std::chrono::steady_clock::now() < end)
+                ;
+            if (!rx_->cq_empty())
+                continue;
+        }
+
+        int left = timeout_ms;
+        if (timeout_ms > 0) {
+            auto spent = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            left = timeout_ms - (int)spent;
+            if (left <= 0)
+                return CON_TIMEOUT;
+        }
+        if (rx_enter(1, left) < 0) {
+            if (errno == ETIME) {
+                reap_rx();
+                if (ready_cnt_ > 0)
+                    return take(rbuf, rsz, ts);
+                if (cancelled_)
+                    continue;
+                return CON_TIMEOUT;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                return -1;
+        }
+    }
+}
+
+void urx::Con_Uring::clear_cancel()
+{
+    Con::clear_cancel();
+    if (!rx_)
+        return;
+    reap_rx();
+    cancelled_ = false;
+}
+
+int urx::Con_Uring::do_send(void *sbuf, int ssz)
+{
+    if (!tx_ || ssz > (int)(URING_SEND_SLOTS * URING_BUF_SZ))
+        return Con::do_send(sbuf, ssz);
+    if (!connected_ || !sbuf || ssz <= 0)
+        return -1;
+
+    std::lock_guard<std::mutex> lg(tx_lock_);
+    if (!tx_)
+        return -1;
+
+    // chain the slots so they are written in order
+    unsigned char *slot = bufs_ + URING_BUFS * URING_BUF_SZ;
+    unsigned k = 0;
+    for (int off = 0; off < ssz; off += URING_BUF_SZ, k++) {
+        int n = std::min(ssz - off, (int)URING_BUF_SZ);
+        memcpy(slot + k * URING_BUF_SZ, (unsigned char *)sbuf + off, n);
+        struct io_uring_sqe *s = tx_->sqe();
+        s->opcode = IORING_OP_WRITE_FIXED;
+        s->fd = FILE_SOCK;
+        s->flags = IOSQE_FIXED_FILE | (off + n < ssz ? IOSQE_IO_LINK : 0);
+        s->addr = (uint64_t)(uintptr_t)(slot + k * URING_BUF_SZ);
+        s->len = n;
+        s->buf_index = 0;
+        s->user_data = TAG_SEND;
+    }
+
+    // submit and wait for the whole chain in one go
+    int written = 0;
+    int err = 0;
+    unsigned done = 0;
+    while (done < k) {
+        enters_.fetch_add(1, std::memory_order_relaxed);
+        if (tx_->enter(k - done, -1) < 0 && errno != EINTR) {
+            err = errno;
+            break;
+        }
+        done += tx_->reap([&](const struct io_uring_cqe& cqe) {
+            if (cqe.res < 0)
+                err = -cqe.res;
+            else
+                written += cqe.res;
+        });
+    }
+    sends_.fetch_add(1, std::memory_order_relaxed);
+
+    if (err) {
+        printf("do_send() failed (errno=%d %s)\n", err, strerror(err));
+        if (err != EINTR && err != EAGAIN)
+            connected_ = false;
+        return -1;
+    }
+    if (written < ssz) {
+        std::cout << "do_sending request FAILED! Expected " << ssz << " got: " << written << std::endl;
+        return -1;
+    }
+    return written;
+}
+
+urx::Uring_Stats urx::Con_Uring::stats() const
+{
+    Uring_Stats s;
+    s.enters = enters_.load(std::memory_order_relaxed);
+    s.frames = frames_.load(std::memory_order_relaxed);
+    s.sends = sends_.load(std::memory_order_relaxed);
+    s.rearms = rearms_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/dashboard_handler.hpp>
+
+urx::Dashboard_Handler::~Dashboard_Handler()
+{
+    stop();
+    fail_pending();
+}
+
+bool urx::Dashboard_Handler::start()
+{
+    if (reading_)
+        return true;
+    if (!con_->is_connected())
+        return false;
+
+    reading_ = true;
+    reader_ = std::thread(&urx::Dashboard_Handler::reader, this);
+    return true;
+}
+
+void urx::Dashboard_Handler::stop()
+{
+    // The server answers 'quit' with "Disconnected" and closes the
+    // connection. Do not rely on that to wake up the reader, a server
+    // that has gone silent would keep us here forever.
+    if (reading_ && con_->is_connected()) {
+        std::future<std::string> bye = command("quit");
+        bye.wait_for(std::chrono::seconds(1));
+    }
+
+    reading_ = false;
+    con_->cancel();
+    if (reader_.joinable())
+        reader_.join();
+    con_->clear_cancel();
+}
+
+std::future<std::string> urx::Dashboard_Handler::command(const std::string& cmd)
+{
+    std::vector<std::future<std::string>> res = batch({cmd});
+    return std::move(res[0]);
+}
+
+std::vector<std::future<std::string>> urx::Dashboard_Handler::batch(const std::vector<std::string>& cmds)
+{
+    std::vector<std::future<std::string>> res;
+    std::string out;
+    for (auto &c : cmds)
+        out += c + "\n";
+
+    // queue and send must be atomic, or responses would be matched to
+    // the wrong command.
+    std::lock_guard<std::mutex> lg(lock_);
+    for (std::size_t i = 0; i < cmds.size(); i++) {
+        pending_.emplace_back();
+        res.push_back(pending_.back().get_future());
+    }
+
+    if (cmds.empty())
+        return res;
+
+    if (con_->do_send((void *)out.c_str(), out.size()) < 0) {
+        std::cout << __func__ << "() failed sending " << cmds.size() << " command(s)" << std::endl;
+        for (std::size_t i = 0; i < cmds.size(); i++) {
+            pending_.back().set_value("");
+            pending_.pop_back();
+        }
+    }
+    return res;
+}
+
+void urx::Dashboard_Handler::handle_incoming(const char *buf, std::size_t len)
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    partial_.append(buf, len);
+
+    std::size_t start = 0;
+    std::size_t nl;
+    while ((nl = partial_.find('\n', start)) != std::string::npos) {
+        std::string line = partial_.substr(start, nl - start);
+        start = nl + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        // server greets us with a single line when we connect
+        if (!welcomed_) {
+            welcomed_ = true;
+            if (line.rfind("Connected: ", 0) == 0)
+                continue;
+        }
+
+        if (pending_.empty()) {
+            std::cout << __func__ << "() unsolicited response: " << line << std::endl;
+            continue;
+        }
+        pending_.front().set_value(line);
+        pending_.pop_front();
+    }
+    partial_.erase(0, start);
+}
+
+std::size_t urx::Dashboard_Handler::pending()
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    return pending_.size();
+}
+
+void urx::Dashboard_Handler::fail_pending()
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    for (auto &p : pending_)
+        p.set_value("");
+    pending_.clear();
+}
+
+void urx::Dashboard_Handler::reader()
+{
+    char buf[1024];
+    while (reading_) {
+        int res = con_->do_recv(buf, sizeof(buf) - 1);
+        if (res == CON_TIMEOUT)
+            continue;
+        if (res <= 0)
+            break;
+        handle_incoming(buf, res);
+    }
+    con_->disconnect();
+    fail_pending();
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/decode_plan.hpp>
+#include <urx/rtde_recipe_token.hpp>
+#include <urx/derived.hpp>
+#include <endian.h>
+#include <string.h>
+
+urx::Decode_Plan::Decode_Plan(RTDE_Recipe *recipe) :
+    key_offset_(-1)
+{
+    if (!recipe)
+        return;
+
+    for (auto t : recipe->get_tokens()) {
+        enum RTDE_DATA_TYPE scalar;
+        int count;
+        split_type(t->type, scalar, count);
+        if (scalar > DOUBLE)
+            continue;
+
+        if (t->name == "timestamp")
+            key_offset_ = t->offset;
+
+        steps_.push_back({t->name, t->offset, t->type, scalar, count, (int)names_.size()});
+        for (int c = 0; c < count; c++) {
+            names_.push_back(count > 1 ? t->name + "[" + std::to_string(c) + "]" : t->name);
+            fields_.push_back(t->name);
+            types_.push_back(scalar);
+        }
+    }
+
+    // derived signals follow the wire payload, always doubles
+    const Derived_Signals *d = recipe->derived();
+    if (!d)
+        return;
+    for (const auto& s : d->signals()) {
+        enum RTDE_DATA_TYPE type = s.width == 6 ? VECTOR6D : s.width == 3 ? VECTOR3D : DOUBLE;
+        steps_.push_back({s.name, s.offset, type, DOUBLE, s.width, (int)names_.size()});
+        for (int c = 0; c < s.width; c++) {
+            names_.push_back(s.width > 1 ? s.name + "[" + std::to_string(c) + "]" : s.name);
+            fields_.push_back(s.name);
+            types_.push_back(DOUBLE);
+        }
+    }
+}
+
+int urx::Decode_Plan::column(const std::string& field, int component) const
+{
+    if (component < 0)
+        return -1;
+    for (std::size_t c = 0; c < fields_.size(); c++) {
+        if (fields_[c] != field)
+            continue;
+        if (c + component < fields_.size() && fields_[c + component] == field)
+            return c + component;
+        return -1;
+    }
+    return -1;
+}
+
+std::vector<int> urx::Decode_Plan::columns(const std::string& field) const
+{
+    std::vector<int> res;
+    for (std::size_t c = 0; c < fields_.size(); c++)
+        if (fields_[c] == field)
+            res.push_back(c);
+    return res;
+}
+
+double urx::Decode_Plan::key(const unsigned char *payload, unsigned long ts) const
+{
+    if (key_offset_ >= 0)
+        return decode(payload + key_offset_, DOUBLE);
+    return ts * 1e-9;
+}
+
+void urx::Decode_Plan::split_type(enum RTDE_DATA_TYPE type, enum RTDE_DATA_TYPE& scalar, int& count)
+{
+    count = 1;
+    scalar = type;
+    switch (type) {
+    case VECTOR3D:
+        scalar = DOUBLE;
+        count = 3;
+        break;
+    case VECTOR6D:
+        scalar = DOUBLE;
+        count = 6;
+        break;
+    case VECTOR6INT32:
+        scalar = INT32;
+        count = 6;
+        break;
+    case VECTOR6UINT32:
+        scalar = UINT32;
+        count = 6;
+        break;
+    default:
+        break;
+    }
+}
+
+void urx::Decode_Plan::to_host(const unsigned char *p, enum RTDE_DATA_TYPE scalar, void *dst)
+{
+    uint32_t u32;
+    uint64_t u64;
+    switch (scalar) {
+    case BOOL:
+    case UINT8:
+        *(uint8_t *)dst = p[0];
+        break;
+    case UINT32:
+    case INT32:
+        memcpy(&u32, p, sizeof(u32));
+        u32 = be32toh(u32);
+        memcpy(dst, &u32, sizeof(u32));
+        break;
+    case UINT64:
+    case DOUBLE:
+        memcpy(&u64, p, sizeof(u64));
+        u64 = be64toh(u64);
+        memcpy(dst, &u64, sizeof(u64));
+        break;
+    default:
+        break;
+    }
+}
+
+double urx::Decode_Plan::decode(const unsigned char *p, enum RTDE_DATA_TYPE scalar)
+{
+    unsigned char v[8];
+    to_host(p, scalar, v);
+    switch (scalar) {
+    case BOOL:
+    case UINT8:
+        return v[0];
+    case UINT32:
+        return *(uint32_t *)v;
+    case INT32:
+        return *(int32_t *)v;
+    case UINT64:
+        return (double)*(uint64_t *)v;
+    case DOUBLE:
+        return *(double *)v;
+    default:
+        return 0.0;
+    }
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/derived.hpp>
+#include <urx/decode_plan.hpp>
+#include <urx/rtde_recipe_token.hpp>
+#include <endian.h>
+#include <string.h>
+#include <cmath>
+#include <iostream>
+
+urx::Derived_Signals::Derived_Signals(RTDE_Recipe *recipe) :
+    recipe_(recipe),
+    wire_bytes_(0),
+    extra_bytes_(0),
+    attached_(false),
+    primed_(false),
+    frames_(0)
+{
+}
+
+urx::Derived_Signals::~Derived_Signals()
+{
+    detach();
+}
+
+bool urx::Derived_Signals::product(const std::string& name, const std::string& a, const std::string& b)
+{
+    return add(name, DERIVED_PRODUCT, a, b, 0.0);
+}
+
+bool urx::Derived_Signals::difference(const std::string& name, const std::string& a, const std::string& b)
+{
+    return add(name, DERIVED_DIFFERENCE, a, b, 0.0);
+}
+
+bool urx::Derived_Signals::sum(const std::string& name, const std::string& a, const std::string& b)
+{
+    return add(name, DERIVED_SUM, a, b, 0.0);
+}
+
+bool urx::Derived_Signals::scale(const std::string& name, const std::string& a, double k)
+{
+    return add(name, DERIVED_SCALE, a, "", k);
+}
+
+bool urx::Derived_Signals::lowpass(const std::string& name, const std::string& a, double alpha)
+{
+    if (alpha <= 0.0 || alpha > 1.0) {
+        std::cout << __func__ << "() " << name << ": alpha must be in (0, 1]" << std::endl;
+        return false;
+    }
+    return add(name, DERIVED_LOWPASS, a, "", alpha);
+}
+
+bool urx::Derived_Signals::norm(const std::string& name, const std::string& a, int first, int count)
+{
+    if (attached_ || taken(name))
+        return false;
+    int width;
+    int slot = operand(a, width);
+    if (slot < 0)
+        return false;
+    if (count < 0)
+        count = width - first;
+    if (first < 0 || count < 1 || first + count > width) {
+        std::cout << __func__ << "() " << name << ": " << a << " has " << width << " elements" << std::endl;
+        return false;
+    }
+
+    signals_.push_back({name, DERIVED_NORM, slot + first, -1, count, 0, 0.0, 1, (int)vals_.size(), 0});
+    vals_.push_back(0.0);
+    return true;
+}
+
+bool urx::Derived_Signals::add(const std::string& name, Derived_Op op, const std::string& a, const std::string& b, double k)
+{
+    if (attached_ || taken(name))
+        return false;
+
+    int aw, bw = 1;
+    int as = operand(a, aw);
+    int bs = -1;
+    if (as < 0)
+        return false;
+    if (op == DERIVED_PRODUCT || op == DERIVED_DIFFERENCE || op == DERIVED_SUM) {
+        bs = operand(b, bw);
+        if (bs < 0)
+            return false;
+        if (aw != bw && aw != 1 && bw != 1) {
+            std::cout << __func__ << "() " << name << ": " << a << " and " << b << " differ in width" << std::endl;
+            return false;
+        }
+    }
+
+    int width = aw > bw ? aw : bw;
+    signals_.push_back({name, op, as, bs, aw, bw, k, width, (int)vals_.size(), 0});
+    vals_.resize(vals_.size() + width, 0.0);
+    return true;
+}
+
+bool urx::Derived_Signals::taken(const std::string& name) const
+{
+    if (name.empty())
+        return true;
+    for (const auto& s : signals_)
+        if (s.name == name)
+            return true;
+    if (recipe_)
+        for (auto t : recipe_->get_tokens())
+            if (t->name == name)
+                return true;
+    return false;
+}
+
+int urx::Derived_Signals::operand(const std::string& name, int& width)
+{
+    for (const auto& s : signals_) {
+        if (s.name == name) {
+            width = s.width;
+            return s.slot;
+        }
+    }
+    for (const auto& l : loads_) {
+        if (l.field == name) {
+            width = l.count;
+            return l.slot;
+        }
+    }
+
+    if (recipe_) {
+        for (auto t : recipe_->get_tokens()) {
+            if (t->name != name)
+                continue;
+            Load l;
+            Decode_Plan::split_type(t->type, l.scalar, l.count);
+            if (l.scalar > DOUBLE)
+                break;
+            l.field = name;
+            l.offset = t->offset;
+            l.slot = vals_.size();
+            loads_.push_back(l);
+            vals_.resize(vals_.size() + l.count, 0.0);
+            width = l.count;
+            return l.slot;
+        }
+    }
+    std::cout << __func__ << "() " << name << " is not a numeric field or derived signal" << std::endl;
+    return -1;
+}
+
+bool urx::Derived_Signals::attach()
+{
+    if (!recipe_ || attached_ || recipe_->derived())
+        return false;
+
+    // fields may have moved since the signals were declared
+    for (auto& l : loads_) {
+        bool found = false;
+        for (auto t : recipe_->get_tokens()) {
+            if (t->name == l.field) {
+                l.offset = t->offset;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            std::cout << __func__ << "() " << l.field << " no longer in recipe" << std::endl;
+            return false;
+        }
+    }
+
+    wire_bytes_ = recipe_->expected_bytes();
+    extra_bytes_ = 0;
+    for (auto& s : signals_) {
+        s.offset = wire_bytes_ + extra_bytes_;
+        extra_bytes_ += s.width * sizeof(double);
+    }
+    frame_.assign(wire_bytes_ + extra_bytes_, 0);
+    primed_ = false;
+    frames_ = 0;
+
+    recipe_->set_derived(this);
+    attached_ = true;
+    return true;
+}
+
+void urx::Derived_Signals::detach()
+{
+    if (!attached_)
+        return;
+    if (recipe_ && recipe_->derived() == this)
+        recipe_->set_derived(nullptr);
+    attached_ = false;
+}
+
+const double * urx::Derived_Signals::value(const std::string& name) const
+{
+    int i = slot(name);
+    return i < 0 ? nullptr : &vals_[i];
+}
+
+int urx::Derived_Signals::slot(const std::string& name) const
+{
+    for (const auto& s : signals_)
+        if (s.name == name)
+            return s.slot;
+    return -1;
+}
+
+const unsigned char * urx::Derived_Signals::process(const unsigned char *payload, unsigned long)
+{
+    if (!payload || !attached_)
+        return payload;
+
+    memcpy(frame_.data(), payload, wire_bytes_);
+
+    double *v = vals_.data();
+    for (const auto& l : loads_) {
+        const unsigned char *p = payload + l.offset;
+        int sz = type_to_size(l.scalar);
+        for (int c = 0; c < l.count; c++)
+            v[l.slot + c] = Decode_Plan::decode(p + c * sz, l.scalar);
+    }
+
+    for (const auto& s : signals_) {
+        double *y = v + s.slot;
+        const double *a = v + s.a;
+        const double *b = s.b >= 0 ? v + s.b : nullptr;
+        int ai = s.a_width > 1 ? 1 : 0;
+        int bi = s.b_width > 1 ? 1 : 0;
+
+        switch (s.op) {
+        case DERIVED_PRODUCT:
+            for (int i = 0; i < s.width; i++)
+                y[i] = a[i * ai] * b[i * bi];
+            break;
+        case DERIVED_DIFFERENCE:
+            for (int i = 0; i < s.width; i++)
+                y[i] = a[i * ai] - b[i * bi];
+            break;
+        case DERIVED_SUM:
+            for (int i = 0; i < s.width; i++)
+                y[i] = a[i * ai] + b[i * bi];
+            break;
+        case DERIVED_SCALE:
+            for (int i = 0; i < s.width; i++)
+                y[i] = s.k * a[i];
+            break;
+        case DERIVED_NORM: {
+            double acc = 0.0;
+            for (int i = 0; i < s.a_width; i++)
+                acc += a[i] * a[i];
+            y[0] = std::sqrt(acc);
+            break;
+        }
+        case DERIVED_LOWPASS:
+            for (int i = 0; i < s.width; i++)
+                y[i] = primed_ ? y[i] + s.k * (a[i] - y[i]) : a[i];
+            break;
+        }
+
+        unsigned char *out = frame_.data() + s.offset;
+        for (int i = 0; i < s.width; i++) {
+            uint64_t u;
+            memcpy(&u, &y[i], sizeof(u));
+            u = htobe64(u);
+            memcpy(out + i * sizeof(u), &u, sizeof(u));
+        }
+    }
+
+    primed_ = true;
+    frames_++;
+    return frame_.data();
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/frame_monitor.hpp>
+#include <cmath>
+
+void urx::Frame_Monitor::reset()
+{
+    if (!fixed_period_)
+        period_ = 0.0;
+    learn_left_ = LEARN_FRAMES;
+    learn_min_ = 0.0;
+    prev_ts_ = -1.0;
+    prev_seqnr_ = 0;
+
+    frames_ = 0;
+    gaps_ = 0;
+    missed_ = 0;
+    max_missed_ = 0;
+    duplicates_ = 0;
+    seqnr_regressions_ = 0;
+    extrapolated_ = 0;
+}
+
+// Collect the smallest increment over the first frames (a single lost
+// frame during startup should not fool us into a 2x period), then snap
+// to a known cycle time if we are close enough.
+void urx::Frame_Monitor::learn(double delta)
+{
+    if (learn_min_ <= 0.0 || delta < learn_min_)
+        learn_min_ = delta;
+
+    if (--learn_left_ > 0)
+        return;
+
+    double p = learn_min_;
+    if (std::fabs(p - PERIOD_500HZ) < PERIOD_500HZ * 0.25)
+        p = PERIOD_500HZ;
+    else if (std::fabs(p - PERIOD_125HZ) < PERIOD_125HZ * 0.25)
+        p = PERIOD_125HZ;
+    period_.store(p, std::memory_order_relaxed);
+}
+
+int urx::Frame_Monitor::update(double ur_ts, int32_t seqnr)
+{
+    frames_.fetch_add(1, std::memory_order_relaxed);
+
+    // first frame, nothing to compare against
+    if (prev_ts_ < 0.0) {
+        prev_ts_ = ur_ts;
+        prev_seqnr_ = seqnr;
+        return 0;
+    }
+
+    double delta = ur_ts - prev_ts_;
+    if (delta <= 0.0) {
+        duplicates_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    if (seqnr < prev_seqnr_)
+        seqnr_regressions_.fetch_add(1, std::memory_order_relaxed);
+
+    int missed = 0;
+    double period = period_.load(std::memory_order_relaxed);
+    if (period <= 0.0) {
+        learn(delta);
+    } else {
+        long cycles = std::lround(delta / period);
+        missed = cycles > 1 ? (int)(cycles - 1) : 0;
+    }
+
+    if (missed > 0) {
+        gaps_.fetch_add(1, std::memory_order_relaxed);
+        missed_.fetch_add(missed, std::memory_order_relaxed);
+        if ((uint64_t)missed > max_missed_.load(std::memory_order_relaxed))
+            max_missed_.store(missed, std::memory_order_relaxed);
+
+        if (gap_cb_)
+            gap_cb_(Frame_Gap{prev_ts_, ur_ts, missed, prev_seqnr_, seqnr});
+    }
+
+    prev_ts_ = ur_ts;
+    prev_seqnr_ = seqnr;
+    return missed;
+}
+
+urx::Frame_Stats urx::Frame_Monitor::stats() const
+{
+    Frame_Stats s;
+    s.frames            = frames_.load(std::memory_order_relaxed);
+    s.gaps              = gaps_.load(std::memory_order_relaxed);
+    s.missed            = missed_.load(std::memory_order_relaxed);
+    s.max_missed        = max_missed_.load(std::memory_order_relaxed);
+    s.duplicates        = duplicates_.load(std::memory_order_relaxed);
+    s.seqnr_regressions = seqnr_regressions_.load(std::memory_order_relaxed);
+    s.extrapolated      = extrapolated_.load(std::memory_order_relaxed);
+    return s;
+}
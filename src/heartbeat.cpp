@@ -0,0 +1,141 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/heartbeat.hpp>
+#include <string>
+
+urx::Heartbeat::Heartbeat(int max_missed) :
+    max_missed_(max_missed > 0 ? max_missed : 1),
+    host_seqnr_(0),
+    limit_(max_missed_),
+    script_seqnr_(0),
+    script_missed_(0)
+{
+    map_.add_int("hb_seqnr", REG_IN, &host_seqnr_);
+    map_.add_int("hb_limit", REG_IN, &limit_);
+    map_.add_int("hb_script_seqnr", REG_OUT, &script_seqnr_);
+    map_.add_int("hb_script_missed", REG_OUT, &script_missed_);
+    reset();
+}
+
+bool urx::Heartbeat::add_input_fields(RTDE_Recipe *in)
+{
+    if (!in)
+        return false;
+    for (auto &c : map_.channels())
+        if (c.dir == REG_IN &&
+            !in->add_field("input_int_register_" + std::to_string(c.first), (int32_t *)c.storage))
+            return false;
+    return true;
+}
+
+bool urx::Heartbeat::add_output_fields(RTDE_Recipe *out)
+{
+    if (!out)
+        return false;
+    for (auto &c : map_.channels())
+        if (c.dir == REG_OUT &&
+            !out->add_field("output_int_register_" + std::to_string(c.first), (int32_t *)c.storage))
+            return false;
+    return true;
+}
+
+urx::Script_Params urx::Heartbeat::params() const
+{
+    Script_Params p;
+    for (auto &c : map_.channels())
+        p[c.name] = std::to_string(c.first);
+    return p;
+}
+
+urx::Script_Params urx::Heartbeat::default_params()
+{
+    static const Script_Params p = Heartbeat().params();
+    return p;
+}
+
+bool urx::Heartbeat::reserve(Register_Map *map) const
+{
+    if (!map)
+        return false;
+    for (auto &c : map_.channels())
+        if (!map->reserve(c.dir, c.type, c.first, c.count))
+            return false;
+    return true;
+}
+
+void urx::Heartbeat::beat()
+{
+    host_seqnr_++;
+    beats_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool urx::Heartbeat::check(int64_t rx_ns)
+{
+    frames_.fetch_add(1, std::memory_order_relaxed);
+
+    int32_t sm = script_missed_;
+    cur_script_missed_.store(sm, std::memory_order_relaxed);
+    if (sm > max_script_missed_.load(std::memory_order_relaxed))
+        max_script_missed_.store(sm, std::memory_order_relaxed);
+
+    if (!seen_ || script_seqnr_ != prev_script_) {
+        seen_ = true;
+        prev_script_ = script_seqnr_;
+        missed_ = 0;
+        last_beat_ns_ = rx_ns;
+        if (stalled_) {
+            stalled_ = false;
+            recoveries_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    if (stalled_ || ++missed_ < max_missed_)
+        return !stalled_;
+
+    stalled_ = true;
+    int64_t latency = rx_ns - last_beat_ns_;
+    stalls_.fetch_add(1, std::memory_order_relaxed);
+    last_detect_ns_.store(latency, std::memory_order_relaxed);
+    if (latency > max_detect_ns_.load(std::memory_order_relaxed))
+        max_detect_ns_.store(latency, std::memory_order_relaxed);
+    if (stall_cb_)
+        stall_cb_(latency);
+    return false;
+}
+
+urx::Heartbeat_Stats urx::Heartbeat::stats() const
+{
+    Heartbeat_Stats s;
+    s.frames = frames_.load(std::memory_order_relaxed);
+    s.beats = beats_.load(std::memory_order_relaxed);
+    s.stalls = stalls_.load(std::memory_order_relaxed);
+    s.recoveries = recoveries_.load(std::memory_order_relaxed);
+    s.last_detect_ms = last_detect_ns_.load(std::memory_order_relaxed) / 1e6;
+    s.max_detect_ms = max_detect_ns_.load(std::memory_order_relaxed) / 1e6;
+    s.script_missed = cur_script_missed_.load(std::memory_order_relaxed);
+    s.max_script_missed = max_script_missed_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void urx::Heartbeat::reset()
+{
+    prev_script_ = 0;
+    seen_ = false;
+    missed_ = 0;
+    last_beat_ns_ = 0;
+    stalled_ = false;
+    frames_ = 0;
+    beats_ = 0;
+    stalls_ = 0;
+    recoveries_ = 0;
+    last_detect_ns_ = 0;
+    max_detect_ns_ = 0;
+    cur_script_missed_ = 0;
+    max_script_missed_ = 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/history.hpp>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    std::size_t pow2(std::size_t n)
+    {
+        std::size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+}
+
+urx::History::History(RTDE_Recipe *recipe, std::size_t capacity) :
+    cap_(pow2(capacity < 2 ? 2 : capacity)),
+    mask_(cap_ - 1),
+    plan_(recipe),
+    head_(0),
+    first_(0),
+    last_key_(-std::numeric_limits<double>::infinity())
+{
+    keys_.assign(cap_, 0.0);
+    data_.assign(plan_.num_columns() * cap_, 0.0);
+}
+
+void urx::History::on_frame(const unsigned char *payload, unsigned long ts)
+{
+    if (!payload)
+        return;
+
+    uint64_t h = head_.load(std::memory_order_relaxed);
+    double key = plan_.key(payload, ts);
+    if (key < last_key_)
+        first_.store(h, std::memory_order_release);
+    last_key_ = key;
+
+    std::size_t slot = h & mask_;
+    keys_[slot] = key;
+    for (const auto& d : plan_.steps()) {
+        const unsigned char *p = payload + d.offset;
+        int sz = type_to_size(d.scalar);
+        for (int c = 0; c < d.count; c++)
+            col_(d.col + c)[slot] = Decode_Plan::decode(p + c * sz, d.scalar);
+    }
+    head_.store(h + 1, std::memory_order_release);
+}
+
+/*
+ * The frame being written is head_, which overwrites the slot of
+ * head_ - cap_, so only the cap_ - 1 frames before it are stable.
+ */
+uint64_t urx::History::oldest_safe_() const
+{
+    uint64_t h = head_.load(std::memory_order_acquire);
+    uint64_t f = first_.load(std::memory_order_acquire);
+    uint64_t lapped = h >= cap_ ? h - cap_ + 1 : 0;
+    return std::max(f, lapped);
+}
+
+std::size_t urx::History::size() const
+{
+    uint64_t s = oldest_safe_();
+    uint64_t h = head_.load(std::memory_order_acquire);
+    return h > s ? h - s : 0;
+}
+
+double urx::History::latest() const
+{
+    uint64_t h = head_.load(std::memory_order_acquire);
+    if (h == 0 || h <= first_.load(std::memory_order_acquire))
+        return -1.0;
+    return key_(h - 1);
+}
+
+// first frame in [lo, hi) with key >= t (key > t if upper)
+uint64_t urx::History::lower_(uint64_t lo, uint64_t hi, double t, bool upper) const
+{
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        double k = key_(mid);
+        if (upper ? k <= t : k < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Find [lo, hi) for t0 <= key <= t1 and hand it to f, which may run
+ * more than once. The search for lo can be misled by slots the writer
+ * is overwriting, but then lo ends up in the overwritten part, which
+ * is caught by comparing with the oldest stable frame afterwards. hi
+ * is searched from lo and only ever sees stable slots.
+ *
+ * A retry skips ahead a little so that it does not race the writer
+ * for the very oldest frame again.
+ */
+template<typename F>
+bool urx::History::read_(double t0, double t1, F&& f) const
+{
+    uint64_t start = oldest_safe_();
+    for (int i = 0; i < HISTORY_READ_RETRIES; i++) {
+        uint64_t f0 = first_.load(std::memory_order_acquire);
+        uint64_t h = head_.load(std::memory_order_acquire);
+        if (start < f0)
+            start = f0;
+        if (start > h)
+            start = h;
+
+        uint64_t lo = lower_(start, h, t0, false);
+        uint64_t hi = lower_(lo, h, t1, true);
+        f(lo, hi);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t safe = oldest_safe_();
+        if (lo >= safe && first_.load(std::memory_order_relaxed) == f0)
+            return true;
+        start = safe + cap_ / 32;
+    }
+    return false;
+}
+
+bool urx::History::snapshot(double t0, double t1, const std::vector<int>& cols, History_Snapshot& out) const
+{
+    for (int c : cols)
+        if (c < 0 || c >= (int)plan_.num_columns())
+            return false;
+
+    out.cols.resize(cols.size());
+    return read_(t0, t1, [&](uint64_t lo, uint64_t hi) {
+        std::size_t n = hi - lo;
+        std::size_t s0 = lo & mask_;
+        std::size_t n0 = std::min(n, cap_ - s0);
+
+        // at most two contiguous pieces per column
+        auto copy = [&](std::vector<double>& dst, const double *src) {
+            dst.resize(n);
+            memcpy(dst.data(), src + s0, n0 * sizeof(double));
+            memcpy(dst.data() + n0, src, (n - n0) * sizeof(double));
+        };
+        copy(out.ts, keys_.data());
+        for (std::size_t i = 0; i < cols.size(); i++)
+            copy(out.cols[i], col_(cols[i]));
+    });
+}
+
+bool urx::History::last(double seconds, const std::vector<int>& cols, History_Snapshot& out) const
+{
+    double t1 = latest();
+    if (t1 < 0) {
+        out.ts.clear();
+        out.cols.assign(cols.size(), std::vector<double>());
+        return true;
+    }
+    return snapshot(t1 - seconds, t1, cols, out);
+}
+
+bool urx::History::stats(double t0, double t1, int col, History_Stats& out) const
+{
+    if (col < 0 || col >= (int)plan_.num_columns())
+        return false;
+
+    const double *base = col_(col);
+    return read_(t0, t1, [&](uint64_t lo, uint64_t hi) {
+        // 4 independent lanes, so that the compiler can keep them in
+        // one vector register without reassociating
+        double mn[4], mx[4], sum[4] = {0, 0, 0, 0}, sq[4] = {0, 0, 0, 0};
+        for (int l = 0; l < 4; l++) {
+            mn[l] = std::numeric_limits<double>::infinity();
+            mx[l] = -std::numeric_limits<double>::infinity();
+        }
+        auto acc = [&](const double *p, std::size_t n) {
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                for (int l = 0; l < 4; l++) {
+                    double v = p[i + l];
+                    mn[l] = v < mn[l] ? v : mn[l];
+                    mx[l] = v > mx[l] ? v : mx[l];
+                    sum[l] += v;
+                    sq[l] += v * v;
+                }
+            }
+            for (; i < n; i++) {
+                double v = p[i];
+                mn[0] = v < mn[0] ? v : mn[0];
+                mx[0] = v > mx[0] ? v : mx[0];
+                sum[0] += v;
+                sq[0] += v * v;
+            }
+        };
+
+        std::size_t n = hi - lo;
+        std::size_t s0 = lo & mask_;
+        std::size_t n0 = std::min(n, cap_ - s0);
+        acc(base + s0, n0);
+        acc(base, n - n0);
+
+        out.n = n;
+        out.min = std::min(std::min(mn[0], mn[1]), std::min(mn[2], mn[3]));
+        out.max = std::max(std::max(mx[0], mx[1]), std::max(mx[2], mx[3]));
+        double s = sum[0] + sum[1] + sum[2] + sum[3];
+        double q = sq[0] + sq[1] + sq[2] + sq[3];
+        out.mean = n ? s / n : 0.0;
+        out.rms = n ? std::sqrt(q / n) : 0.0;
+        if (!n)
+            out.min = out.max = 0.0;
+    });
+}
+
+std::vector<urx::History_Stats> urx::History::stats(double t0, double t1, const std::string& name) const
+{
+    std::vector<History_Stats> res;
+    for (int c : plan_.columns(name)) {
+        History_Stats s;
+        if (!stats(t0, t1, c, s))
+            s = {0, 0.0, 0.0, 0.0, 0.0};
+        res.push_back(s);
+    }
+    return res;
+}
@@ -0,0 +1,559 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/log_file.hpp>
+#include <urx/codec.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <iostream>
+
+namespace {
+    std::size_t round_up(std::size_t v, std::size_t a)
+    {
+        return (v + a - 1) / a * a;
+    }
+
+    struct log_column_desc mkcol(const std::string& name, enum RTDE_DATA_TYPE type,
+                                 enum RTDE_DATA_TYPE scalar, int component)
+    {
+        struct log_column_desc d;
+        memset(&d, 0, sizeof(d));
+        strncpy(d.name, name.c_str(), sizeof(d.name) - 1);
+        d.field_type = type;
+        d.scalar = scalar;
+        d.component = component;
+        d.elem_size = type_to_size(scalar);
+        return d;
+    }
+}
+
+urx::Log_Writer::Log_Writer(RTDE_Recipe *recipe, std::size_t chunk_frames, bool compress) :
+    plan_(recipe),
+    chunk_frames_(chunk_frames ? chunk_frames : LOG_CHUNK_FRAMES),
+    chunk_bytes_(0),
+    header_bytes_(0),
+    fd_(-1),
+    chunk_(nullptr),
+    chunk_idx_(0),
+    in_chunk_(0),
+    frames_(0),
+    dropped_(0),
+    append_off_(0),
+    compress_(compress),
+    cur_(0),
+    pending_(nullptr),
+    stop_(false),
+    failed_(false)
+{
+    cols_.push_back(mkcol("t", DOUBLE, DOUBLE, 0));
+    cols_.push_back(mkcol("rx_ns", UINT64, UINT64, 0));
+    for (const auto& s : plan_.steps())
+        for (int c = 0; c < s.count; c++)
+            cols_.push_back(mkcol(s.field, s.type, s.scalar, c));
+
+    // cache-line aligned columns after the chunk header
+    std::size_t off = round_up(sizeof(struct log_chunk_header), 64);
+    for (auto& c : cols_) {
+        c.offset = off;
+        off = round_up(off + chunk_frames_ * c.elem_size, 64);
+    }
+    chunk_bytes_ = round_up(off, LOG_PAGE);
+    header_bytes_ = round_up(sizeof(struct log_file_header) + cols_.size() * sizeof(struct log_column_desc), LOG_PAGE);
+    if (compress_) {
+        staging_[0].assign(chunk_bytes_, 0);
+        staging_[1].assign(chunk_bytes_, 0);
+    }
+}
+
+urx::Log_Writer::~Log_Writer()
+{
+    close();
+}
+
+bool urx::Log_Writer::open(const std::string& path)
+{
+    close();
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        perror("Log_Writer open()");
+        return false;
+    }
+
+    std::vector<unsigned char> hdr(header_bytes_, 0);
+    struct log_file_header *h = (struct log_file_header *)hdr.data();
+    memcpy(h->magic, URX_LOG_MAGIC, sizeof(h->magic));
+    h->version = LOG_VERSION;
+    h->byte_order = 0x01020304;
+    h->num_columns = cols_.size();
+    h->chunk_frames = chunk_frames_;
+    h->chunk_bytes = chunk_bytes_;
+    h->header_bytes = header_bytes_;
+    h->flags = compress_ ? LOG_FLAG_COMPRESSED : 0;
+    memcpy(hdr.data() + sizeof(*h), cols_.data(), cols_.size() * sizeof(struct log_column_desc));
+
+    if (pwrite(fd_, hdr.data(), hdr.size(), 0) != (ssize_t)hdr.size()) {
+        perror("Log_Writer header");
+        close();
+        return false;
+    }
+    frames_ = 0;
+    dropped_ = 0;
+    append_off_ = header_bytes_;
+    if (compress_) {
+        cur_ = 0;
+        pending_ = nullptr;
+        stop_ = false;
+        failed_ = false;
+        chunk_ = staging_[cur_].data();
+        init_chunk_(chunk_, 0);
+        encoder_thread_ = std::thread(&Log_Writer::encoder_, this);
+        return true;
+    }
+    if (!map_chunk_(0)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void urx::Log_Writer::close()
+{
+    if (compress_ && encoder_thread_.joinable()) {
+        // the last, partial, chunk
+        if (chunk_ && in_chunk_ > 0) {
+            {
+                std::unique_lock<std::mutex> lk(lock_);
+                cv_.wait(lk, [this]() { return !pending_; });
+            }
+            queue_chunk_();
+        }
+        {
+            std::unique_lock<std::mutex> lk(lock_);
+            cv_.wait(lk, [this]() { return !pending_; });
+            stop_ = true;
+        }
+        cv_.notify_all();
+        encoder_thread_.join();
+        chunk_ = nullptr;
+    }
+    unmap_chunk_();
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+}
+
+uint64_t urx::Log_Writer::bytes() const
+{
+    return append_off_;
+}
+
+void urx::Log_Writer::init_chunk_(unsigned char *chunk, uint64_t k)
+{
+    struct log_chunk_header *ch = (struct log_chunk_header *)chunk;
+    ch->magic = URX_LOG_CHUNK_MAGIC;
+    ch->frames = 0;
+    ch->t_min = 0.0;
+    ch->t_max = 0.0;
+    ch->seq = k;
+    ch->bytes = chunk_bytes_;
+    chunk_idx_ = k;
+    in_chunk_ = 0;
+}
+
+/*
+ * Hand the current staging chunk to the encoder and continue in the
+ * other one. Fails if the encoder has not finished the other one yet.
+ */
+bool urx::Log_Writer::queue_chunk_()
+{
+    {
+        std::lock_guard<std::mutex> lg(lock_);
+        if (pending_ || failed_)
+            return false;
+        pending_ = chunk_;
+    }
+    cv_.notify_all();
+    cur_ ^= 1;
+    chunk_ = staging_[cur_].data();
+    init_chunk_(chunk_, chunk_idx_ + 1);
+    return true;
+}
+
+void urx::Log_Writer::encoder_()
+{
+    std::unique_lock<std::mutex> lk(lock_);
+    for (;;) {
+        cv_.wait(lk, [this]() { return pending_ || stop_; });
+        if (!pending_)
+            return;
+        unsigned char *chunk = pending_;
+        lk.unlock();
+        bool ok = write_encoded_(chunk);
+        lk.lock();
+        if (!ok)
+            failed_ = true;
+        pending_ = nullptr;
+        cv_.notify_all();
+    }
+}
+
+bool urx::Log_Writer::write_encoded_(const unsigned char *chunk)
+{
+    struct log_chunk_header ch;
+    memcpy(&ch, chunk, sizeof(ch));
+    std::size_t n = ch.frames;
+
+    enc_.assign(round_up(sizeof(ch), 8), 0);
+    ints_.resize(chunk_frames_);
+    for (const auto& c : cols_) {
+        std::size_t at = enc_.size();
+        enc_.resize(at + sizeof(uint32_t));
+        const unsigned char *src = chunk + c.offset;
+        if (c.scalar == DOUBLE) {
+            xor_encode((const double *)src, n, enc_);
+        } else {
+            for (std::size_t i = 0; i < n; i++) {
+                switch (c.scalar) {
+                case UINT32:
+                    ints_[i] = ((const uint32_t *)src)[i];
+                    break;
+                case INT32:
+                    ints_[i] = ((const int32_t *)src)[i];
+                    break;
+                case UINT64:
+                    ints_[i] = ((const int64_t *)src)[i];
+                    break;
+                default:
+                    ints_[i] = src[i];
+                    break;
+                }
+            }
+            dod_encode(ints_.data(), n, enc_);
+        }
+        uint32_t len = enc_.size() - at - sizeof(uint32_t);
+        memcpy(enc_.data() + at, &len, sizeof(len));
+        enc_.resize(round_up(enc_.size(), 8), 0);
+    }
+
+    ch.bytes = enc_.size();
+    memcpy(enc_.data(), &ch, sizeof(ch));
+    if (pwrite(fd_, enc_.data(), enc_.size(), append_off_) != (ssize_t)enc_.size()) {
+        perror("Log_Writer write");
+        return false;
+    }
+    append_off_ += enc_.size();
+    return true;
+}
+
+bool urx::Log_Writer::map_chunk_(uint64_t k)
+{
+    unmap_chunk_();
+    off_t end = header_bytes_ + (k + 1) * chunk_bytes_;
+    if (ftruncate(fd_, end)) {
+        perror("Log_Writer grow");
+        return false;
+    }
+    append_off_ = end;
+    // populate now, not with a page fault per column on the first frames
+    void *m = mmap(NULL, chunk_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fd_, header_bytes_ + k * chunk_bytes_);
+    if (m == MAP_FAILED) {
+        perror("Log_Writer mmap");
+        return false;
+    }
+    chunk_ = (unsigned char *)m;
+    init_chunk_(chunk_, k);
+    return true;
+}
+
+void urx::Log_Writer::unmap_chunk_()
+{
+    if (!chunk_ || compress_)
+        return;
+    munmap(chunk_, chunk_bytes_);
+    chunk_ = nullptr;
+}
+
+void urx::Log_Writer::on_frame(const unsigned char *payload, unsigned long ts)
+{
+    if (!chunk_ || !payload)
+        return;
+    if (in_chunk_ == chunk_frames_) {
+        if (compress_) {
+            if (!queue_chunk_()) {
+                dropped_++;
+                return;
+            }
+        } else if (!map_chunk_(chunk_idx_ + 1)) {
+            std::cerr << "Log_Writer: cannot extend log, recording stopped" << std::endl;
+            close();
+            return;
+        }
+    }
+
+    uint32_t i = in_chunk_;
+    double key = plan_.key(payload, ts);
+    ((double *)(chunk_ + cols_[0].offset))[i] = key;
+    ((uint64_t *)(chunk_ + cols_[1].offset))[i] = ts;
+
+    std::size_t col = 2;
+    for (const auto& s : plan_.steps()) {
+        int sz = type_to_size(s.scalar);
+        for (int c = 0; c < s.count; c++, col++)
+            Decode_Plan::to_host(payload + s.offset + c * sz, s.scalar, chunk_ + cols_[col].offset + i * sz);
+    }
+
+    // publish the frame last, a reader of a live file trusts frames
+    struct log_chunk_header *ch = (struct log_chunk_header *)chunk_;
+    if (i == 0)
+        ch->t_min = key;
+    ch->t_max = key;
+    __atomic_store_n(&ch->frames, i + 1, __ATOMIC_RELEASE);
+    in_chunk_++;
+    frames_++;
+}
+
+urx::Log_Reader::Log_Reader() :
+    base_(nullptr),
+    size_(0),
+    hdr_(nullptr),
+    cols_(nullptr),
+    num_chunks_(0),
+    num_frames_(0),
+    cache_chunk_{0, 0},
+    cache_col_{-1, -1}
+{
+}
+
+urx::Log_Reader::~Log_Reader()
+{
+    close();
+}
+
+bool urx::Log_Reader::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror("Log_Reader open()");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || (std::size_t)st.st_size < sizeof(struct log_file_header)) {
+        ::close(fd);
+        return false;
+    }
+    void *m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED) {
+        perror("Log_Reader mmap");
+        return false;
+    }
+    base_ = (const unsigned char *)m;
+    size_ = st.st_size;
+    hdr_ = (const struct log_file_header *)base_;
+
+    if (memcmp(hdr_->magic, URX_LOG_MAGIC, sizeof(hdr_->magic)) || hdr_->version != LOG_VERSION ||
+        hdr_->byte_order != 0x01020304 || hdr_->chunk_bytes == 0 || hdr_->header_bytes > size_ ||
+        sizeof(*hdr_) + hdr_->num_columns * sizeof(struct log_column_desc) > hdr_->header_bytes) {
+        std::cerr << path << ": not a (compatible) URX log" << std::endl;
+        close();
+        return false;
+    }
+    cols_ = (const struct log_column_desc *)(base_ + sizeof(*hdr_));
+
+    // Walk the chunks, fixed size or following bytes when compressed.
+    // A chunk being written (or cut short) ends the file.
+    std::size_t off = hdr_->header_bytes;
+    while (off + sizeof(struct log_chunk_header) <= size_) {
+        const struct log_chunk_header *ch = (const struct log_chunk_header *)(base_ + off);
+        std::size_t bytes = compressed() ? ch->bytes : hdr_->chunk_bytes;
+        if (ch->magic != URX_LOG_CHUNK_MAGIC || ch->frames == 0 || ch->frames > hdr_->chunk_frames ||
+            bytes < sizeof(*ch) || off + bytes > size_)
+            break;
+        chunk_off_.push_back(off);
+        num_frames_ += __atomic_load_n(&ch->frames, __ATOMIC_ACQUIRE);
+        off += bytes;
+    }
+    num_chunks_ = chunk_off_.size();
+    return true;
+}
+
+void urx::Log_Reader::close()
+{
+    if (base_)
+        munmap((void *)base_, size_);
+    base_ = nullptr;
+    size_ = 0;
+    hdr_ = nullptr;
+    cols_ = nullptr;
+    num_chunks_ = 0;
+    num_frames_ = 0;
+    chunk_off_.clear();
+    for (int i = 0; i < 2; i++) {
+        cache_col_[i] = -1;
+        cache_[i].clear();
+    }
+}
+
+bool urx::Log_Reader::read_(std::size_t chunk, int col, void *out) const
+{
+    std::size_t n = chunk_frames(chunk);
+    const struct log_column_desc& c = cols_[col];
+    if (!compressed()) {
+        memcpy(out, chunk_base_(chunk) + c.offset, n * c.elem_size);
+        return true;
+    }
+
+    // skip to the column
+    const unsigned char *p = chunk_base_(chunk) + round_up(sizeof(struct log_chunk_header), 8);
+    const unsigned char *end = chunk_base_(chunk) + chunk_hdr_(chunk)->bytes;
+    uint32_t len = 0;
+    for (int i = 0; i <= col; i++) {
+        if (i)
+            p += round_up(sizeof(uint32_t) + len, 8);
+        if (p + sizeof(uint32_t) > end)
+            return false;
+        memcpy(&len, p, sizeof(len));
+        if (p + sizeof(uint32_t) + len > end)
+            return false;
+    }
+    p += sizeof(uint32_t);
+
+    if (c.scalar == DOUBLE)
+        return xor_decode(p, len, n, (double *)out);
+    if (c.elem_size == 8)
+        return dod_decode(p, len, n, (int64_t *)out);
+
+    std::vector<int64_t> v(n);
+    if (!dod_decode(p, len, n, v.data()))
+        return false;
+    for (std::size_t i = 0; i < n; i++) {
+        switch (c.elem_size) {
+        case 4:
+            ((uint32_t *)out)[i] = (uint32_t)v[i];
+            break;
+        default:
+            ((uint8_t *)out)[i] = (uint8_t)v[i];
+            break;
+        }
+    }
+    return true;
+}
+
+const unsigned char *urx::Log_Reader::cached_(std::size_t chunk, int col) const
+{
+    if (!compressed())
+        return chunk_base_(chunk) + cols_[col].offset;
+
+    int slot = col == 0 ? 0 : 1;
+    if (cache_col_[slot] != col || cache_chunk_[slot] != chunk) {
+        cache_[slot].resize(chunk_frames(chunk) * cols_[col].elem_size);
+        cache_col_[slot] = -1;
+        if (!read_(chunk, col, cache_[slot].data()))
+            return nullptr;
+        cache_col_[slot] = col;
+        cache_chunk_[slot] = chunk;
+    }
+    return cache_[slot].data();
+}
+
+const double *urx::Log_Reader::times(std::size_t chunk) const
+{
+    if (chunk >= num_chunks_)
+        return nullptr;
+    return (const double *)cached_(chunk, 0);
+}
+
+std::string urx::Log_Reader::column_name(int col) const
+{
+    if (col < 0 || col >= (int)num_columns())
+        return "";
+    std::string name(cols_[col].name, strnlen(cols_[col].name, sizeof(cols_[col].name)));
+    int count;
+    enum RTDE_DATA_TYPE scalar;
+    Decode_Plan::split_type((enum RTDE_DATA_TYPE)cols_[col].field_type, scalar, count);
+    if (count > 1)
+        name.append("[").append(std::to_string(cols_[col].component)).append("]");
+    return name;
+}
+
+enum RTDE_DATA_TYPE urx::Log_Reader::column_type(int col) const
+{
+    if (col < 0 || col >= (int)num_columns())
+        return NOT_FOUND;
+    return (enum RTDE_DATA_TYPE)cols_[col].scalar;
+}
+
+int urx::Log_Reader::column(const std::string& field, int component) const
+{
+    for (int c = 0; c < (int)num_columns(); c++)
+        if (strncmp(cols_[c].name, field.c_str(), sizeof(cols_[c].name)) == 0 &&
+            cols_[c].component == component)
+            return c;
+    return -1;
+}
+
+double urx::Log_Reader::value(std::size_t chunk, int col, std::size_t idx) const
+{
+    if (chunk >= num_chunks_ || col < 0 || col >= (int)num_columns() || idx >= chunk_frames(chunk))
+        return 0.0;
+    const unsigned char *p = cached_(chunk, col);
+    if (!p)
+        return 0.0;
+    p += idx * cols_[col].elem_size;
+    switch (cols_[col].scalar) {
+    case BOOL:
+    case UINT8:
+        return *p;
+    case UINT32:
+        return *(const uint32_t *)p;
+    case INT32:
+        return *(const int32_t *)p;
+    case UINT64:
+        return (double)*(const uint64_t *)p;
+    case DOUBLE:
+        return *(const double *)p;
+    default:
+        return 0.0;
+    }
+}
+
+bool urx::Log_Reader::seek(double t, std::size_t& chunk, std::size_t& idx) const
+{
+    // first chunk that reaches t, the chunk headers are the index
+    std::size_t lo = 0, hi = num_chunks_;
+    while (lo < hi) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (chunk_t_max(mid) < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == num_chunks_)
+        return false;
+
+    const double *ts = times(lo);
+    if (!ts)
+        return false;
+    std::size_t n = chunk_frames(lo);
+    std::size_t a = 0, b = n;
+    while (a < b) {
+        std::size_t mid = a + (b - a) / 2;
+        if (ts[mid] < t)
+            a = mid + 1;
+        else
+            b = mid;
+    }
+    chunk = lo;
+    idx = a;
+    return true;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/phase_lock.hpp>
+#include <cmath>
+
+void urx::Phase_Lock::reset()
+{
+    period_ns_ = 0;
+    pred_ns_ = 0;
+    arrivals_ = 0;
+    streak_ = 0;
+    offset_ns_ = 0;
+    sent_ = 0;
+    hits_ = 0;
+    misses_ = 0;
+}
+
+void urx::Phase_Lock::on_arrival(int64_t host_ns, double period)
+{
+    int64_t p = std::llround(period * 1e9);
+    if (p <= 0)
+        return;
+
+    // new (or changed) period, start over, initial guess is to send
+    // half a cycle after the frame arrived.
+    if (p != period_ns_ || arrivals_ == 0) {
+        period_ns_ = p;
+        pred_ns_ = host_ns;
+        arrivals_ = 1;
+        offset_ns_ = p / 2;
+        return;
+    }
+
+    // advance prediction the number of cycles since last frame (we
+    // may have lost some on the way).
+    int64_t cycles = std::llround((double)(host_ns - pred_ns_) / period_ns_);
+    if (cycles < 1)
+        cycles = 1;
+    pred_ns_ += cycles * period_ns_;
+
+    // Delays are positive, an early frame tells us more about the
+    // phase than a late one.
+    int64_t err = host_ns - pred_ns_;
+    if (err < 0)
+        pred_ns_ += err / 2;
+    else
+        pred_ns_ += err / 16;
+
+    if (arrivals_ < LOCK_FRAMES)
+        arrivals_++;
+}
+
+void urx::Phase_Lock::report(bool hit)
+{
+    int64_t offset = offset_ns_.load(std::memory_order_relaxed);
+    if (hit) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        if (++streak_ >= HIT_STREAK) {
+            streak_ = 0;
+            offset += period_ns_ / 64;
+        }
+    } else {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        streak_ = 0;
+        offset -= period_ns_ / 8;
+    }
+
+    // never past 90% of the cycle, that would collide with the next frame
+    if (offset < 0)
+        offset = 0;
+    else if (offset > period_ns_ * 9 / 10)
+        offset = period_ns_ * 9 / 10;
+    offset_ns_.store(offset, std::memory_order_relaxed);
+}
+
+urx::Phase_Lock_Stats urx::Phase_Lock::stats() const
+{
+    Phase_Lock_Stats s;
+    s.sent = sent_.load(std::memory_order_relaxed);
+    s.hits = hits_.load(std::memory_order_relaxed);
+    s.misses = misses_.load(std::memory_order_relaxed);
+    s.offset_ns = offset_ns_.load(std::memory_order_relaxed);
+    s.hit_rate = (s.hits + s.misses) > 0 ? (double)s.hits / (s.hits + s.misses) : 0.0;
+    return s;
+}
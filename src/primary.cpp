@@ -0,0 +1,236 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/primary.hpp>
+#include <algorithm>
+
+// Largest message we accept, anything above this means we have lost
+// track of the stream.
+constexpr std::size_t PRIMARY_MAX_MSG = 1 << 16;
+
+void urx::Primary_Parser::reset()
+{
+    partial_.clear();
+    {
+        std::lock_guard<std::mutex> lg(state_lock_);
+        memset(&state_, 0, sizeof(state_));
+        state_.robot_mode = -1;
+        state_.control_mode = -1;
+        state_.safety_mode = -1;
+        state_.program_state = -1;
+    }
+    bytes_ = 0;
+    messages_ = 0;
+    state_updates_ = 0;
+    errors_ = 0;
+    malformed_ = 0;
+}
+
+int urx::Primary_Parser::feed(const unsigned char *buf, std::size_t len)
+{
+    if (!buf || len == 0)
+        return 0;
+    bytes_.fetch_add(len, std::memory_order_relaxed);
+
+    // Complete an earlier partial message first, copying only what
+    // is needed.
+    int parsed = 0;
+    if (!partial_.empty()) {
+        if (partial_.size() < sizeof(primary_header)) {
+            std::size_t n = std::min(len, sizeof(primary_header) - partial_.size());
+            partial_.insert(partial_.end(), buf, buf + n);
+            buf += n;
+            len -= n;
+            if (partial_.size() < sizeof(primary_header))
+                return 0;
+        }
+        std::size_t sz = be32toh(((const struct primary_header *)partial_.data())->size);
+        if (sz < sizeof(primary_header) || sz > PRIMARY_MAX_MSG) {
+            malformed_.fetch_add(1, std::memory_order_relaxed);
+            partial_.clear();
+            return -1;
+        }
+        std::size_t n = std::min(len, sz - partial_.size());
+        partial_.insert(partial_.end(), buf, buf + n);
+        buf += n;
+        len -= n;
+        if (partial_.size() < sz)
+            return 0;
+
+        if (parse_message(partial_.data(), sz))
+            parsed++;
+        partial_.clear();
+    }
+
+    // decode directly from the caller's buffer
+    while (len >= sizeof(primary_header)) {
+        std::size_t sz = be32toh(((const struct primary_header *)buf)->size);
+        if (sz < sizeof(primary_header) || sz > PRIMARY_MAX_MSG) {
+            // no way of resynchronizing, the caller must reconnect
+            malformed_.fetch_add(1, std::memory_order_relaxed);
+            partial_.clear();
+            return -1;
+        }
+        if (sz > len)
+            break;
+        if (parse_message(buf, sz))
+            parsed++;
+        buf += sz;
+        len -= sz;
+    }
+
+    if (len > 0)
+        partial_.assign(buf, buf + len);
+    return parsed;
+}
+
+bool urx::Primary_Parser::parse_message(const unsigned char *msg, std::size_t len)
+{
+    if (!msg || len < sizeof(primary_header))
+        return false;
+
+    const struct primary_header *hdr = (const struct primary_header *)msg;
+    if (be32toh(hdr->size) != len) {
+        malformed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    messages_.fetch_add(1, std::memory_order_relaxed);
+
+    switch (hdr->type) {
+    case PRIMARY_ROBOT_STATE:
+        return parse_robot_state(msg, len);
+    case PRIMARY_ROBOT_MESSAGE:
+        return parse_robot_message(msg, len);
+    default:
+        // version, program state (variables) etc, not used
+        return true;
+    }
+}
+
+bool urx::Primary_Parser::parse_robot_state(const unsigned char *msg, std::size_t len)
+{
+    Primary_State next;
+    int prev_robot, prev_safety, prev_program;
+    {
+        std::lock_guard<std::mutex> lg(state_lock_);
+        next = state_;
+    }
+    prev_robot = next.robot_mode;
+    prev_safety = next.safety_mode;
+    prev_program = next.program_state;
+
+    std::size_t pos = sizeof(primary_header);
+    while (pos + sizeof(primary_package_header) <= len) {
+        const unsigned char *p = msg + pos;
+        std::size_t sz = be32toh(((const struct primary_package_header *)p)->size);
+        if (sz < sizeof(primary_package_header) || pos + sz > len) {
+            malformed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        switch (((const struct primary_package_header *)p)->type) {
+        case PRIMARY_ROBOT_MODE_DATA:
+            if (sz >= sizeof(primary_robot_mode_data)) {
+                const struct primary_robot_mode_data *rm = (const struct primary_robot_mode_data *)p;
+                next.ts = be64toh(rm->timestamp);
+                next.robot_mode = rm->robot_mode;
+                next.control_mode = rm->control_mode;
+                next.power_on = rm->robot_power_on;
+                next.emergency_stopped = rm->emergency_stopped;
+                next.protective_stopped = rm->protective_stopped;
+                next.speed_scaling = primary_double(rm->speed_scaling);
+                if (rm->program_paused)
+                    next.program_state = PROGRAM_PAUSED;
+                else if (rm->program_running)
+                    next.program_state = PROGRAM_RUNNING;
+                else
+                    next.program_state = PROGRAM_STOPPED;
+            }
+            break;
+        case PRIMARY_JOINT_DATA:
+            if (sz >= sizeof(primary_joint_data)) {
+                const struct primary_joint_data *jd = (const struct primary_joint_data *)p;
+                for (int i = 0; i < 6; i++) {
+                    next.q[i] = primary_double(jd->joint[i].q_actual);
+                    next.qd[i] = primary_double(jd->joint[i].qd_actual);
+                    next.current[i] = primary_float(jd->joint[i].i_actual);
+                    next.t_motor[i] = primary_float(jd->joint[i].t_motor);
+                    next.joint_mode[i] = jd->joint[i].joint_mode;
+                }
+            }
+            break;
+        case PRIMARY_MASTERBOARD_DATA:
+            if (sz >= sizeof(primary_masterboard_data))
+                next.safety_mode = ((const struct primary_masterboard_data *)p)->safety_mode;
+            break;
+        default:
+            break;
+        }
+        pos += sz;
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(state_lock_);
+        state_ = next;
+    }
+    state_updates_.fetch_add(1, std::memory_order_relaxed);
+
+    if (robot_mode_cb_ && next.robot_mode != prev_robot)
+        robot_mode_cb_(prev_robot, next.robot_mode);
+    if (safety_mode_cb_ && next.safety_mode != prev_safety)
+        safety_mode_cb_(prev_safety, next.safety_mode);
+    if (program_state_cb_ && next.program_state != prev_program)
+        program_state_cb_(prev_program, next.program_state);
+    return true;
+}
+
+bool urx::Primary_Parser::parse_robot_message(const unsigned char *msg, std::size_t len)
+{
+    if (len < sizeof(primary_robot_message))
+        return false;
+
+    const struct primary_robot_message *rm = (const struct primary_robot_message *)msg;
+    if (rm->message_type != PRIMARY_MESSAGE_ERROR_CODE)
+        return true;
+
+    if (len < sizeof(primary_error_code)) {
+        malformed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const struct primary_error_code *ec = (const struct primary_error_code *)msg;
+    errors_.fetch_add(1, std::memory_order_relaxed);
+    if (!error_cb_)
+        return true;
+
+    Primary_Error e;
+    e.ts = be64toh(rm->timestamp);
+    e.source = rm->source;
+    e.code = (int32_t)be32toh(ec->code);
+    e.argument = (int32_t)be32toh(ec->argument);
+    e.report_level = (int32_t)be32toh(ec->report_level);
+    e.text.assign((const char *)msg + sizeof(*ec), len - sizeof(*ec));
+    error_cb_(e);
+    return true;
+}
+
+urx::Primary_State urx::Primary_Parser::state()
+{
+    std::lock_guard<std::mutex> lg(state_lock_);
+    return state_;
+}
+
+urx::Primary_Stats urx::Primary_Parser::stats() const
+{
+    Primary_Stats s;
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.messages = messages_.load(std::memory_order_relaxed);
+    s.state_updates = state_updates_.load(std::memory_order_relaxed);
+    s.errors = errors_.load(std::memory_order_relaxed);
+    s.malformed = malformed_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/register_map.hpp>
+#include <iostream>
+#include <sstream>
+
+urx::Register_Map::Register_Map(int base, int bit_base, bool trajectory)
+{
+    for (int d = 0; d < 2; d++) {
+        next_[d][REG_INT] = base;
+        next_[d][REG_DOUBLE] = base;
+        next_[d][REG_BIT] = bit_base;
+    }
+    if (!trajectory)
+        return;
+
+    // see Trajectory_Stream for the layout
+    reserve(REG_IN, REG_INT, TRAJ_REG_BASE, 2);
+    reserve(REG_IN, REG_DOUBLE, TRAJ_REG_BASE, TRAJ_RING * TRAJ_SLOT_REGS);
+    reserve(REG_OUT, REG_INT, TRAJ_REG_BASE, 1);
+}
+
+bool urx::Register_Map::reserve(Reg_Dir dir, Reg_Type type, int first, std::size_t count)
+{
+    for (auto &c : channels_) {
+        if (c.dir == dir && c.type == type &&
+            c.first < first + (int)count && first < c.first + (int)c.count)
+            return false;
+    }
+    reserved_.push_back({dir, type, first, count});
+    return true;
+}
+
+int urx::Register_Map::limit(Reg_Type type) const
+{
+    switch (type) {
+    case REG_INT:
+        return NUM_INT_REGISTERS;
+    case REG_DOUBLE:
+        return NUM_DOUBLE_REGISTERS;
+    case REG_BIT:
+        return NUM_BIT_REGISTERS;
+    }
+    return 0;
+}
+
+const urx::Reg_Channel *urx::Register_Map::find(const std::string& name) const
+{
+    for (auto &c : channels_)
+        if (c.name == name)
+            return &c;
+    return nullptr;
+}
+
+int urx::Register_Map::add(const std::string& name, Reg_Dir dir, Reg_Type type, void *storage, std::size_t count)
+{
+    if (!storage || count == 0 || name.empty() || name == "register_map")
+        return -1;
+    if (find(name)) {
+        std::cout << __func__ << "() channel " << name << " already exists" << std::endl;
+        return -1;
+    }
+
+    // first free range after the last channel, skipping reservations
+    int first = next_[dir][type];
+    for (bool moved = true; moved; ) {
+        moved = false;
+        for (auto &r : reserved_) {
+            if (r.dir == dir && r.type == type &&
+                r.first < first + (int)count && first < r.first + (int)r.count) {
+                first = r.first + r.count;
+                moved = true;
+            }
+        }
+    }
+    if (first + (int)count > limit(type)) {
+        std::cout << __func__ << "() out of registers for " << name << std::endl;
+        return -1;
+    }
+
+    next_[dir][type] = first + count;
+    channels_.push_back({name, dir, type, first, count, storage});
+    return first;
+}
+
+bool urx::Register_Map::build(RTDE_Recipe *in, RTDE_Recipe *out)
+{
+    for (auto &c : channels_) {
+        RTDE_Recipe *r = c.dir == REG_IN ? in : out;
+        if (!r || r->dir_out() != (c.dir == REG_OUT))
+            return false;
+
+        std::string prefix = c.dir == REG_IN ? "input_" : "output_";
+        for (std::size_t i = 0; i < c.count; i++) {
+            int reg = c.first + i;
+            switch (c.type) {
+            case REG_INT:
+                if (!r->add_field(prefix + "int_register_" + std::to_string(reg), (int32_t *)c.storage + i))
+                    return false;
+                break;
+            case REG_DOUBLE:
+                if (!r->add_field(prefix + "double_register_" + std::to_string(reg), (double *)c.storage + i))
+                    return false;
+                break;
+            case REG_BIT:
+                if (reg >= 64) {
+                    if (!r->add_field(prefix + "bit_register_" + std::to_string(reg), (bool *)c.storage + i))
+                        return false;
+                    break;
+                }
+                if (r->add_bit_field(c.count > 1 ? c.name + "_" + std::to_string(i) : c.name,
+                                     (bool *)c.storage + i, 1, reg) != reg)
+                    return false;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+std::size_t urx::Register_Map::frame_bytes(Reg_Dir dir) const
+{
+    std::size_t bytes = 0;
+    bool words[2] = { false, false };
+    for (auto &c : channels_) {
+        if (c.dir != dir)
+            continue;
+        if (c.type == REG_INT)
+            bytes += 4 * c.count;
+        else if (c.type == REG_DOUBLE)
+            bytes += 8 * c.count;
+        else
+            for (std::size_t i = 0; i < c.count; i++)
+                if (c.first + i >= 64)
+                    bytes += 1;
+                else
+                    words[(c.first + i) / 32] = true;
+    }
+    return bytes + 4 * words[0] + 4 * words[1];
+}
+
+std::string urx::Register_Map::script_header() const
+{
+    static const char *type_names[] = { "integer", "float", "boolean" };
+    std::ostringstream ss;
+    ss << "# Register map (generated by urx::Register_Map)\n";
+    for (auto &c : channels_) {
+        ss << "# " << c.name << ": " << (c.dir == REG_IN ? "input" : "output")
+           << " " << type_names[c.type] << " " << c.first;
+        if (c.count > 1)
+            ss << ".." << c.first + c.count - 1;
+        ss << "\n";
+    }
+
+    for (auto &c : channels_) {
+        const char *t = type_names[c.type];
+        if (c.dir == REG_IN) {
+            ss << "def get_" << c.name << "():\n";
+            ss << "    return ";
+            if (c.count > 1)
+                ss << "[";
+            for (std::size_t i = 0; i < c.count; i++)
+                ss << (i ? ", " : "") << "read_input_" << t << "_register(" << c.first + i << ")";
+            if (c.count > 1)
+                ss << "]";
+            ss << "\n";
+        } else {
+            ss << "def set_" << c.name << "(v):\n";
+            if (c.count == 1)
+                ss << "    write_output_" << t << "_register(" << c.first << ", v)\n";
+            else
+                for (std::size_t i = 0; i < c.count; i++)
+                    ss << "    write_output_" << t << "_register(" << c.first + i << ", v[" << i << "])\n";
+        }
+        ss << "end\n";
+    }
+    return ss.str();
+}
+
+urx::Script_Params urx::Register_Map::params() const
+{
+    Script_Params p;
+    for (auto &c : channels_)
+        p[c.name] = std::to_string(c.first);
+    p["register_map"] = script_header();
+    return p;
+}
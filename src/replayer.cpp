@@ -0,0 +1,441 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/replayer.hpp>
+#include <urx/rtde_handler.hpp>
+#include <urx/decode_plan.hpp>
+#include <urx/header.hpp>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <poll.h>
+#include <time.h>
+#include <string.h>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+namespace {
+    // same order as enum RTDE_DATA_TYPE
+    const char *const type_names[] = {
+        "BOOL", "UINT8", "UINT32", "UINT64", "INT32", "DOUBLE", "VECTOR3D",
+        "VECTOR6D", "VECTOR6INT32", "VECTOR6UINT32", "STRING", "IN_USE", "NOT_FOUND"
+    };
+
+    int64_t now_ns()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000L + ts.tv_nsec;
+    }
+
+    std::vector<std::string> split(const char *names)
+    {
+        std::vector<std::string> res;
+        std::stringstream ss(names);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                res.push_back(item);
+        return res;
+    }
+
+    // host order column to big-endian payload
+    void put_be(unsigned char *dst, const unsigned char *src, int elem_size)
+    {
+        switch (elem_size) {
+        case 8: {
+            uint64_t v;
+            memcpy(&v, src, 8);
+            v = htobe64(v);
+            memcpy(dst, &v, 8);
+            break;
+        }
+        case 4: {
+            uint32_t v;
+            memcpy(&v, src, 4);
+            v = htobe32(v);
+            memcpy(dst, &v, 4);
+            break;
+        }
+        default:
+            *dst = *src;
+            break;
+        }
+    }
+}
+
+bool urx::Replayer::do_connect(bool nodelay)
+{
+    (void)nodelay;
+    if (connected_)
+        return true;
+    if (!reader_.open(remote_))
+        return false;
+
+    // the receive timestamp is optional in case the recording was
+    // trimmed by hand
+    rx_col_ = reader_.column("rx_ns");
+    if (rx_col_ >= 0 && reader_.column_type(rx_col_) != UINT64)
+        rx_col_ = -1;
+
+    chunk_ = 0;
+    idx_ = 0;
+    loaded_chunk_ = -1;
+    start_ns_ = 0;
+    streaming_ = false;
+    finished_ = reader_.num_frames() == 0;
+    connected_ = true;
+    return true;
+}
+
+void urx::Replayer::disconnect()
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    reader_.close();
+    fields_.clear();
+    chunk_cols_.clear();
+    pending_sz_ = 0;
+    streaming_ = false;
+    connected_ = false;
+}
+
+void urx::Replayer::reply(const void *msg, int sz)
+{
+    // pipelined requests are answered in order, in one read
+    if (pending_sz_ + sz > (int)sizeof(pending_))
+        return;
+    memcpy(pending_ + pending_sz_, msg, sz);
+    pending_sz_ += sz;
+}
+
+bool urx::Replayer::setup_outputs(const char *names)
+{
+    std::string types;
+    bool ok = true;
+    fields_.clear();
+    payload_sz_ = 0;
+    missing_ = 0;
+    for (const auto &name : split(names)) {
+        enum RTDE_DATA_TYPE type = output_name_to_type(name.c_str());
+        if (!types.empty())
+            types += ",";
+        types += type_names[type];
+        if (type == NOT_FOUND || type == STRING) {
+            ok = false;
+            continue;
+        }
+
+        enum RTDE_DATA_TYPE scalar;
+        int count;
+        Decode_Plan::split_type(type, scalar, count);
+        for (int c = 0; c < count; c++) {
+            int col = reader_.column(name, c);
+            if (col < 0 && name == "timestamp")
+                col = reader_.column("t");
+            if (col >= 0 && type_to_size(reader_.column_type(col)) != type_to_size(scalar))
+                col = -1;
+            if (col < 0)
+                missing_++;
+            fields_.push_back({payload_sz_, type_to_size(scalar), col});
+            payload_sz_ += type_to_size(scalar);
+        }
+    }
+    if (missing_)
+        std::cout << __func__ << "() " << missing_ << " output value(s) not in recording, sending 0" << std::endl;
+
+    unsigned char buf[2048];
+    struct rtde_control_package_resp *resp = (struct rtde_control_package_resp *)buf;
+    if (sizeof(*resp) + types.size() + 1 > sizeof(buf))
+        return false;
+    resp->hdr.type = RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS;
+    resp->hdr.size = htons(sizeof(*resp) + types.size());
+    resp->recipe_id = REPLAY_OUT_RECIPE_ID;
+    memcpy(rtde_control_package_resp_get_payload(resp), types.c_str(), types.size() + 1);
+    reply(buf, sizeof(*resp) + types.size());
+
+    // rebuild the columns for the new layout
+    loaded_chunk_ = -1;
+    return ok;
+}
+
+void urx::Replayer::setup_inputs(const char *names)
+{
+    std::string types;
+    for (const auto &name : split(names)) {
+        if (!types.empty())
+            types += ",";
+        types += type_names[input_name_to_type(name.c_str())];
+    }
+
+    unsigned char buf[2048];
+    struct rtde_control_package_resp *resp = (struct rtde_control_package_resp *)buf;
+    if (sizeof(*resp) + types.size() + 1 > sizeof(buf))
+        return;
+    resp->hdr.type = RTDE_CONTROL_PACKAGE_SETUP_INPUTS;
+    resp->hdr.size = htons(sizeof(*resp) + types.size());
+    resp->recipe_id = next_in_id_++ & 0xff;
+    memcpy(rtde_control_package_resp_get_payload(resp), types.c_str(), types.size() + 1);
+    reply(buf, sizeof(*resp) + types.size());
+}
+
+int urx::Replayer::do_send(void *sbuf, int ssz)
+{
+    if (!connected_ || !sbuf || ssz < (int)sizeof(struct rtde_header))
+        return -1;
+
+    struct rtde_header *hdr = (struct rtde_header *)sbuf;
+    if (hdr->type == RTDE_DATA_PACKAGE) {
+        inputs_++;
+        return ssz;
+    }
+
+    std::lock_guard<std::mutex> lg(lock_);
+    switch (hdr->type) {
+    case RTDE_REQUEST_PROTOCOL_VERSION: {
+        struct rtde_prot prot;
+        prot.hdr.type = RTDE_REQUEST_PROTOCOL_VERSION;
+        prot.hdr.size = htons(sizeof(prot.hdr) + sizeof(prot.payload.accepted));
+        prot.payload.accepted = 1;
+        reply(&prot, sizeof(prot.hdr) + sizeof(prot.payload.accepted));
+        break;
+    }
+    case RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS:
+        if ((std::size_t)ssz <= sizeof(struct rtde_control_package_out))
+            return -1;
+        setup_outputs(std::string((const char *)sbuf + sizeof(struct rtde_control_package_out),
+                                  ssz - sizeof(struct rtde_control_package_out)).c_str());
+        break;
+    case RTDE_CONTROL_PACKAGE_SETUP_INPUTS:
+        if ((std::size_t)ssz <= sizeof(struct rtde_control_package_in))
+            return -1;
+        setup_inputs(std::string((const char *)sbuf + sizeof(struct rtde_control_package_in),
+                                 ssz - sizeof(struct rtde_control_package_in)).c_str());
+        break;
+    case RTDE_CONTROL_PACKAGE_START:
+    case RTDE_CONTROL_PACKAGE_PAUSE: {
+        struct rtde_control_package_sp_resp resp;
+        resp.hdr.type = hdr->type;
+        resp.hdr.size = htons(sizeof(resp));
+        resp.accepted = hdr->type == RTDE_CONTROL_PACKAGE_PAUSE || !fields_.empty();
+        reply(&resp, sizeof(resp));
+        if (hdr->type == RTDE_CONTROL_PACKAGE_START && resp.accepted) {
+            start_ns_ = 0;
+            streaming_ = true;
+        } else {
+            streaming_ = false;
+        }
+        break;
+    }
+    default:
+        // text messages etc, nobody listening
+        break;
+    }
+    return ssz;
+}
+
+bool urx::Replayer::load_chunk(std::size_t chunk)
+{
+    std::size_t n = reader_.chunk_frames(chunk);
+    const double *t = reader_.times(chunk);
+    if (!t)
+        return false;
+    chunk_t_.assign(t, t + n);
+
+    chunk_rx_.resize(n);
+    if (rx_col_ < 0 || !reader_.read<uint64_t>(chunk, rx_col_, chunk_rx_.data()))
+        chunk_rx_.assign(n, 0);
+
+    chunk_cols_.resize(fields_.size());
+    for (std::size_t i = 0; i < fields_.size(); i++) {
+        const Replay_Field &f = fields_[i];
+        auto &dst = chunk_cols_[i];
+        dst.assign(n * f.elem_size, 0);
+        if (f.col < 0)
+            continue;
+
+        bool ok = false;
+        switch (reader_.column_type(f.col)) {
+        case DOUBLE:
+            ok = reader_.read<double>(chunk, f.col, (double *)dst.data());
+            break;
+        case UINT64:
+            ok = reader_.read<uint64_t>(chunk, f.col, (uint64_t *)dst.data());
+            break;
+        case UINT32:
+            ok = reader_.read<uint32_t>(chunk, f.col, (uint32_t *)dst.data());
+            break;
+        case INT32:
+            ok = reader_.read<int32_t>(chunk, f.col, (int32_t *)dst.data());
+            break;
+        default:
+            ok = reader_.read<uint8_t>(chunk, f.col, dst.data());
+            break;
+        }
+        if (!ok) {
+            std::cout << __func__ << "() failed reading column " << reader_.column_name(f.col)
+                      << " of chunk " << chunk << std::endl;
+            return false;
+        }
+    }
+    loaded_chunk_ = (long)chunk;
+    return true;
+}
+
+int urx::Replayer::wait_until(int64_t due_ns, int timeout_ms)
+{
+    int64_t wait_ns = due_ns - now_ns();
+    if (due_ns > 0 && wait_ns <= 0)
+        return 0;
+
+    // due_ns 0: nothing to wait for but the timeout (or cancel())
+    bool times_out = due_ns <= 0 || (timeout_ms >= 0 && wait_ns > (int64_t)timeout_ms * 1000000L);
+    if (times_out && timeout_ms >= 0)
+        wait_ns = (int64_t)timeout_ms * 1000000L;
+
+    struct pollfd pfd = { cancel_fd_, POLLIN, 0 };
+    struct timespec ts = { (time_t)(wait_ns / 1000000000L), (long)(wait_ns % 1000000000L) };
+    int rc = ppoll(&pfd, 1, times_out && timeout_ms < 0 ? NULL : &ts, NULL);
+    if (rc > 0)
+        return CON_CANCELLED;
+    if (rc < 0)
+        return -1;
+    return times_out ? CON_TIMEOUT : 0;
+}
+
+int urx::Replayer::next_frame(void *rbuf, int rsz, int timeout_ms, unsigned long *ts)
+{
+    // the recipe may be set up again (from do_send()) while waiting
+    // for the frame to become due, so only the wait is unlocked.
+    std::unique_lock<std::mutex> lk(lock_);
+    if (chunk_ >= reader_.num_chunks())
+        return 0;
+    if ((long)chunk_ != loaded_chunk_ && !load_chunk(chunk_))
+        return -1;
+
+    double t = chunk_t_[idx_];
+    int64_t now = now_ns();
+    if (!start_ns_) {
+        start_ns_ = now;
+        t0_ = t;
+    }
+    if (speed_ > 0.0) {
+        int64_t due = start_ns_ + (int64_t)((t - t0_) / speed_ * 1e9);
+        lk.unlock();
+        int rc = wait_until(due, timeout_ms);
+        if (rc < 0)
+            return rc;
+        now = now_ns();
+        lk.lock();
+        if (now - due > max_lag_ns_)
+            max_lag_ns_ = now - due;
+        if ((long)chunk_ != loaded_chunk_ && !load_chunk(chunk_))
+            return -1;
+    }
+
+    int sz = (int)sizeof(struct rtde_data_package) + payload_sz_;
+    if (sz > rsz)
+        return -1;
+
+    struct rtde_data_package *dp = (struct rtde_data_package *)rbuf;
+    rtde_data_package_init(dp, REPLAY_OUT_RECIPE_ID, payload_sz_);
+    unsigned char *payload = rtde_data_package_get_payload(dp);
+    for (std::size_t i = 0; i < fields_.size(); i++) {
+        const Replay_Field &f = fields_[i];
+        put_be(payload + f.offset, &chunk_cols_[i][idx_ * f.elem_size], f.elem_size);
+    }
+    if (ts)
+        *ts = chunk_rx_[idx_] ? chunk_rx_[idx_] : (unsigned long)now;
+
+    if (!frames_++)
+        first_ns_ = now;
+    last_ns_ = now;
+
+    if (++idx_ >= chunk_t_.size()) {
+        idx_ = 0;
+        if (++chunk_ >= reader_.num_chunks()) {
+            std::lock_guard<std::mutex> lg(done_lock_);
+            finished_ = true;
+            done_cv_.notify_all();
+        }
+    }
+    return sz;
+}
+
+int urx::Replayer::recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *ts)
+{
+    if (!connected_ || !rbuf)
+        return -1;
+
+    {
+        std::lock_guard<std::mutex> lg(lock_);
+        if (pending_sz_ > 0) {
+            int sz = pending_sz_ < rsz ? pending_sz_ : rsz;
+            memcpy(rbuf, pending_, sz);
+            pending_sz_ -= sz;
+            memmove(pending_, pending_ + sz, pending_sz_);
+            if (ts)
+                *ts = now_ns();
+            return sz;
+        }
+    }
+
+    if (streaming_) {
+        int rc = next_frame(rbuf, rsz, timeout_ms, ts);
+        if (rc != 0)
+            return rc;
+    }
+
+    // paused or played out, like a silent controller
+    return wait_until(0, timeout_ms);
+}
+
+uint64_t urx::Replayer::run(RTDE_Handler *rtdeh, uint64_t max_frames)
+{
+    if (!rtdeh || !connected_ || fields_.empty())
+        return 0;
+    if (!streaming_) {
+        start_ns_ = 0;
+        streaming_ = true;
+    }
+
+    unsigned char buf[2048];
+    uint64_t accepted = 0;
+    for (uint64_t n = 0; !max_frames || n < max_frames; n++) {
+        unsigned long ts;
+        if (next_frame(buf, sizeof(buf), CON_WAIT_FOREVER, &ts) <= 0)
+            break;
+
+        int64_t t0 = now_ns();
+        if (rtdeh->parse_incoming_data((struct rtde_data_package *)buf, ts))
+            accepted++;
+        decode_ns_ += now_ns() - t0;
+    }
+    return accepted;
+}
+
+bool urx::Replayer::wait_finished(int timeout_ms)
+{
+    std::unique_lock<std::mutex> lk(done_lock_);
+    if (timeout_ms < 0)
+        done_cv_.wait(lk, [this] { return finished_.load(); });
+    else
+        done_cv_.wait_for(lk, std::chrono::milliseconds(timeout_ms), [this] { return finished_.load(); });
+    return finished_;
+}
+
+urx::Replay_Stats urx::Replayer::stats() const
+{
+    Replay_Stats s;
+    s.frames = frames_;
+    s.inputs = inputs_;
+    s.missing = missing_;
+    s.wall_s = (last_ns_ - first_ns_) / 1e9;
+    s.fps = s.wall_s > 0.0 ? (s.frames - 1) / s.wall_s : 0.0;
+    s.decode_ns = s.frames ? (double)decode_ns_ / s.frames : 0.0;
+    s.max_lag_ms = max_lag_ns_ / 1e6;
+    return s;
+}
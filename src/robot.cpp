@@ -8,6 +8,7 @@
 #include <urx/robot.hpp>
 
 #include <future>   // For launching wait_for_q_ref() asynchronously
+#include <time.h>     // clock_nanosleep()
 
 #ifndef BOOST_LOG_DYN_LINK
 #define BOOST_LOG_DYN_LINK
@@ -16,6 +17,10 @@
 #include <boost/log/trivial.hpp>
 namespace logging = boost::log;
 
+// consecutive bad frames on an open socket before the session is
+// considered lost
+constexpr int RECONNECT_AFTER_FAILURES = 50;
+
 bool urx::Robot::init_output()
 {
     std::lock_guard<std::mutex> lg(bottleneck);
@@ -55,6 +60,10 @@ bool urx::Robot::init_output()
         return false;
     if (!out->add_field("target_moment", target_moment))
         return false;
+    if (traj_ && !traj_->add_output_fields(out))
+        return false;
+    if (hb_ && !hb_->add_output_fields(out))
+        return false;
 
     if (!rtdeh_->register_recipe(out)) {
         out->clear_fields();
@@ -81,6 +90,8 @@ bool urx::Robot::init_input()
     in->add_field("input_double_register_3", &set_qd[3]);
     in->add_field("input_double_register_4", &set_qd[4]);
     in->add_field("input_double_register_5", &set_qd[5]);
+    if (hb_)
+        hb_->add_input_fields(in);
 
     if (!rtdeh_->register_recipe(in)) {
         BOOST_LOG_TRIVIAL(error) << __func__ << "() Failed registering input recipe" << std::endl;
@@ -148,6 +159,10 @@ bool urx::Robot::init_output_TCP_pose()
         return false;
     if (!out->add_field("output_double_register_5", &q_ref_buf[5]))
         return false;
+    if (traj_ && !traj_->add_output_fields(out))
+        return false;
+    if (hb_ && !hb_->add_output_fields(out))
+        return false;
 
     if (!rtdeh_->register_recipe(out)) {
         out->clear_fields();
@@ -185,6 +200,8 @@ bool urx::Robot::init_input_TCP_pose()
     in->add_field("input_double_register_11", &TCP_pose_ref[3]);
     in->add_field("input_double_register_12", &TCP_pose_ref[4]);
     in->add_field("input_double_register_13", &TCP_pose_ref[5]);
+    if (hb_)
+        hb_->add_input_fields(in);
 
     if (!rtdeh_->register_recipe(in)) {
         BOOST_LOG_TRIVIAL(error) << __func__ << "() Failed registering input recipe" << std::endl;
@@ -195,9 +212,15 @@ bool urx::Robot::init_input_TCP_pose()
     return true;
 }
 
-bool urx::Robot::upload_script(const std::string& script)
+bool urx::Robot::upload_script(const std::string& script, const Script_Params& params)
 {
-    return urxh_->upload_script(script);
+    if (!hb_)
+        return urxh_->upload_script(script, params);
+
+    Script_Params p = params;
+    Script_Params hp = hb_->params();
+    p.insert(hp.begin(), hp.end());
+    return urxh_->upload_script(script, p);
 }
 
 bool urx::Robot::recv()
@@ -206,7 +229,9 @@ bool urx::Robot::recv()
         BOOST_LOG_TRIVIAL(error) << __func__ << "() FAILED receiving incoming frame from RTDE Handler" << std::endl;
         return false;
     }
+    auto rx = std::chrono::steady_clock::now();
 
+    Robot_State st;
     {
         std::lock_guard<std::mutex> lg(bottleneck);
         if (!out_initialized_) {
@@ -227,15 +252,276 @@ bool urx::Robot::recv()
             ur_state.jt[i]       = target_moment[i];
             ur_state.tcp_pose[i] = target_TCP_pose[i];
         }
+        // the stage ran on this thread, in rtdeh_->recv()
+        if (derived_ && derived_->attached())
+            ur_state.derived = derived_->values();
+        ur_state.extrapolated = false;
         updated_state_ = true;
-        
+        last_rx_ = rx;
+        num_extrapolated_ = 0;
+        if (on_state_)
+            st = ur_state;
+
         ts_log.push_back( std::tuple<std::chrono::microseconds, double>(ur_state.local_ts_us, ur_state.ur_ts) );
+
+        // refill the waypoint ring with whatever the controller consumed
+        if (traj_in_ && traj_->sync() && !rtdeh_->send(traj_in_->recipe_id()))
+            BOOST_LOG_TRIVIAL(error) << __func__ << "() FAILED sending trajectory update" << std::endl;
     }
 
     cv.notify_all();
+
+    // only the receiver writes to timestamp/out_seqnr, so no need for
+    // the lock here (and the gap-callback should not run with it held).
+    int64_t rx_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(rx.time_since_epoch()).count();
+    frame_mon_.update(timestamp, out_seqnr);
+    clock_.add(timestamp, rx_ns);
+
+    if (hb_)
+        hb_->check(rx_ns);
+    if (on_state_)
+        on_state_(st);
+
+    // last, an update from on_state_() makes this cycle
+    if (phase_lock_)
+        release_queued(rx_ns);
+    return true;
+}
+
+bool urx::Robot::enable_trajectory(Traj_Mode mode, std::size_t capacity)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (out_initialized_) {
+        BOOST_LOG_TRIVIAL(error) << __func__ << "() must be called before init_output()" << std::endl;
+        return false;
+    }
+    if (traj_)
+        return true;
+
+    traj_ = new Trajectory_Stream(capacity, mode);
+    return true;
+}
+
+bool urx::Robot::init_trajectory()
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (!traj_ || !out_initialized_) {
+        BOOST_LOG_TRIVIAL(error) << __func__ << "() enable_trajectory() and init_output() must be called first" << std::endl;
+        return false;
+    }
+    if (traj_in_)
+        return true;
+
+    RTDE_Recipe *r = new RTDE_Recipe();
+    r->dir_input();
+    if (!traj_->add_input_fields(r) || !rtdeh_->register_recipe(r)) {
+        BOOST_LOG_TRIVIAL(error) << __func__ << "() Failed registering trajectory recipe" << std::endl;
+        delete r;
+        return false;
+    }
+
+    // mode and (empty) ring is sent with the first frame after start()
+    traj_in_ = r;
+    return true;
+}
+
+const urx::History *urx::Robot::enable_history(std::size_t capacity)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (!out_initialized_ || running_) {
+        BOOST_LOG_TRIVIAL(error) << __func__ << "() must be called after init_output() and before start()" << std::endl;
+        return nullptr;
+    }
+    if (history_)
+        return history_;
+
+    history_ = new History(out, capacity);
+    out->add_sink(history_);
+    return history_;
+}
+
+urx::Derived_Signals *urx::Robot::enable_derived()
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (!out_initialized_ || running_) {
+        BOOST_LOG_TRIVIAL(error) << __func__ << "() must be called after init_output() and before start()" << std::endl;
+        return nullptr;
+    }
+    if (!derived_)
+        derived_ = new Derived_Signals(out);
+    return derived_;
+}
+
+bool urx::Robot::enable_heartbeat(int max_missed)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (out_initialized_ || in_initialized_) {
+        BOOST_LOG_TRIVIAL(error) << __func__ << "() must be called before init_output() and init_input()" << std::endl;
+        return false;
+    }
+    if (!hb_)
+        hb_ = new Heartbeat(max_missed);
+    return true;
+}
+
+urx::Heartbeat_Stats urx::Robot::heartbeat_stats() const
+{
+    if (!hb_)
+        return Heartbeat_Stats();
+    return hb_->stats();
+}
+
+bool urx::Robot::push_waypoint(double t, const std::vector<double>& q)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (!traj_ || q.size() != TRAJ_DOF)
+        return false;
+
+    Waypoint wp;
+    wp.t = t;
+    for (std::size_t i = 0; i < TRAJ_DOF; i++)
+        wp.q[i] = q[i];
+    return traj_->push(wp);
+}
+
+std::size_t urx::Robot::trajectory_space()
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    return traj_ ? traj_->space() : 0;
+}
+
+void urx::Robot::finish_trajectory()
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (traj_)
+        traj_->finish();
+}
+
+void urx::Robot::enable_phase_lock(bool enable)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    // phase_ belongs to the receiver, let it start over
+    phase_reset_ = true;
+    tx_outstanding_ = false;
+    phase_lock_ = enable;
+
+    // don't leave anything behind in the queue
+    if (!enable && tx_pending_) {
+        tx_pending_ = false;
+        send_input();
+    }
+}
+
+void urx::Robot::release_queued(int64_t rx_ns)
+{
+    if (phase_reset_.exchange(false))
+        phase_.reset();
+    double period = frame_mon_.period();
+    if (period > 0.0)
+        phase_.on_arrival(rx_ns, period);
+
+    {
+        std::lock_guard<std::mutex> lg(bottleneck);
+        if (tx_outstanding_) {
+            phase_.report(out_seqnr == tx_seqnr_);
+            tx_outstanding_ = false;
+        }
+    }
+
+    // The control loop is woken by the same frame, so its update is
+    // usually not queued yet: wait for the release point and look
+    // then. Until we know the phase, send as soon as possible.
+    if (phase_.locked()) {
+        int64_t rel = phase_.release_ns();
+        struct timespec ts = { (time_t)(rel / 1000000000), (long)(rel % 1000000000) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+
+    std::unique_lock<std::mutex> lk(bottleneck);
+    // a late update still beats waiting for the next frame, give the
+    // control loop until then
+    if (!tx_pending_ && phase_.locked()) {
+        auto next = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(phase_.next_arrival_ns()));
+        tx_cv_.wait_until(lk, next, [this] { return tx_pending_ || !running_; });
+    }
+    if (!tx_pending_)
+        return;
+
+    tx_pending_ = false;
+    if (!send_input())
+        return;
+
+    tx_seqnr_ = in_seqnr;
+    tx_outstanding_ = phase_.locked();
+    phase_.sent();
+}
+
+bool urx::Robot::send_input()
+{
+    if (hb_)
+        hb_->beat();
+    if (!rtdeh_->send(in->recipe_id())) {
+        std::cout << "Sending to handler using " << in->recipe_id() << " failed" << std::endl;
+        cmd = NO_COMMAND;
+        return false;
+    }
+    cmd = NO_COMMAND;
+    return true;
+}
+
+std::chrono::steady_clock::time_point urx::Robot::controller_to_host(double ur_ts) const
+{
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(clock_.to_host_ns(ur_ts)));
+}
+
+double urx::Robot::host_to_controller(std::chrono::steady_clock::time_point t) const
+{
+    return clock_.to_controller(std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+}
+
+void urx::Robot::set_gap_policy(Gap_Policy policy, int max_frames)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    gap_policy_ = policy;
+    max_extrapolated_ = max_frames;
+    num_extrapolated_ = 0;
+}
+
+bool urx::Robot::extrapolate(std::unique_lock<std::mutex>& lk, Robot_State& out)
+{
+    double period = frame_mon_.period();
+    if (!gap_policy_ || period <= 0.0 || num_extrapolated_ >= max_extrapolated_)
+        return false;
+
+    // Next frame is due one period after the last, give it half a cycle
+    // of slack before we consider it lost.
+    auto slack = std::chrono::duration<double>(period * (num_extrapolated_ + 1.5));
+    auto deadline = last_rx_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(slack);
+    if (cv.wait_until(lk, deadline, [&] { return updated_state_; }))
+        return false;
+
+    const Robot_State& last = num_extrapolated_ > 0 ? extrap_state_ : ur_state;
+    Robot_State next(last);
+    gap_policy_(last, next, period);
+    next.extrapolated = true;
+    extrap_state_ = next;
+    num_extrapolated_++;
+    frame_mon_.extrapolated();
+
+    out = next;
     return true;
 }
 
+void urx::extrapolate_linear(const Robot_State& last, Robot_State& next, double dt)
+{
+    next.ur_ts = last.ur_ts + dt;
+    next.local_ts_us = last.local_ts_us + std::chrono::microseconds((long)(dt * 1e6));
+    for (std::size_t i = 0; i < DOF; i++) {
+        next.jq[i]  = last.jq[i] + last.jqd[i] * dt + 0.5 * last.jqdd[i] * dt * dt;
+        next.jqd[i] = last.jqd[i] + last.jqdd[i] * dt;
+    }
+}
+
 urx::Robot_State urx::Robot::loc_state()
 {
     if (updated_state_)
@@ -254,6 +540,9 @@ urx::Robot_State urx::Robot::state(bool synchronous)
         bottleneck.unlock();
     } else {
         std::unique_lock<std::mutex> lk(bottleneck);
+        if (extrapolate(lk, out))
+            return out;
+
         auto timeout = std::chrono::milliseconds(100);
         if (!cv.wait_for(lk, timeout, [&] { return updated_state_; })) {
             BOOST_LOG_TRIVIAL(error) << __func__ << "() wait_for FAILED, did not receive a state-update" << std::endl;
@@ -326,6 +615,13 @@ bool urx::Robot::calculate_q_ref(std::vector<double>& new_pose)
         return false;
     }
 
+    // Only a single command per frame, so push out anything queued
+    // by update_w() first.
+    if (tx_pending_) {
+        tx_pending_ = false;
+        send_input();
+    }
+
     // ranges are nice, but we have registred the address of the
     // elements in set_qd with the recipe, so we cannot simply swap, we
     // need a per-element copy
@@ -395,14 +691,42 @@ bool urx::Robot::update_w(std::vector<double>& new_w)
 
     in_seqnr = ++last_seqnr;
     cmd = NEW_CONTROL_INPUT_COMMAND;
-    if (!rtdeh_->send(in->recipe_id())) {
-        std::cout << "Sending to handler using " << in->recipe_id() << " failed" << std::endl;
+
+    // receiver will pick it up and send it at the right time
+    if (phase_lock_) {
+        tx_pending_ = true;
+        tx_cv_.notify_one();
+        return true;
+    }
+    return send_input();
+}
+
+bool urx::Robot::stage_w(const std::vector<double>& new_w)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (new_w.size() != DOF || !in_initialized_) {
+        BOOST_LOG_TRIVIAL(error) << __func__ << "() wrong size or init_input() not completed" << std::endl;
         return false;
     }
 
+    for (std::size_t i = 0; i < DOF; ++i)
+        set_qd[i] = new_w[i];
+    in_seqnr = ++last_seqnr;
+    cmd = NEW_CONTROL_INPUT_COMMAND;
+    if (hb_)
+        hb_->beat();
+    tx_staged_ = rtdeh_->prepare(in->recipe_id());
     cmd = NO_COMMAND;
+    return tx_staged_;
+}
 
-    return true;
+bool urx::Robot::release_w()
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (!tx_staged_)
+        return false;
+    tx_staged_ = false;
+    return rtdeh_->send_prepared(in->recipe_id());
 }
 
 bool urx::Robot::stop()
@@ -410,14 +734,19 @@ bool urx::Robot::stop()
     if (!running_)
         return false;
 
+    tx_pending_ = false;
     in_seqnr = ++last_seqnr;
     cmd = STOP_COMMAND;
     if (!rtdeh_->send(in->recipe_id())) {
         std::cout << "Sending STOP command to handler using " << in->recipe_id() << " failed" << std::endl;
     }
+    // do not wait for the next frame (that may never come) to notice
     running_ = false;
+    rtdeh_->cancel_recv();
     receiver.join();
+    rtdeh_->resume_recv();
     rtdeh_->stop();
+    urxh_->stop_reader();
     return true;
 }
 
@@ -430,6 +759,10 @@ bool urx::Robot::start_(Func f)
     if (!f())
         return false;
 
+    // drain robot-state from the primary interface, or the controller
+    // will eventually consider the connection stale.
+    urxh_->start_reader();
+
     // start receiving data
     rtdeh_->start();
     receiver = std::thread(&urx::Robot::run, this);
@@ -476,11 +809,48 @@ void urx::Robot::run()
     if (!running_)
         running_ = true;
 
+    // requests from other threads now leave the stream to us
+    rtdeh_->set_receiver(true);
     start_cv.notify_all();
 
+    int failures = 0;
     while (running_) {
         if (dut_)
             usleep(2000);
-        recv();
+        if (recv()) {
+            failures = 0;
+            continue;
+        }
+
+        // A closed or silent socket is reconnected at once, a
+        // connection that only delivers garbage is given a few frames
+        // to settle.
+        if (!reconnect_ || !running_)
+            continue;
+        if (rtdeh_->is_connected() && !rtdeh_->timed_out() && ++failures < RECONNECT_AFTER_FAILURES)
+            continue;
+        failures = 0;
+
+        // state() and update_w() keep working (on stale data) while
+        // we are away, so do not hold the lock here.
+        BOOST_LOG_TRIVIAL(warning) << __func__ << "() RTDE session lost, reconnecting" << std::endl;
+        if (!rtdeh_->reconnect(reconnect_policy_, [this] { return running_.load(); }))
+            continue;
+
+        // controller may have restarted, relearn time and phase
+        std::lock_guard<std::mutex> lg(bottleneck);
+        frame_mon_.reset();
+        clock_.reset();
+        phase_.reset();
+        tx_outstanding_ = false;
+        auto rs = rtdeh_->recovery_stats();
+        BOOST_LOG_TRIVIAL(info) << __func__ << "() RTDE session restored in " << rs.last_ms << " ms" << std::endl;
     }
+    rtdeh_->set_receiver(false);
+}
+
+void urx::Robot::set_reconnect(bool enable, const Reconnect_Policy& policy)
+{
+    reconnect_ = enable;
+    reconnect_policy_ = policy;
 }
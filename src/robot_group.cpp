@@ -0,0 +1,134 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/robot_group.hpp>
+#include <time.h>
+#include <chrono>
+
+namespace {
+    int64_t now_ns()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000L + ts.tv_nsec;
+    }
+}
+
+urx::Robot_Group::Robot_Group(double period) :
+    period_(period),
+    last_spread_ns_(0),
+    stats_({0, 0, 0, 0.0, 0, 0, 0, 0.0})
+{
+}
+
+std::size_t urx::Robot_Group::add(Robot *robot)
+{
+    arms_.push_back(robot);
+    staged_.push_back(false);
+    return arms_.size() - 1;
+}
+
+int64_t urx::Robot_Group::host_ns(std::size_t idx, const Robot_State& s) const
+{
+    if (!arms_[idx]->clock_sync().valid())
+        return 0;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        arms_[idx]->controller_to_host(s.ur_ts).time_since_epoch()).count();
+}
+
+int64_t urx::Robot_Group::skew(const std::vector<int64_t>& host, std::size_t& lagging) const
+{
+    int64_t lo = 0;
+    int64_t hi = 0;
+    lagging = 0;
+    for (std::size_t i = 0; i < host.size(); i++) {
+        if (!host[i])
+            return -1;
+        if (!i || host[i] < lo) {
+            lo = host[i];
+            lagging = i;
+        }
+        if (!i || host[i] > hi)
+            hi = host[i];
+    }
+    return hi - lo;
+}
+
+bool urx::Robot_Group::wait(Group_Cycle& cycle)
+{
+    std::size_t n = arms_.size();
+    cycle.states.resize(n);
+    cycle.host_ns.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        cycle.states[i] = arms_[i]->state();
+        if (cycle.states[i].ur_ts <= 0.0)
+            return false;
+        cycle.host_ns[i] = host_ns(i, cycle.states[i]);
+    }
+
+    // An arm that is a cycle behind gets to catch up, the others
+    // already hold their newest frame.
+    std::size_t lagging;
+    int64_t sk = skew(cycle.host_ns, lagging);
+    int64_t half = (int64_t)(period_ * 0.5e9);
+    for (int a = 0; sk > half && a < GROUP_ALIGN_ATTEMPTS; a++) {
+        Robot_State s = arms_[lagging]->state();
+        if (s.ur_ts <= cycle.states[lagging].ur_ts)
+            break;
+        cycle.states[lagging] = s;
+        cycle.host_ns[lagging] = host_ns(lagging, s);
+        sk = skew(cycle.host_ns, lagging);
+    }
+    cycle.skew_ns = sk;
+    cycle.release_spread_ns = last_spread_ns_;
+
+    if (sk >= 0) {
+        stats_.cycles++;
+        if (sk > half)
+            stats_.misaligned++;
+        if (sk > stats_.max_skew_ns)
+            stats_.max_skew_ns = sk;
+        stats_.mean_skew_ns += (sk - stats_.mean_skew_ns) / stats_.cycles;
+    }
+    return true;
+}
+
+bool urx::Robot_Group::stage(std::size_t idx, const std::vector<double>& new_w)
+{
+    if (idx >= arms_.size())
+        return false;
+    staged_[idx] = arms_[idx]->stage_w(new_w);
+    return staged_[idx];
+}
+
+bool urx::Robot_Group::commit()
+{
+    bool ok = true;
+    int64_t first = 0;
+    int64_t last = 0;
+    for (std::size_t i = 0; i < arms_.size(); i++) {
+        if (!staged_[i])
+            continue;
+        staged_[i] = false;
+        if (!arms_[i]->release_w()) {
+            stats_.failed_releases++;
+            ok = false;
+        }
+        last = now_ns();
+        if (!first)
+            first = last;
+    }
+    if (!first)
+        return ok;
+
+    last_spread_ns_ = last - first;
+    stats_.commits++;
+    if (last_spread_ns_ > stats_.max_spread_ns)
+        stats_.max_spread_ns = last_spread_ns_;
+    stats_.mean_spread_ns += (last_spread_ns_ - stats_.mean_spread_ns) / stats_.commits;
+    return ok;
+}
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <sched.h>
 #include <linux/sched.h>
+#include <algorithm>
 
 struct sched_attr {
         uint32_t size;
@@ -28,20 +29,45 @@ struct sched_attr {
         uint64_t sched_period;
 };
 
+namespace {
+    // a request that never made it to CON
+    urx::RTDE_Request rejected()
+    {
+        std::promise<bool> p;
+        p.set_value(false);
+        return {0, p.get_future()};
+    }
+
+    // replies are at least as long as the struct describing them
+    template<typename T>
+    T copy_reply(const unsigned char *reply, int len)
+    {
+        T t;
+        memset(&t, 0, sizeof(t));
+        memcpy(&t, reply, std::min((int)sizeof(t), len));
+        return t;
+    }
+}
+
 bool urx::RTDE_Handler::set_version()
+{
+    RTDE_Request req = set_version_async();
+    return wait(req);
+}
+
+urx::RTDE_Request urx::RTDE_Handler::set_version_async()
 {
     // Construct frame for library default version
     struct rtde_prot prot;
     if (!rtde_mkreq_prot_version(&prot)) {
         std::cout << "Creating version request FAILED." << std::endl;
-        return false;
+        return rejected();
     }
 
-    if (con_->do_send_recv(&prot, ntohs(prot.hdr.size), buffer_, 1024) < 0) {
-        std::cout << "do_sending request FAILED" << std::endl;
-        return false;
-    }
-    return rtde_parse_prot_version((struct rtde_prot *)buffer_);
+    return submit_(&prot, ntohs(prot.hdr.size), [](const unsigned char *reply, int len) {
+        struct rtde_prot resp = copy_reply<struct rtde_prot>(reply, len);
+        return rtde_parse_prot_version(&resp);
+    });
 }
 
 bool urx::RTDE_Handler::get_ur_version(struct rtde_ur_ver_payload& urver)
@@ -52,15 +78,17 @@ bool urx::RTDE_Handler::get_ur_version(struct rtde_ur_ver_payload& urver)
         std::cout << "Creating URControl version query FAILED." << std::endl;
         return false;
     }
-    if (con_->do_send_recv(&header, ntohs(header.size), buffer_, 1024) < 0) {
-        std::cout << "do_sending request FAILED" << std::endl;
-        return false;
-    }
 
-    if (!rtde_parse_urctrl_resp((struct rtde_ur_ver *)buffer_, &urver)) {
-        std::cout << "Parsing returned UR-version FAILED" << std::endl;
+    RTDE_Request req = submit_(&header, ntohs(header.size), [&urver](const unsigned char *reply, int len) {
+        struct rtde_ur_ver resp = copy_reply<struct rtde_ur_ver>(reply, len);
+        if (!rtde_parse_urctrl_resp(&resp, &urver)) {
+            std::cout << "Parsing returned UR-version FAILED" << std::endl;
+            return false;
+        }
+        return true;
+    });
+    if (!wait(req))
         return false;
-    }
 
     return (urver.major > 0 && urver.major < 7);
 }
@@ -81,79 +109,290 @@ bool  urx::RTDE_Handler::send_emerg_msg(const std::string& msg)
 }
 
 bool urx::RTDE_Handler::register_recipe(urx::RTDE_Recipe *r)
+{
+    RTDE_Request req = register_recipe_async(r);
+    return wait(req);
+}
+
+urx::RTDE_Request urx::RTDE_Handler::register_recipe_async(urx::RTDE_Recipe *r)
 {
     if (!r)
-        return false;
+        return rejected();
 
     struct rtde_header *hdr = r->GetMsg();
     if (!hdr)
-        return false;
+        return rejected();
 
-    auto sendcode = con_->do_send_recv(hdr, ntohs(hdr->size), buffer_, 2048);
-    if (sendcode < 0)
-        return false;
+    return submit_(hdr, ntohs(hdr->size), [this, r](const unsigned char *reply, int len) {
+        return registered_(r, reply, len);
+    });
+}
 
+bool urx::RTDE_Handler::registered_(urx::RTDE_Recipe *r, const unsigned char *reply, int len)
+{
     // Make sure buffer is 0-terminated
-    buffer_[sendcode < 2048 ? sendcode: 2047] = 0x00;
+    unsigned char resp[2048];
+    len = std::min(len, (int)sizeof(resp) - 1);
+    memcpy(resp, reply, len);
+    resp[len] = 0x00;
 
-    if (!r->register_response((struct rtde_control_package_resp *)buffer_))
+    if (!r->register_response((struct rtde_control_package_resp *)resp))
         return false;
 
+    // runs on whichever thread dispatches the reply, keep send() and
+    // reregister() out
+    std::lock_guard<std::mutex> lg(bottleneck);
+
     if (r->dir_out()) {
-        if (out != nullptr)
+        bool swapping;
+        {
+            std::lock_guard<std::mutex> sl(swap_lock_);
+            swapping = r == gap_next_;
+        }
+        if (out != nullptr && out != r && !swapping)
             std::cout << "WARNING: adding another Out-recipe (we can only have *one* outgoing Recipe!)" << std::endl;
         out = r;
-    } else {
-        recipes_in.insert({r->recipe_id(), r});
+        return true;
+    }
 
-        // Clearing input registers on robot controller, assuming variables in recipe are initialized properly. If not done, it may read stuff from previous time robot was run.
-        if (!send(r->recipe_id())) {
-            std::cout << "Initial sending to handler using " << r->recipe_id() << " failed" << std::endl;
-            return false;
-        }
+    {
+        std::lock_guard<std::mutex> lk(recipes_lock_);
+        recipes_in[r->recipe_id()] = r;
     }
 
+    // remember for reconnect()
+    if (std::find(registered_in_.begin(), registered_in_.end(), r) == registered_in_.end())
+        registered_in_.push_back(r);
+
+    // Clearing input registers on robot controller, assuming variables in recipe are initialized properly. If not done, it may read stuff from previous time robot was run.
+    if (!send_(r->recipe_id())) {
+        std::cout << "Initial sending to handler using " << r->recipe_id() << " failed" << std::endl;
+        return false;
+    }
     return true;
 }
 
 bool
 urx::RTDE_Handler::start()
+{
+    RTDE_Request req = start_async();
+    return wait(req);
+}
+
+urx::RTDE_Request urx::RTDE_Handler::start_async()
 {
     struct rtde_header cp;
     rtde_control_package_start(&cp);
-    struct rtde_control_package_sp_resp *resp = (struct rtde_control_package_sp_resp *)buffer_;
-    int sendcode = con_->do_send_recv(&cp, ntohs(cp.size), (void *)resp, (int)sizeof(*resp));
-
-    if (sendcode < 0)
-        return false;
+    return submit_(&cp, ntohs(cp.size), [this](const unsigned char *reply, int len) {
+        auto resp = copy_reply<struct rtde_control_package_sp_resp>(reply, len);
+        if (!rtde_control_package_sp_resp_validate(&resp, true))
+            return false;
 
-    if (!rtde_control_package_sp_resp_validate(resp, true))
-        return false;
+        streaming_ = resp.accepted;
 
-    return resp->accepted;
+        // data frames are the bulk of the stream from here on, do not
+        // wake up for less. Text messages and control replies are
+        // shorter and sit in the socket until the next frame arrives.
+        if (streaming_ && out && con_->profile().rcvlowat_frame)
+            con_->set_rcvlowat(sizeof(struct rtde_data_package) + out->expected_bytes());
+        return (bool)resp.accepted;
+    });
 }
 
 bool
 urx::RTDE_Handler::stop()
 {
-    usleep(10000);
+    RTDE_Request req = stop_async();
+    return wait(req);
+}
 
+urx::RTDE_Request urx::RTDE_Handler::stop_async()
+{
+    // the reply is smaller than a frame
+    streaming_ = false;
+    if (con_->profile().rcvlowat_frame)
+        con_->set_rcvlowat(1);
+
+    // data packages still in flight are parsed as usual, the reply
+    // is matched whenever it shows up.
     struct rtde_header cp;
     rtde_control_package_stop(&cp);
-    struct rtde_control_package_sp_resp *resp = (struct rtde_control_package_sp_resp *)buffer_;
-    int sendcode = con_->do_send_recv(&cp, ntohs(cp.size), (void *)resp, (int)sizeof(*resp));
+    return submit_(&cp, ntohs(cp.size), [](const unsigned char *reply, int len) {
+        auto resp = copy_reply<struct rtde_control_package_sp_resp>(reply, len);
+        return rtde_control_package_sp_resp_validate(&resp, false) && resp.accepted;
+    });
+}
 
-    if (sendcode < 0)
+bool urx::RTDE_Handler::swap_input(int recipe_id, urx::RTDE_Recipe *next)
+{
+    if (!next || next->dir_out() || !in_recipe_(recipe_id))
         return false;
-    else if (!rtde_control_package_sp_resp_validate(resp, true))
+
+    auto t0 = std::chrono::steady_clock::now();
+    RTDE_Request req = register_recipe_async(next);
+    if (!wait(req))
         return false;
-    return resp->accepted;
+
+    {
+        std::lock_guard<std::mutex> lg(bottleneck);
+        std::lock_guard<std::mutex> lk(recipes_lock_);
+        RTDE_Recipe *old = recipes_in[recipe_id];
+        for (auto &e : recipes_in)
+            if (e.second == old)
+                e.second = next;
+        registered_in_.erase(std::remove(registered_in_.begin(), registered_in_.end(), old), registered_in_.end());
+    }
+
+    std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+    std::lock_guard<std::mutex> sl(swap_lock_);
+    swap_.input_swaps++;
+    swap_.last_input_ms = dt.count();
+    return true;
+}
+
+bool urx::RTDE_Handler::swap_output(urx::RTDE_Recipe *next)
+{
+    if (!next || !next->dir_out())
+        return false;
+
+    bool restart = streaming_;
+    if (restart) {
+        std::lock_guard<std::mutex> sl(swap_lock_);
+        gap_next_ = next;
+        gap_last_ = std::chrono::steady_clock::now();
+        gap_watch_ = true;
+    }
+
+    std::vector<RTDE_Request> reqs;
+    if (restart)
+        reqs.push_back(stop_async());
+    reqs.push_back(register_recipe_async(next));
+    if (restart)
+        reqs.push_back(start_async());
+    bool ok = wait_all(reqs);
+
+    // the gap is closed by the first frame of the new recipe
+    std::lock_guard<std::mutex> sl(swap_lock_);
+    if (!ok || out != next) {
+        gap_watch_ = false;
+        gap_next_ = nullptr;
+    }
+    if (ok && out == next)
+        swap_.output_swaps++;
+    return ok && out == next;
+}
+
+void urx::RTDE_Handler::note_frame_()
+{
+    std::lock_guard<std::mutex> sl(swap_lock_);
+    auto now = std::chrono::steady_clock::now();
+    if (!gap_watch_ || out != gap_next_) {
+        gap_last_ = now;
+        return;
+    }
+    std::chrono::duration<double, std::milli> gap = now - gap_last_;
+    swap_.last_gap_ms = gap.count();
+    if (gap.count() > swap_.max_gap_ms)
+        swap_.max_gap_ms = gap.count();
+    gap_watch_ = false;
+    gap_next_ = nullptr;
+}
+
+urx::Swap_Stats urx::RTDE_Handler::swap_stats() const
+{
+    std::lock_guard<std::mutex> sl(swap_lock_);
+    return swap_;
+}
+
+bool urx::RTDE_Handler::reregister(bool restart)
+{
+    // ids are handed out by the controller, so they may change
+    {
+        std::lock_guard<std::mutex> lk(recipes_lock_);
+        recipes_in.clear();
+    }
+
+    std::vector<RTDE_Recipe *> ins;
+    RTDE_Recipe *o;
+    {
+        std::lock_guard<std::mutex> lg(bottleneck);
+        ins = registered_in_;
+        o = out;
+    }
+
+    // all in one go, CON answers in order
+    std::vector<RTDE_Request> reqs;
+    reqs.push_back(set_version_async());
+    if (o)
+        reqs.push_back(register_recipe_async(o));
+    for (auto &r : ins)
+        reqs.push_back(register_recipe_async(r));
+    if (restart)
+        reqs.push_back(start_async());
+    return wait_all(reqs);
+}
+
+bool urx::RTDE_Handler::reconnect(const Reconnect_Policy& policy, std::function<bool()> keep_going)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    auto backoff = policy.initial_backoff;
+    bool restart = streaming_;
+    recovery_.losses++;
+
+    for (int attempt = 1; ; attempt++) {
+        if (keep_going && !keep_going())
+            return false;
+
+        recovery_.attempts++;
+        {
+            // any send() in progress finishes on the old socket, the
+            // next ones fail fast until the recipes are registered again
+            std::lock_guard<std::mutex> lg(bottleneck);
+            reregistering_ = true;
+        }
+        bool connected = con_->reconnect();
+        if (connected) {
+            // a new session does not answer the old one's requests,
+            // fail them before they take the replies to reregister()
+            std::lock_guard<std::mutex> pl(pending_lock_);
+            for (auto &p : pending_)
+                if (!p->dropped)
+                    p->result.set_value(false);
+            pending_.clear();
+        }
+        bool ok = connected && reregister(restart);
+        {
+            std::lock_guard<std::mutex> lg(bottleneck);
+            reregistering_ = false;
+        }
+        if (ok) {
+            std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+            recovery_.recoveries++;
+            recovery_.last_ms = dt.count();
+            if (dt.count() > recovery_.max_ms)
+                recovery_.max_ms = dt.count();
+            std::cout << __func__ << "() session restored after " << dt.count() << " ms ("
+                      << attempt << " attempt(s))" << std::endl;
+            return true;
+        }
+
+        if (policy.max_attempts > 0 && attempt >= policy.max_attempts)
+            break;
+
+        // first retry comes quickly, then back off to not hammer a
+        // controller that is still booting.
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min(backoff * 2, policy.max_backoff);
+    }
+
+    con_->disconnect();
+    return false;
 }
 
 bool
 urx::RTDE_Handler::parse_incoming_data(struct rtde_data_package* data, unsigned long rx_ts)
 {
-    if (!rtde_parse_data_package(data))
+    if (!rtde_parse_data_package(data) || !out)
         return false;
 
     int rid = data->recipe_id;
@@ -169,38 +408,307 @@ urx::RTDE_Handler::parse_incoming_data(struct rtde_data_package* data, unsigned
     return out->parse(rtde_data_package_get_payload(data), rx_ts);
 }
 
-//              FIXME
-// this assumes all incoming data is data-pacakges that we can
-// parse, where as we can, in fact, receive other data as well.
-// Once fixed, update doc in .hpp
-bool urx::RTDE_Handler::recv()
+namespace {
+    bool is_setup_reply(uint8_t type)
+    {
+        return type == RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS || type == RTDE_CONTROL_PACKAGE_SETUP_INPUTS;
+    }
+}
+
+int urx::RTDE_Handler::dispatch_(struct rtde_header *hdr, unsigned long rx_ts)
+{
+    switch (hdr->type) {
+    case RTDE_DATA_PACKAGE:
+        rx_data_.fetch_add(1, std::memory_order_relaxed);
+        if (!parse_incoming_data((struct rtde_data_package *)hdr, rx_ts))
+            return 0;
+        if (gap_watch_.load(std::memory_order_relaxed))
+            note_frame_();
+        return 1;
+
+    case RTDE_TEXT_MESSAGE: {
+        RTDE_Text_Message msg;
+        if (!rtde_parse_text_message(hdr, rx_ts, msg))
+            rx_malformed_.fetch_add(1, std::memory_order_relaxed);
+        else if (text_.push(msg))
+            rx_text_.fetch_add(1, std::memory_order_relaxed);
+        break;
+    }
+
+    case RTDE_REQUEST_PROTOCOL_VERSION:
+    case RTDE_GET_URCONTROL_VERSION:
+    case RTDE_CONTROL_PACKAGE_SETUP_OUTPUTS:
+    case RTDE_CONTROL_PACKAGE_SETUP_INPUTS:
+    case RTDE_CONTROL_PACKAGE_START:
+    case RTDE_CONTROL_PACKAGE_PAUSE: {
+        // a recipe is answered with either setup type, like
+        // rtde_control_package_resp_validate() accepts
+        std::unique_ptr<Pending_Request> p;
+        {
+            std::lock_guard<std::mutex> lk(pending_lock_);
+            for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+                if ((*it)->type == hdr->type || (is_setup_reply((*it)->type) && is_setup_reply(hdr->type))) {
+                    p = std::move(*it);
+                    pending_.erase(it);
+                    break;
+                }
+            }
+        }
+        if (!p || p->dropped) {
+            // nobody asked, or the request has already given up
+            rx_unexpected_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        rx_replies_.fetch_add(1, std::memory_order_relaxed);
+        p->result.set_value(p->done((const unsigned char *)hdr, ntohs(hdr->size)));
+        break;
+    }
+
+    default:
+        rx_unexpected_.fetch_add(1, std::memory_order_relaxed);
+        break;
+    }
+    return -1;
+}
+
+int urx::RTDE_Handler::read_(int timeout_ms, bool& parsed)
 {
-    unsigned long ts;
-    int rcode = con_->do_recv(buffer_, 2048, &ts);
-    if (rcode < 0) {
-        std::cout << "do_recv() failed, code=" << rcode << ", buffer_=" << buffer_ << std::endl;
+    parsed = false;
+    unsigned long ts = 0;
+    int fill = con_->recv_for(buffer_, sizeof(buffer_), timeout_ms, &ts);
+    if (fill < 0)
+        return fill;
+
+    // A read holds whatever the stream had, zero or more packages and
+    // possibly the start of the next one.
+    int data = 0;
+    int off = 0;
+    while (off < fill) {
+        int avail = fill - off;
+        struct rtde_header *hdr = (struct rtde_header *)(buffer_ + off);
+        int size = avail >= (int)sizeof(*hdr) ? ntohs(hdr->size) : 0;
+        if (avail >= (int)sizeof(*hdr) && (size < (int)sizeof(*hdr) || size > (int)sizeof(buffer_))) {
+            rx_malformed_.fetch_add(1, std::memory_order_relaxed);
+            std::cout << __func__ << "() invalid package size " << size << ", dropping " << avail << " bytes" << std::endl;
+            return -1;
+        }
+
+        if (avail < (int)sizeof(*hdr) || size > avail) {
+            // the rest is on its way
+            memmove(buffer_, buffer_ + off, avail);
+            off = 0;
+            fill = avail;
+            int rcode = con_->recv_for(buffer_ + fill, sizeof(buffer_) - fill, con_->recv_timeout(), &ts);
+            if (rcode <= 0)
+                return rcode < 0 ? rcode : -1;
+            fill += rcode;
+            continue;
+        }
+
+        int res = dispatch_(hdr, ts);
+        if (res >= 0) {
+            data++;
+            parsed = parsed || res > 0;
+        }
+        off += size;
+    }
+    return data;
+}
+
+urx::RTDE_Request urx::RTDE_Handler::submit_(void *req, int sz, std::function<bool(const unsigned char *, int)> done)
+{
+    auto p = std::unique_ptr<Pending_Request>(new Pending_Request());
+    p->type = ((struct rtde_header *)req)->type;
+    p->dropped = false;
+    p->done = done;
+    RTDE_Request r;
+    r.result = p->result.get_future();
+
+    // queued in the order it goes on the wire
+    std::lock_guard<std::mutex> sl(send_lock_);
+    {
+        std::lock_guard<std::mutex> lk(pending_lock_);
+        p->id = r.id = ++next_request_;
+        pending_.push_back(std::move(p));
+    }
+    if (con_->do_send(req, sz) < 0)
+        drop_(r.id, false);
+    return r;
+}
+
+void urx::RTDE_Handler::drop_(uint64_t id, bool sent)
+{
+    std::lock_guard<std::mutex> lk(pending_lock_);
+    for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+        if ((*it)->id == id && !(*it)->dropped) {
+            (*it)->result.set_value(false);
+            // CON still answers a request on the wire, keep its place
+            if (sent)
+                (*it)->dropped = true;
+            else
+                pending_.erase(it);
+            return;
+        }
+    }
+}
+
+bool urx::RTDE_Handler::wait(RTDE_Request& req, int timeout_ms)
+{
+    return wait_until_(req, std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms));
+}
+
+bool urx::RTDE_Handler::wait_all(std::vector<RTDE_Request>& reqs, int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    bool ok = true;
+    for (auto &req : reqs)
+        ok = wait_until_(req, deadline) && ok;
+    return ok;
+}
+
+bool urx::RTDE_Handler::wait_until_(RTDE_Request& req, std::chrono::steady_clock::time_point deadline)
+{
+    if (!req.result.valid())
         return false;
+
+    // Either a receiver is running and completes the request, or we
+    // read (and dispatch) the stream ourselves until the reply shows up.
+    while (req.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            drop_(req.id);
+            break;
+        }
+
+        // never take the stream from the receiver, it would lose the
+        // data frames we read. Look again now and then in case it leaves.
+        std::thread::id rx = receiver_.load();
+        if (rx != std::thread::id() && rx != std::this_thread::get_id()) {
+            req.result.wait_until(std::min(deadline, now + std::chrono::milliseconds(10)));
+            continue;
+        }
+
+        int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        if (rx_lock_.try_lock()) {
+            bool parsed;
+            int rcode = read_(left, parsed);
+            rx_lock_.unlock();
+            if (rcode < 0 && rcode != CON_TIMEOUT) {
+                drop_(req.id);
+                break;
+            }
+        } else {
+            req.result.wait_for(std::chrono::milliseconds(1));
+        }
     }
+    return req.result.get();
+}
 
-    return parse_incoming_data((struct rtde_data_package *)buffer_, ts);
+void urx::RTDE_Handler::set_receiver(bool running)
+{
+    receiver_ = running ? std::this_thread::get_id() : std::thread::id();
 }
 
-bool urx::RTDE_Handler::send(int recipe_id)
+bool urx::RTDE_Handler::recv()
 {
-    for (auto& e : recipes_in) {
-        urx::RTDE_Recipe *r = e.second;
-        if (r->recipe_id() == recipe_id) {
-            // create datamsg;
-            struct rtde_data_package *dp = r->get_dp();
-            r->store(dp);
-            int sendcode = con_->do_send(dp, ntohs(dp->hdr.size));
-            r->put_dp(dp);
-            return (sendcode > 0);
+    std::lock_guard<std::mutex> lg(rx_lock_);
+    int timeout = con_->recv_timeout();
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (int n = 0; n < RTDE_RECV_MAX_READS; n++) {
+        int left = timeout;
+        if (timeout > 0) {
+            auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0);
+            left = std::max(0, timeout - (int)dt.count());
         }
+
+        bool parsed;
+        int rcode = read_(left, parsed);
+        timed_out_ = rcode == CON_TIMEOUT;
+        if (rcode == CON_TIMEOUT || rcode == CON_CANCELLED)
+            return false;
+        if (rcode < 0) {
+            std::cout << "do_recv() failed, code=" << rcode << std::endl;
+            return false;
+        }
+
+        // only text or control packages, data for this cycle is still
+        // to come
+        if (rcode > 0)
+            return parsed;
     }
     return false;
 }
 
+urx::RTDE_Rx_Stats urx::RTDE_Handler::rx_stats() const
+{
+    RTDE_Rx_Stats s;
+    s.data = rx_data_.load(std::memory_order_relaxed);
+    s.text = rx_text_.load(std::memory_order_relaxed);
+    s.replies = rx_replies_.load(std::memory_order_relaxed);
+    s.unexpected = rx_unexpected_.load(std::memory_order_relaxed);
+    s.malformed = rx_malformed_.load(std::memory_order_relaxed);
+    s.dropped_text = text_.dropped();
+    return s;
+}
+
+bool urx::RTDE_Handler::send(int recipe_id)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (reregistering_)
+        return false;
+    return send_(recipe_id);
+}
+
+urx::RTDE_Recipe *urx::RTDE_Handler::in_recipe_(int recipe_id)
+{
+    std::lock_guard<std::mutex> lk(recipes_lock_);
+    auto it = recipes_in.find(recipe_id);
+    return it != recipes_in.end() ? it->second : nullptr;
+}
+
+bool urx::RTDE_Handler::send_(int recipe_id)
+{
+    urx::RTDE_Recipe *r = in_recipe_(recipe_id);
+    if (!r)
+        return false;
+
+    // create datamsg;
+    struct rtde_data_package *dp = r->get_dp();
+    r->store(dp);
+    int sendcode = con_->do_send(dp, ntohs(dp->hdr.size));
+    r->put_dp(dp);
+    return (sendcode > 0);
+}
+
+bool urx::RTDE_Handler::prepare(int recipe_id)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    urx::RTDE_Recipe *r = in_recipe_(recipe_id);
+    if (!r)
+        return false;
+
+    struct rtde_data_package *dp = r->get_dp();
+    r->store(dp);
+    r->put_dp(dp);
+    return true;
+}
+
+bool urx::RTDE_Handler::send_prepared(int recipe_id)
+{
+    std::lock_guard<std::mutex> lg(bottleneck);
+    if (reregistering_)
+        return false;
+    urx::RTDE_Recipe *r = in_recipe_(recipe_id);
+    if (!r)
+        return false;
+
+    struct rtde_data_package *dp = r->get_dp();
+    int sendcode = con_->do_send(dp, ntohs(dp->hdr.size));
+    r->put_dp(dp);
+    return (sendcode > 0);
+}
+
 #define US_IN_NS 1000
 #define MS_IN_NS (1000*US_IN_NS)
 
@@ -7,9 +7,11 @@
  */
 #include <urx/rtde_recipe.hpp>
 #include <urx/rtde_recipe_token.hpp>
+#include <urx/derived.hpp>
 #include <urx/magic.h>
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 bool
 urx::RTDE_Recipe::add_field(std::string name, void *storage)
@@ -59,7 +61,57 @@ urx::RTDE_Recipe::get_fields()
 
 void urx::RTDE_Recipe::clear_fields()
 {
+    for (auto &t : fields)
+        delete t;
     fields.clear();
+    bytes = 0;
+    bit_fields.clear();
+    bit_word_added_[0] = bit_word_added_[1] = false;
+    used_bits_ = 0;
+    next_bit_ = 0;
+}
+
+bool urx::RTDE_Recipe::add_bit_word(int word)
+{
+    static const char *names[2][2] = {
+        { "input_bit_registers0_to_31", "input_bit_registers32_to_63" },
+        { "output_bit_registers0_to_31", "output_bit_registers32_to_63" },
+    };
+    if (bit_word_added_[word])
+        return true;
+    if (!add_field(names[dir_out_][word], &bit_words_[word]))
+        return false;
+    bit_word_added_[word] = true;
+    return true;
+}
+
+std::string urx::RTDE_Recipe::bit_field_script()
+{
+    std::stringstream ss;
+    for (auto &f : bit_fields) {
+        if (!dir_out_) {
+            ss << "def get_" << f.name << "():\n";
+            if (f.width == 1) {
+                ss << "    return read_input_boolean_register(" << f.bit << ")\n";
+            } else {
+                ss << "    return binary_list_to_integer([";
+                for (int i = 0; i < f.width; i++)
+                    ss << (i ? ", " : "") << "read_input_boolean_register(" << f.bit + i << ")";
+                ss << "])\n";
+            }
+        } else {
+            ss << "def set_" << f.name << "(v):\n";
+            if (f.width == 1) {
+                ss << "    write_output_boolean_register(" << f.bit << ", v)\n";
+            } else {
+                ss << "    b = integer_to_binary_list(v)\n";
+                for (int i = 0; i < f.width; i++)
+                    ss << "    write_output_boolean_register(" << f.bit + i << ", b[" << i << "])\n";
+            }
+        }
+        ss << "end\n";
+    }
+    return ss.str();
 }
 
 struct rtde_control_package_out * urx::RTDE_Recipe::msg_out_()
@@ -128,12 +180,32 @@ urx::RTDE_Recipe::parse(unsigned char *buf, unsigned long ts)
         if (!t->parse(buf))
             return false;
 
+    for (auto &f : bit_fields)
+        f.set((bit_words_[f.word()] & f.mask()) >> f.shift());
+
     // Update timestamp if it's being tracked
     if (ts_ns_)
         *ts_ns_ = ts;
+
+    const unsigned char *frame = buf;
+    if (derived_)
+        frame = derived_->process(buf, ts);
+    for (auto s : sinks_)
+        s->on_frame(frame, ts);
     return true;
 }
 
+void urx::RTDE_Recipe::add_sink(RTDE_Frame_Sink *sink)
+{
+    if (sink && std::find(sinks_.begin(), sinks_.end(), sink) == sinks_.end())
+        sinks_.push_back(sink);
+}
+
+void urx::RTDE_Recipe::remove_sink(RTDE_Frame_Sink *sink)
+{
+    sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sink), sinks_.end());
+}
+
 bool
 urx::RTDE_Recipe::store(struct rtde_data_package *dp)
 
@@ -144,6 +216,12 @@ urx::RTDE_Recipe::store(struct rtde_data_package *dp)
     rtde_data_package_init(dp, recipe_id_, expected_bytes());
     unsigned char *data = rtde_data_package_get_payload(dp);
 
+    if (!bit_fields.empty()) {
+        bit_words_[0] = bit_words_[1] = 0;
+        for (auto &f : bit_fields)
+            bit_words_[f.word()] |= (f.get() << f.shift()) & f.mask();
+    }
+
     for (auto &t : fields)
         if (!t->store(data))
             return false;
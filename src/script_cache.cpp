@@ -0,0 +1,186 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/script_cache.hpp>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <sys/stat.h>
+
+static bool is_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+urx::Script_Template::Script_Template(const std::string& raw)
+{
+    // same formatting as URX_Script::get_script(), done once
+    text_.reserve(raw.size());
+    for (std::size_t i = 0; i < raw.size(); i++) {
+        if (raw[i] == '\r' && i + 1 < raw.size() && raw[i + 1] == '\n')
+            continue;
+        if (raw[i] == '\t')
+            text_.append(8, ' ');
+        else
+            text_.push_back(raw[i]);
+    }
+
+    // URX_Script ended every line, including the last, with a newline
+    if (!text_.empty() && text_.back() != '\n')
+        text_.push_back('\n');
+
+    std::size_t pos = 0;
+    while ((pos = text_.find("${", pos)) != std::string::npos) {
+        std::size_t end = pos + 2;
+        while (end < text_.size() && is_name_char(text_[end]))
+            end++;
+        if (end == pos + 2 || end >= text_.size() || text_[end] != '}') {
+            pos += 2;
+            continue;
+        }
+
+        std::string name = text_.substr(pos + 2, end - pos - 2);
+        std::size_t idx = 0;
+        while (idx < names_.size() && names_[idx] != name)
+            idx++;
+        if (idx == names_.size())
+            names_.push_back(name);
+
+        segments_.push_back({pos, end + 1, idx});
+        pos = end + 1;
+    }
+}
+
+bool urx::Script_Template::render(const Script_Params& params, std::string& out) const
+{
+    // resolve all names up front, so we fail before producing anything
+    std::vector<const std::string *> values(names_.size());
+    std::size_t size = text_.size();
+    for (std::size_t i = 0; i < names_.size(); i++) {
+        auto it = params.find(names_[i]);
+        if (it == params.end()) {
+            std::cout << __func__ << "() no value for placeholder '" << names_[i] << "'" << std::endl;
+            return false;
+        }
+        values[i] = &it->second;
+        size += it->second.size();
+    }
+
+    out.clear();
+    out.reserve(size);
+    std::size_t pos = 0;
+    for (auto &s : segments_) {
+        out.append(text_, pos, s.lit_end - pos);
+        out.append(*values[s.name]);
+        pos = s.next;
+    }
+    out.append(text_, pos, std::string::npos);
+    return true;
+}
+
+uint64_t urx::Script_Cache::hash(const std::string& s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+urx::Script_Cache& urx::Script_Cache::global()
+{
+    static Script_Cache cache;
+    return cache;
+}
+
+std::shared_ptr<urx::Script_Cache::Entry> urx::Script_Cache::lookup(const std::string& fname)
+{
+    struct stat st;
+    if (stat(fname.c_str(), &st) || !S_ISREG(st.st_mode)) {
+        std::cout << __func__ << "() ERROR: file not found (" << fname << ")" << std::endl;
+        return nullptr;
+    }
+    int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+    auto f = files_.find(fname);
+    if (f != files_.end() && f->second.mtime_ns == mtime_ns && f->second.size == st.st_size) {
+        auto e = entries_.find(f->second.hash);
+        if (e != entries_.end()) {
+            stats_.hits++;
+            return e->second;
+        }
+    }
+
+    std::ifstream in(fname, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Unable to open file \"" << fname << "\" for reading!" << std::endl;
+        return nullptr;
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    std::string raw = ss.str();
+    stats_.reads++;
+    if (raw.empty())
+        return nullptr;
+
+    uint64_t h = hash(raw);
+    files_[fname] = {mtime_ns, (int64_t)st.st_size, h};
+
+    auto e = entries_.find(h);
+    if (e != entries_.end())
+        return e->second;
+
+    auto entry = std::make_shared<Entry>();
+    entry->tmpl = std::make_shared<const Script_Template>(raw);
+    entries_[h] = entry;
+    stats_.compiles++;
+    return entry;
+}
+
+std::shared_ptr<const urx::Script_Template> urx::Script_Cache::get(const std::string& fname)
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    auto e = lookup(fname);
+    return e ? e->tmpl : nullptr;
+}
+
+std::shared_ptr<const std::string> urx::Script_Cache::script(const std::string& fname, const Script_Params& params)
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    auto e = lookup(fname);
+    if (!e)
+        return nullptr;
+
+    auto r = e->rendered.find(params);
+    if (r != e->rendered.end())
+        return r->second;
+
+    auto out = std::make_shared<std::string>();
+    if (!e->tmpl->render(params, *out))
+        return nullptr;
+    stats_.renders++;
+
+    // keep a handful of variants, register layouts rarely change
+    if (e->rendered.size() >= MAX_RENDERED)
+        e->rendered.clear();
+    e->rendered[params] = out;
+    return out;
+}
+
+void urx::Script_Cache::clear()
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    files_.clear();
+    entries_.clear();
+}
+
+urx::Script_Cache_Stats urx::Script_Cache::stats()
+{
+    std::lock_guard<std::mutex> lg(lock_);
+    return stats_;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/text_queue.hpp>
+#include <arpa/inet.h>
+#include <string.h>
+
+bool urx::rtde_parse_text_message(const struct rtde_header *hdr, unsigned long rx_ts, RTDE_Text_Message& msg)
+{
+    if (!hdr || hdr->type != RTDE_TEXT_MESSAGE)
+        return false;
+
+    // mlength, message, srclength, source, level
+    const unsigned char *p = (const unsigned char *)hdr + sizeof(*hdr);
+    const unsigned char *end = (const unsigned char *)hdr + ntohs(hdr->size);
+    if (p >= end)
+        return false;
+    std::size_t mlen = *p++;
+    if (p + mlen + 1 > end)
+        return false;
+    const unsigned char *text = p;
+    p += mlen;
+    std::size_t slen = *p++;
+    if (p + slen + 1 > end)
+        return false;
+    const unsigned char *src = p;
+    p += slen;
+
+    msg.level = *p;
+    msg.rx_ts = rx_ts;
+    memcpy(msg.text, text, mlen);
+    msg.text[mlen] = 0x00;
+    if (slen >= sizeof(msg.source))
+        slen = sizeof(msg.source) - 1;
+    memcpy(msg.source, src, slen);
+    msg.source[slen] = 0x00;
+    return true;
+}
+
+bool urx::Text_Queue::push(const RTDE_Text_Message& msg)
+{
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= TEXT_QUEUE_SIZE) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slots_[tail & (TEXT_QUEUE_SIZE - 1)] = msg;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool urx::Text_Queue::pop(RTDE_Text_Message& msg)
+{
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+        return false;
+    msg = slots_[head & (TEXT_QUEUE_SIZE - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+std::size_t urx::Text_Queue::size() const
+{
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <urx/trajectory.hpp>
+#include <string>
+
+urx::Trajectory_Stream::Trajectory_Stream(std::size_t capacity, Traj_Mode mode) :
+    buf_(capacity > 0 ? capacity : 1),
+    head_(0),
+    count_(0),
+    last_t_(0.0),
+    have_last_(false),
+    last_pushed_t_(0.0),
+    written_(0),
+    mode_(mode),
+    consumed_(0),
+    sent_mode_(-1)
+{
+    for (auto &slot : regs_)
+        for (auto &r : slot)
+            r = 0.0;
+}
+
+bool urx::Trajectory_Stream::add_output_fields(RTDE_Recipe *out)
+{
+    if (!out || !out->dir_out())
+        return false;
+    return out->add_field("output_int_register_" + std::to_string(TRAJ_REG_BASE), &consumed_);
+}
+
+bool urx::Trajectory_Stream::add_input_fields(RTDE_Recipe *in)
+{
+    if (!in || in->dir_out())
+        return false;
+
+    if (!in->add_field("input_int_register_" + std::to_string(TRAJ_REG_BASE), &written_) ||
+        !in->add_field("input_int_register_" + std::to_string(TRAJ_REG_BASE + 1), &mode_))
+        return false;
+
+    int reg = TRAJ_REG_BASE;
+    for (std::size_t s = 0; s < TRAJ_RING; s++)
+        for (std::size_t j = 0; j < TRAJ_SLOT_REGS; j++)
+            if (!in->add_field("input_double_register_" + std::to_string(reg++), &regs_[s][j]))
+                return false;
+    return true;
+}
+
+bool urx::Trajectory_Stream::push(const Waypoint& wp)
+{
+    if (count_ >= buf_.size())
+        return false;
+
+    // time must move forward, servoj cannot go back in time
+    bool any = count_ > 0 || have_last_;
+    if (any && wp.t <= last_pushed_t_)
+        return false;
+
+    buf_[(head_ + count_) % buf_.size()] = wp;
+    count_++;
+    last_pushed_t_ = wp.t;
+    return true;
+}
+
+bool urx::Trajectory_Stream::sync()
+{
+    bool changed = false;
+    while (count_ > 0 && in_flight() < TRAJ_RING) {
+        const Waypoint& wp = buf_[head_];
+        double *slot = regs_[(uint32_t)written_ % TRAJ_RING];
+
+        // First waypoint has no predecessor, treat its time as the
+        // duration from now.
+        slot[0] = have_last_ ? wp.t - last_t_ : wp.t;
+        for (std::size_t j = 0; j < TRAJ_DOF; j++)
+            slot[1 + j] = wp.q[j];
+
+        last_t_ = wp.t;
+        have_last_ = true;
+        head_ = (head_ + 1) % buf_.size();
+        count_--;
+        written_++;
+        changed = true;
+    }
+
+    // mode change (finish()) must reach the controller as well
+    if (mode_ != sent_mode_) {
+        sent_mode_ = mode_;
+        changed = true;
+    }
+    return changed;
+}
@@ -6,19 +6,74 @@
  * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
  */
 #include <urx/urx_handler.hpp>
+#include <urx/heartbeat.hpp>
 
-bool urx::URX_Handler::upload_script(const std::string script_name)
+#ifndef BOOST_LOG_DYN_LINK
+#define BOOST_LOG_DYN_LINK
+#endif
+
+#include <boost/log/trivial.hpp>
+
+bool urx::URX_Handler::upload_script(const std::string script_name, const Script_Params& params)
 {
-    if (!script_.set_script(script_name)) {
-        printf("%s: failed setting script\n", __func__);
-        return false;
-    }
-    if (!script_.read_file()) {
-        printf("%s: failed reading file\n", __func__);
+    // shipped scripts keep the heartbeat, even with it disabled on the host
+    Script_Params p = params;
+    Script_Params hp = Heartbeat::default_params();
+    p.insert(hp.begin(), hp.end());
+    std::shared_ptr<const std::string> s = Script_Cache::global().script(script_name, p);
+    if (!s) {
+        printf("%s: failed preparing script %s\n", __func__, script_name.c_str());
         return false;
     }
 
-    std::string s = script_.get_script();
-    int res = con_->do_send((void *)s.c_str(), s.size());
+    int res = con_->do_send((void *)s->data(), s->size());
     return res > 0;
 }
+
+bool urx::URX_Handler::start_reader()
+{
+    if (reading_)
+        return true;
+    if (!con_->is_connected())
+        return false;
+
+    reading_ = true;
+    reader_ = std::thread(&urx::URX_Handler::reader, this);
+    return true;
+}
+
+void urx::URX_Handler::stop_reader()
+{
+    reading_ = false;
+    con_->cancel();
+    if (reader_.joinable())
+        reader_.join();
+    con_->clear_cancel();
+}
+
+void urx::URX_Handler::reader()
+{
+    unsigned char buf[4096];
+    while (reading_) {
+        int res = con_->do_recv(buf, sizeof(buf));
+        if (res == CON_TIMEOUT)
+            continue;
+        if (res == CON_CANCELLED)
+            break;
+        if (res <= 0) {
+            BOOST_LOG_TRIVIAL(error) << __func__ << "() connection closed or failed (" << res << "), stopping" << std::endl;
+            reading_ = false;
+            break;
+        }
+        if (primary_.feed(buf, res) >= 0)
+            continue;
+
+        // out of step, a new connection starts on a message boundary
+        BOOST_LOG_TRIVIAL(warning) << __func__ << "() malformed primary stream, reconnecting" << std::endl;
+        if (!con_->reconnect()) {
+            BOOST_LOG_TRIVIAL(error) << __func__ << "() reconnect failed, stopping" << std::endl;
+            reading_ = false;
+            break;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE clock_sync
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/clock_sync.hpp>
+#include <random>
+#include <cstdlib>
+
+struct F
+{
+    F() : gen(42), delay(1.0) {}
+
+    // controller has been up for a while, host-clock is far ahead and
+    // the controller runs slightly fast.
+    int64_t host_time(double ur_ts)
+    {
+        return offset_ns + (int64_t)(ur_ts * 1e9 * (1.0 + drift_ppm * 1e-6));
+    }
+
+    // 50us minimum delay, exponential tail with a mean of 200us
+    int64_t rx_time(double ur_ts)
+    {
+        return host_time(ur_ts) + 50000 + (int64_t)(delay(gen) * 200000.0);
+    }
+
+    const int64_t offset_ns = 123456789000000;
+    const double drift_ppm = 40.0;
+    std::mt19937 gen;
+    std::exponential_distribution<double> delay;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, F)
+
+BOOST_AUTO_TEST_CASE(test_clock_sync_not_valid)
+{
+    urx::Clock_Sync cs;
+    BOOST_CHECK(!cs.valid());
+    BOOST_CHECK(cs.to_host_ns(1.0) == 0);
+    BOOST_CHECK(cs.to_controller(1000) < 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_clock_sync_offset_and_drift)
+{
+    urx::Clock_Sync cs(50, 20);
+    double ur_ts = 3600.0;
+    for (int i = 0; i < 5000; i++, ur_ts += 0.002)
+        cs.add(ur_ts, rx_time(ur_ts));
+
+    BOOST_CHECK(cs.valid());
+    BOOST_CHECK_CLOSE(cs.drift_ppm(), drift_ppm, 5.0);
+
+    // mapping is relative to the fastest delivery (50us)
+    int64_t expected = host_time(ur_ts) + 50000;
+    int64_t err = std::llabs(cs.to_host_ns(ur_ts) - expected);
+    BOOST_TEST_MESSAGE("error: " << err << " ns, bound: " << cs.error_bound_ns() << " ns");
+    BOOST_CHECK(err < 20000);
+    BOOST_CHECK(cs.error_bound_ns() < 20000);
+
+    // and back again
+    BOOST_CHECK_CLOSE(cs.to_controller(cs.to_host_ns(ur_ts)), ur_ts, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_clock_sync_reset)
+{
+    urx::Clock_Sync cs(10, 4);
+    double ur_ts = 1.0;
+    for (int i = 0; i < 100; i++, ur_ts += 0.008)
+        cs.add(ur_ts, rx_time(ur_ts));
+    BOOST_CHECK(cs.valid());
+    cs.reset();
+    BOOST_CHECK(!cs.valid());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
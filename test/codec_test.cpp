@@ -0,0 +1,106 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE codec
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/codec.hpp>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+BOOST_AUTO_TEST_SUITE(codec_test)
+
+static void check_doubles(const std::vector<double>& v)
+{
+    std::vector<uint8_t> enc;
+    urx::xor_encode(v.data(), v.size(), enc);
+    std::vector<double> dec(v.size());
+    BOOST_REQUIRE(urx::xor_decode(enc.data(), enc.size(), v.size(), dec.data()));
+    BOOST_CHECK(memcmp(v.data(), dec.data(), v.size() * sizeof(double)) == 0);
+}
+
+static void check_ints(const std::vector<int64_t>& v)
+{
+    std::vector<uint8_t> enc;
+    urx::dod_encode(v.data(), v.size(), enc);
+    std::vector<int64_t> dec(v.size());
+    BOOST_REQUIRE(urx::dod_decode(enc.data(), enc.size(), v.size(), dec.data()));
+    BOOST_CHECK(v == dec);
+}
+
+BOOST_AUTO_TEST_CASE(test_xor_roundtrip)
+{
+    check_doubles({});
+    check_doubles({1.0});
+    check_doubles({0.0, -0.0, 1.0, 1.0, 1.0, -1e300, 1e-300,
+                   std::numeric_limits<double>::infinity(),
+                   std::numeric_limits<double>::quiet_NaN(),
+                   std::numeric_limits<double>::denorm_min()});
+
+    std::mt19937_64 rng(42);
+    std::vector<double> v;
+    for (int i = 0; i < 5000; i++) {
+        uint64_t u = rng();
+        double d;
+        memcpy(&d, &u, sizeof(d));
+        v.push_back(d);
+    }
+    check_doubles(v);
+}
+
+BOOST_AUTO_TEST_CASE(test_dod_roundtrip)
+{
+    check_ints({});
+    check_ints({42});
+    check_ints({std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), 0, -1, 1,
+                std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min()});
+
+    std::mt19937_64 rng(7);
+    std::vector<int64_t> v;
+    int64_t x = 0;
+    for (int i = 0; i < 5000; i++) {
+        // mix of all buckets
+        int64_t step = (int64_t)(rng() >> (rng() % 64));
+        x += (i % 3) ? step : -step;
+        v.push_back(x);
+    }
+    check_ints(v);
+}
+
+BOOST_AUTO_TEST_CASE(test_codec_ratio)
+{
+    // 500Hz receive timestamps with jitter, a seqnr and a slow joint
+    std::vector<int64_t> ts, seq;
+    std::vector<double> q;
+    std::mt19937_64 rng(1);
+    std::normal_distribution<double> jitter(0.0, 2000.0);
+    for (int i = 0; i < 2048; i++) {
+        ts.push_back(1700000000000000000LL + i * 2000000LL + (int64_t)jitter(rng));
+        seq.push_back(i);
+        q.push_back(std::round(1e6 * std::sin(i * 0.002)) / 1e6);
+    }
+
+    std::vector<uint8_t> enc;
+    urx::dod_encode(seq.data(), seq.size(), enc);
+    BOOST_CHECK(enc.size() < 300);      // ~1 bit per value
+    enc.clear();
+    urx::dod_encode(ts.data(), ts.size(), enc);
+    BOOST_CHECK(enc.size() < ts.size() * 8 / 3);
+    check_ints(ts);
+    check_doubles(q);
+
+    // truncated input is detected
+    enc.clear();
+    urx::xor_encode(q.data(), q.size(), enc);
+    std::vector<double> dec(q.size());
+    BOOST_CHECK(!urx::xor_decode(enc.data(), enc.size() / 2, q.size(), dec.data()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
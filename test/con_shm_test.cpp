@@ -0,0 +1,164 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE urx_con_shm
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/con_shm.hpp>
+#include <urx/rtde_handler.hpp>
+#include <urx/header.hpp>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <unistd.h>
+
+struct F
+{
+    F() :
+        name_("/urx-shm-test-" + std::to_string(getpid())),
+        server_(name_, urx::SHM_SERVER)
+    {
+        BOOST_REQUIRE(server_.do_connect());
+        BOOST_TEST_MESSAGE( "setup fixture" );
+    }
+    ~F()
+    {
+        BOOST_TEST_MESSAGE( "teardown fixture" );
+    }
+    std::string name_;
+    urx::Con_Shm server_;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, F)
+
+BOOST_AUTO_TEST_CASE(test_shm_attach)
+{
+    urx::Con_Shm none("/urx-shm-test-missing");
+    BOOST_CHECK(!none.do_connect());
+    BOOST_CHECK(!none.is_connected());
+
+    urx::Con_Shm con(name_);
+    const char *str = "foobar";
+    BOOST_CHECK(con.do_send((void *)str, strlen(str)) == -1); // not connected
+    BOOST_CHECK(con.do_connect());
+    BOOST_CHECK(con.is_connected());
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_messages)
+{
+    urx::Con_Shm con(name_);
+    BOOST_REQUIRE(con.do_connect());
+    char buf[64];
+
+    // message boundaries are kept, one receive per send
+    BOOST_CHECK(con.do_send((void *)"foo", 3) == 3);
+    BOOST_CHECK(con.do_send((void *)"barbaz", 6) == 6);
+    BOOST_CHECK(server_.do_recv(buf, sizeof(buf)) == 3);
+    BOOST_CHECK(strncmp(buf, "foo", 3) == 0);
+    unsigned long ts = 0;
+    BOOST_CHECK(server_.do_recv(buf, sizeof(buf), &ts) == 6);
+    BOOST_CHECK(strncmp(buf, "barbaz", 6) == 0);
+    BOOST_CHECK(ts > 0);
+    BOOST_CHECK(server_.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+
+    // many times around the ring, with wrap-around padding
+    char msg[1000];
+    for (int i = 0; i < 500; i++) {
+        memset(msg, i & 0xff, sizeof(msg));
+        int sz = 100 + (i * 37) % 900;
+        BOOST_REQUIRE(server_.do_send(msg, sz) == sz);
+        char rx[1000];
+        BOOST_REQUIRE(con.do_recv(rx, sizeof(rx)) == sz);
+        BOOST_REQUIRE(memcmp(rx, msg, sz) == 0);
+    }
+
+    // too large for the buffer: truncated
+    BOOST_CHECK(server_.do_send(msg, sizeof(msg)) == sizeof(msg));
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == sizeof(buf));
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_wakeup)
+{
+    urx::Con_Shm con(name_);
+    BOOST_REQUIRE(con.do_connect());
+
+    std::thread t([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        server_.do_send((void *)"ping", 4);
+    });
+    char buf[16];
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == 4);
+    t.join();
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_timeout_cancel)
+{
+    urx::Con_Shm con(name_);
+    BOOST_REQUIRE(con.do_connect());
+    char buf[16];
+
+    con.set_recv_timeout(20);
+    auto t0 = std::chrono::steady_clock::now();
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+    auto dt = std::chrono::steady_clock::now() - t0;
+    BOOST_CHECK(dt >= std::chrono::milliseconds(20));
+    BOOST_CHECK(dt < std::chrono::milliseconds(500));
+
+    con.set_recv_timeout(urx::CON_WAIT_FOREVER);
+    std::thread t([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        con.cancel();
+    });
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == urx::CON_CANCELLED);
+    t.join();
+    BOOST_CHECK(con.is_connected());
+
+    // pending cancel, then cleared
+    con.cancel();
+    BOOST_CHECK(con.try_recv(buf, sizeof(buf)) == urx::CON_CANCELLED);
+    con.cancel();
+    con.clear_cancel();
+    BOOST_CHECK(con.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_peer_gone)
+{
+    urx::Con_Shm con(name_);
+    BOOST_REQUIRE(con.do_connect());
+    char buf[16];
+
+    std::thread t([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        con.disconnect();
+    });
+    BOOST_CHECK(server_.do_recv(buf, sizeof(buf)) == -1);
+    BOOST_CHECK(!server_.is_connected());
+    t.join();
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_rtde_handler)
+{
+    // simulator side answers the protocol version request
+    std::thread sim([&]() {
+        char buf[64];
+        if (server_.do_recv(buf, sizeof(buf)) != 5)
+            return;
+        struct rtde_prot resp;
+        resp.hdr.size = htons(4);
+        resp.hdr.type = RTDE_REQUEST_PROTOCOL_VERSION;
+        resp.payload.accepted = 1;
+        server_.do_send(&resp, 4);
+    });
+
+    urx::RTDE_Handler handler(new urx::Con_Shm(name_));
+    BOOST_REQUIRE(handler.connect_ur());
+    BOOST_CHECK(handler.set_version());
+    sim.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,8 +10,41 @@
 
 #include <boost/test/unit_test.hpp>
 #include <urx/con.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <pthread.h>
 #include "test_server.hpp"
 
+// listener on loopback, ephemeral port
+static int listen_any(int family, int backlog, int *port)
+{
+    int fd = socket(family, SOCK_STREAM, 0);
+    struct sockaddr_storage ss;
+    memset(&ss, 0, sizeof(ss));
+    socklen_t len;
+    if (family == AF_INET6) {
+        ((struct sockaddr_in6 *)&ss)->sin6_family = AF_INET6;
+        ((struct sockaddr_in6 *)&ss)->sin6_addr = in6addr_loopback;
+        len = sizeof(struct sockaddr_in6);
+    } else {
+        ((struct sockaddr_in *)&ss)->sin_family = AF_INET;
+        ((struct sockaddr_in *)&ss)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        len = sizeof(struct sockaddr_in);
+    }
+    if (fd < 0 || bind(fd, (struct sockaddr *)&ss, len) || listen(fd, backlog) ||
+        getsockname(fd, (struct sockaddr *)&ss, &len)) {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    *port = ntohs(family == AF_INET6 ? ((struct sockaddr_in6 *)&ss)->sin6_port : ((struct sockaddr_in *)&ss)->sin_port);
+    return fd;
+}
+
 struct F
 {
     F() :
@@ -57,4 +90,198 @@ BOOST_AUTO_TEST_CASE(test_con_disconnect)
     con.disconnect();
 }
 
+BOOST_AUTO_TEST_CASE(test_con_recv_timeout)
+{
+    urx::Con con("127.0.0.1", urx::URX_PORT);
+    char buf[64];
+    BOOST_CHECK(con.recv_timeout() == urx::CON_WAIT_FOREVER);
+    BOOST_CHECK(con.do_connect());
+
+    // server stays silent until we send something
+    con.set_recv_timeout(20);
+    auto t0 = std::chrono::steady_clock::now();
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+    auto dt = std::chrono::steady_clock::now() - t0;
+    BOOST_CHECK(dt >= std::chrono::milliseconds(20));
+    BOOST_CHECK(dt < std::chrono::milliseconds(500));
+    BOOST_CHECK(con.is_connected());
+
+    BOOST_CHECK(con.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+
+    const char *resp = "pong";
+    server_.set_resp((unsigned char *)resp, strlen(resp));
+    const char *req = "ping";
+    BOOST_CHECK(con.do_send((void *)req, strlen(req)) > 0);
+    BOOST_CHECK(con.recv_for(buf, sizeof(buf), 1000, NULL) == 4);
+    BOOST_CHECK(strncmp(buf, resp, 4) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_con_recv_signal)
+{
+    urx::Con con("127.0.0.1", urx::URX_PORT);
+    char buf[64];
+    BOOST_CHECK(con.do_connect());
+
+    // no SA_RESTART, so poll() returns EINTR
+    struct sigaction sa, old;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = [](int) {};
+    sigemptyset(&sa.sa_mask);
+    BOOST_REQUIRE(sigaction(SIGUSR1, &sa, &old) == 0);
+
+    // signals alone do not end the wait early
+    int res = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread t([&] { res = con.recv_for(buf, sizeof(buf), 100, NULL); });
+    for (int i = 0; i < 5; i++) {
+        usleep(10000);
+        pthread_kill(t.native_handle(), SIGUSR1);
+    }
+    t.join();
+    BOOST_CHECK(res == urx::CON_TIMEOUT);
+    BOOST_CHECK(std::chrono::steady_clock::now() - t0 >= std::chrono::milliseconds(100));
+    BOOST_CHECK(con.is_connected());
+
+    // and data arriving after a signal is still received
+    const char *resp = "pong";
+    server_.set_resp((unsigned char *)resp, strlen(resp));
+    std::thread t2([&] { res = con.recv_for(buf, sizeof(buf), 1000, NULL); });
+    usleep(10000);
+    pthread_kill(t2.native_handle(), SIGUSR1);
+    usleep(10000);
+    const char *req = "ping";
+    BOOST_CHECK(con.do_send((void *)req, strlen(req)) > 0);
+    t2.join();
+    BOOST_CHECK(res == 4);
+
+    sigaction(SIGUSR1, &old, NULL);
+}
+
+BOOST_AUTO_TEST_CASE(test_con_cancel)
+{
+    urx::Con con("127.0.0.1", urx::URX_PORT);
+    char buf[64];
+    BOOST_CHECK(con.do_connect());
+
+    // blocked forever, until cancelled
+    int res = 0;
+    std::thread t([&] { res = con.do_recv(buf, sizeof(buf)); });
+    usleep(20000);
+    con.cancel();
+    t.join();
+    BOOST_CHECK(res == urx::CON_CANCELLED);
+    BOOST_CHECK(con.is_connected());
+
+    // consumed by the receiver
+    BOOST_CHECK(con.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+
+    // pending until cleared
+    con.cancel();
+    con.clear_cancel();
+    BOOST_CHECK(con.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+    con.cancel();
+    BOOST_CHECK(con.try_recv(buf, sizeof(buf)) == urx::CON_CANCELLED);
+}
+
+BOOST_AUTO_TEST_CASE(test_con_low_latency_profile)
+{
+    urx::Con con("127.0.0.1", urx::URX_PORT);
+    char buf[64];
+    BOOST_CHECK(!con.set_rcvlowat(8));      // no socket yet
+
+    urx::Con_Profile p = urx::Con_Profile::low_latency();
+    con.set_profile(p);
+    BOOST_CHECK(con.profile().spin_us == p.spin_us);
+    BOOST_CHECK(con.do_connect());
+
+    // spinning gives up and falls back to poll()
+    BOOST_CHECK(con.recv_for(buf, sizeof(buf), 10, NULL) == urx::CON_TIMEOUT);
+
+    // a 4 byte response does not satisfy a low-water mark of 8
+    const char *resp = "pong";
+    server_.set_resp((unsigned char *)resp, strlen(resp));
+    BOOST_CHECK(con.set_rcvlowat(8));
+    const char *req = "ping";
+    BOOST_CHECK(con.do_send((void *)req, strlen(req)) > 0);
+    usleep(10000);
+    p.spin_us = 0;
+    con.set_profile(p);
+    BOOST_CHECK(con.recv_for(buf, sizeof(buf), 20, NULL) == urx::CON_TIMEOUT);
+
+    BOOST_CHECK(con.set_rcvlowat(1));
+    BOOST_CHECK(con.recv_for(buf, sizeof(buf), 1000, NULL) == 4);
+    BOOST_CHECK(strncmp(buf, resp, 4) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_con_resolve)
+{
+    urx::Con byname("localhost", urx::URX_PORT);
+    BOOST_CHECK(byname.do_connect());
+
+    urx::Con bad("no-such-host.invalid", urx::URX_PORT);
+    BOOST_CHECK(!bad.do_connect());
+
+    // the lookup is bounded by the connect timeout as well
+    urx::Con slow("no-such-host.invalid", urx::URX_PORT);
+    slow.set_connect_timeout(50);
+    auto t0 = std::chrono::steady_clock::now();
+    BOOST_CHECK(!slow.do_connect());
+    BOOST_CHECK(std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(500));
+
+    urx::Con refused("127.0.0.1", 1);
+    BOOST_CHECK(!refused.do_connect());
+}
+
+BOOST_AUTO_TEST_CASE(test_con_ipv6)
+{
+    int port;
+    int lfd = listen_any(AF_INET6, 4, &port);
+    if (lfd < 0) {
+        BOOST_TEST_MESSAGE("no IPv6 loopback, skipping");
+        return;
+    }
+    urx::Con con("::1", port);
+    BOOST_CHECK(con.do_connect(true));
+    int s = accept(lfd, NULL, NULL);
+    BOOST_CHECK(s >= 0);
+    BOOST_CHECK(con.do_send((void *)"v6", 2) == 2);
+    char buf[4];
+    BOOST_CHECK(read(s, buf, sizeof(buf)) == 2);
+    close(s);
+    close(lfd);
+}
+
+BOOST_AUTO_TEST_CASE(test_con_connect_timeout)
+{
+    // A listener nobody accepts on: once the queue is full, SYNs are
+    // dropped and connect() hangs.
+    int port;
+    int lfd = listen_any(AF_INET, 0, &port);
+    BOOST_REQUIRE(lfd >= 0);
+    std::vector<urx::Con *> cons;
+    for (int i = 0; i < 4; i++) {
+        cons.push_back(new urx::Con("127.0.0.1", port));
+        cons.back()->set_connect_timeout(200);
+    }
+
+    // in parallel, so about one timeout in total
+    auto t0 = std::chrono::steady_clock::now();
+    int connected = urx::connect_all(cons);
+    auto dt = std::chrono::steady_clock::now() - t0;
+    BOOST_CHECK(connected < 4);
+    BOOST_CHECK(dt >= std::chrono::milliseconds(150));
+    BOOST_CHECK(dt < std::chrono::milliseconds(600));
+    for (auto c : cons)
+        delete c;
+    close(lfd);
+
+    std::vector<urx::Con *> ok = {
+        new urx::Con("127.0.0.1", urx::URX_PORT),
+        new urx::Con("localhost", urx::URX_PORT),
+    };
+    BOOST_CHECK(urx::connect_all(ok, true) == 2);
+    for (auto c : ok)
+        delete c;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE urx_con_unix
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/con_unix.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <unistd.h>
+
+struct F
+{
+    F() :
+        path_("/tmp/urx-unix-test-" + std::to_string(getpid()) + ".sock"),
+        lfd_(socket(AF_UNIX, SOCK_STREAM, 0))
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path_.c_str());
+        BOOST_REQUIRE(bind(lfd_, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        BOOST_REQUIRE(listen(lfd_, 4) == 0);
+        BOOST_TEST_MESSAGE( "setup fixture" );
+    }
+    ~F()
+    {
+        BOOST_TEST_MESSAGE( "teardown fixture" );
+        close(lfd_);
+        unlink(path_.c_str());
+    }
+    std::string path_;
+    int lfd_;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, F)
+
+BOOST_AUTO_TEST_CASE(test_unix_connect)
+{
+    urx::Con_Unix none(path_ + ".missing");
+    BOOST_CHECK(!none.do_connect());
+
+    urx::Con_Unix con(path_);
+    BOOST_CHECK(!con.is_connected());
+    BOOST_CHECK(con.do_connect(true));
+    BOOST_CHECK(con.is_connected());
+    con.disconnect();
+    BOOST_CHECK(!con.is_connected());
+}
+
+BOOST_AUTO_TEST_CASE(test_unix_send_recv)
+{
+    urx::Con_Unix con(path_);
+    BOOST_REQUIRE(con.do_connect());
+    int s = accept(lfd_, NULL, NULL);
+    BOOST_REQUIRE(s >= 0);
+
+    char buf[64];
+    BOOST_CHECK(con.do_send((void *)"foobar", 6) == 6);
+    BOOST_CHECK(read(s, buf, sizeof(buf)) == 6);
+    BOOST_CHECK(strncmp(buf, "foobar", 6) == 0);
+
+    BOOST_CHECK(write(s, "pong", 4) == 4);
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == 4);
+    BOOST_CHECK(strncmp(buf, "pong", 4) == 0);
+
+    // timeout, cancel and peer hang-up as for TCP
+    con.set_recv_timeout(20);
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+    con.cancel();
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == urx::CON_CANCELLED);
+    close(s);
+    BOOST_CHECK(con.do_recv(buf, sizeof(buf)) == -1);
+    BOOST_CHECK(!con.is_connected());
+
+    // and back again
+    BOOST_CHECK(con.reconnect());
+    s = accept(lfd_, NULL, NULL);
+    BOOST_CHECK(s >= 0);
+    close(s);
+}
+
+BOOST_AUTO_TEST_CASE(test_unix_abstract)
+{
+    std::string name = "@urx-unix-test-" + std::to_string(getpid());
+    int afd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, name.c_str() + 1, name.size() - 1);
+    BOOST_REQUIRE(bind(afd, (struct sockaddr *)&addr, offsetof(struct sockaddr_un, sun_path) + name.size()) == 0);
+    BOOST_REQUIRE(listen(afd, 1) == 0);
+
+    urx::Con_Unix con(name);
+    BOOST_CHECK(con.do_connect());
+    close(afd);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE urx_con_uring
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/con_uring.hpp>
+#include <chrono>
+#include <thread>
+#include "test_server.hpp"
+
+constexpr int TEST_PORT = 30012;
+
+struct F
+{
+    F() :
+        server_("127.0.0.1", TEST_PORT),
+        con_("127.0.0.1", TEST_PORT)
+    {
+        server_.start();
+        usleep(50000);
+        BOOST_TEST_MESSAGE( "setup fixture" );
+    }
+    ~F()
+    {
+        BOOST_TEST_MESSAGE( "teardown fixture" );
+        con_.disconnect();
+        server_.stop();
+        usleep(10000);
+    }
+    test::TestServer server_;
+    urx::Con_Uring con_;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, F)
+
+BOOST_AUTO_TEST_CASE(test_uring_send_recv)
+{
+    char buf[64];
+    BOOST_CHECK(con_.do_send((void *)"x", 1) == -1);     // not connected
+    BOOST_CHECK(con_.do_connect());
+    BOOST_CHECK(con_.uring());
+
+    const char *resp = "pong";
+    server_.set_resp((unsigned char *)resp, strlen(resp));
+    const char *req = "ping";
+    BOOST_CHECK(con_.do_send_recv((void *)req, strlen(req), buf, sizeof(buf)) == 4);
+    BOOST_CHECK(strncmp(buf, resp, 4) == 0);
+    BOOST_CHECK(server_.get_last_tx_buf_sz() == strlen(req));
+    BOOST_CHECK(strncmp(server_.get_last_tx_buf(), req, strlen(req)) == 0);
+
+    urx::Uring_Stats st = con_.stats();
+    BOOST_CHECK(st.sends == 1);
+    BOOST_CHECK(st.frames == 1);
+    BOOST_CHECK(st.rearms == 1);        // multishot stays armed
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_short_reads)
+{
+    BOOST_CHECK(con_.do_connect());
+
+    // one completion, read in pieces smaller than it
+    const char *resp = "0123456789";
+    server_.set_resp((unsigned char *)resp, strlen(resp));
+    const char *req = "ping";
+    BOOST_CHECK(con_.do_send((void *)req, strlen(req)) > 0);
+
+    char buf[5];
+    std::string got;
+    for (int i = 0; i < 10 && got.size() < strlen(resp); i++) {
+        int res = con_.recv_for(buf, 4, 1000, NULL);
+        BOOST_REQUIRE(res > 0 && res <= 4);
+        got.append(buf, res);
+    }
+    BOOST_CHECK(got == resp);
+    BOOST_CHECK(con_.try_recv(buf, 4) == urx::CON_TIMEOUT);
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_linked_send)
+{
+    BOOST_CHECK(con_.do_connect());
+
+    // spans 3 send slots, has to arrive in order
+    unsigned char big[5000];
+    for (std::size_t i = 0; i < sizeof(big); i++)
+        big[i] = i & 0xff;
+    BOOST_CHECK(con_.do_send(big, sizeof(big)) == (int)sizeof(big));
+
+    // test server only reads the first 2048 bytes
+    BOOST_CHECK(server_.get_last_tx_buf_sz() > 0);
+    BOOST_CHECK(memcmp(server_.get_last_tx_buf(), big, server_.get_last_tx_buf_sz()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_timeout_cancel)
+{
+    char buf[64];
+    BOOST_CHECK(con_.do_connect());
+
+    auto t0 = std::chrono::steady_clock::now();
+    BOOST_CHECK(con_.recv_for(buf, sizeof(buf), 20, NULL) == urx::CON_TIMEOUT);
+    auto dt = std::chrono::steady_clock::now() - t0;
+    BOOST_CHECK(dt >= std::chrono::milliseconds(20));
+    BOOST_CHECK(dt < std::chrono::milliseconds(500));
+    BOOST_CHECK(con_.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+    BOOST_CHECK(con_.is_connected());
+
+    int res = 0;
+    std::thread t([&] { res = con_.do_recv(buf, sizeof(buf)); });
+    usleep(20000);
+    con_.cancel();
+    t.join();
+    BOOST_CHECK(res == urx::CON_CANCELLED);
+    BOOST_CHECK(con_.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+
+    con_.cancel();
+    con_.clear_cancel();
+    BOOST_CHECK(con_.try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+}
+
+BOOST_AUTO_TEST_CASE(test_uring_reconnect)
+{
+    BOOST_CHECK(con_.do_connect());
+    BOOST_CHECK(con_.uring());
+    con_.disconnect();
+    BOOST_CHECK(!con_.uring());
+    BOOST_CHECK(con_.reconnect());
+    BOOST_CHECK(con_.uring());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
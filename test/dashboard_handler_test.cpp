@@ -0,0 +1,97 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE dashboard_handler
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/dashboard_handler.hpp>
+#include "mocks/mock_con.hpp"
+#include <chrono>
+
+static bool ready(std::future<std::string>& f)
+{
+    return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+struct F
+{
+    F()
+    {
+        mock = new urx::Con_mock();
+        h = new urx::Dashboard_Handler(mock);
+        memset(buffer_, 0, sizeof(buffer_));
+        mock->set_sendBuffer(buffer_, sizeof(buffer_));
+        mock->set_sendCode(1);
+    }
+    ~F()
+    {
+        delete h;
+    }
+    unsigned char buffer_[2048];
+    urx::Con_mock* mock;
+    urx::Dashboard_Handler* h;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, F)
+
+BOOST_AUTO_TEST_CASE(test_dashboard_batch)
+{
+    auto res = h->batch({"power on", "brake release", "robotmode"});
+    BOOST_CHECK(res.size() == 3);
+    BOOST_CHECK(h->pending() == 3);
+
+    // all commands in a single write
+    BOOST_CHECK(strcmp((const char *)buffer_, "power on\nbrake release\nrobotmode\n") == 0);
+
+    // welcome line is skipped, responses split over reads
+    const char *r1 = "Connected: Universal Robots Dashboard Server\nPowering on\nBrake rel";
+    const char *r2 = "easing\r\nRobotmode: IDLE\n";
+    h->handle_incoming(r1, strlen(r1));
+    BOOST_CHECK(ready(res[0]));
+    BOOST_CHECK(!ready(res[1]));
+    h->handle_incoming(r2, strlen(r2));
+
+    BOOST_CHECK(res[0].get() == "Powering on");
+    BOOST_CHECK(res[1].get() == "Brake releasing");
+    BOOST_CHECK(res[2].get() == "Robotmode: IDLE");
+    BOOST_CHECK(h->pending() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_dashboard_in_order)
+{
+    auto a = h->load("/programs/foo.urp");
+    auto b = h->play();
+    BOOST_CHECK(strncmp((const char *)buffer_, "play\n", 5) == 0);
+
+    const char *r = "Loading program: /programs/foo.urp\nStarting program\n";
+    h->handle_incoming(r, strlen(r));
+    BOOST_CHECK(a.get() == "Loading program: /programs/foo.urp");
+    BOOST_CHECK(b.get() == "Starting program");
+}
+
+BOOST_AUTO_TEST_CASE(test_dashboard_send_fail)
+{
+    mock->set_sendCode(-1);
+    auto f = h->robotmode();
+    BOOST_CHECK(ready(f));
+    BOOST_CHECK(f.get() == "");
+    BOOST_CHECK(h->pending() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_dashboard_lost_connection)
+{
+    auto f = h->robotmode();
+
+    // mock returns error on recv, reader gives up and fails the rest
+    BOOST_CHECK(h->start());
+    BOOST_CHECK(f.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    BOOST_CHECK(f.get() == "");
+    BOOST_CHECK(!h->is_connected());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE derived
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/derived.hpp>
+#include <urx/history.hpp>
+#include <urx/log_file.hpp>
+#include <urx/rtde_recipe.hpp>
+#include <urx/replayer.hpp>
+#include <urx/rtde_handler.hpp>
+#include <urx/urx_handler.hpp>
+#include <urx/robot.hpp>
+#include "mocks/mock_con.hpp"
+#include <endian.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include "test_helpers.hpp"
+
+struct Capture : public urx::RTDE_Frame_Sink
+{
+    void on_frame(const unsigned char *payload, unsigned long) override { last = payload; }
+    const unsigned char *last = nullptr;
+};
+
+struct F
+{
+    F() :
+        path_("/tmp/urx-derived-test-" + std::to_string(getpid()) + ".urxlog")
+    {
+        BOOST_REQUIRE(recipe.add_field("timestamp", &ts));
+        BOOST_REQUIRE(recipe.add_field("actual_q", q));
+        BOOST_REQUIRE(recipe.add_field("target_q", tq));
+        BOOST_REQUIRE(recipe.add_field("actual_current", cur));
+        BOOST_REQUIRE(recipe.add_field("actual_joint_voltage", volt));
+        BOOST_REQUIRE(recipe.add_field("actual_TCP_speed", speed));
+        BOOST_REQUIRE(recipe.expected_bytes() == 8 + 5 * 48);
+    }
+
+    ~F()
+    {
+        unlink(path_.c_str());
+    }
+
+    // frame i at t = i * 2ms: q = i + j, target = q + j/10, current
+    // = 1 + i (step at i=1), voltage = 48, TCP speed (3, 4, 0, 1, 1, 1)
+    void feed(int i)
+    {
+        unsigned char buf[8 + 5 * 48];
+        put_double(buf, i * 0.002);
+        for (int j = 0; j < 6; j++) {
+            put_double(buf + 8 + j * 8, i + j);
+            put_double(buf + 56 + j * 8, i + j + j / 10.0);
+            put_double(buf + 104 + j * 8, i ? 2.0 : 1.0);
+            put_double(buf + 152 + j * 8, 48.0);
+            put_double(buf + 200 + j * 8, j == 0 ? 3.0 : j == 1 ? 4.0 : j == 2 ? 0.0 : 1.0);
+        }
+        BOOST_REQUIRE(recipe.parse(buf, 1000 + i));
+    }
+
+    void declare(urx::Derived_Signals& d)
+    {
+        BOOST_REQUIRE(d.product("joint_power", "actual_current", "actual_joint_voltage"));
+        BOOST_REQUIRE(d.difference("tracking_error", "target_q", "actual_q"));
+        BOOST_REQUIRE(d.norm("tcp_speed", "actual_TCP_speed", 0, 3));
+        BOOST_REQUIRE(d.lowpass("current_lp", "actual_current", 0.5));
+        BOOST_REQUIRE(d.scale("power_kw", "joint_power", 1e-3));
+        BOOST_REQUIRE(d.attach());
+    }
+
+    std::string path_;
+    urx::RTDE_Recipe recipe;
+    double ts;
+    double q[6];
+    double tq[6];
+    double cur[6];
+    double volt[6];
+    double speed[6];
+};
+
+BOOST_FIXTURE_TEST_SUITE(derived_test, F)
+
+BOOST_AUTO_TEST_CASE(test_derived_declare)
+{
+    urx::Derived_Signals d(&recipe);
+    BOOST_CHECK(!d.product("p", "actual_current", "no_such_field"));
+    BOOST_CHECK(!d.product("actual_q", "actual_current", "actual_joint_voltage"));
+    BOOST_CHECK(!d.norm("n", "actual_TCP_speed", 4, 3));
+    BOOST_CHECK(!d.lowpass("lp", "actual_q", 0.0));
+    BOOST_CHECK(d.norm("n", "actual_TCP_speed"));
+    BOOST_CHECK(!d.norm("n", "actual_q"));
+
+    // scalar broadcast over a vector, vectors must match
+    BOOST_CHECK(d.product("q_n", "actual_q", "n"));
+    BOOST_CHECK(d.signals().back().width == 6);
+    BOOST_CHECK(d.signals().size() == 2);
+    BOOST_CHECK(d.value("q_n") != nullptr);
+    BOOST_CHECK(d.value("nope") == nullptr);
+
+    BOOST_CHECK(d.attach());
+    BOOST_CHECK(recipe.derived() == &d);
+    BOOST_CHECK(d.extra_bytes() == 8 + 48);
+    BOOST_CHECK(d.signals()[0].offset == (std::size_t)recipe.expected_bytes());
+    BOOST_CHECK(!d.scale("late", "actual_q", 2.0));
+
+    urx::Derived_Signals other(&recipe);
+    BOOST_CHECK(other.norm("n2", "actual_q"));
+    BOOST_CHECK(!other.attach());
+
+    d.detach();
+    BOOST_CHECK(recipe.derived() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_derived_values)
+{
+    urx::Derived_Signals d(&recipe);
+    declare(d);
+    Capture c;
+    recipe.add_sink(&c);
+
+    feed(0);
+    BOOST_CHECK(d.frames() == 1);
+    BOOST_CHECK(c.last != nullptr);
+    BOOST_CHECK_CLOSE(d.value("joint_power")[3], 48.0, 1e-9);
+    BOOST_CHECK_CLOSE(d.value("tracking_error")[5], 0.5, 1e-9);
+    BOOST_CHECK(d.value("tracking_error")[0] == 0.0);
+    BOOST_CHECK_CLOSE(d.value("tcp_speed")[0], 5.0, 1e-9);
+    BOOST_CHECK_CLOSE(d.value("current_lp")[0], 1.0, 1e-9);
+    BOOST_CHECK_CLOSE(d.value("power_kw")[0], 0.048, 1e-9);
+
+    // wire fields untouched, derived values appended big-endian
+    BOOST_CHECK_CLOSE(urx::Decode_Plan::decode(c.last + 8 + 8, DOUBLE), 1.0, 1e-9);
+    std::size_t off = d.signals()[2].offset;
+    BOOST_CHECK_CLOSE(urx::Decode_Plan::decode(c.last + off, DOUBLE), 5.0, 1e-9);
+
+    // current steps to 2, the filter follows halfway each frame
+    feed(1);
+    BOOST_CHECK_CLOSE(d.value("joint_power")[0], 96.0, 1e-9);
+    BOOST_CHECK_CLOSE(d.value("current_lp")[2], 1.5, 1e-9);
+    feed(2);
+    BOOST_CHECK_CLOSE(d.value("current_lp")[2], 1.75, 1e-9);
+    BOOST_CHECK(d.frames() == 3);
+
+    recipe.remove_sink(&c);
+}
+
+BOOST_AUTO_TEST_CASE(test_derived_history)
+{
+    urx::Derived_Signals d(&recipe);
+    declare(d);
+    urx::History h(&recipe, 64);
+    recipe.add_sink(&h);
+    for (int i = 0; i < 10; i++)
+        feed(i);
+
+    BOOST_CHECK(h.num_columns() == 1 + 5 * 6 + 6 + 6 + 1 + 6 + 6);
+    int pw = h.column("joint_power", 1);
+    int err = h.column("tracking_error", 4);
+    int spd = h.column("tcp_speed");
+    BOOST_REQUIRE(pw > 0 && err > 0 && spd > 0);
+    BOOST_CHECK(h.column_name(spd) == "tcp_speed");
+    BOOST_CHECK(h.column("tcp_speed", 1) == -1);
+    BOOST_CHECK(h.columns("joint_power").size() == 6);
+
+    urx::History_Snapshot snap;
+    BOOST_CHECK(h.last(1.0, {pw, err, spd}, snap));
+    BOOST_REQUIRE(snap.size() == 10);
+    BOOST_CHECK_CLOSE(snap.cols[0][0], 48.0, 1e-9);
+    BOOST_CHECK_CLOSE(snap.cols[0][9], 96.0, 1e-9);
+    BOOST_CHECK_CLOSE(snap.cols[1][9], 0.4, 1e-9);
+    BOOST_CHECK_CLOSE(snap.cols[2][5], 5.0, 1e-9);
+    recipe.remove_sink(&h);
+}
+
+BOOST_AUTO_TEST_CASE(test_derived_log)
+{
+    urx::Derived_Signals d(&recipe);
+    declare(d);
+    {
+        urx::Log_Writer w(&recipe, 16);
+        BOOST_REQUIRE(w.open(path_));
+        recipe.add_sink(&w);
+        for (int i = 0; i < 20; i++)
+            feed(i);
+        recipe.remove_sink(&w);
+        BOOST_CHECK(w.frames() == 20);
+    }
+
+    urx::Log_Reader r;
+    BOOST_REQUIRE(r.open(path_));
+    BOOST_CHECK(r.num_frames() == 20);
+    int lp = r.column("current_lp", 0);
+    int spd = r.column("tcp_speed");
+    BOOST_REQUIRE(lp > 0 && spd > 0);
+    BOOST_CHECK(r.column_type(lp) == DOUBLE);
+    const double *v = r.view<double>(0, spd);
+    BOOST_REQUIRE(v);
+    BOOST_CHECK_CLOSE(v[15], 5.0, 1e-9);
+    BOOST_CHECK_CLOSE(r.value(0, lp, 1), 1.5, 1e-9);
+    BOOST_CHECK_CLOSE(r.value(1, r.column("power_kw", 2), 3), 0.096, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_derived_robot_state)
+{
+    // target_qd = (3, 4, i, 0, 0, 0) for frame i
+    {
+        urx::RTDE_Recipe rec;
+        double t;
+        double qd[6];
+        BOOST_REQUIRE(rec.add_field("timestamp", &t));
+        BOOST_REQUIRE(rec.add_field("target_qd", qd));
+        urx::Log_Writer w(&rec, 16);
+        BOOST_REQUIRE(w.open(path_));
+        rec.add_sink(&w);
+        unsigned char buf[8 + 48];
+        for (int i = 0; i < 10; i++) {
+            put_double(buf, 1.0 + i * 0.002);
+            for (int j = 0; j < 6; j++)
+                put_double(buf + 8 + j * 8, j == 0 ? 3.0 : j == 1 ? 4.0 : j == 2 ? i : 0.0);
+            BOOST_REQUIRE(rec.parse(buf, 1000000UL * i));
+        }
+        rec.remove_sink(&w);
+    }
+
+    auto rp = new urx::Replayer(path_, 0.0);
+    urx::Robot robot(new urx::URX_Handler(new urx::Con_mock()), new urx::RTDE_Handler(rp));
+    robot.set_reconnect(false);
+    BOOST_REQUIRE(robot.init_output());
+    auto d = robot.enable_derived();
+    BOOST_REQUIRE(d);
+    BOOST_REQUIRE(d->norm("qd_xy", "target_qd", 0, 2));
+    BOOST_REQUIRE(d->scale("qd_z2", "target_qd", 2.0));
+    BOOST_REQUIRE(d->attach());
+    int xy = d->slot("qd_xy");
+    int z2 = d->slot("qd_z2");
+    BOOST_REQUIRE(xy >= 0 && z2 >= 0);
+    BOOST_CHECK(d->slot("nope") == -1);
+    BOOST_CHECK(robot.state(false).derived.empty());
+
+    BOOST_REQUIRE(robot.start());
+    BOOST_CHECK(rp->wait_finished(2000));
+    for (int i = 0; i < 100 && d->frames() < 10; i++)
+        usleep(1000);
+
+    // a copy, taken with the rest of the state
+    urx::Robot_State st = robot.state(false);
+    BOOST_REQUIRE(st.derived.size() == d->values().size());
+    BOOST_CHECK_CLOSE(st.derived[xy], 5.0, 1e-9);
+    BOOST_CHECK_CLOSE(st.derived[z2 + 2], 18.0, 1e-9);
+    BOOST_CHECK(robot.stop());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
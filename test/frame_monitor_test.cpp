@@ -0,0 +1,94 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE frame_monitor
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/frame_monitor.hpp>
+#include <urx/robot.hpp>
+
+BOOST_AUTO_TEST_SUITE(frame_monitor_test)
+
+BOOST_AUTO_TEST_CASE(test_frame_monitor_no_gaps)
+{
+    urx::Frame_Monitor fm(urx::PERIOD_500HZ);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(fm.update(41.0 + i * 0.002, 1) == 0);
+
+    urx::Frame_Stats s = fm.stats();
+    BOOST_CHECK(s.frames == 100);
+    BOOST_CHECK(s.gaps == 0);
+    BOOST_CHECK(s.missed == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_frame_monitor_gap_callback)
+{
+    urx::Frame_Monitor fm(urx::PERIOD_500HZ);
+    int cb_missed = 0;
+    fm.on_gap([&](const urx::Frame_Gap& g) { cb_missed = g.missed; });
+
+    BOOST_CHECK(fm.update(10.000, 1) == 0);
+    BOOST_CHECK(fm.update(10.002, 1) == 0);
+    BOOST_CHECK(fm.update(10.008, 2) == 2);
+    BOOST_CHECK(cb_missed == 2);
+    BOOST_CHECK(fm.update(10.010, 3) == 0);
+    BOOST_CHECK(fm.update(10.020, 3) == 4);
+
+    urx::Frame_Stats s = fm.stats();
+    BOOST_CHECK(s.gaps == 2);
+    BOOST_CHECK(s.missed == 6);
+    BOOST_CHECK(s.max_missed == 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_frame_monitor_duplicate_and_seqnr)
+{
+    urx::Frame_Monitor fm(urx::PERIOD_125HZ);
+    fm.update(1.000, 10);
+    BOOST_CHECK(fm.update(1.000, 10) == -1);
+    BOOST_CHECK(fm.update(1.008, 9) == 0);
+
+    urx::Frame_Stats s = fm.stats();
+    BOOST_CHECK(s.duplicates == 1);
+    BOOST_CHECK(s.seqnr_regressions == 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_frame_monitor_learn_period)
+{
+    urx::Frame_Monitor fm;
+    BOOST_CHECK(fm.period() == 0.0);
+
+    // a lost frame while learning should not double the period
+    double ts = 5.0;
+    fm.update(ts, 0);
+    for (int i = 0; i < 8; i++) {
+        ts += (i == 3) ? 0.016 : 0.008;
+        fm.update(ts, 0);
+    }
+    BOOST_CHECK_CLOSE(fm.period(), urx::PERIOD_125HZ, 1e-9);
+    BOOST_CHECK(fm.update(ts + 0.024, 0) == 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_extrapolate_linear)
+{
+    urx::Robot_State last;
+    last.ur_ts = 1.0;
+    for (std::size_t i = 0; i < urx::DOF; i++) {
+        last.jq[i] = 1.0;
+        last.jqd[i] = 0.5;
+        last.jqdd[i] = 0.0;
+    }
+    urx::Robot_State next(last);
+    urx::extrapolate_linear(last, next, 0.002);
+    BOOST_CHECK_CLOSE(next.ur_ts, 1.002, 1e-9);
+    for (std::size_t i = 0; i < urx::DOF; i++) {
+        BOOST_CHECK_CLOSE(next.jq[i], 1.001, 1e-9);
+        BOOST_CHECK_CLOSE(next.jqd[i], 0.5, 1e-9);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE heartbeat
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/heartbeat.hpp>
+#include <urx/replayer.hpp>
+#include <urx/log_file.hpp>
+#include <urx/rtde_handler.hpp>
+#include <urx/urx_handler.hpp>
+#include <urx/robot.hpp>
+#include "mocks/mock_con.hpp"
+#include <endian.h>
+#include <unistd.h>
+#include <cstring>
+#include <string>
+#include "test_helpers.hpp"
+
+struct F
+{
+    F() : hb(3)
+    {
+        BOOST_REQUIRE(hb.add_output_fields(&out));
+        in.dir_input();
+        BOOST_REQUIRE(hb.add_input_fields(&in));
+    }
+
+    // script frame with seqnr and missed host beats
+    void frame(int32_t seqnr, int32_t missed, int64_t rx_ns, bool expect = true)
+    {
+        unsigned char buf[8];
+        put_int(buf, seqnr);
+        put_int(buf + 4, missed);
+        BOOST_REQUIRE(out.parse(buf, rx_ns));
+        BOOST_CHECK(hb.check(rx_ns) == expect);
+    }
+
+    urx::Heartbeat hb;
+    urx::RTDE_Recipe out;
+    urx::RTDE_Recipe in;
+};
+
+BOOST_FIXTURE_TEST_SUITE(heartbeat_test, F)
+
+BOOST_AUTO_TEST_CASE(test_heartbeat_fields)
+{
+    // allocated above the Trajectory_Stream registers
+    BOOST_CHECK(out.get_fields() == "output_int_register_25,output_int_register_26");
+    BOOST_CHECK(in.get_fields() == "input_int_register_26,input_int_register_27");
+    auto p = hb.params();
+    BOOST_CHECK(p.size() == 4);
+    BOOST_CHECK(p["hb_seqnr"] == "26");
+    BOOST_CHECK(p["hb_limit"] == "27");
+    BOOST_CHECK(p["hb_script_seqnr"] == "25");
+    BOOST_CHECK(p["hb_script_missed"] == "26");
+    BOOST_CHECK(urx::Heartbeat::default_params() == p);
+
+    // a map sharing the recipes skips them
+    urx::Register_Map map;
+    int32_t v;
+    BOOST_CHECK(hb.reserve(&map));
+    BOOST_CHECK(map.add_int("v", urx::REG_IN, &v) == 28);
+    BOOST_CHECK(!hb.reserve(nullptr));
+
+    BOOST_CHECK(hb.max_missed() == 3);
+    BOOST_CHECK(urx::Heartbeat(0).max_missed() == 1);
+    BOOST_CHECK(!hb.add_input_fields(nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(test_heartbeat_scripts)
+{
+    // every streaming script keeps the script side of the heartbeat
+    for (auto name : {"ur_speedj.script", "tcp_pose.script", "ur_servoj_stream.script"}) {
+        BOOST_CHECK(!urx::Script_Cache::global().script(name, urx::Script_Params()));
+        auto s = urx::Script_Cache::global().script(name, hb.params());
+        BOOST_REQUIRE(s);
+        BOOST_CHECK(s->find("${") == std::string::npos);
+        BOOST_CHECK(s->find("write_output_integer_register(25, script_hb)") != std::string::npos);
+        BOOST_CHECK(s->find("read_input_integer_register(27)") != std::string::npos);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_heartbeat_beat)
+{
+    hb.beat();
+    hb.beat();
+    BOOST_CHECK(hb.stats().beats == 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_heartbeat_stall)
+{
+    int stalls = 0;
+    int64_t latency = 0;
+    hb.on_stall([&](int64_t ns) { stalls++; latency = ns; });
+
+    // script beating every 2ms
+    for (int i = 0; i < 10; i++)
+        frame(i, 0, i * 2000000L);
+    BOOST_CHECK(hb.alive());
+
+    // script stuck on 9, lost on the third repeat and reported once
+    frame(9, 0, 20000000L);
+    frame(9, 0, 22000000L);
+    frame(9, 0, 24000000L, false);
+    frame(9, 0, 26000000L, false);
+    BOOST_CHECK(!hb.alive());
+    BOOST_CHECK(stalls == 1);
+    BOOST_CHECK(latency == 6000000L);
+
+    // and back
+    frame(10, 0, 28000000L);
+    BOOST_CHECK(hb.alive());
+
+    auto s = hb.stats();
+    BOOST_CHECK(s.frames == 15);
+    BOOST_CHECK(s.stalls == 1);
+    BOOST_CHECK(s.recoveries == 1);
+    BOOST_CHECK_CLOSE(s.last_detect_ms, 6.0, 1e-9);
+    BOOST_CHECK_CLOSE(s.max_detect_ms, 6.0, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(test_heartbeat_script_view)
+{
+    frame(1, 0, 0);
+    frame(2, 2, 2000000L);
+    frame(3, 4, 4000000L);
+    frame(4, 0, 6000000L);
+    auto s = hb.stats();
+    BOOST_CHECK(s.script_missed == 0);
+    BOOST_CHECK(s.max_script_missed == 4);
+
+    hb.reset();
+    BOOST_CHECK(hb.stats().max_script_missed == 0);
+    BOOST_CHECK(hb.stats().frames == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_heartbeat_robot)
+{
+    // script beats for 100 frames, then hangs
+    std::string path = "/tmp/urx-hb-test-" + std::to_string(getpid()) + ".urxlog";
+    {
+        urx::RTDE_Recipe rec;
+        double ts;
+        int32_t reg[2];
+        BOOST_REQUIRE(rec.add_field("timestamp", &ts));
+        BOOST_REQUIRE(rec.add_field("output_int_register_25", &reg[0]));
+        BOOST_REQUIRE(rec.add_field("output_int_register_26", &reg[1]));
+        urx::Log_Writer w(&rec, 100);
+        BOOST_REQUIRE(w.open(path));
+        rec.add_sink(&w);
+        unsigned char buf[16];
+        for (int i = 0; i < 150; i++) {
+            put_double(buf, 1.0 + i * 0.002);
+            put_int(buf + 8, i < 100 ? i : 99);
+            put_int(buf + 12, 0);
+            BOOST_REQUIRE(rec.parse(buf, 1000000UL * i));
+        }
+        rec.remove_sink(&w);
+    }
+
+    auto rp = new urx::Replayer(path, 10.0);
+    urx::Robot robot(new urx::URX_Handler(new urx::Con_mock()), new urx::RTDE_Handler(rp));
+    robot.set_reconnect(false);
+    BOOST_CHECK(robot.heartbeat_stats().frames == 0);
+    BOOST_REQUIRE(robot.enable_heartbeat(5));
+    std::atomic<int> lost(0);
+    robot.on_heartbeat_lost([&](int64_t) { lost++; });
+    BOOST_REQUIRE(robot.init());
+    BOOST_CHECK(!robot.enable_heartbeat(5));
+    BOOST_REQUIRE(robot.start());
+
+    std::vector<double> w(6, 0.0);
+    BOOST_CHECK(robot.update_w(w));
+    BOOST_CHECK(robot.update_w(w));
+    BOOST_CHECK(rp->wait_finished(2000));
+    for (int i = 0; i < 100 && robot.heartbeat_stats().frames < 150; i++)
+        usleep(1000);
+
+    auto s = robot.heartbeat_stats();
+    BOOST_CHECK(s.frames == 150);
+    BOOST_CHECK(s.beats == 2);
+    BOOST_CHECK(s.stalls == 1);
+    BOOST_CHECK(lost == 1);
+    // 5 frames of 0.2ms at 10x
+    BOOST_CHECK(s.last_detect_ms > 0.5 && s.last_detect_ms < 50.0);
+    BOOST_CHECK(robot.stop());
+    unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE history
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/history.hpp>
+#include <urx/rtde_recipe.hpp>
+#include <endian.h>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include "test_helpers.hpp"
+
+struct F
+{
+    F()
+    {
+        BOOST_REQUIRE(recipe.add_field("timestamp", &ts));
+        BOOST_REQUIRE(recipe.add_field("actual_q", q));
+        BOOST_REQUIRE(recipe.add_field("output_int_register_0", &reg));
+    }
+
+    // frame i at t = i * 2ms, joint j = i + j/10, register -i
+    void feed(urx::RTDE_Recipe& r, int i, double t0 = 0.0)
+    {
+        unsigned char buf[8 + 48 + 4];
+        put_double(buf, t0 + i * 0.002);
+        for (int j = 0; j < 6; j++)
+            put_double(buf + 8 + j * 8, i + j / 10.0);
+        put_int(buf + 56, -i);
+        BOOST_REQUIRE(r.parse(buf, 1000));
+    }
+
+    urx::RTDE_Recipe recipe;
+    double ts;
+    double q[6];
+    int32_t reg;
+};
+
+BOOST_FIXTURE_TEST_SUITE(history_test, F)
+
+BOOST_AUTO_TEST_CASE(test_history_columns)
+{
+    urx::History h(&recipe, 100);
+    BOOST_CHECK(h.capacity() == 128);
+    BOOST_CHECK(h.num_columns() == 1 + 6 + 1);
+    BOOST_CHECK(h.column("timestamp") == 0);
+    BOOST_CHECK(h.column("actual_q", 0) == 1);
+    BOOST_CHECK(h.column("actual_q", 5) == 6);
+    BOOST_CHECK(h.column("actual_q", 6) == -1);
+    BOOST_CHECK(h.column("output_int_register_0") == 7);
+    BOOST_CHECK(h.column("target_q") == -1);
+    BOOST_CHECK(h.columns("actual_q").size() == 6);
+    BOOST_CHECK(h.column_name(3) == "actual_q[2]");
+    BOOST_CHECK(h.size() == 0);
+    BOOST_CHECK(h.latest() < 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_history_window)
+{
+    urx::History h(&recipe, 64);
+    recipe.add_sink(&h);
+    for (int i = 0; i < 50; i++)
+        feed(recipe, i);
+
+    BOOST_CHECK(h.size() == 50);
+    BOOST_CHECK_CLOSE(h.latest(), 49 * 0.002, 1e-9);
+
+    urx::History_Snapshot snap;
+    int q2 = h.column("actual_q", 2);
+    int reg = h.column("output_int_register_0");
+    BOOST_CHECK(h.snapshot(0.0199, 0.0401, {q2, reg}, snap));
+    BOOST_REQUIRE(snap.size() == 11);
+    BOOST_CHECK_CLOSE(snap.ts[0], 0.020, 1e-9);
+    BOOST_CHECK_CLOSE(snap.cols[0][0], 10.2, 1e-9);
+    BOOST_CHECK(snap.cols[1][10] == -20.0);
+
+    // last 10 frames (t1 - 0.018 .. t1)
+    BOOST_CHECK(h.last(0.0181, {q2}, snap));
+    BOOST_CHECK(snap.size() == 10);
+    BOOST_CHECK_CLOSE(snap.cols[0][9], 49.2, 1e-9);
+
+    BOOST_CHECK(!h.snapshot(0.0, 1.0, {42}, snap));
+    BOOST_CHECK(h.snapshot(5.0, 6.0, {q2}, snap));
+    BOOST_CHECK(snap.size() == 0);
+    recipe.remove_sink(&h);
+}
+
+BOOST_AUTO_TEST_CASE(test_history_wrap_and_stats)
+{
+    urx::History h(&recipe, 32);
+    recipe.add_sink(&h);
+    for (int i = 0; i < 100; i++)
+        feed(recipe, i);
+
+    // 31 stable frames: 69..99
+    BOOST_CHECK(h.size() == 31);
+    urx::History_Snapshot snap;
+    BOOST_CHECK(h.snapshot(0.0, 1.0, {h.column("actual_q", 0)}, snap));
+    BOOST_REQUIRE(snap.size() == 31);
+    for (std::size_t i = 0; i < snap.size(); i++)
+        BOOST_CHECK(snap.cols[0][i] == 69.0 + i);
+
+    urx::History_Stats s;
+    BOOST_CHECK(h.stats(0.0, 1.0, h.column("actual_q", 0), s));
+    BOOST_CHECK(s.n == 31);
+    BOOST_CHECK(s.min == 69.0);
+    BOOST_CHECK(s.max == 99.0);
+    BOOST_CHECK_CLOSE(s.mean, 84.0, 1e-9);
+    double sq = 0;
+    for (int i = 69; i < 100; i++)
+        sq += (double)i * i;
+    BOOST_CHECK_CLOSE(s.rms, std::sqrt(sq / 31), 1e-9);
+
+    auto per_joint = h.stats(0.0, 1.0, "actual_q");
+    BOOST_REQUIRE(per_joint.size() == 6);
+    BOOST_CHECK_CLOSE(per_joint[5].max, 99.5, 1e-9);
+
+    // controller restarted, time went backwards
+    feed(recipe, 0, 0.0);
+    BOOST_CHECK(h.size() == 1);
+    BOOST_CHECK(h.latest() == 0.0);
+    recipe.remove_sink(&h);
+}
+
+BOOST_AUTO_TEST_CASE(test_history_concurrent_readers)
+{
+    urx::History h(&recipe, 256);
+    recipe.add_sink(&h);
+    std::atomic<bool> done(false);
+    std::atomic<int> bad(0);
+
+    // every snapshot must be consistent: actual_q[0] == frame index,
+    // register == -index and keys strictly increasing
+    std::thread reader([&]() {
+        urx::History_Snapshot snap;
+        std::vector<int> cols = {h.column("actual_q", 0), h.column("output_int_register_0")};
+        while (!done) {
+            if (!h.last(0.3, cols, snap))
+                continue;
+            for (std::size_t i = 0; i < snap.size(); i++) {
+                if (snap.cols[0][i] != -snap.cols[1][i] ||
+                    std::fabs(snap.ts[i] - snap.cols[0][i] * 0.002) > 1e-9)
+                    bad++;
+                if (i && snap.ts[i] <= snap.ts[i - 1])
+                    bad++;
+            }
+        }
+    });
+    for (int i = 0; i < 200000; i++)
+        feed(recipe, i);
+    done = true;
+    reader.join();
+    BOOST_CHECK(bad == 0);
+    recipe.remove_sink(&h);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,8 @@
 
 #include <string.h>
 #include <string>
+#include <deque>
+#include <utility>
 #include <urx/con.hpp>
 
 namespace urx {
@@ -21,7 +23,9 @@ namespace urx {
             Con("mock.ex.org", 1),
             send_code(-1),
             ssz_(-1),
-            rsz_(-1)
+            rsz_(-1),
+            connects_(0),
+            connect_ok_(true)
         {};
 
         virtual ~Con_mock() =default;
@@ -31,7 +35,13 @@ namespace urx {
             connected_ = false;
         };
 
-        bool do_connect(bool nodelay = false) { (void)nodelay; connected_ = true; return true; };
+        bool do_connect(bool nodelay = false)
+        {
+            (void)nodelay;
+            connects_++;
+            connected_ = connect_ok_;
+            return connected_;
+        };
 
         int do_send(void *buf , int sz)
         {
@@ -46,6 +56,18 @@ namespace urx {
 
         int do_recv(void* rbuf, int rsz, unsigned long *rx_ns)
         {
+            // queued responses first (one per call), then the default
+            if (!queue_.empty()) {
+                auto q = queue_.front();
+                queue_.pop_front();
+                if (q.second > rsz)
+                    return -1;
+                memcpy(rbuf, q.first, q.second);
+                if (rx_ns)
+                    *rx_ns = rx_ns_;
+                return q.second;
+            }
+
             // avoid buffer overflows in test-harness
             if (rsz_ > rsz || rsz_ < 0 || rsz < 0)
                 return -1;
@@ -55,6 +77,12 @@ namespace urx {
             return rsz_;
         };
 
+        int recv_for(void *rbuf, int rsz, int timeout_ms, unsigned long *rx_ns)
+        {
+            (void)timeout_ms;
+            return do_recv(rbuf, rsz, rx_ns);
+        };
+
         int do_send_recv(void *sbuf, int sz, void *rbuf, int rsz)
         {
             if (do_send(sbuf, sz) >= 0)
@@ -71,6 +99,13 @@ namespace urx {
         };
         void set_recv_ts(int ts_ns) { rx_ns_ = ts_ns; };
 
+        // Queue a response to be returned (once) before the default buffer
+        void push_recvBuf(unsigned char *rbuf, int rsz) { queue_.push_back({rbuf, rsz}); };
+
+        // Pretend remote is gone (or back)
+        void set_connect_ok(bool ok) { connect_ok_ = ok; };
+        int connects() { return connects_; };
+
         // Set a reference to a buffer into which sent frames will be stored.
         void set_sendBuffer(unsigned char *buf, int ssz)
         {
@@ -86,6 +121,9 @@ namespace urx {
         unsigned long rx_ns_;
         unsigned char *sbuf_;
         unsigned char *rbuf_;
+        int connects_;
+        bool connect_ok_;
+        std::deque<std::pair<unsigned char *, int>> queue_;
     };
 }
 #endif // MOCK_RTDE_CON_HPP
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE phase_lock
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/phase_lock.hpp>
+#include <random>
+
+BOOST_AUTO_TEST_SUITE(phase_lock_test)
+
+BOOST_AUTO_TEST_CASE(test_phase_lock_initial)
+{
+    urx::Phase_Lock pl;
+    BOOST_CHECK(!pl.locked());
+
+    int64_t t = 1000000000;
+    for (int i = 0; i < 16; i++, t += 2000000)
+        pl.on_arrival(t, 0.002);
+    BOOST_CHECK(pl.locked());
+
+    // starts out at half a cycle after the last arrival
+    BOOST_CHECK(pl.release_ns() == t - 2000000 + 1000000);
+    BOOST_CHECK(pl.stats().offset_ns == 1000000);
+}
+
+BOOST_AUTO_TEST_CASE(test_phase_lock_feedback)
+{
+    urx::Phase_Lock pl;
+    pl.on_arrival(0, 0.002);
+    int64_t start = pl.stats().offset_ns;
+
+    pl.report(false);
+    BOOST_CHECK(pl.stats().offset_ns < start);
+    BOOST_CHECK(pl.stats().misses == 1);
+
+    int64_t after_miss = pl.stats().offset_ns;
+    for (int i = 0; i < 32; i++)
+        pl.report(true);
+    BOOST_CHECK(pl.stats().offset_ns > after_miss);
+    BOOST_CHECK_CLOSE(pl.stats().hit_rate, 32.0 / 33.0, 1e-6);
+
+    // never negative
+    for (int i = 0; i < 100; i++)
+        pl.report(false);
+    BOOST_CHECK(pl.stats().offset_ns == 0);
+}
+
+// Simulated controller, frames leave at the start of each cycle and
+// reach us after 100-400us. Inputs are sampled 1.2ms into the cycle and
+// the update needs 150us to get there, so anything sent later than
+// ~1.05ms after the cycle start misses.
+BOOST_AUTO_TEST_CASE(test_phase_lock_converges)
+{
+    constexpr int64_t period = 2000000;
+    constexpr int64_t read_point = 1200000;
+    constexpr int64_t tx_delay = 150000;
+
+    std::mt19937 gen(1337);
+    std::uniform_int_distribution<int64_t> delay(100000, 400000);
+
+    urx::Phase_Lock pl;
+    int64_t cycle = 5000000000;
+    int late_hits = 0;
+    for (int i = 0; i < 5000; i++, cycle += period) {
+        pl.on_arrival(cycle + delay(gen), 0.002);
+        if (!pl.locked())
+            continue;
+        bool hit = pl.release_ns() + tx_delay <= cycle + read_point;
+        pl.report(hit);
+        if (i > 4000 && hit)
+            late_hits++;
+    }
+
+    urx::Phase_Lock_Stats s = pl.stats();
+    BOOST_TEST_MESSAGE("offset: " << s.offset_ns << " ns, hit-rate: " << s.hit_rate);
+    BOOST_CHECK(s.hit_rate > 0.95);
+    BOOST_CHECK(late_hits > 950);
+
+    // should have moved *past* the initial guess (1ms) towards the read-point
+    BOOST_CHECK(s.offset_ns > 500000);
+    BOOST_CHECK(s.offset_ns < read_point);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
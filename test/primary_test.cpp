@@ -0,0 +1,223 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE primary
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/primary.hpp>
+#include <urx/urx_handler.hpp>
+#include "mocks/mock_con.hpp"
+#include <thread>
+#include <chrono>
+
+static uint64_t be_double(double d)
+{
+    uint64_t v;
+    memcpy(&v, &d, sizeof(v));
+    return htobe64(v);
+}
+
+// Build a robot-state message with robot-mode, joint and masterboard
+// data (plus an unknown package that must be skipped).
+static std::vector<unsigned char> robot_state(int robot_mode, int safety_mode, bool running, double q0)
+{
+    struct primary_robot_mode_data rm;
+    memset(&rm, 0, sizeof(rm));
+    rm.hdr.size = htobe32(sizeof(rm));
+    rm.hdr.type = PRIMARY_ROBOT_MODE_DATA;
+    rm.timestamp = htobe64(1234);
+    rm.robot_power_on = true;
+    rm.program_running = running;
+    rm.robot_mode = robot_mode;
+    rm.speed_scaling = be_double(0.5);
+
+    struct primary_joint_data jd;
+    memset(&jd, 0, sizeof(jd));
+    jd.hdr.size = htobe32(sizeof(jd));
+    jd.hdr.type = PRIMARY_JOINT_DATA;
+    for (int i = 0; i < 6; i++) {
+        jd.joint[i].q_actual = be_double(q0 + i);
+        jd.joint[i].joint_mode = 253;
+    }
+
+    unsigned char unknown[9] = { 0, 0, 0, 9, 2, 0xde, 0xad, 0xbe, 0xef };
+
+    struct primary_masterboard_data mb;
+    memset(&mb, 0, sizeof(mb));
+    mb.hdr.size = htobe32(sizeof(mb));
+    mb.hdr.type = PRIMARY_MASTERBOARD_DATA;
+    mb.safety_mode = safety_mode;
+
+    struct primary_header hdr;
+    hdr.size = htobe32(sizeof(hdr) + sizeof(rm) + sizeof(jd) + sizeof(unknown) + sizeof(mb));
+    hdr.type = PRIMARY_ROBOT_STATE;
+
+    std::vector<unsigned char> res;
+    auto append = [&](const void *p, std::size_t sz) {
+        std::size_t pos = res.size();
+        res.resize(pos + sz);
+        memcpy(res.data() + pos, p, sz);
+    };
+    append(&hdr, sizeof(hdr));
+    append(&rm, sizeof(rm));
+    append(&jd, sizeof(jd));
+    append(unknown, sizeof(unknown));
+    append(&mb, sizeof(mb));
+    return res;
+}
+
+static std::vector<unsigned char> error_code(int code, const std::string& text)
+{
+    struct primary_error_code ec;
+    memset(&ec, 0, sizeof(ec));
+    ec.msg.hdr.size = htobe32(sizeof(ec) + text.size());
+    ec.msg.hdr.type = PRIMARY_ROBOT_MESSAGE;
+    ec.msg.message_type = PRIMARY_MESSAGE_ERROR_CODE;
+    ec.code = htobe32(code);
+    ec.report_level = htobe32(3);
+
+    std::vector<unsigned char> res(sizeof(ec) + text.size());
+    memcpy(res.data(), &ec, sizeof(ec));
+    memcpy(res.data() + sizeof(ec), text.data(), text.size());
+    return res;
+}
+
+BOOST_AUTO_TEST_SUITE(primary_test)
+
+BOOST_AUTO_TEST_CASE(test_primary_struct_sizes)
+{
+    BOOST_CHECK(sizeof(struct primary_header) == 5);
+    BOOST_CHECK(sizeof(struct primary_joint) == 41);
+    BOOST_CHECK(sizeof(struct primary_robot_mode_data) == 5 + 8 + 7 + 2 + 3 * 8);
+    BOOST_CHECK(sizeof(struct primary_masterboard_data) == 5 + 60 + 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_primary_robot_state)
+{
+    urx::Primary_Parser p;
+    std::vector<unsigned char> msg = robot_state(7, 1, true, 0.25);
+    BOOST_CHECK(p.feed(msg.data(), msg.size()) == 1);
+
+    urx::Primary_State s = p.state();
+    BOOST_CHECK(s.ts == 1234);
+    BOOST_CHECK(s.robot_mode == 7);
+    BOOST_CHECK(s.safety_mode == 1);
+    BOOST_CHECK(s.program_state == urx::PROGRAM_RUNNING);
+    BOOST_CHECK(s.power_on);
+    BOOST_CHECK_CLOSE(s.speed_scaling, 0.5, 1e-9);
+    BOOST_CHECK_CLOSE(s.q[0], 0.25, 1e-9);
+    BOOST_CHECK_CLOSE(s.q[5], 5.25, 1e-9);
+    BOOST_CHECK(s.joint_mode[3] == 253);
+    BOOST_CHECK(p.stats().malformed == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_primary_fragmented)
+{
+    urx::Primary_Parser p;
+    std::vector<unsigned char> stream = robot_state(5, 1, false, 0.0);
+    std::vector<unsigned char> err = error_code(263, "Protective stop");
+    std::vector<unsigned char> second = robot_state(7, 3, true, 1.0);
+    stream.insert(stream.end(), err.begin(), err.end());
+    stream.insert(stream.end(), second.begin(), second.end());
+
+    std::vector<std::pair<int, int>> modes;
+    std::vector<std::pair<int, int>> safety;
+    std::vector<urx::Primary_Error> errors;
+    p.on_robot_mode([&](int prev, int mode) { modes.push_back({prev, mode}); });
+    p.on_safety_mode([&](int prev, int mode) { safety.push_back({prev, mode}); });
+    p.on_error([&](const urx::Primary_Error& e) { errors.push_back(e); });
+
+    // feed in odd-sized chunks, splitting headers as well as payload
+    int parsed = 0;
+    for (std::size_t pos = 0; pos < stream.size(); pos += 3)
+        parsed += p.feed(stream.data() + pos, std::min<std::size_t>(3, stream.size() - pos));
+    BOOST_CHECK(parsed == 3);
+    BOOST_CHECK(p.stats().messages == 3);
+    BOOST_CHECK(p.stats().bytes == stream.size());
+
+    BOOST_REQUIRE(modes.size() == 2);
+    BOOST_CHECK(modes[0].first == -1);
+    BOOST_CHECK(modes[0].second == 5);
+    BOOST_CHECK(modes[1].first == 5);
+    BOOST_CHECK(modes[1].second == 7);
+
+    BOOST_REQUIRE(safety.size() == 2);
+    BOOST_CHECK(safety[1].second == 3);
+
+    BOOST_REQUIRE(errors.size() == 1);
+    BOOST_CHECK(errors[0].code == 263);
+    BOOST_CHECK(errors[0].report_level == 3);
+    BOOST_CHECK(errors[0].text == "Protective stop");
+
+    // same state again, no callbacks
+    p.feed(second.data(), second.size());
+    BOOST_CHECK(modes.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_primary_malformed)
+{
+    urx::Primary_Parser p;
+    unsigned char bad[8] = { 0, 0, 0, 2, 16, 0, 0, 0 };
+    BOOST_CHECK(p.feed(bad, sizeof(bad)) == -1);
+    BOOST_CHECK(p.stats().malformed == 1);
+
+    // sub-package claiming to be larger than the message
+    std::vector<unsigned char> msg = robot_state(7, 1, true, 0.0);
+    msg[5 + 3] = 0xff;
+    BOOST_CHECK(!p.parse_message(msg.data(), msg.size()));
+    BOOST_CHECK(p.state().robot_mode == -1);
+
+    // bad length after a good message, nothing kept for the next feed()
+    urx::Primary_Parser q;
+    std::vector<unsigned char> good = robot_state(7, 1, true, 0.0);
+    std::vector<unsigned char> stream = good;
+    stream.insert(stream.end(), bad, bad + sizeof(bad));
+    stream.insert(stream.end(), good.begin(), good.begin() + 3);
+    BOOST_CHECK(q.feed(stream.data(), stream.size()) == -1);
+    BOOST_CHECK(q.stats().malformed == 1);
+    BOOST_CHECK(q.state().robot_mode == 7);
+    BOOST_CHECK(q.feed(good.data(), good.size()) == 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_primary_reader)
+{
+    urx::Con_mock *mock = new urx::Con_mock();
+    urx::URX_Handler h(mock);
+    std::vector<unsigned char> msg = robot_state(7, 1, true, 0.0);
+    mock->set_recvBuf(msg.data(), msg.size());
+
+    BOOST_CHECK(h.start_reader());
+    BOOST_CHECK(h.reading());
+    for (int i = 0; i < 100 && h.primary().stats().state_updates == 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    h.stop_reader();
+    BOOST_CHECK(!h.reading());
+    BOOST_CHECK(h.primary().stats().state_updates > 0);
+    BOOST_CHECK(h.primary().state().robot_mode == 7);
+}
+
+BOOST_AUTO_TEST_CASE(test_primary_reader_resync)
+{
+    urx::Con_mock *mock = new urx::Con_mock();
+    urx::URX_Handler h(mock);
+    int connects = mock->connects();
+    unsigned char bad[8] = { 0, 0, 0, 2, 16, 0, 0, 0 };
+    std::vector<unsigned char> msg = robot_state(7, 1, true, 0.0);
+    mock->push_recvBuf(bad, sizeof(bad));
+    mock->set_recvBuf(msg.data(), msg.size());
+
+    BOOST_CHECK(h.start_reader());
+    for (int i = 0; i < 100 && h.primary().stats().state_updates == 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    h.stop_reader();
+    BOOST_CHECK(mock->connects() == connects + 1);
+    BOOST_CHECK(h.primary().stats().malformed == 1);
+    BOOST_CHECK(h.primary().state().robot_mode == 7);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
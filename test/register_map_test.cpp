@@ -0,0 +1,153 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE register_map
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/register_map.hpp>
+#include <urx/header.hpp>
+#include <endian.h>
+
+struct F
+{
+    F()
+    {
+        in.dir_input();
+    }
+    urx::Register_Map map;
+    urx::RTDE_Recipe in;
+    urx::RTDE_Recipe out;
+
+    int32_t seqnr;
+    int32_t echo;
+    double qd[6];
+    double gain;
+    bool stop;
+    bool flags[3];
+    bool done;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, F)
+
+BOOST_AUTO_TEST_CASE(test_register_map_alloc)
+{
+    // trajectory block (in int 24..25, in double 24..44, out int 24) skipped
+    BOOST_CHECK(map.add_int("seqnr", urx::REG_IN, &seqnr) == 26);
+    BOOST_CHECK(map.add_double("gain", urx::REG_IN, &gain) == 45);
+    BOOST_CHECK(map.add_double("qd", urx::REG_OUT, qd, 6) == 24);
+    BOOST_CHECK(map.add_int("echo", urx::REG_OUT, &echo) == 25);
+    BOOST_CHECK(map.add_bit("stop", urx::REG_IN, &stop) == 64);
+    BOOST_CHECK(map.add_bit("flags", urx::REG_IN, flags, 3) == 65);
+    BOOST_CHECK(map.add_bit("done", urx::REG_OUT, &done) == 64);
+
+    // duplicates and exhaustion
+    BOOST_CHECK(map.add_int("seqnr", urx::REG_IN, &seqnr) < 0);
+    double many[48];
+    BOOST_CHECK(map.add_double("many", urx::REG_IN, many, 3) < 0);
+    BOOST_CHECK(map.add_double("many", urx::REG_IN, many, 2) == 46);
+    BOOST_CHECK(map.add_double("more", urx::REG_IN, many, 1) < 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_register_map_reserve)
+{
+    urx::Register_Map plain(urx::REG_USER_BASE, urx::REG_USER_BIT_BASE, false);
+    BOOST_CHECK(plain.add_double("qd", urx::REG_IN, qd, 6) == 24);
+    BOOST_CHECK(plain.add_int("seqnr", urx::REG_IN, &seqnr) == 24);
+    BOOST_CHECK(!plain.reserve(urx::REG_IN, urx::REG_DOUBLE, 28, 4));
+    BOOST_CHECK(plain.reserve(urx::REG_IN, urx::REG_DOUBLE, 30, 4));
+    BOOST_CHECK(plain.add_double("gain", urx::REG_IN, &gain) == 34);
+
+    // a channel that does not fit in front of a reservation goes after it
+    BOOST_CHECK(plain.reserve(urx::REG_IN, urx::REG_INT, 26, 1));
+    int32_t pair[2];
+    BOOST_CHECK(plain.add_int("pair", urx::REG_IN, pair, 2) == 27);
+}
+
+BOOST_AUTO_TEST_CASE(test_register_map_build)
+{
+    map.add_int("seqnr", urx::REG_IN, &seqnr);
+    map.add_double("gain", urx::REG_IN, &gain);
+    map.add_bit("stop", urx::REG_IN, &stop);
+    map.add_int("echo", urx::REG_OUT, &echo);
+    map.add_bit("done", urx::REG_OUT, &done);
+
+    BOOST_CHECK(map.build(&in, &out));
+    BOOST_CHECK(in.get_fields() == "input_int_register_26,input_double_register_45,input_bit_register_64");
+    BOOST_CHECK(in.get_bit_fields().empty());
+    BOOST_CHECK(out.get_fields() == "output_int_register_25,output_bit_register_64");
+    BOOST_CHECK((std::size_t)in.expected_bytes() == map.frame_bytes(urx::REG_IN));
+    BOOST_CHECK(map.frame_bytes(urx::REG_IN) == 4 + 8 + 1);
+    BOOST_CHECK(map.frame_bytes(urx::REG_OUT) == 4 + 1);
+
+    stop = true;
+    struct rtde_data_package *dp = in.get_dp();
+    BOOST_CHECK(in.store(dp));
+    BOOST_CHECK(rtde_data_package_get_payload(dp)[12] == 1);
+
+    unsigned char buf[5] = { 0, 0, 0, 7, 1 };
+    done = false;
+    BOOST_CHECK(out.parse(buf));
+    BOOST_CHECK(echo == 7);
+    BOOST_CHECK(done);
+
+    // need both recipes when both directions are used
+    urx::RTDE_Recipe in2;
+    in2.dir_input();
+    BOOST_CHECK(!map.build(&in2, nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(test_register_map_bits)
+{
+    // the packed words are PLC/fieldbus territory, only on request
+    urx::Register_Map low(urx::REG_USER_BASE, 0);
+    low.add_bit("stop", urx::REG_IN, &stop);
+    low.add_bit("flags", urx::REG_IN, flags, 3);
+    low.add_bit("done", urx::REG_OUT, &done);
+    BOOST_CHECK(low.build(&in, &out));
+    BOOST_CHECK(in.get_fields() == "input_bit_registers0_to_31");
+    BOOST_CHECK(low.frame_bytes(urx::REG_IN) == 4);
+
+    stop = false;
+    flags[0] = true;
+    flags[1] = false;
+    flags[2] = true;
+
+    struct rtde_data_package *dp = in.get_dp();
+    BOOST_CHECK(in.store(dp));
+    uint32_t word;
+    memcpy(&word, rtde_data_package_get_payload(dp), sizeof(word));
+    BOOST_CHECK(be32toh(word) == 0x0a);
+
+    unsigned char buf[4] = { 0, 0, 0, 1 };
+    done = false;
+    BOOST_CHECK(out.parse(buf));
+    BOOST_CHECK(done);
+}
+
+BOOST_AUTO_TEST_CASE(test_register_map_script)
+{
+    map.add_int("seqnr", urx::REG_IN, &seqnr);
+    map.add_double("qd", urx::REG_IN, qd, 2);
+    map.add_int("echo", urx::REG_OUT, &echo);
+    map.add_bit("done", urx::REG_OUT, &done);
+
+    std::string h = map.script_header();
+    BOOST_CHECK(h.find("def get_seqnr():\n    return read_input_integer_register(26)\nend\n") != std::string::npos);
+    BOOST_CHECK(h.find("def get_qd():\n    return [read_input_float_register(45), read_input_float_register(46)]\nend\n") != std::string::npos);
+    BOOST_CHECK(h.find("def set_echo(v):\n    write_output_integer_register(25, v)\nend\n") != std::string::npos);
+    BOOST_CHECK(h.find("def set_done(v):\n    write_output_boolean_register(64, v)\nend\n") != std::string::npos);
+
+    // plugs straight into a script template
+    urx::Script_Template t("def prog():\n${register_map}    x = read_input_integer_register(${seqnr})\nend\n");
+    std::string res;
+    BOOST_CHECK(t.render(map.params(), res));
+    BOOST_CHECK(res.find("read_input_integer_register(26)\nend\n") != std::string::npos);
+    BOOST_CHECK(res.find("def get_qd()") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE replayer
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/replayer.hpp>
+#include <urx/log_file.hpp>
+#include <urx/rtde_handler.hpp>
+#include <urx/rtde_recipe.hpp>
+#include <urx/urx_handler.hpp>
+#include <urx/robot.hpp>
+#include "mocks/mock_con.hpp"
+#include <endian.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <string>
+#include "test_helpers.hpp"
+
+struct Last_Rx : public urx::RTDE_Frame_Sink
+{
+    Last_Rx() : frames(0), ts(0) {}
+    void on_frame(const unsigned char *payload, unsigned long rx_ts)
+    {
+        (void)payload;
+        frames++;
+        ts = rx_ts;
+    }
+    int frames;
+    unsigned long ts;
+};
+
+struct F
+{
+    F() :
+        path_("/tmp/urx-replay-test-" + std::to_string(getpid()) + ".urxlog")
+    {
+        BOOST_REQUIRE(rec.add_field("output_int_register_0", &reg));
+        BOOST_REQUIRE(rec.add_field("timestamp", &ts));
+        BOOST_REQUIRE(rec.add_field("target_q", q));
+        BOOST_REQUIRE(rec.add_field("robot_mode", &mode));
+    }
+    ~F()
+    {
+        unlink(path_.c_str());
+    }
+
+    // frame i at t = 10 + i * 2ms, joint j = i + j/10, register i
+    void record(int frames)
+    {
+        urx::Log_Writer w(&rec, 100);
+        BOOST_REQUIRE(w.open(path_));
+        rec.add_sink(&w);
+        unsigned char buf[4 + 8 + 48 + 4];
+        for (int i = 0; i < frames; i++) {
+            put_int(buf, i);
+            put_double(buf + 4, 10.0 + i * 0.002);
+            for (int j = 0; j < 6; j++)
+                put_double(buf + 12 + j * 8, i + j / 10.0);
+            put_int(buf + 60, 7);
+            BOOST_REQUIRE(rec.parse(buf, 5000000UL + i));
+        }
+        rec.remove_sink(&w);
+    }
+
+    std::string path_;
+    urx::RTDE_Recipe rec;
+    int32_t reg;
+    double ts;
+    double q[6];
+    int32_t mode;
+};
+
+BOOST_FIXTURE_TEST_SUITE(replayer_test, F)
+
+BOOST_AUTO_TEST_CASE(test_replay_handler)
+{
+    record(250);
+
+    auto rp = new urx::Replayer(path_, 0.0);
+    urx::RTDE_Handler h(rp);
+    BOOST_REQUIRE(h.is_connected());
+    BOOST_CHECK(h.set_version());
+
+    // different order and a field that was not recorded
+    urx::RTDE_Recipe out;
+    double o_ts = 0;
+    double o_q[6];
+    double o_qd[6];
+    int32_t o_mode = 0;
+    BOOST_REQUIRE(out.add_field("robot_mode", &o_mode));
+    BOOST_REQUIRE(out.add_field("target_q", o_q));
+    BOOST_REQUIRE(out.add_field("timestamp", &o_ts));
+    BOOST_REQUIRE(out.add_field("target_qd", o_qd));
+    BOOST_REQUIRE(h.register_recipe(&out));
+    BOOST_CHECK(out.recipe_id() == urx::REPLAY_OUT_RECIPE_ID);
+
+    Last_Rx sink;
+    out.add_sink(&sink);
+    BOOST_CHECK(rp->run(&h, 10) == 10);
+    BOOST_CHECK(o_mode == 7);
+    BOOST_CHECK_CLOSE(o_ts, 10.018, 1e-9);
+    BOOST_CHECK_CLOSE(o_q[4], 9.4, 1e-9);
+    BOOST_CHECK(!rp->finished());
+
+    BOOST_CHECK(rp->run(&h) == 240);
+    BOOST_CHECK(rp->finished());
+    BOOST_CHECK(rp->wait_finished(0));
+    BOOST_CHECK_CLOSE(o_ts, 10.498, 1e-9);
+    BOOST_CHECK_CLOSE(o_q[5], 249.5, 1e-9);
+    BOOST_CHECK(o_qd[0] == 0.0 && o_qd[5] == 0.0);
+    BOOST_CHECK(sink.frames == 250);
+    BOOST_CHECK(sink.ts == 5000249UL);
+    out.remove_sink(&sink);
+
+    auto s = rp->stats();
+    BOOST_CHECK(s.frames == 250);
+    BOOST_CHECK(s.missing == 6);
+    BOOST_CHECK(s.decode_ns > 0.0);
+    BOOST_CHECK(s.max_lag_ms == 0.0);
+
+    // played out
+    BOOST_CHECK(rp->run(&h) == 0);
+    unsigned char buf[2048];
+    BOOST_CHECK(rp->try_recv(buf, sizeof(buf)) == urx::CON_TIMEOUT);
+}
+
+BOOST_AUTO_TEST_CASE(test_replay_refused)
+{
+    record(10);
+
+    // a controller rejects a start without an output recipe
+    auto rp2 = new urx::Replayer(path_, 0.0);
+    urx::RTDE_Handler h2(rp2);
+    BOOST_CHECK(!h2.start());
+
+    // and a missing file refuses to connect
+    auto rp3 = new urx::Replayer("/tmp/urx-replay-does-not-exist.urxlog");
+    urx::RTDE_Handler h3(rp3);
+    BOOST_CHECK(!h3.is_connected());
+}
+
+BOOST_AUTO_TEST_CASE(test_replay_paced)
+{
+    record(250);
+
+    // 0.5s recorded, 50ms at 10x
+    auto rp = new urx::Replayer(path_, 10.0);
+    urx::RTDE_Handler h(rp);
+    urx::RTDE_Recipe out;
+    double o_ts;
+    BOOST_REQUIRE(out.add_field("timestamp", &o_ts));
+    BOOST_REQUIRE(h.register_recipe(&out));
+
+    auto t0 = std::chrono::steady_clock::now();
+    BOOST_CHECK(rp->run(&h) == 250);
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+    BOOST_CHECK(dt.count() >= 0.049);
+    BOOST_CHECK(dt.count() < 0.5);
+
+    auto s = rp->stats();
+    BOOST_CHECK(s.wall_s >= 0.049);
+    BOOST_CHECK(s.fps > 0.0 && s.fps < 250 / 0.049);
+}
+
+BOOST_AUTO_TEST_CASE(test_replay_robot)
+{
+    record(200);
+
+    auto umock = new urx::Con_mock();
+    auto rp = new urx::Replayer(path_, 0.0);
+    urx::Robot robot(new urx::URX_Handler(umock), new urx::RTDE_Handler(rp));
+    robot.set_reconnect(false);
+
+    std::atomic<int> states(0);
+    std::atomic<double> last_ts(0.0);
+    robot.on_state([&](const urx::Robot_State& s) {
+        states++;
+        last_ts = s.ur_ts;
+    });
+    BOOST_REQUIRE(robot.init_output());
+    BOOST_REQUIRE(robot.start());
+    BOOST_CHECK(rp->wait_finished(2000));
+
+    for (int i = 0; i < 200 && states < 200; i++)
+        usleep(1000);
+    BOOST_CHECK(states == 200);
+    BOOST_CHECK_CLOSE(last_ts.load(), 10.398, 1e-9);
+
+    auto st = robot.state();
+    BOOST_CHECK_CLOSE(st.ur_ts, 10.398, 1e-9);
+    BOOST_CHECK(st.seqnr == 199);
+    BOOST_CHECK_CLOSE(st.jq[2], 199.2, 1e-9);
+    BOOST_CHECK(robot.frame_stats().missed == 0);
+
+    BOOST_CHECK(robot.stop());
+    BOOST_CHECK(rp->stats().frames == 200);
+}
+
+BOOST_AUTO_TEST_CASE(test_control_while_streaming)
+{
+    record(250);
+
+    auto rp = new urx::Replayer(path_, 1.0);
+    rp->set_recv_timeout(20);
+    urx::RTDE_Handler h(rp);
+    urx::RTDE_Recipe out;
+    double o_ts = 0;
+    BOOST_REQUIRE(out.add_field("timestamp", &o_ts));
+    BOOST_REQUIRE(h.register_recipe(&out));
+    BOOST_REQUIRE(h.start());
+
+    std::atomic<bool> run(true);
+    std::atomic<int> frames(0);
+    std::atomic<int> failed(0);
+    std::thread receiver([&] {
+            while (run) {
+                if (h.recv())
+                    frames++;
+                else if (!h.timed_out())
+                    failed++;
+            }
+        });
+    while (frames < 20)
+        usleep(1000);
+
+    // the receiver picks up the replies, data keeps flowing
+    urx::RTDE_Recipe in;
+    in.dir_input();
+    double slf = 0.5;
+    BOOST_REQUIRE(in.add_field("speed_slider_fraction", &slf));
+    int before = frames;
+    auto t0 = std::chrono::steady_clock::now();
+    BOOST_CHECK(h.register_recipe(&in));
+    std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+    BOOST_CHECK(dt.count() < 20.0);
+    BOOST_CHECK(h.send(in.recipe_id()));
+    usleep(10000);
+    BOOST_CHECK(frames > before);
+
+    BOOST_CHECK(h.stop());
+    run = false;
+    receiver.join();
+    BOOST_CHECK(failed == 0);
+    BOOST_CHECK(h.rx_stats().unexpected == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_swap_output)
+{
+    record(500);
+
+    auto rp = new urx::Replayer(path_, 1.0);
+    rp->set_recv_timeout(20);
+    urx::RTDE_Handler h(rp);
+    urx::RTDE_Recipe out;
+    double o_ts = 0;
+    BOOST_REQUIRE(out.add_field("timestamp", &o_ts));
+    BOOST_REQUIRE(h.register_recipe(&out));
+    BOOST_REQUIRE(h.start());
+
+    std::atomic<bool> run(true);
+    std::atomic<int> frames(0);
+    std::thread receiver([&] {
+            while (run)
+                if (h.recv())
+                    frames++;
+        });
+    while (frames < 20)
+        usleep(1000);
+
+    // monitor the joints as well from now on
+    urx::RTDE_Recipe next;
+    double n_ts = 0;
+    double n_q[6] = {0};
+    BOOST_REQUIRE(next.add_field("timestamp", &n_ts));
+    BOOST_REQUIRE(next.add_field("target_q", n_q));
+    BOOST_CHECK(h.swap_output(&next));
+    for (int i = 0; i < 200 && h.swap_stats().last_gap_ms == 0.0; i++)
+        usleep(1000);
+
+    run = false;
+    receiver.join();
+    BOOST_CHECK(n_ts > 10.0);
+    BOOST_CHECK(n_q[1] > 0.0);
+
+    urx::Swap_Stats s = h.swap_stats();
+    BOOST_CHECK(s.output_swaps == 1);
+    BOOST_CHECK(s.last_gap_ms > 0.0);
+    BOOST_CHECK(s.last_gap_ms < 50.0);
+    BOOST_CHECK(s.max_gap_ms == s.last_gap_ms);
+    BOOST_TEST_MESSAGE("output swap gap " << s.last_gap_ms << " ms");
+
+    // the old recipe can be reused once swapped out
+    out.clear_fields();
+    BOOST_CHECK(out.num_fields() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE robot_group
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/robot_group.hpp>
+#include <urx/replayer.hpp>
+#include <urx/log_file.hpp>
+#include <urx/rtde_handler.hpp>
+#include <urx/urx_handler.hpp>
+#include "mocks/mock_con.hpp"
+#include <endian.h>
+#include <unistd.h>
+#include <cstring>
+#include <string>
+#include "test_helpers.hpp"
+
+struct F
+{
+    F() :
+        path_("/tmp/urx-group-test-" + std::to_string(getpid()) + ".urxlog")
+    {
+        // 0.8s of a controller at 500Hz
+        urx::RTDE_Recipe rec;
+        double ts;
+        double q[6];
+        BOOST_REQUIRE(rec.add_field("timestamp", &ts));
+        BOOST_REQUIRE(rec.add_field("target_q", q));
+        urx::Log_Writer w(&rec, 100);
+        BOOST_REQUIRE(w.open(path_));
+        rec.add_sink(&w);
+        unsigned char buf[8 + 48];
+        for (int i = 0; i < 400; i++) {
+            put_double(buf, 100.0 + i * 0.002);
+            for (int j = 0; j < 6; j++)
+                put_double(buf + 8 + j * 8, i);
+            BOOST_REQUIRE(rec.parse(buf, 1000000UL * i));
+        }
+        rec.remove_sink(&w);
+    }
+    ~F()
+    {
+        for (auto r : robots)
+            delete r;
+        unlink(path_.c_str());
+    }
+
+    urx::Robot *arm()
+    {
+        auto rp = new urx::Replayer(path_, 1.0);
+        replayers.push_back(rp);
+        auto r = new urx::Robot(new urx::URX_Handler(new urx::Con_mock()), new urx::RTDE_Handler(rp));
+        r->set_reconnect(false);
+        robots.push_back(r);
+        return r;
+    }
+
+    std::string path_;
+    std::vector<urx::Replayer *> replayers;
+    std::vector<urx::Robot *> robots;
+};
+
+BOOST_FIXTURE_TEST_SUITE(robot_group_test, F)
+
+BOOST_AUTO_TEST_CASE(test_group_stage_commit)
+{
+    urx::Robot_Group g;
+    BOOST_CHECK(g.add(arm()) == 0);
+    BOOST_CHECK(g.add(arm()) == 1);
+    BOOST_CHECK(g.size() == 2);
+
+    // not initialized
+    std::vector<double> w(6, 0.1);
+    BOOST_CHECK(!g.stage(0, w));
+    BOOST_CHECK(!g.stage(2, w));
+    BOOST_CHECK(g.commit());
+    BOOST_CHECK(g.stats().commits == 0);
+
+    for (auto r : robots)
+        BOOST_REQUIRE(r->init());
+    uint64_t in0 = replayers[0]->stats().inputs;
+    uint64_t in1 = replayers[1]->stats().inputs;
+
+    // staging builds the frame, only commit sends it
+    BOOST_CHECK(g.stage(0, w));
+    BOOST_CHECK(g.stage(1, w));
+    BOOST_CHECK(replayers[0]->stats().inputs == in0);
+    BOOST_CHECK(g.commit());
+    BOOST_CHECK(replayers[0]->stats().inputs == in0 + 1);
+    BOOST_CHECK(replayers[1]->stats().inputs == in1 + 1);
+
+    // nothing left staged
+    BOOST_CHECK(g.commit());
+    BOOST_CHECK(replayers[0]->stats().inputs == in0 + 1);
+    BOOST_CHECK(g.stats().commits == 1);
+    BOOST_CHECK(g.stats().failed_releases == 0);
+    BOOST_CHECK(g.stats().max_spread_ns >= 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_group_cycles)
+{
+    urx::Robot_Group g(0.002);
+    g.add(arm());
+    g.add(arm());
+    for (auto r : robots) {
+        BOOST_REQUIRE(r->init());
+        BOOST_REQUIRE(r->start());
+    }
+
+    std::vector<double> w(6, 0.0);
+    urx::Group_Cycle c;
+    int cycles = 0;
+    int aligned = 0;
+    while (cycles < 300 && g.wait(c)) {
+        BOOST_REQUIRE(c.states.size() == 2);
+        if (c.skew_ns >= 0) {
+            aligned++;
+            BOOST_CHECK(c.host_ns[0] > 0 && c.host_ns[1] > 0);
+        }
+        w[0] = cycles;
+        BOOST_CHECK(g.stage(0, w));
+        BOOST_CHECK(g.stage(1, w));
+        BOOST_CHECK(g.commit());
+        cycles++;
+    }
+    BOOST_CHECK(cycles == 300);
+
+    // the clock estimates need a few hundred ms of frames
+    auto s = g.stats();
+    BOOST_CHECK(aligned > 0);
+    BOOST_CHECK(s.cycles == (uint64_t)aligned);
+    BOOST_CHECK(s.commits == 300);
+    BOOST_CHECK(s.max_skew_ns >= 0);
+    BOOST_CHECK(s.mean_skew_ns < 2e6);
+    BOOST_CHECK(s.mean_spread_ns < 1e6);
+    BOOST_TEST_MESSAGE("skew mean " << s.mean_skew_ns / 1e3 << " us, max " << s.max_skew_ns / 1e3
+                       << " us, release spread mean " << s.mean_spread_ns / 1e3 << " us");
+
+    for (auto r : robots)
+        BOOST_CHECK(r->stop());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
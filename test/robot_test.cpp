@@ -19,6 +19,9 @@
 #include "test_helpers.hpp"
 #include <urx/robot.hpp>
 #include <urx/helper.hpp>
+#include <urx/log_file.hpp>
+#include <urx/replayer.hpp>
+#include <unistd.h>
 
 struct F
 {
@@ -368,6 +371,11 @@ BOOST_AUTO_TEST_CASE(test_robot_sync_state)
     setup_robot_output_defaults();
     setup_robot_input_defaults();
 
+    // stream data again, without it the receiver keeps reconnecting
+    // and update_w() fails meanwhile
+    setup_rtde_vals();
+    ready_data_buffer();
+
     constexpr int loop = 10;
     std::chrono::microseconds prev;
 
@@ -417,4 +425,48 @@ BOOST_AUTO_TEST_CASE(test_robot_sync_state)
     t.join();
 
 }
+
+BOOST_AUTO_TEST_CASE(test_robot_phase_lock_same_cycle)
+{
+    // 60 frames at 125 Hz, replayed in real time
+    std::string path = "/tmp/urx-phase-test-" + std::to_string(getpid()) + ".urxlog";
+    {
+        urx::RTDE_Recipe rec;
+        double ts;
+        BOOST_REQUIRE(rec.add_field("timestamp", &ts));
+        urx::Log_Writer w(&rec, 16);
+        BOOST_REQUIRE(w.open(path));
+        rec.add_sink(&w);
+        unsigned char buf[8];
+        for (int i = 0; i < 60; i++) {
+            put_double(buf, 1.0 + i * 0.008);
+            BOOST_REQUIRE(rec.parse(buf, 8000000UL * i));
+        }
+        rec.remove_sink(&w);
+    }
+
+    auto rp = new urx::Replayer(path, 1.0);
+    urx::Robot r(new urx::URX_Handler(new urx::Con_mock()), new urx::RTDE_Handler(rp));
+    r.set_reconnect(false);
+    BOOST_REQUIRE(r.init());
+    r.enable_phase_lock(true);
+    BOOST_REQUIRE(r.start());
+
+    // the update for a frame is released before the next one arrives
+    std::vector<double> w(urx::DOF, 0.0);
+    uint64_t prev = 0;
+    int late = 0;
+    for (int i = 0; i < 50; i++) {
+        r.state();
+        uint64_t inputs = rp->stats().inputs;
+        if (i > 32 && inputs == prev)
+            late++;
+        prev = inputs;
+        BOOST_CHECK(r.update_w(w));
+    }
+    BOOST_CHECK(late == 0);
+    BOOST_CHECK(r.phase_lock_stats().sent > 0);
+    r.stop();
+    unlink(path.c_str());
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,8 @@
 #include <boost/test/unit_test.hpp>
 #include <iostream>
 #include <arpa/inet.h>
+#include <atomic>
+#include <thread>
 
 #include <urx/rtde_handler.hpp>
 #include <urx/con.hpp>
@@ -327,7 +329,7 @@ BOOST_AUTO_TEST_CASE(test_handler_full_large_data)
         BOOST_CHECK_CLOSE(jt[c], jt_val[c], 0.00001);
 
     // send stop
-    rtde_control_package_start((struct rtde_header *)&cpr);
+    rtde_control_package_stop((struct rtde_header *)&cpr);
     cpr.hdr.size = htons(4);
     cpr.accepted = false;
     mock->set_recvBuf((unsigned char *)&cpr, ntohs(cpr.hdr.size));
@@ -452,4 +454,469 @@ BOOST_AUTO_TEST_CASE(test_handler_input_full)
     free(resp);
 }
 
+BOOST_AUTO_TEST_CASE(test_handler_reconnect)
+{
+    double ts;
+    urx::RTDE_Recipe *out = new urx::RTDE_Recipe();
+    BOOST_CHECK(out->add_field("timestamp", &ts));
+    double slf = 0.25;
+    urx::RTDE_Recipe *in = new urx::RTDE_Recipe();
+    in->dir_input();
+    BOOST_CHECK(in->add_field("speed_slider_fraction", &slf));
+
+    struct rtde_control_package_resp *out_resp = create_cp_resp();
+    struct rtde_control_package_resp *in_resp = create_cp_resp();
+    _set_recipe_resp(out_resp, "DOUBLE", 1);
+    _set_recipe_resp(in_resp, "DOUBLE", 2);
+    struct rtde_control_package_sp_resp cpr;
+    rtde_control_package_start((struct rtde_header *)&cpr);
+    cpr.hdr.size = htons(4);
+    cpr.accepted = true;
+
+    mock->push_recvBuf((unsigned char *)out_resp, ntohs(out_resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)in_resp, ntohs(in_resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+    BOOST_CHECK(h->register_recipe(out));
+    BOOST_CHECK(h->register_recipe(in));
+    BOOST_CHECK(h->start());
+    BOOST_CHECK(h->send(2));
+
+    // remote gone, give up after a bounded number of attempts
+    mock->disconnect();
+    mock->set_connect_ok(false);
+    urx::Reconnect_Policy policy;
+    policy.initial_backoff = std::chrono::milliseconds(1);
+    policy.max_backoff = std::chrono::milliseconds(2);
+    policy.max_attempts = 3;
+    int connects = mock->connects();
+    BOOST_CHECK(!h->reconnect(policy));
+    BOOST_CHECK(!h->is_connected());
+    BOOST_CHECK_EQUAL(mock->connects() - connects, 3);
+
+    urx::Recovery_Stats rs = h->recovery_stats();
+    BOOST_CHECK_EQUAL(rs.losses, 1);
+    BOOST_CHECK_EQUAL(rs.attempts, 3);
+    BOOST_CHECK_EQUAL(rs.recoveries, 0);
+
+    // keep_going aborts before any attempt is made
+    BOOST_CHECK(!h->reconnect(policy, [] { return false; }));
+    BOOST_CHECK_EQUAL(h->recovery_stats().attempts, 3);
+
+    // remote back, with new recipe ids. Version reply is the default
+    // buffer, recipes and start are queued behind it.
+    mock->set_connect_ok(true);
+    _set_recipe_resp(out_resp, "DOUBLE", 7);
+    _set_recipe_resp(in_resp, "DOUBLE", 8);
+    mock->push_recvBuf(buf_, 4);
+    mock->push_recvBuf((unsigned char *)out_resp, ntohs(out_resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)in_resp, ntohs(in_resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+
+    unsigned char sbuf[256] = {0};
+    mock->set_sendBuffer(sbuf, 256);
+    BOOST_CHECK(h->reconnect(policy));
+    BOOST_CHECK(h->is_connected());
+    BOOST_CHECK_EQUAL(out->recipe_id(), 7);
+    BOOST_CHECK_EQUAL(in->recipe_id(), 8);
+
+    // old id is forgotten, and inputs were sent again
+    BOOST_CHECK(!h->send(2));
+    BOOST_CHECK(h->send(8));
+    struct rtde_data_package *data = (struct rtde_data_package *)sbuf;
+    BOOST_CHECK(data->hdr.type == RTDE_DATA_PACKAGE);
+    BOOST_CHECK_EQUAL(data->recipe_id, 8);
+
+    rs = h->recovery_stats();
+    BOOST_CHECK_EQUAL(rs.losses, 3);
+    BOOST_CHECK_EQUAL(rs.recoveries, 1);
+    BOOST_CHECK_EQUAL(rs.attempts, 4);
+    BOOST_CHECK(rs.max_ms >= rs.last_ms);
+
+    free(out_resp);
+    free(in_resp);
+}
+
+BOOST_AUTO_TEST_CASE(test_send_during_reconnect)
+{
+    double slf = 0.25;
+    urx::RTDE_Recipe *in = new urx::RTDE_Recipe();
+    in->dir_input();
+    BOOST_CHECK(in->add_field("speed_slider_fraction", &slf));
+    struct rtde_control_package_resp *in_resp = create_cp_resp();
+    _set_recipe_resp(in_resp, "DOUBLE", 2);
+    mock->push_recvBuf((unsigned char *)in_resp, ntohs(in_resp->hdr.size));
+    BOOST_CHECK(h->register_recipe(in));
+    BOOST_CHECK(h->send(2));
+
+    // the new session never answers the recipe, the attempt runs into
+    // the reply timeout while send() is refused at once
+    urx::Reconnect_Policy policy;
+    policy.max_attempts = 1;
+    std::atomic<bool> started(false);
+    std::thread t([&] {
+        started = true;
+        BOOST_CHECK(!h->reconnect(policy));
+    });
+    while (!started)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto t0 = std::chrono::steady_clock::now();
+    BOOST_CHECK(!h->send(2));
+    BOOST_CHECK(!h->send_prepared(2));
+    BOOST_CHECK(std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(100));
+    t.join();
+
+    free(in_resp);
+    delete in;
+}
+
+BOOST_AUTO_TEST_CASE(test_request_across_reconnect)
+{
+    double slf = 0.25, slf2 = 0.5;
+    urx::RTDE_Recipe *in = new urx::RTDE_Recipe();
+    in->dir_input();
+    BOOST_CHECK(in->add_field("speed_slider_fraction", &slf));
+    urx::RTDE_Recipe *in2 = new urx::RTDE_Recipe();
+    in2->dir_input();
+    BOOST_CHECK(in2->add_field("speed_slider_fraction", &slf2));
+    struct rtde_control_package_resp *in_resp = create_cp_resp();
+    _set_recipe_resp(in_resp, "DOUBLE", 2);
+    mock->push_recvBuf((unsigned char *)in_resp, ntohs(in_resp->hdr.size));
+    BOOST_CHECK(h->register_recipe(in));
+    int id2 = in2->recipe_id();
+
+    // in flight when the link drops, never answered
+    urx::RTDE_Request req = h->register_recipe_async(in2);
+    BOOST_CHECK(req.result.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+
+    // the new session answers reregister() only: version (the default
+    // buffer) and the recipe it already had
+    _set_recipe_resp(in_resp, "DOUBLE", 8);
+    mock->push_recvBuf(buf_, 4);
+    mock->push_recvBuf((unsigned char *)in_resp, ntohs(in_resp->hdr.size));
+    urx::Reconnect_Policy policy;
+    policy.max_attempts = 1;
+    BOOST_CHECK(h->reconnect(policy));
+
+    BOOST_CHECK(req.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    BOOST_CHECK(!h->wait(req));
+    BOOST_CHECK_EQUAL(in->recipe_id(), 8);
+    BOOST_CHECK_EQUAL(in2->recipe_id(), id2);
+    BOOST_CHECK(h->send(8));
+
+    free(in_resp);
+    delete in;
+    delete in2;
+}
+
+// registers a "timestamp" output recipe and starts the stream
+static urx::RTDE_Recipe *start_ts_stream(urx::RTDE_Handler *h, urx::Con_mock *mock, double *ts)
+{
+    struct rtde_control_package_resp *resp = create_cp_resp();
+    _set_recipe_resp(resp, "DOUBLE", 5);
+    struct rtde_control_package_sp_resp cpr;
+    rtde_control_package_start((struct rtde_header *)&cpr);
+    cpr.hdr.size = htons(4);
+    cpr.accepted = true;
+    mock->set_sendCode(42);
+    mock->push_recvBuf((unsigned char *)resp, ntohs(resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+
+    urx::RTDE_Recipe *r = new urx::RTDE_Recipe();
+    BOOST_CHECK(r->add_field("timestamp", ts));
+    BOOST_CHECK(h->register_recipe(r));
+    BOOST_CHECK(h->start());
+    free(resp);
+    return r;
+}
+
+static int mk_ts_package(unsigned char *buf, double ts)
+{
+    struct rtde_data_package *dp = (struct rtde_data_package *)buf;
+    dp->hdr.type = RTDE_DATA_PACKAGE;
+    dp->hdr.size = htons(sizeof(struct rtde_data_package) + sizeof(double));
+    dp->recipe_id = 5;
+    double v = urx::double_h(ts);
+    memcpy(rtde_data_package_get_payload(dp), &v, sizeof(v));
+    return ntohs(dp->hdr.size);
+}
+
+BOOST_AUTO_TEST_CASE(test_text_message_keeps_data_cycle)
+{
+    double ts = 0.0;
+    urx::RTDE_Recipe *r = start_ts_stream(h, mock, &ts);
+
+    struct rtde_msg *msg = rtde_msg_get();
+    BOOST_ASSERT(rtde_mkreq_msg_out(msg, "Protective stop", 16, "Controller", 11));
+    unsigned char data[64];
+    int dsz = mk_ts_package(data, 17.25);
+
+    // a warning arrives right before the data of this cycle
+    mock->push_recvBuf((unsigned char *)msg, ntohs(msg->hdr.size));
+    mock->push_recvBuf(data, dsz);
+    BOOST_CHECK(h->recv());
+    BOOST_CHECK_CLOSE(ts, 17.25, 1e-9);
+
+    urx::RTDE_Text_Message m;
+    BOOST_CHECK(h->pop_message(m));
+    BOOST_CHECK_EQUAL(std::string(m.text), "Protective stop");
+    BOOST_CHECK_EQUAL(std::string(m.source), "Controller");
+    BOOST_CHECK_EQUAL(m.level, RTDE_EXCEPTION_MESSAGE);
+    BOOST_CHECK(!h->pop_message(m));
+
+    urx::RTDE_Rx_Stats s = h->rx_stats();
+    BOOST_CHECK_EQUAL(s.text, 1);
+    BOOST_CHECK_EQUAL(s.data, 1);
+    BOOST_CHECK_EQUAL(s.malformed, 0);
+
+    rtde_msg_put(msg);
+    delete r;
+}
+
+BOOST_AUTO_TEST_CASE(test_packages_sharing_a_read)
+{
+    double ts = 0.0;
+    urx::RTDE_Recipe *r = start_ts_stream(h, mock, &ts);
+
+    // text, a stray start-reply and data in one read
+    unsigned char buf[512];
+    struct rtde_msg *msg = (struct rtde_msg *)buf;
+    BOOST_ASSERT(rtde_mkreq_msg_out(msg, "hello", 6, "me", 3));
+    int off = ntohs(msg->hdr.size);
+    struct rtde_control_package_sp_resp *cpr = (struct rtde_control_package_sp_resp *)(buf + off);
+    rtde_control_package_start((struct rtde_header *)cpr);
+    cpr->hdr.size = htons(4);
+    cpr->accepted = true;
+    off += 4;
+    off += mk_ts_package(buf + off, 3.5);
+
+    urx::RTDE_Rx_Stats before = h->rx_stats();
+    mock->push_recvBuf(buf, off);
+    BOOST_CHECK(h->recv());
+    BOOST_CHECK_CLOSE(ts, 3.5, 1e-9);
+
+    urx::RTDE_Rx_Stats after = h->rx_stats();
+    BOOST_CHECK_EQUAL(after.text - before.text, 1);
+    BOOST_CHECK_EQUAL(after.unexpected - before.unexpected, 1);
+    BOOST_CHECK_EQUAL(after.data - before.data, 1);
+
+    // a package split over two reads
+    int dsz = mk_ts_package(buf, 4.5);
+    mock->push_recvBuf(buf, 5);
+    mock->push_recvBuf(buf + 5, dsz - 5);
+    BOOST_CHECK(h->recv());
+    BOOST_CHECK_CLOSE(ts, 4.5, 1e-9);
+    delete r;
+}
+
+BOOST_AUTO_TEST_CASE(test_stop_reply_behind_data)
+{
+    double ts = 0.0;
+    urx::RTDE_Recipe *r = start_ts_stream(h, mock, &ts);
+
+    // the pause reply queues up behind frames already on their way
+    unsigned char d1[64], d2[64];
+    int sz1 = mk_ts_package(d1, 1.0);
+    int sz2 = mk_ts_package(d2, 2.0);
+    struct rtde_control_package_sp_resp cpr;
+    rtde_control_package_stop((struct rtde_header *)&cpr);
+    cpr.hdr.size = htons(4);
+    cpr.accepted = true;
+    mock->push_recvBuf(d1, sz1);
+    mock->push_recvBuf(d2, sz2);
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+
+    BOOST_CHECK(h->stop());
+    BOOST_CHECK_CLOSE(ts, 2.0, 1e-9);
+    delete r;
+}
+
+BOOST_AUTO_TEST_CASE(test_request_leaves_stream_to_receiver)
+{
+    double ts = 0.0;
+    urx::RTDE_Recipe *r = start_ts_stream(h, mock, &ts);
+
+    unsigned char d1[64];
+    int sz1 = mk_ts_package(d1, 1.0);
+    struct rtde_control_package_sp_resp cpr;
+    rtde_control_package_stop((struct rtde_header *)&cpr);
+    cpr.hdr.size = htons(4);
+    cpr.accepted = true;
+    mock->push_recvBuf(d1, sz1);
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+
+    // the receiver gets the frame even though the request waits first
+    std::atomic<bool> ready(false);
+    bool got_frame = false;
+    std::thread rx([&] {
+        h->set_receiver(true);
+        ready = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        got_frame = h->recv();
+        h->recv();
+        h->set_receiver(false);
+    });
+    while (!ready)
+        std::this_thread::yield();
+
+    BOOST_CHECK(h->stop());
+    rx.join();
+    BOOST_CHECK(got_frame);
+    BOOST_CHECK_CLOSE(ts, 1.0, 1e-9);
+    delete r;
+}
+
+BOOST_AUTO_TEST_CASE(test_pipelined_setup)
+{
+    double ts = 0.0;
+    urx::RTDE_Recipe *out = new urx::RTDE_Recipe();
+    BOOST_CHECK(out->add_field("timestamp", &ts));
+    double slf = 0.5;
+    urx::RTDE_Recipe *in = new urx::RTDE_Recipe();
+    in->dir_input();
+    BOOST_CHECK(in->add_field("speed_slider_fraction", &slf));
+
+    struct rtde_control_package_resp *out_resp = create_cp_resp();
+    struct rtde_control_package_resp *in_resp = create_cp_resp();
+    _set_recipe_resp(out_resp, "DOUBLE", 3);
+    _set_recipe_resp(in_resp, "DOUBLE", 4);
+    in_resp->hdr.type = RTDE_CONTROL_PACKAGE_SETUP_INPUTS;
+    struct rtde_control_package_sp_resp cpr;
+    rtde_control_package_start((struct rtde_header *)&cpr);
+    cpr.hdr.size = htons(4);
+    cpr.accepted = true;
+
+    // everything is sent before the first reply is read
+    std::vector<urx::RTDE_Request> reqs;
+    reqs.push_back(h->set_version_async());
+    reqs.push_back(h->register_recipe_async(out));
+    reqs.push_back(h->register_recipe_async(in));
+    reqs.push_back(h->start_async());
+    for (auto &r : reqs)
+        BOOST_CHECK(r.result.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+
+    mock->push_recvBuf(buf_, 4);
+    mock->push_recvBuf((unsigned char *)out_resp, ntohs(out_resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)in_resp, ntohs(in_resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+    BOOST_CHECK(h->wait_all(reqs));
+    BOOST_CHECK_EQUAL(out->recipe_id(), 3);
+    BOOST_CHECK_EQUAL(in->recipe_id(), 4);
+    BOOST_CHECK(h->send(4));
+    BOOST_CHECK_EQUAL(h->rx_stats().replies, 4);
+
+    free(out_resp);
+    free(in_resp);
+    delete out;
+    delete in;
+}
+
+BOOST_AUTO_TEST_CASE(test_request_timeout)
+{
+    // a data package in place of the reply, the request gives up
+    double ts = 0.0;
+    urx::RTDE_Recipe *r = start_ts_stream(h, mock, &ts);
+    unsigned char data[64];
+    mock->set_recvBuf(data, mk_ts_package(data, 8.0));
+
+    urx::RTDE_Request req = h->stop_async();
+    BOOST_CHECK(!h->wait(req, 20));
+    BOOST_CHECK_CLOSE(ts, 8.0, 1e-9);
+
+    // a late reply is not mistaken for the next request of its type
+    struct rtde_control_package_sp_resp late, cpr;
+    rtde_control_package_stop((struct rtde_header *)&late);
+    late.hdr.size = htons(4);
+    late.accepted = false;
+    cpr = late;
+    cpr.accepted = true;
+    uint64_t unexpected = h->rx_stats().unexpected;
+    req = h->stop_async();
+    mock->push_recvBuf((unsigned char *)&late, 4);
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+    BOOST_CHECK(h->wait(req, 1000));
+    BOOST_CHECK_EQUAL(h->rx_stats().unexpected, unexpected + 1);
+
+    // and once swallowed, the next reply is unexpected again
+    mock->push_recvBuf((unsigned char *)&cpr, 4);
+    BOOST_CHECK(h->recv());
+    BOOST_CHECK_EQUAL(h->rx_stats().unexpected, unexpected + 2);
+
+    // nothing sent, nothing to wait for
+    mock->set_sendCode(-1);
+    req = h->stop_async();
+    BOOST_CHECK(!h->wait(req, 1000));
+    delete r;
+}
+
+BOOST_AUTO_TEST_CASE(test_swap_input)
+{
+    double slf = 0.5;
+    urx::RTDE_Recipe *in = new urx::RTDE_Recipe();
+    in->dir_input();
+    BOOST_CHECK(in->add_field("speed_slider_fraction", &slf));
+    int32_t reg = 17;
+    urx::RTDE_Recipe *next = new urx::RTDE_Recipe();
+    next->dir_input();
+    BOOST_CHECK(next->add_field("input_int_register_5", &reg));
+
+    struct rtde_control_package_resp *in_resp = create_cp_resp();
+    struct rtde_control_package_resp *next_resp = create_cp_resp();
+    _set_recipe_resp(in_resp, "DOUBLE", 2);
+    _set_recipe_resp(next_resp, "INT32", 3);
+    mock->set_sendCode(42);
+    mock->push_recvBuf((unsigned char *)in_resp, ntohs(in_resp->hdr.size));
+    mock->push_recvBuf((unsigned char *)next_resp, ntohs(next_resp->hdr.size));
+    BOOST_CHECK(h->register_recipe(in));
+
+    // unknown id or wrong direction
+    BOOST_CHECK(!h->swap_input(9, next));
+    BOOST_CHECK(!h->swap_input(2, nullptr));
+
+    BOOST_CHECK(h->swap_input(2, next));
+    BOOST_CHECK_EQUAL(next->recipe_id(), 3);
+
+    // both ids send the new layout
+    unsigned char sbuf[256] = {0};
+    mock->set_sendBuffer(sbuf, 256);
+    struct rtde_data_package *dp = (struct rtde_data_package *)sbuf;
+    BOOST_CHECK(h->send(2));
+    BOOST_CHECK_EQUAL(dp->recipe_id, 3);
+    BOOST_CHECK_EQUAL(ntohs(dp->hdr.size), sizeof(struct rtde_data_package) + 4);
+    memset(sbuf, 0, sizeof(sbuf));
+    BOOST_CHECK(h->send(3));
+    BOOST_CHECK_EQUAL(dp->recipe_id, 3);
+
+    urx::Swap_Stats s = h->swap_stats();
+    BOOST_CHECK_EQUAL(s.input_swaps, 1);
+    BOOST_CHECK(s.last_input_ms >= 0.0);
+
+    // the old recipe is no longer in use
+    delete in;
+    BOOST_CHECK(h->send(2));
+    free(in_resp);
+    free(next_resp);
+    delete next;
+}
+
+BOOST_AUTO_TEST_CASE(test_text_queue_overflow)
+{
+    urx::Text_Queue q;
+    urx::RTDE_Text_Message m;
+    memset(&m, 0, sizeof(m));
+    for (std::size_t i = 0; i < urx::TEXT_QUEUE_SIZE; i++) {
+        m.rx_ts = i;
+        BOOST_CHECK(q.push(m));
+    }
+    BOOST_CHECK(!q.push(m));
+    BOOST_CHECK_EQUAL(q.dropped(), 1);
+    BOOST_CHECK_EQUAL(q.size(), urx::TEXT_QUEUE_SIZE);
+
+    // oldest first
+    BOOST_CHECK(q.pop(m));
+    BOOST_CHECK_EQUAL(m.rx_ts, 0);
+    BOOST_CHECK(q.push(m));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -53,6 +53,13 @@ BOOST_AUTO_TEST_CASE(test_recipe_clear_fields)
     BOOST_CHECK(r.num_fields() == 2);
     r.clear_fields();
     BOOST_CHECK(r.num_fields() == 0);
+    BOOST_CHECK(r.expected_bytes() == 0);
+
+    // filled again, offsets start over
+    double ts;
+    BOOST_CHECK(r.add_field("timestamp", &ts));
+    BOOST_CHECK(r.expected_bytes() == 8);
+    BOOST_CHECK(r.get_tokens()[0]->offset == 0);
 }
 
 BOOST_AUTO_TEST_CASE(test_recipe_construct_msg)
@@ -271,4 +278,74 @@ BOOST_AUTO_TEST_CASE(test_handler_in_byte_ok)
     BOOST_CHECK(sbuf[23] == 0x30);
 }
 
+enum Test_Cmd { CMD_NONE = 0, CMD_STOP = 1, CMD_GO = 2, CMD_TCP = 3 };
+
+BOOST_AUTO_TEST_CASE(test_recipe_bit_fields_in)
+{
+    BOOST_CHECK(r.dir_input());
+    bool stop = true;
+    Test_Cmd cmd = CMD_TCP;
+    uint8_t level = 5;
+    int32_t seqnr = 0x01020304;
+
+    BOOST_CHECK(r.add_field("input_int_register_24", &seqnr));
+    BOOST_CHECK(r.add_bit_field("stop", &stop) == 0);
+    BOOST_CHECK(r.add_bit_field("cmd", &cmd, 2) == 1);
+    BOOST_CHECK(r.add_bit_field("level", &level, 3) == 3);
+
+    // explicit placement, overlap and straddling the words
+    bool b = false;
+    BOOST_CHECK(r.add_bit_field("overlap", &b, 1, 4) == -1);
+    BOOST_CHECK(r.add_bit_field("straddle", &b, 2, 31) == -1);
+    BOOST_CHECK(r.add_bit_field("high", &b, 1, 40) == 40);
+    BOOST_CHECK(r.add_bit_field("wide", &seqnr, 33) == -1);
+
+    // one word per 32 bits, not one register per field
+    BOOST_CHECK(r.get_fields() == "input_int_register_24,input_bit_registers0_to_31,input_bit_registers32_to_63");
+    BOOST_CHECK(r.expected_bytes() == 12);
+
+    const urx::RTDE_Bit_Field& f = r.get_bit_fields()[2];
+    BOOST_CHECK(f.shift() == 3);
+    BOOST_CHECK(f.mask() == 0x38);
+
+    struct rtde_data_package *dp = r.get_dp();
+    BOOST_CHECK(r.store(dp));
+    unsigned char *payload = rtde_data_package_get_payload(dp);
+    // stop | cmd << 1 | level << 3
+    BOOST_CHECK(payload[4] == 0 && payload[5] == 0 && payload[6] == 0 && payload[7] == (1 | 3 << 1 | 5 << 3));
+    BOOST_CHECK(payload[8] == 0 && payload[9] == 0 && payload[10] == 0 && payload[11] == 0);
+
+    b = true;
+    BOOST_CHECK(r.store(dp));
+    BOOST_CHECK(payload[10] == 0x01);
+
+    std::string script = r.bit_field_script();
+    BOOST_CHECK(script.find("def get_stop():\n    return read_input_boolean_register(0)\nend\n") != std::string::npos);
+    BOOST_CHECK(script.find("def get_cmd():\n    return binary_list_to_integer([read_input_boolean_register(1), "
+                            "read_input_boolean_register(2)])\nend\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_recipe_bit_fields_out)
+{
+    bool done = false;
+    Test_Cmd state = CMD_NONE;
+    BOOST_CHECK(r.add_bit_field("done", &done, 1, 32) == 32);
+    BOOST_CHECK(r.add_bit_field("state", &state, 2) == 33);
+    BOOST_CHECK(r.get_fields() == "output_bit_registers32_to_63");
+
+    unsigned char buf[4] = { 0, 0, 0, 1 | 2 << 1 };
+    BOOST_CHECK(r.parse(buf));
+    BOOST_CHECK(done);
+    BOOST_CHECK(state == CMD_GO);
+
+    std::string script = r.bit_field_script();
+    BOOST_CHECK(script.find("def set_state(v):\n    b = integer_to_binary_list(v)\n"
+                            "    write_output_boolean_register(33, b[0])\n"
+                            "    write_output_boolean_register(34, b[1])\nend\n") != std::string::npos);
+
+    r.clear_fields();
+    BOOST_CHECK(r.get_bit_fields().empty());
+    BOOST_CHECK(r.add_bit_field("done", &done) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE script_cache
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/script_cache.hpp>
+#include <fstream>
+#include <cstdio>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+static void write_file(const std::string& fname, const std::string& content, time_t mtime)
+{
+    std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+    out << content;
+    out.close();
+
+    // set explicit mtime, fs timestamps are too coarse to rely on
+    struct timespec ts[2] = { {mtime, 0}, {mtime, 0} };
+    utimensat(AT_FDCWD, fname.c_str(), ts, 0);
+}
+
+struct F
+{
+    F() : fname("script_cache_test.script"), fname2("script_cache_test2.script") {}
+    ~F()
+    {
+        remove(fname.c_str());
+        remove(fname2.c_str());
+    }
+    std::string fname;
+    std::string fname2;
+    urx::Script_Cache cache;
+};
+
+BOOST_FIXTURE_TEST_SUITE(s, F)
+
+BOOST_AUTO_TEST_CASE(test_template_normalize)
+{
+    urx::Script_Template t("def prog():\r\n\ttextmsg(\"hi\")\r\nend\n");
+    BOOST_CHECK(t.text() == "def prog():\n        textmsg(\"hi\")\nend\n");
+    BOOST_CHECK(!t.has_placeholders());
+
+    std::string out;
+    BOOST_CHECK(t.render({}, out));
+    BOOST_CHECK(out == t.text());
+
+    // missing final newline is added, as when read line by line
+    urx::Script_Template u("def prog():\n\tsync()\nend");
+    BOOST_CHECK(u.text() == "def prog():\n        sync()\nend\n");
+    BOOST_CHECK(urx::Script_Template("").text().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_template_placeholders)
+{
+    urx::Script_Template t("x = read_input_integer_register(${reg})\nservoj(q, gain=${gain})\ny = ${reg}\n${ not a placeholder} ${}");
+    BOOST_CHECK(t.placeholders().size() == 2);
+
+    std::string out;
+    BOOST_CHECK(!t.render({{"reg", "24"}}, out));
+    BOOST_CHECK(t.render({{"reg", "24"}, {"gain", "300"}, {"unused", "x"}}, out));
+    BOOST_CHECK(out == "x = read_input_integer_register(24)\nservoj(q, gain=300)\ny = 24\n${ not a placeholder} ${}\n");
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_hits)
+{
+    write_file(fname, "a = ${reg}\n", 1000);
+
+    auto s1 = cache.script(fname, {{"reg", "1"}});
+    BOOST_REQUIRE(s1);
+    BOOST_CHECK(*s1 == "a = 1\n");
+
+    // same params, same buffer, no re-read
+    auto s2 = cache.script(fname, {{"reg", "1"}});
+    BOOST_CHECK(s1 == s2);
+    BOOST_CHECK(cache.stats().reads == 1);
+    BOOST_CHECK(cache.stats().hits == 1);
+    BOOST_CHECK(cache.stats().renders == 1);
+
+    // different params, render only
+    auto s3 = cache.script(fname, {{"reg", "2"}});
+    BOOST_CHECK(*s3 == "a = 2\n");
+    BOOST_CHECK(cache.stats().reads == 1);
+    BOOST_CHECK(cache.stats().compiles == 1);
+
+    // missing placeholder
+    BOOST_CHECK(!cache.script(fname));
+    BOOST_CHECK(!cache.script("/dev/foo/bar"));
+}
+
+BOOST_AUTO_TEST_CASE(test_cache_invalidate)
+{
+    write_file(fname, "a = 1\n", 1000);
+    auto s1 = cache.script(fname);
+    BOOST_CHECK(*s1 == "a = 1\n");
+
+    // new mtime and content
+    write_file(fname, "a = 2\n", 2000);
+    auto s2 = cache.script(fname);
+    BOOST_CHECK(*s2 == "a = 2\n");
+    BOOST_CHECK(cache.stats().reads == 2);
+    BOOST_CHECK(cache.stats().compiles == 2);
+
+    // touched, but same content, read but not compiled
+    write_file(fname, "a = 2\n", 3000);
+    auto s3 = cache.script(fname);
+    BOOST_CHECK(s3 == s2);
+    BOOST_CHECK(cache.stats().reads == 3);
+    BOOST_CHECK(cache.stats().compiles == 2);
+
+    // other file, same content, shares the compiled template
+    write_file(fname2, "a = 2\n", 1000);
+    BOOST_CHECK(cache.get(fname2) == cache.get(fname));
+    BOOST_CHECK(cache.stats().compiles == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,9 @@
 #define TEST_HELPERS_HPP
 
 #include <stdlib.h>
+#include <endian.h>
+#include <cstring>
+#include <cstdint>
 #include <urx/header.hpp>
 
 static inline struct rtde_control_package_resp * create_cp_resp()
@@ -26,4 +29,19 @@ static inline void _set_recipe_resp(struct rtde_control_package_resp *resp, std:
     strncpy(dst, variables.c_str(), variables.length()+1);
 }
 
+// big-endian values, as in a data package payload
+static inline void put_double(unsigned char *p, double d)
+{
+    uint64_t v;
+    memcpy(&v, &d, sizeof(v));
+    v = htobe64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void put_int(unsigned char *p, int32_t i)
+{
+    uint32_t v = htobe32((uint32_t)i);
+    memcpy(p, &v, sizeof(v));
+}
+
 #endif  // TEST_HELPERS_HPP
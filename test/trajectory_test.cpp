@@ -0,0 +1,128 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#define BOOST_TEST_MODULE trajectory
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <urx/trajectory.hpp>
+#include <urx/rtde_recipe.hpp>
+#include <urx/header.hpp>
+#include <endian.h>
+#include <cstring>
+
+static urx::Waypoint wp(double t, double v)
+{
+    urx::Waypoint w;
+    w.t = t;
+    w.q.fill(v);
+    return w;
+}
+
+static double reg_double(unsigned char *payload, std::size_t reg)
+{
+    uint64_t v;
+    memcpy(&v, payload + 2 * 4 + reg * 8, sizeof(v));
+    v = be64toh(v);
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+BOOST_AUTO_TEST_SUITE(trajectory_test)
+
+BOOST_AUTO_TEST_CASE(test_trajectory_recipes)
+{
+    urx::Trajectory_Stream ts;
+    urx::RTDE_Recipe out;
+    urx::RTDE_Recipe in;
+    in.dir_input();
+
+    BOOST_CHECK(ts.add_output_fields(&out));
+    BOOST_CHECK(out.num_fields() == 1);
+    BOOST_CHECK(out.get_fields() == "output_int_register_24");
+
+    // wrong direction
+    BOOST_CHECK(!ts.add_output_fields(&in));
+    BOOST_CHECK(!ts.add_input_fields(&out));
+
+    BOOST_CHECK(ts.add_input_fields(&in));
+    BOOST_CHECK(in.num_fields() == 2 + urx::TRAJ_RING * urx::TRAJ_SLOT_REGS);
+    BOOST_CHECK(in.expected_bytes() == 2 * 4 + urx::TRAJ_RING * urx::TRAJ_SLOT_REGS * 8);
+}
+
+BOOST_AUTO_TEST_CASE(test_trajectory_push)
+{
+    urx::Trajectory_Stream ts(4);
+    BOOST_CHECK(ts.space() == 4);
+    BOOST_CHECK(ts.push(wp(0.1, 0)));
+    BOOST_CHECK(ts.push(wp(0.2, 0)));
+
+    // time must increase
+    BOOST_CHECK(!ts.push(wp(0.2, 0)));
+    BOOST_CHECK(!ts.push(wp(0.15, 0)));
+
+    BOOST_CHECK(ts.push(wp(0.3, 0)));
+    BOOST_CHECK(ts.push(wp(0.4, 0)));
+    BOOST_CHECK(ts.space() == 0);
+    BOOST_CHECK(!ts.push(wp(0.5, 0)));
+}
+
+BOOST_AUTO_TEST_CASE(test_trajectory_flow)
+{
+    urx::Trajectory_Stream ts(8);
+    urx::RTDE_Recipe out;
+    urx::RTDE_Recipe in;
+    in.dir_input();
+    ts.add_output_fields(&out);
+    ts.add_input_fields(&in);
+
+    // first sync always sends the mode
+    BOOST_CHECK(ts.sync());
+    BOOST_CHECK(!ts.sync());
+
+    for (int i = 1; i <= 5; i++)
+        BOOST_CHECK(ts.push(wp(0.002 * i, i)));
+
+    // nothing consumed, only room for TRAJ_RING in the ring
+    BOOST_CHECK(ts.sync());
+    BOOST_CHECK(ts.written() == (int32_t)urx::TRAJ_RING);
+    BOOST_CHECK(ts.in_flight() == urx::TRAJ_RING);
+    BOOST_CHECK(ts.buffered() == 5 - urx::TRAJ_RING);
+    BOOST_CHECK(ts.space() == 8 - (5 - urx::TRAJ_RING));
+    BOOST_CHECK(!ts.sync());
+
+    // first waypoint's time is its duration, then deltas
+    struct rtde_data_package *dp = in.get_dp();
+    BOOST_CHECK(in.store(dp));
+    unsigned char *payload = rtde_data_package_get_payload(dp);
+    BOOST_CHECK_CLOSE(reg_double(payload, 0), 0.002, 1e-9);
+    BOOST_CHECK_CLOSE(reg_double(payload, 1), 1.0, 1e-9);
+    BOOST_CHECK_CLOSE(reg_double(payload, urx::TRAJ_SLOT_REGS), 0.002, 1e-9);
+    BOOST_CHECK_CLOSE(reg_double(payload, urx::TRAJ_SLOT_REGS + 6), 2.0, 1e-9);
+
+    // pretend controller consumed 2 by way of the output recipe
+    unsigned char buf[4] = { 0, 0, 0, 2 };
+    BOOST_CHECK(out.parse(buf));
+    BOOST_CHECK(ts.consumed() == 2);
+    BOOST_CHECK(ts.sync());
+    BOOST_CHECK(ts.written() == 5);
+    BOOST_CHECK(ts.buffered() == 0);
+
+    // waypoint 4 and 5 wrapped around to slot 0 and 1
+    BOOST_CHECK(in.store(dp));
+    BOOST_CHECK_CLOSE(reg_double(payload, 1), 4.0, 1e-9);
+    BOOST_CHECK_CLOSE(reg_double(payload, urx::TRAJ_SLOT_REGS + 1), 5.0, 1e-9);
+    BOOST_CHECK_CLOSE(reg_double(payload, 2 * urx::TRAJ_SLOT_REGS + 1), 3.0, 1e-9);
+
+    // stopping must reach the controller even when the ring is idle
+    ts.finish();
+    BOOST_CHECK(ts.sync());
+    BOOST_CHECK(!ts.sync());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
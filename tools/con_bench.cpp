@@ -0,0 +1,212 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+/*
+ * Receive-path cost per arm, socket Con vs. Con_Uring.
+ *
+ * A local emulator streams RTDE data packages to a number of "arms"
+ * over loopback at the controller rate. Each arm is a thread receiving
+ * with the selected backend, and reports CPU time, context switches
+ * and syscalls per frame.
+ */
+#include <urx/con.hpp>
+#include <urx/con_uring.hpp>
+#include <urx/header.hpp>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <string>
+
+struct Arm_Result {
+    uint64_t frames;
+    uint64_t calls;             // do_recv() calls returning data
+    double cpu_us;
+    long ctx_switches;
+    uint64_t syscalls;
+};
+
+static int listen_local(int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 64) ||
+        getsockname(fd, (struct sockaddr *)&addr, &len)) {
+        perror("emulator");
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// stream frames to all arms at a fixed rate, then hang up
+static void emulator(int lfd, int arms, int frames, int rate, int payload)
+{
+    std::vector<int> socks;
+    for (int i = 0; i < arms; i++)
+        socks.push_back(accept(lfd, NULL, NULL));
+
+    std::vector<unsigned char> frame(sizeof(struct rtde_data_package) + payload, 0);
+    struct rtde_data_package *dp = (struct rtde_data_package *)frame.data();
+    dp->hdr.size = htons(frame.size());
+    dp->hdr.type = RTDE_DATA_PACKAGE;
+    dp->recipe_id = 1;
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    long period_ns = rate > 0 ? 1000000000L / rate : 0;
+    for (int f = 0; f < frames; f++) {
+        for (int s : socks)
+            send(s, frame.data(), frame.size(), 0);
+        if (!period_ns)
+            continue;
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    for (int s : socks) {
+        shutdown(s, SHUT_RDWR);
+        close(s);
+    }
+}
+
+static void arm(urx::Con *con, bool uring, int frame_sz, Arm_Result *res)
+{
+    unsigned char buf[2048];
+    uint64_t bytes = 0;
+    uint64_t calls = 0;
+
+    struct timespec c0, c1;
+    struct rusage r0, r1;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    getrusage(RUSAGE_THREAD, &r0);
+    for (;;) {
+        int n = con->do_recv(buf, sizeof(buf));
+        if (n < 0)
+            break;
+        bytes += n;
+        calls++;
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    getrusage(RUSAGE_THREAD, &r1);
+
+    res->frames = bytes / frame_sz;
+    res->calls = calls;
+    res->cpu_us = (c1.tv_sec - c0.tv_sec) * 1e6 + (c1.tv_nsec - c0.tv_nsec) / 1e3;
+    res->ctx_switches = (r1.ru_nvcsw - r0.ru_nvcsw) + (r1.ru_nivcsw - r0.ru_nivcsw);
+
+    // Con does poll() + recvfrom() per call (and one poll() seeing the
+    // EOF), Con_Uring counts its own enters.
+    if (uring)
+        res->syscalls = ((urx::Con_Uring *)con)->stats().enters;
+    else
+        res->syscalls = 2 * calls + 2;
+}
+
+static bool run(const std::string& backend, int arms, int frames, int rate, int payload)
+{
+    int port;
+    int lfd = listen_local(&port);
+    if (lfd < 0)
+        return false;
+
+    bool uring = backend == "uring";
+    std::vector<urx::Con *> cons;
+    for (int i = 0; i < arms; i++) {
+        urx::Con *c = uring ? new urx::Con_Uring("127.0.0.1", port) : new urx::Con("127.0.0.1", port);
+        if (!c->do_connect(true))
+            return false;
+        if (uring && !((urx::Con_Uring *)c)->uring())
+            std::cerr << "io_uring not available, numbers are for the socket fallback" << std::endl;
+        cons.push_back(c);
+    }
+
+    int frame_sz = sizeof(struct rtde_data_package) + payload;
+    std::vector<Arm_Result> res(arms);
+    std::vector<std::thread> threads;
+    std::thread emu(emulator, lfd, arms, frames, rate, payload);
+    for (int i = 0; i < arms; i++)
+        threads.emplace_back(arm, cons[i], uring, frame_sz, &res[i]);
+    for (auto &t : threads)
+        t.join();
+    emu.join();
+    close(lfd);
+
+    Arm_Result tot = {0, 0, 0.0, 0, 0};
+    for (const auto &r : res) {
+        tot.frames += r.frames;
+        tot.calls += r.calls;
+        tot.cpu_us += r.cpu_us;
+        tot.ctx_switches += r.ctx_switches;
+        tot.syscalls += r.syscalls;
+    }
+    double f = tot.frames ? (double)tot.frames : 1.0;
+    printf("%-7s arms=%d frames/arm=%lu  cpu/frame=%6.2f us  syscalls/frame=%5.2f  ctxsw/frame=%5.2f  cpu/arm=%7.1f ms\n",
+           backend.c_str(), arms, (unsigned long)(tot.frames / arms), tot.cpu_us / f,
+           tot.syscalls / f, tot.ctx_switches / f, tot.cpu_us / arms / 1000.0);
+
+    for (auto c : cons)
+        delete c;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int arms = 4;
+    int frames = 5000;
+    int rate = 500;
+    int payload = 8 + 6 * 6 * 8;        // timestamp + 6 joint vectors
+    std::string backend = "both";
+    int opt;
+    while ((opt = getopt(argc, argv, "a:n:r:s:b:h")) != -1) {
+        switch (opt) {
+        case 'a':
+            arms = atoi(optarg);
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 's':
+            payload = atoi(optarg);
+            break;
+        case 'b':
+            backend = optarg;
+            break;
+        default:
+            std::cout << "Usage: " << argv[0] << " [-a arms] [-n frames] [-r rate Hz, 0: flat out] [-s payload bytes] [-b socket|uring|both]" << std::endl;
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+    if (arms <= 0 || frames <= 0 || payload <= 0 || payload + sizeof(struct rtde_data_package) > 2000) {
+        std::cerr << "Invalid arguments" << std::endl;
+        return -1;
+    }
+
+    if (backend == "both" || backend == "socket")
+        if (!run("socket", arms, frames, rate, payload))
+            return -1;
+    if (backend == "both" || backend == "uring")
+        if (!run("uring", arms, frames, rate, payload))
+            return -1;
+    return 0;
+}
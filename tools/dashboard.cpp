@@ -0,0 +1,32 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+#include <iostream>
+#include <urx/dashboard_handler.hpp>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cout << "Wrong number of arguments, want:" << std::endl;
+        std::cout << argv[0] << " <IP> <command> [<command> ...]" << std::endl;
+        std::cout << "e.g. " << argv[0] << " 10.0.0.2 \"power on\" \"brake release\"" << std::endl;
+        return 1;
+    }
+
+    urx::Dashboard_Handler h(argv[1]);
+    if (!h.is_connected()) {
+        std::cout << "Failed connecting to dashboard server on " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // send everything in one go, then collect the answers
+    std::vector<std::string> cmds(argv + 2, argv + argc);
+    auto res = h.batch(cmds);
+    for (std::size_t i = 0; i < cmds.size(); i++)
+        std::cout << cmds[i] << ": " << res[i].get() << std::endl;
+    return 0;
+}
@@ -7,12 +7,14 @@
  */
 #include <iostream>
 #include <urx/rtde_handler.hpp>
+#include <urx/log_file.hpp>
 #include <urx/helper.hpp>
 #include <stdio.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string.h>
+#include <sstream>
 
 static int loopctr = 5000;
 void write_file(const char *fname, std::vector<std::tuple<unsigned long,double>> ts)
@@ -30,15 +32,20 @@ void write_file(const char *fname, std::vector<std::tuple<unsigned long,double>>
 void usage(const char *argv0)
 {
     std::cout << "Usage: " << std::endl;
-    std::cout << argv0 << " -i UR_Controller_IPv4 -c CSV_File -l loops [-h help]" << std::endl;
+    std::cout << argv0 << " -i UR_Controller_IPv4 [-c CSV_File] [-o log_file [-z]] [-f field,field..] -l loops [-h help]" << std::endl;
+    std::cout << "  -o writes a columnar log (see urx/log_file.hpp) of timestamp and fields" << std::endl;
+    std::cout << "  -z compresses the log (see urx/codec.hpp)" << std::endl;
 }
 
 int main(int argc, char *argv[])
 {
     char ip4[16] = {0};
     char csv_file[256] = {0};
+    std::string log_file;
+    std::string fields;
+    bool compress = false;
     int opt;
-    while ((opt = getopt(argc, argv, "i:c:hl:")) != -1) {
+    while ((opt = getopt(argc, argv, "i:c:o:f:zhl:")) != -1) {
         switch (opt) {
         case 'i':
             strncpy(ip4, optarg, 15);
@@ -47,6 +54,15 @@ int main(int argc, char *argv[])
             strncpy(csv_file, optarg, 255);
             std::cout << "copy optarg (" << optarg << ") into csv_file" << std::endl;
             break;
+        case 'o':
+            log_file = optarg;
+            break;
+        case 'f':
+            fields = optarg;
+            break;
+        case 'z':
+            compress = true;
+            break;
         case 'l':
             loopctr = atoi(optarg);
             break;
@@ -59,7 +75,7 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (strlen(ip4) <= 0 || strlen(csv_file) <= 0)  {
+    if (strlen(ip4) <= 0 || (strlen(csv_file) <= 0 && log_file.empty()))  {
         std::cerr << "Need IP for UR Controller and filename to log to!" << std::endl;
         usage(argv[0]);
         return 1;
@@ -79,6 +95,25 @@ int main(int argc, char *argv[])
     out.track_ts_ns(&ts_ns);
     out.add_field("timestamp", &ur_ts);
 
+    // Extra fields only go to the log, values are decoded from the
+    // frame so the storage is just scratch space.
+    double scratch[64][6];
+    std::stringstream ss(fields);
+    std::string field;
+    for (int i = 0; std::getline(ss, field, ','); i++) {
+        if (i >= 64 || !out.add_field(field, scratch[i])) {
+            std::cerr << "Cannot record " << field << std::endl;
+            return -1;
+        }
+    }
+
+    urx::Log_Writer log(&out, urx::LOG_CHUNK_FRAMES, compress);
+    if (!log_file.empty()) {
+        if (!log.open(log_file))
+            return -1;
+        out.add_sink(&log);
+    }
+
     if (!h.register_recipe(&out)) {
         std::cerr << __func__ << ": Failed setting output_recipe!" << std::endl;
         return -1;
@@ -96,6 +131,12 @@ int main(int argc, char *argv[])
         }
     }
     h.stop();
+    out.remove_sink(&log);
+    if (log.is_open())
+        std::cout << "Wrote " << log.frames() << " frames to " << log_file << std::endl;
+    log.close();
+    if (log.dropped())
+        std::cout << "Dropped " << log.dropped() << " frames, encoder could not keep up" << std::endl;
 
     if (strlen(csv_file) > 0)
         write_file(csv_file, ts_set);
@@ -10,6 +10,7 @@
 #include <urx/helper.hpp>
 #include <unistd.h>
 #include <iostream>
+#include <algorithm>
 
 #include <chrono>
 using namespace std::chrono;
@@ -27,6 +28,24 @@ void write_file(const char *fname, std::vector<std::tuple<long,double>> ts)
     fclose(ts_log_fd);
 }
 
+// Tail latency is what the socket profile (-L) is about, so report the
+// distribution and not only an average.
+void print_percentiles(std::vector<long> rtt_us, bool low_latency)
+{
+    if (rtt_us.empty())
+        return;
+    std::sort(rtt_us.begin(), rtt_us.end());
+    auto pct = [&](double p) { return rtt_us[(std::size_t)(p * (rtt_us.size() - 1))]; };
+
+    printf("round-trip [us], %s profile, %zu samples\n", low_latency ? "low-latency" : "default", rtt_us.size());
+    printf("  min   %6ld\n", rtt_us.front());
+    printf("  p50   %6ld\n", pct(0.50));
+    printf("  p90   %6ld\n", pct(0.90));
+    printf("  p99   %6ld\n", pct(0.99));
+    printf("  p99.9 %6ld\n", pct(0.999));
+    printf("  max   %6ld\n", rtt_us.back());
+}
+
 static FILE *tracefd = NULL;
 void tag_tracebuffer(int expseqnr, int actseqnr, long diff_us)
 {
@@ -67,7 +86,8 @@ int main(int argc, char *argv[])
     int opt;
     int loopctr = 5000;
     int trace_timeout = -1;
-    while ((opt = getopt(argc, argv, "c:i:l:f:t:")) != -1) {
+    bool low_latency = false;
+    while ((opt = getopt(argc, argv, "c:i:l:f:t:L")) != -1) {
         switch (opt) {
         case 'c':
             strncpy(csv_file, optarg, 255);
@@ -94,6 +114,10 @@ int main(int argc, char *argv[])
                 if (!tracefd)
                     perror("Unable to open trace-marker");
             }
+            break;
+        case 'L':
+            low_latency = true;
+            break;
         }
     }
 
@@ -103,6 +127,8 @@ int main(int argc, char *argv[])
     }
 
     urx::RTDE_Handler h(ip4);
+    if (low_latency)
+        h.set_profile(urx::Con_Profile::low_latency());
     h.connect_ur();
     if (!h.set_version()) {
         std::cout << "Setting version FAILED" << std::endl;
@@ -143,6 +169,8 @@ int main(int argc, char *argv[])
     h.recv();
 
     std::vector<std::tuple<long, double>> ts_set;
+    std::vector<long> rtt_us;
+    rtt_us.reserve(loopctr);
     long err_ctr = 100;
 
     bool horiz_found = false;
@@ -167,6 +195,7 @@ int main(int argc, char *argv[])
             goto again;
 
         ts_set.push_back(std::tuple<long, double>(end_us, ts));
+        rtt_us.push_back(diff);
 
         if (diff > trace_timeout)
             stop_trace();
@@ -192,6 +221,7 @@ int main(int argc, char *argv[])
     }
 
     stop_trace();
+    print_percentiles(rtt_us, low_latency);
 
     in_seqnr = 200000;          // trigger close in script
     h.send(in.recipe_id());
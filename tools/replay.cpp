@@ -0,0 +1,115 @@
+/*
+ * Copyright 2023 SINTEF AS
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not distributed
+ * with this file, You can obtain one at https://mozilla.org/MPL/2.0/
+ */
+/*
+ * Decode throughput on recorded data.
+ *
+ * Plays a log written by get_remote -o through RTDE_Handler and the
+ * recipe decode path (see urx/replayer.hpp), registering either the
+ * recorded fields or the ones given with -f, and reports frames/s and
+ * the time spent per frame in parse_incoming_data().
+ */
+#include <urx/replayer.hpp>
+#include <urx/rtde_handler.hpp>
+#include <urx/rtde_recipe.hpp>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+void usage(const char *argv0)
+{
+    std::cout << "Usage: " << std::endl;
+    std::cout << argv0 << " -r log_file [-s speed] [-f field,field..] [-n repeat] [-h help]" << std::endl;
+    std::cout << "  -s 1: as recorded, 10: ten times faster, 0: as fast as possible (default)" << std::endl;
+    std::cout << "  -n plays the log this many times" << std::endl;
+}
+
+// recorded fields, "actual_q[2]" -> "actual_q"
+static std::string recorded_fields(const urx::Log_Reader& r)
+{
+    std::string fields;
+    std::string last;
+    for (std::size_t c = 0; c < r.num_columns(); c++) {
+        std::string name = r.column_name(c);
+        name = name.substr(0, name.find('['));
+        if (name == "t" || name == "rx_ns" || name == last)
+            continue;
+        if (!fields.empty())
+            fields += ",";
+        fields += name;
+        last = name;
+    }
+    return fields;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string log_file;
+    std::string fields;
+    double speed = 0.0;
+    int repeat = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:f:n:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            log_file = optarg;
+            break;
+        case 's':
+            speed = atof(optarg);
+            break;
+        case 'f':
+            fields = optarg;
+            break;
+        case 'n':
+            repeat = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (log_file.empty() || repeat <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int run = 0; run < repeat; run++) {
+        auto rp = new urx::Replayer(log_file, speed);
+        urx::RTDE_Handler h(rp);
+        if (!h.is_connected() || !h.set_version())
+            return -1;
+        if (fields.empty())
+            fields = recorded_fields(rp->reader());
+
+        // values are decoded into scratch space
+        urx::RTDE_Recipe out;
+        double scratch[64][6];
+        std::stringstream ss(fields);
+        std::string field;
+        for (int i = 0; std::getline(ss, field, ','); i++) {
+            if (i >= 64 || !out.add_field(field, scratch[i])) {
+                std::cerr << "Cannot replay " << field << std::endl;
+                return -1;
+            }
+        }
+        if (!h.register_recipe(&out)) {
+            std::cerr << "Failed setting output_recipe!" << std::endl;
+            return -1;
+        }
+
+        uint64_t ok = rp->run(&h);
+        auto s = rp->stats();
+        printf("run %d: frames=%lu accepted=%lu  wall=%8.3f s  %10.0f frames/s  decode=%7.1f ns/frame  max lag=%6.3f ms\n",
+               run, (unsigned long)s.frames, (unsigned long)ok, s.wall_s, s.fps, s.decode_ns, s.max_lag_ms);
+    }
+    return 0;
+}